@@ -11,6 +11,8 @@ import ij.CompositeImage;
 
 import java.io.*;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.ShortBuffer;
 import java.nio.channels.FileChannel;
 
 import ij.IJ;
@@ -475,6 +477,69 @@ public class ImageJ_Reader {
         }
     }
 
+    /* Fills caller-owned direct buffers (one per z slice) in place.
+       The buffers wrap native memory allocated by FluoRender, so the pixels are
+       written straight into the final volume without intermediate Java arrays.
+       bytes is 1 for 8-bit and 2 for 16-bit output.
+       Returns 0 on success, 1/2/3 for format/io/other errors and 4 for a size mismatch.
+     */
+    public static int readToBuffers(String[] args, int time_id, int channel_id, int bytes, ByteBuffer[] slices) {
+        String id = args[0];
+        ImageProcessorReader ip_reader = new ImageProcessorReader(new ChannelSeparator(LociPrefs.makeImageReader()));
+        try {
+            ip_reader.setId(id);
+            int width = ip_reader.getSizeX();
+            int height = ip_reader.getSizeY();
+            int channels = ip_reader.getSizeC();
+            int depth = ip_reader.getSizeZ();
+            int slice_size = width * height;
+
+            if (slices.length < depth)
+                return 4;
+
+            int time_offset = time_id * channels * depth;
+            for (int d = 0; d < depth; ++d) {
+                ByteBuffer buffer = slices[d];
+                if (buffer == null || buffer.capacity() < slice_size * bytes)
+                    return 4;
+                buffer.clear();
+                buffer.order(ByteOrder.nativeOrder());
+
+                ImageProcessor ip = ip_reader.openProcessors(time_offset + d * channels + channel_id)[0];
+                Object pixels = ip.getPixels();
+                if (bytes == 1 && pixels instanceof byte[]) {
+                    //bulk copy, same layout as the volume
+                    buffer.put((byte[])pixels, 0, slice_size);
+                }
+                else if (bytes == 2 && pixels instanceof short[]) {
+                    ShortBuffer sbuf = buffer.asShortBuffer();
+                    sbuf.put((short[])pixels, 0, slice_size);
+                }
+                else if (bytes == 1) {
+                    for (int i = 0; i < slice_size; ++i)
+                        buffer.put(i, (byte)ip.get(i));
+                }
+                else {
+                    ShortBuffer sbuf = buffer.asShortBuffer();
+                    for (int i = 0; i < slice_size; ++i)
+                        sbuf.put(i, (short)ip.get(i));
+                }
+            }
+            return 0;
+        } catch (FormatException exc) {
+            return 1;
+        } catch (IOException exc) {
+            return 2;
+        } catch (Exception exc) {
+            return 3;
+        } finally {
+            try {
+                ip_reader.close();
+            } catch (IOException exc) {
+            }
+        }
+    }
+
     private static ImagePlus applyLookupTables(IFormatReader r, ImagePlus imp, byte[][][] lookupTable) {
         // apply color lookup tables, if present
         // this requires ImageJ v1.39 or higher
@@ -673,6 +673,13 @@ void ChannelCompare::Product()
 		long nx, ny, nz, bits1, bits2;
 		if (!GetInfo(b1, b2, bits1, bits2, nx, ny, nz))
 			continue;
+		//nothing to add from empty bricks
+		if (b1->is_empty(0) || b2->is_empty(0))
+			continue;
+		if (m_use_mask &&
+			(b1->is_empty(b1->nmask()) ||
+			b2->is_empty(b2->nmask())))
+			continue;
 		//get tex ids
 		GLint tid1 = m_vd1->GetVR()->load_brick(b1);
 		GLint tid2 = m_vd2->GetVR()->load_brick(b2);
@@ -788,6 +795,13 @@ void ChannelCompare::MinValue()
 		long nx, ny, nz, bits1, bits2;
 		if (!GetInfo(b1, b2, bits1, bits2, nx, ny, nz))
 			continue;
+		//nothing to add from empty bricks
+		if (b1->is_empty(0) || b2->is_empty(0))
+			continue;
+		if (m_use_mask &&
+			(b1->is_empty(b1->nmask()) ||
+			b2->is_empty(b2->nmask())))
+			continue;
 		//get tex ids
 		GLint tid1 = m_vd1->GetVR()->load_brick(b1);
 		GLint tid2 = m_vd2->GetVR()->load_brick(b2);
@@ -903,6 +917,11 @@ void ChannelCompare::Threshold(float th1, float th2, float th3, float th4)
 		long nx, ny, nz, bits1, bits2;
 		if (!GetInfo(b1, b2, bits1, bits2, nx, ny, nz))
 			continue;
+		//nothing to add from empty bricks
+		if (m_use_mask &&
+			(b1->is_empty(b1->nmask()) ||
+			b2->is_empty(b2->nmask())))
+			continue;
 		//get tex ids
 		GLint tid1 = m_vd1->GetVR()->load_brick(b1);
 		GLint tid2 = m_vd2->GetVR()->load_brick(b2);
@@ -190,6 +190,9 @@ void CountVoxels::Count()
 		long nx, ny, nz, bits;
 		if (!GetInfo(b, bits, nx, ny, nz))
 			continue;
+		//skip bricks without selection
+		if (b->is_empty(b->nmask()))
+			continue;
 		//get tex ids
 		GLint tid = m_vd->GetVR()->load_brick(b);
 		GLint mid = m_vd->GetVR()->load_brick_mask(b);
@@ -27,12 +27,21 @@ DEALINGS IN THE SOFTWARE.
 */
 #include "ClusterMethod.h"
 #include <boost/qvm/vec_access.hpp>
+#include <algorithm>
 
 using namespace FL;
 
 void ClusterMethod::AddClusterPoint(const EmVec &p, const float value, int cid)
 {
-	pClusterPoint pp(new ClusterPoint);
+	//a full block is left to the points in it
+	if (!m_block || m_block->size() == m_block->capacity())
+	{
+		m_block.reset(new PointBlock);
+		m_block->reserve(std::max(m_reserve, size_t(4096)));
+		m_reserve = 0;
+	}
+	m_block->push_back(ClusterPoint());
+	pClusterPoint pp(m_block, &m_block->back());
 	pp->id = m_id_counter++;
 	pp->cid = cid;
 	pp->visited = false;
@@ -54,7 +63,12 @@ void ClusterMethod::GenerateNewIDs(unsigned int id, void* label,
 	if (out_cells)
 		m_out_cells.clear();
 
-	unsigned int id2 = id;
+	std::vector<unsigned int> ids;
+	if (m_used_ids)
+		FindFreeIds(*m_used_ids, id, inc, m_result.size(), ids);
+	else
+		FindFreeIds(label, id, nx, ny, nz, inc, m_result.size(), ids);
+	unsigned int id2;
 	unsigned long long index;
 	int i, j, k;
 	Cell* cell = 0;
@@ -62,12 +76,7 @@ void ClusterMethod::GenerateNewIDs(unsigned int id, void* label,
 	for (size_t ii = 0; ii < m_result.size(); ++ii)
 	{
 		Cluster &cluster = m_result[ii];
-		do
-		{
-			id2 += inc;
-			if (id2 == id)
-				break;
-		} while (!id2 || FindId(label, id2, nx, ny, nz));
+		id2 = ids[ii];
 
 		if (out_cells)
 			cell = new Cell(id2);
@@ -112,6 +121,89 @@ bool ClusterMethod::FindId(void* label, unsigned int id,
 	return false;
 }
 
+void ClusterMethod::FindFreeIds(void* label, unsigned int id,
+	size_t nx, size_t ny, size_t nz,
+	unsigned int inc, size_t num,
+	std::vector<unsigned int> &ids)
+{
+	ids.clear();
+	unsigned long long for_size = (unsigned long long)nx *
+		(unsigned long long)ny * (unsigned long long)nz;
+	unsigned int* data = (unsigned int*)label;
+	unsigned int id2 = id;
+	bool wrapped = false;
+	while (ids.size() < num && !wrapped)
+	{
+		//candidates in sequence, with spares for the ids taken
+		std::vector<unsigned int> cands;
+		size_t cand_num = (num - ids.size()) * 2 + 8;
+		while (cands.size() < cand_num)
+		{
+			id2 += inc;
+			if (id2 == id)
+			{
+				wrapped = true;
+				break;
+			}
+			if (id2)
+				cands.push_back(id2);
+		}
+		if (cands.empty())
+			break;
+		std::vector<unsigned int> sorted = cands;
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<char> used(sorted.size(), 0);
+		unsigned int lo = sorted.front();
+		unsigned int span = sorted.back() - lo;
+		//most blocks have none in range
+		const unsigned long long block = 4096;
+		for (unsigned long long b = 0; b < for_size; b += block)
+		{
+			unsigned long long e = std::min(b + block, for_size);
+			bool hit = false;
+			for (unsigned long long index = b; index < e; ++index)
+				hit |= data[index] - lo <= span;
+			if (!hit)
+				continue;
+			for (unsigned long long index = b; index < e; ++index)
+			{
+				if (data[index] - lo > span)
+					continue;
+				auto it = std::lower_bound(sorted.begin(), sorted.end(), data[index]);
+				if (it != sorted.end() && *it == data[index])
+					used[it - sorted.begin()] = 1;
+			}
+		}
+		for (size_t ci = 0; ci < cands.size() && ids.size() < num; ++ci)
+		{
+			auto it = std::lower_bound(sorted.begin(), sorted.end(), cands[ci]);
+			if (!used[it - sorted.begin()])
+				ids.push_back(cands[ci]);
+		}
+	}
+	//the sequence returns to id when all are taken
+	while (ids.size() < num)
+		ids.push_back(id);
+}
+
+void ClusterMethod::FindFreeIds(const std::vector<unsigned int> &used,
+	unsigned int id, unsigned int inc, size_t num,
+	std::vector<unsigned int> &ids)
+{
+	ids.clear();
+	unsigned int id2 = id;
+	while (ids.size() < num)
+	{
+		id2 += inc;
+		if (id2 == id)
+			break;
+		if (id2 && !std::binary_search(used.begin(), used.end(), id2))
+			ids.push_back(id2);
+	}
+	while (ids.size() < num)
+		ids.push_back(id);
+}
+
 void ClusterMethod::AddIDsToData()
 {
 	for (size_t ii = 0; ii < m_result.size(); ++ii)
@@ -32,7 +32,6 @@ DEALINGS IN THE SOFTWARE.
 #include <boost/qvm/mat.hpp>
 #include <boost/qvm/vec_operations.hpp>
 #include <boost/shared_ptr.hpp>
-#include <list>
 #include <vector>
 #include <Tracking/CellList.h>
 
@@ -52,6 +51,9 @@ namespace FL
 		float intensity;
 	};
 
+	//points live in contiguous blocks owned by ClusterMethod
+	//the pointers alias the blocks, so the data handed to another method
+	//by SetData keeps its points alive
 	typedef boost::shared_ptr<ClusterPoint> pClusterPoint;
 
 	inline float Dist(const ClusterPoint &p1, const ClusterPoint &p2, float w)
@@ -61,7 +63,8 @@ namespace FL
 		return boost::qvm::mag(p1p2) + w * int_diff;
 	}
 
-	class Cluster : public std::list<pClusterPoint>
+	//a contiguous list of point handles
+	class Cluster : public std::vector<pClusterPoint>
 	{
 	public:
 		inline bool find(pClusterPoint &p);
@@ -138,7 +141,9 @@ namespace FL
 		ClusterMethod() :
 			m_id_counter(1),
 			m_use_init_cluster(false),
-			m_spc({1, 1, 1}) {};
+			m_spc({1, 1, 1}),
+			m_reserve(0),
+			m_used_ids(0) {};
 		virtual ~ClusterMethod() {};
 
 		void SetData(Cluster &data)
@@ -156,12 +161,28 @@ namespace FL
 		{ m_id_counter = 1; }
 		void SetSpacings(double spcx, double spcy, double spcz)
 		{ m_spc = {spcx, spcy, spcz}; }
+		//expected number of points, so they are stored contiguously
+		void ReservePoints(size_t num)
+		{ m_reserve = num; }
+		//sorted ids in the label, so new ids are chosen without reading it
+		void SetUsedIds(const std::vector<unsigned int> *ids)
+		{ m_used_ids = ids; }
 		void AddClusterPoint(const EmVec &p, const float value, int cid=-1);
 		void GenerateNewIDs(unsigned int id, void* label,
 			size_t nx, size_t ny, size_t nz,
 			bool out_cells = false, unsigned int inc = 42);
 		bool FindId(void* label, unsigned int id,
 			size_t nx, size_t ny, size_t nz);
+		//next num ids from id in steps of inc that are not in label
+		//the label is read once for all of them
+		void FindFreeIds(void* label, unsigned int id,
+			size_t nx, size_t ny, size_t nz,
+			unsigned int inc, size_t num,
+			std::vector<unsigned int> &ids);
+		//same, checked against a sorted list of the ids in use
+		void FindFreeIds(const std::vector<unsigned int> &used,
+			unsigned int id, unsigned int inc, size_t num,
+			std::vector<unsigned int> &ids);
 		std::vector<unsigned int> &GetNewIDs()
 		{ return m_id_list; }
 		virtual bool Execute() = 0;
@@ -179,6 +200,11 @@ namespace FL
 		EmVec m_spc;//spacings
 		//output cells
 		CellList m_out_cells;
+		//points are allocated in blocks that their pointers share
+		typedef std::vector<ClusterPoint> PointBlock;
+		boost::shared_ptr<PointBlock> m_block;
+		size_t m_reserve;
+		const std::vector<unsigned int> *m_used_ids;
 	};
 }
 #endif//FL_ClusterMethod_h
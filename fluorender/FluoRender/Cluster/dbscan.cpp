@@ -109,10 +109,10 @@ void ClusterDbscan::ExpandCluster(pClusterPoint& p, Cluster& neighbors, Cluster&
 {
 	cluster.push_back(p);
 	p->noise = false;
-	for (ClusterIter iter = neighbors.begin();
-		iter != neighbors.end(); ++iter)
+	//neighbors grows while it is walked
+	for (size_t i = 0; i < neighbors.size(); ++i)
 	{
-		pClusterPoint p2 = *iter;
+		pClusterPoint p2 = neighbors[i];
 		if (!p2->visited)
 		{
 			p2->visited = true;
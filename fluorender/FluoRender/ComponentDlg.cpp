@@ -3361,14 +3361,19 @@ void ComponentDlg::Analyze(bool sel)
 	{
 		wxFileDialog *fopendlg = new wxFileDialog(
 			this, "Save Analysis Data", "", "",
-			"Text file (*.txt)|*.txt",
+			"Text file (*.txt)|*.txt|CSV file (*.csv)|*.csv|"\
+			"Column chunks (*.flt)|*.flt",
 			wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
 		int rval = fopendlg->ShowModal();
 		if (rval == wxID_OK)
 		{
 			wxString filename = fopendlg->GetPath();
 			string str = filename.ToStdString();
-			m_comp_analyzer.OutputCompListFile(str, 1);
+			int index = fopendlg->GetFilterIndex();
+			if (index == 0)
+				m_comp_analyzer.OutputCompListFile(str, 1);
+			else
+				m_comp_analyzer.OutputCompListTable(str, index - 1);
 		}
 		if (fopendlg)
 			delete fopendlg;
@@ -26,6 +26,7 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
 #include "CompAnalyzer.h"
+#include <Formats/table_writer.h>
 #include <sstream>
 #include <iostream>
 #include <fstream>
@@ -123,6 +124,10 @@ void ComponentAnalyzer::Analyze(bool sel, bool consistent, bool colocal)
 		TextureBrick* b = (*bricks)[bi];
 		int c = 0;
 		int nb = 1;
+		//skip bricks without components
+		if (b->is_empty(0) || b->is_empty(b->nlabel()) ||
+			(sel && b->is_empty(b->nmask())))
+			continue;
 		if (bn > 1)
 		{
 			// get brick if ther are more than one brick
@@ -796,6 +801,100 @@ void ComponentAnalyzer::OutputCompListFile(std::string &filename, int verbose, s
 	ofs.close();
 }
 
+bool ComponentAnalyzer::OutputCompListTable(const std::string &filename, int format)
+{
+	if (!m_vd)
+		return false;
+	int bn = m_vd->GetAllBrickNum();
+
+	//same columns as the text output
+	TableWriter table;
+	table.AddColumn("ID", TableWriter::COL_UINT);
+	if (bn > 1)
+		table.AddColumn("BRICK_ID", TableWriter::COL_UINT);
+	table.AddColumn("PosX", TableWriter::COL_DOUBLE);
+	table.AddColumn("PosY", TableWriter::COL_DOUBLE);
+	table.AddColumn("PosZ", TableWriter::COL_DOUBLE);
+	table.AddColumn("SumN", TableWriter::COL_UINT);
+	table.AddColumn("SumI", TableWriter::COL_DOUBLE);
+	table.AddColumn("PhysN", TableWriter::COL_DOUBLE);
+	table.AddColumn("PhysI", TableWriter::COL_DOUBLE);
+	table.AddColumn("SurfN", TableWriter::COL_UINT);
+	table.AddColumn("SurfI", TableWriter::COL_DOUBLE);
+	table.AddColumn("Mean", TableWriter::COL_DOUBLE);
+	table.AddColumn("Sigma", TableWriter::COL_DOUBLE);
+	table.AddColumn("Min", TableWriter::COL_DOUBLE);
+	table.AddColumn("Max", TableWriter::COL_DOUBLE);
+	table.AddColumn("Dist", TableWriter::COL_DOUBLE);
+	if (m_colocal)
+	{
+		for (size_t i = 0; i < m_vd_list.size(); ++i)
+		{
+			std::string name = m_vd_list[i]->GetName().ToStdString();
+			table.AddColumn(name + "_N", TableWriter::COL_UINT);
+			table.AddColumn(name + "_I", TableWriter::COL_DOUBLE);
+		}
+	}
+	if (!table.Open(filename, format == 1 ?
+		TableWriter::TABLE_CHUNK : TableWriter::TABLE_CSV))
+		return false;
+
+	double sx = m_comp_list.sx;
+	double sy = m_comp_list.sy;
+	double sz = m_comp_list.sz;
+	double size_scale = sx * sy * sz;
+	double scale = m_vd->GetScalarScale();
+
+	m_comp_graph.ClearVisited();
+	for (auto i = m_comp_list.begin();
+		i != m_comp_list.end(); ++i)
+	{
+		unsigned int id = i->second->id;
+		unsigned int brick_id = i->second->brick_id;
+		if (bn > 1)
+		{
+			if (m_comp_graph.Visited(i->second))
+				continue;
+
+			CompList list;
+			if (m_comp_graph.GetLinkedComps(i->second, list, SIZE_LIMIT))
+			{
+				id = list.begin()->second->id;
+				brick_id = list.begin()->second->brick_id;
+			}
+		}
+
+		table.Put(id);
+		if (bn > 1)
+			table.Put(brick_id);
+		table.Put(i->second->pos.x()*sx);
+		table.Put(i->second->pos.y()*sy);
+		table.Put(i->second->pos.z()*sz);
+		table.Put(i->second->sumi);
+		table.Put(i->second->sumd * scale);
+		table.Put(size_scale * i->second->sumi);
+		table.Put(size_scale * i->second->sumd * scale);
+		table.Put(i->second->ext_sumi);
+		table.Put(i->second->ext_sumd * scale);
+		table.Put(i->second->mean);
+		table.Put(i->second->var);
+		table.Put(i->second->min);
+		table.Put(i->second->max);
+		table.Put(i->second->dist);
+		if (m_colocal)
+		{
+			for (size_t ii = 0; ii < m_vd_list.size(); ++ii)
+			{
+				table.Put(i->second->cosumi[ii]);
+				table.Put(i->second->cosumd[ii]);
+			}
+		}
+		table.EndRow();
+	}
+
+	return table.Close();
+}
+
 unsigned int ComponentAnalyzer::GetExt(unsigned int* data_label,
 	unsigned long long index,
 	unsigned int id,
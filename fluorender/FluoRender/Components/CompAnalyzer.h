@@ -91,6 +91,9 @@ namespace FL
 		void OutputCompListStream(std::ostream &stream, int verbose, std::string comp_header = "");
 		void OutputCompListStr(std::string &str, int verbose, std::string comp_header="");
 		void OutputCompListFile(std::string &filename, int verbose, std::string comp_header = "");
+		//same values as a table, written as they are computed
+		//format: 0-csv; 1-binary column chunks
+		bool OutputCompListTable(const std::string &filename, int format);
 		bool GenAnnotations(Annotations &ann, bool consistent, int type);
 		//color_type: 1-id-based; 2-size-based
 		bool GenMultiChannels(std::list<VolumeData*> &channs, int color_type, bool consistent);
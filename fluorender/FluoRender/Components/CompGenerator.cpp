@@ -171,6 +171,7 @@ void ComponentGenerator::ShuffleID()
 		//kernel_prog->readBuffer(sizeof(unsigned int)*nx*ny*nz, val32, val32);
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -366,6 +367,7 @@ void ComponentGenerator::SetIDBit(int psize)
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -454,6 +456,7 @@ void ComponentGenerator::Grow(bool diffuse, int iter, float tran, float falloff,
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -699,6 +702,7 @@ void ComponentGenerator::DensityField(int dsize, int wsize,
 		//read back
 		kernel2_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel2_prog->releaseAll();
@@ -877,6 +881,7 @@ void ComponentGenerator::DistGrow(bool diffuse, int iter,
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1219,6 +1224,7 @@ void ComponentGenerator::DistDensityField(
 		//read back
 		kernel_prog_grow->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog_grow->releaseAll();
@@ -1373,6 +1379,7 @@ void ComponentGenerator::Cleanup(int iter, unsigned int size_lm)
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1434,6 +1441,7 @@ void ComponentGenerator::ClearBorders()
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1500,6 +1508,7 @@ void ComponentGenerator::FillBorders(float tol)
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1574,6 +1583,7 @@ void ComponentGenerator::ReleaseLabel(void* val32, size_t brick_num, TextureBric
 		tp += b->sx()*b->sy()*nb;
 	}
 	delete[] val32;
+	b->invalidate_summary(c);
 }
 
 void ComponentGenerator::OrderID_3D()
@@ -1631,6 +1641,7 @@ void ComponentGenerator::OrderID_2D()
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1695,6 +1706,7 @@ void ComponentGenerator::ShuffleID_2D()
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1838,6 +1850,7 @@ void ComponentGenerator::Grow3DSized(
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -2050,6 +2063,8 @@ void ComponentGenerator::MatchSlices(bool backwards, unsigned int size_thresh,
 			}
 		}
 	}
+	m_vd->GetTexture()->invalidate_summary(
+		m_vd->GetTexture()->nlabel());
 
 	m_sig_progress();
 }
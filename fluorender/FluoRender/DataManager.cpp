@@ -702,6 +702,7 @@ void VolumeData::AddEmptyMask(int mode, bool change)
 				memset((void*)val8, mode ?
 					255 : 0, mem_size * sizeof(uint8));
 		}
+		m_tex->invalidate_summary(m_tex->nmask());
 	}
 }
 
@@ -1008,6 +1009,7 @@ void VolumeData::AddEmptyLabel(int mode, bool change)
 			SetShuffledID(val32);
 			break;
 		}
+		m_tex->invalidate_summary(m_tex->nlabel());
 	}
 }
 
@@ -1511,15 +1513,15 @@ void VolumeData::SaveLabel(bool use_reader, int t, int c)
 		}
 	}
 
-	MSKWriter msk_writer;
-	msk_writer.SetData(data);
-	msk_writer.SetSpacings(spcx, spcy, spcz);
+	LBLWriter lbl_writer;
+	lbl_writer.SetData(data);
+	lbl_writer.SetSpacings(spcx, spcy, spcz);
 	wstring filename;
 	if (use_reader && m_reader)
 		filename = m_reader->GetCurLabelName(t, c);
 	else
 		filename = m_tex_path.substr(0, m_tex_path.find_last_of('.')) + ".lbl";
-	msk_writer.Save(filename, 1);
+	lbl_writer.Save(filename, 0);
 	if (delete_data)
 		nrrdNuke(data);
 }
@@ -3762,17 +3764,16 @@ unsigned int TraceGroup::GetMappedEdges(
 		return result;
 
 	FL::CellList &cell_list1 = m_track_map->GetCellList(frame1);
-	FL::InterGraph &inter_graph = m_track_map->GetInterGraph(
+	FL::LinkIndex &link_index = m_track_map->GetLinkIndex(
 		frame1 > frame2 ? frame2 : frame1);
+	int side = frame1 > frame2 ? 1 : 0;
 	FL::CellListIter sel_iter, cell_iter;
 	FL::pVertex vertex1, vertex2;
 	FL::pCell cell;
-	FL::InterVert v1, v2;
-	std::pair<FL::InterAdjIter, FL::InterAdjIter> adj_verts;
-	FL::InterAdjIter inter_iter;
+	std::pair<FL::LinkIndex::LinkIter, FL::LinkIndex::LinkIter> links;
+	FL::LinkIndex::LinkIter link_iter;
 	FL::CellBinIter pwcell_iter;
 	FLIVR::Color c;
-	std::pair<FL::InterEdge, bool> inter_edge;
 
 	for (sel_iter = sel_list1.begin();
 		sel_iter != sel_list1.end();
@@ -3784,23 +3785,13 @@ unsigned int TraceGroup::GetMappedEdges(
 		vertex1 = cell_iter->second->GetVertex().lock();
 		if (!vertex1)
 			continue;
-		v1 = vertex1->GetInterVert(inter_graph);
-		if (v1 == FL::InterGraph::null_vertex())
-			continue;
-		adj_verts = boost::adjacent_vertices(v1, inter_graph);
-		//for each adjacent vertex
-		for (inter_iter = adj_verts.first;
-			inter_iter != adj_verts.second;
-			++inter_iter)
+		links = link_index.links(side, vertex1.get());
+		//for each linked vertex
+		for (link_iter = links.first;
+			link_iter != links.second;
+			++link_iter)
 		{
-			v2 = *inter_iter;
-			//get edge
-			inter_edge = boost::edge(v1, v2, inter_graph);
-			if (!inter_edge.second)
-				continue;
-			else if (!inter_graph[inter_edge.first].link)
-				continue;
-			vertex2 = inter_graph[v2].vertex.lock();
+			vertex2 = link_iter->lock();
 			if (!vertex2)
 				continue;
 			//store all cells in sel_list2
@@ -3847,17 +3838,16 @@ bool TraceGroup::GetMappedRulers(
 		return false;
 
 	FL::CellList &cell_list1 = m_track_map->GetCellList(frame1);
-	FL::InterGraph &inter_graph = m_track_map->GetInterGraph(
+	FL::LinkIndex &link_index = m_track_map->GetLinkIndex(
 		frame1 > frame2 ? frame2 : frame1);
+	int side = frame1 > frame2 ? 1 : 0;
 	FL::CellListIter sel_iter, cell_iter;
 	FL::pVertex vertex1, vertex2;
 	FL::pCell cell;
-	FL::InterVert v1, v2;
-	std::pair<FL::InterAdjIter, FL::InterAdjIter> adj_verts;
-	FL::InterAdjIter inter_iter;
+	std::pair<FL::LinkIndex::LinkIter, FL::LinkIndex::LinkIter> links;
+	FL::LinkIndex::LinkIter link_iter;
 	FL::CellBinIter pwcell_iter;
 	FLIVR::Color c;
-	std::pair<FL::InterEdge, bool> inter_edge;
 	FL::RulerListIter ruler_iter;
 
 	for (sel_iter = sel_list1.begin();
@@ -3870,23 +3860,13 @@ bool TraceGroup::GetMappedRulers(
 		vertex1 = cell_iter->second->GetVertex().lock();
 		if (!vertex1)
 			continue;
-		v1 = vertex1->GetInterVert(inter_graph);
-		if (v1 == FL::InterGraph::null_vertex())
-			continue;
-		adj_verts = boost::adjacent_vertices(v1, inter_graph);
-		//for each adjacent vertex
-		for (inter_iter = adj_verts.first;
-			inter_iter != adj_verts.second;
-			++inter_iter)
+		links = link_index.links(side, vertex1.get());
+		//for each linked vertex
+		for (link_iter = links.first;
+			link_iter != links.second;
+			++link_iter)
 		{
-			v2 = *inter_iter;
-			//get edge
-			inter_edge = boost::edge(v1, v2, inter_graph);
-			if (!inter_edge.second)
-				continue;
-			else if (!inter_graph[inter_edge.first].link)
-				continue;
-			vertex2 = inter_graph[v2].vertex.lock();
+			vertex2 = link_iter->lock();
 			if (!vertex2)
 				continue;
 			//store all cells in sel_list2
@@ -3952,6 +3932,13 @@ bool TraceGroup::Save(wxString &filename)
 	return tm_processor.Export(str);
 }
 
+bool TraceGroup::ExportTables(wxString &prefix, int format)
+{
+	FL::TrackMapProcessor tm_processor(m_track_map);
+	std::string str = ws2s(prefix.ToStdWstring());
+	return tm_processor.ExportTables(str, format);
+}
+
 unsigned int TraceGroup::Draw(vector<float> &verts, int shuffle)
 {
 	unsigned int result = 0;
@@ -50,6 +50,7 @@ DEALINGS IN THE SOFTWARE.
 #include "Formats/tif_writer.h"
 #include "Formats/msk_reader.h"
 #include "Formats/msk_writer.h"
+#include "Formats/lbl_writer.h"
 #include "Formats/lsm_reader.h"
 #include "Formats/lbl_reader.h"
 #include "Formats/pvxml_reader.h"
@@ -875,6 +876,9 @@ public:
 	//i/o
 	bool Load(wxString &filename);
 	bool Save(wxString &filename);
+	//per-frame tables of cells, vertices and edges
+	//format: 0-csv; 1-binary column chunks
+	bool ExportTables(wxString &prefix, int format);
 
 	//draw
 	unsigned int Draw(vector<float> &verts, int shuffle);
@@ -32,6 +32,8 @@ DEALINGS IN THE SOFTWARE.
 #include <FLIVR/TextureBrick.h>
 #include <FLIVR/Texture.h>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 using namespace FL;
 
@@ -121,9 +123,11 @@ const char* str_cl_cov = \
 
 Cov::Cov(VolumeData* vd)
 	: m_vd(vd),
-	m_use_mask(false)
+	m_use_mask(false),
+	m_use_int(false),
+	m_use_cpu(false)
 {
-	std::memset(m_cov, 0, sizeof(float) * 9);
+	std::memset(m_cov, 0, sizeof(float) * 6);
 	std::memset(m_center, 0, sizeof(float) * 3);
 }
 
@@ -181,6 +185,9 @@ bool Cov::ComputeCenter()
 		long nx, ny, nz, bits;
 		if (!GetInfo(b, bits, nx, ny, nz))
 			continue;
+		//skip bricks without selection
+		if (b->is_empty(b->nmask()))
+			continue;
 		//get tex ids
 		GLint mid = m_vd->GetVR()->load_brick_mask(b);
 
@@ -264,12 +271,16 @@ bool Cov::ComputeCov()
 	vector<FLIVR::TextureBrick*> *bricks = m_vd->GetTexture()->get_bricks();
 
 	//get cov
+	std::memset(m_cov, 0, sizeof(float) * 6);
 	for (size_t i = 0; i < brick_num; ++i)
 	{
 		FLIVR::TextureBrick* b = (*bricks)[i];
 		long nx, ny, nz, bits;
 		if (!GetInfo(b, bits, nx, ny, nz))
 			continue;
+		//skip bricks without selection
+		if (b->is_empty(b->nmask()))
+			continue;
 		//get tex ids
 		GLint mid = m_vd->GetVR()->load_brick_mask(b);
 
@@ -328,8 +339,96 @@ bool Cov::ComputeCov()
 	return true;
 }
 
+bool Cov::ComputeCpu(int type)
+{
+	if (!CheckBricks())
+		return false;
+	Nrrd* nrrd_mask = m_vd->GetMask(true);
+	if (!nrrd_mask || !nrrd_mask->data)
+		return false;
+	unsigned char* mask = (unsigned char*)(nrrd_mask->data);
+	int nx, ny, nz;
+	m_vd->GetResolution(nx, ny, nz);
+	if (nx <= 0 || ny <= 0 || nz <= 0)
+		return false;
+
+	//slices are summed exactly in local coordinates,
+	//then merged into the accumulator of each thread
+	int thread_num = std::thread::hardware_concurrency();
+	thread_num = std::max(1, std::min(thread_num, nz));
+	std::vector<CovAccum> accs(thread_num);
+	std::atomic<int> next(0);
+	auto work = [&](int ti)
+	{
+		int k;
+		while ((k = next++) < nz)
+		{
+			unsigned long long n = 0;
+			unsigned long long s[3] = { 0, 0, 0 };
+			unsigned long long ss[6] = { 0, 0, 0, 0, 0, 0 };
+			unsigned char* ptr = mask + (unsigned long long)nx * ny * k;
+			for (unsigned long long j = 0; j < (unsigned long long)ny; ++j)
+			{
+				unsigned long long rn = 0, rs = 0, rss = 0;
+				for (unsigned long long i = 0; i < (unsigned long long)nx; ++i)
+				{
+					if (!ptr[i])
+						continue;
+					rn++;
+					rs += i;
+					rss += i * i;
+				}
+				ptr += nx;
+				if (!rn)
+					continue;
+				n += rn;
+				s[0] += rs;
+				s[1] += j * rn;
+				ss[0] += rss;
+				ss[1] += j * rs;
+				ss[3] += j * j * rn;
+			}
+			if (!n)
+				continue;
+			double ds[3] = { double(s[0]), double(s[1]), 0.0 };
+			double dss[6] = { double(ss[0]), double(ss[1]), 0.0,
+				double(ss[3]), 0.0, 0.0 };
+			accs[ti].AddSums(double(n), ds, dss, 0.0, 0.0, double(k));
+		}
+	};
+	std::vector<std::thread> threads;
+	for (int i = 1; i < thread_num; ++i)
+		threads.push_back(std::thread(work, i));
+	work(0);
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+
+	CovAccum acc;
+	for (size_t i = 0; i < accs.size(); ++i)
+		acc.Merge(accs[i]);
+	if (acc.GetCount() <= 0.0)
+		return false;
+
+	FLIVR::Point center = acc.GetMean();
+	m_center[0] = center.x();
+	m_center[1] = center.y();
+	m_center[2] = center.z();
+	if (type == 0)
+	{
+		double m2[6];
+		acc.GetScatter(m2);
+		for (int i = 0; i < 6; ++i)
+			m_cov[i] = m2[i];
+	}
+	return true;
+}
+
 bool Cov::Compute(int type)
 {
+	if (m_use_cpu ||
+		!FLIVR::VolumeRenderer::vol_kernel_factory_.kernel(str_cl_cov))
+		return ComputeCpu(type);
+
 	bool result = true;
 	result = result && ComputeCenter();
 	if (type == 0)
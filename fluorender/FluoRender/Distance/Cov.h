@@ -32,6 +32,7 @@ DEALINGS IN THE SOFTWARE.
 #include <FLIVR/KernelProgram.h>
 #include <FLIVR/VolKernel.h>
 #include <FLIVR/Point.h>
+#include <Distance/CovAccum.h>
 #include <vector>
 
 using namespace std;
@@ -53,6 +54,16 @@ namespace FL
 		{
 			return m_use_mask;
 		}
+		//compute on cpu in one pass
+		//also used when opencl is not available
+		void SetUseCpu(bool use_cpu)
+		{
+			m_use_cpu = use_cpu;
+		}
+		bool GetUseCpu()
+		{
+			return m_use_cpu;
+		}
 
 		bool Compute(int type);//type: 0-cov; 1-center only
 
@@ -100,12 +111,14 @@ namespace FL
 		VolumeData *m_vd;
 		bool m_use_mask;//use mask instead of data
 		bool m_use_int;//use intensity values as weights
+		bool m_use_cpu;
 		//result
 		float m_cov[6];//covariance matrix {xx, xy, xz, yy, yz, zz}
 		float m_center[3];//center
 
 		bool ComputeCenter();
 		bool ComputeCov();
+		bool ComputeCpu(int type);
 		bool CheckBricks();
 		bool GetInfo(FLIVR::TextureBrick* b,
 			long &bits, long &nx, long &ny, long &nz);
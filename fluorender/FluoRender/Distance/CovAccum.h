@@ -0,0 +1,156 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FL_CovAccum_h
+#define FL_CovAccum_h
+
+#include <FLIVR/Point.h>
+#include <cstring>
+
+namespace FL
+{
+	//streaming center and covariance of 3d points
+	//points are added one at a time (Welford) or as blocks of sums,
+	//partial results from threads are combined with Merge
+	class CovAccum
+	{
+	public:
+		CovAccum()
+		{
+			Clear();
+		}
+		~CovAccum()
+		{}
+
+		void Clear()
+		{
+			m_n = 0.0;
+			std::memset(m_mean, 0, sizeof(double) * 3);
+			std::memset(m_m2, 0, sizeof(double) * 6);
+		}
+
+		void Add(double x, double y, double z)
+		{
+			m_n += 1.0;
+			double d[3] = {
+				x - m_mean[0],
+				y - m_mean[1],
+				z - m_mean[2] };
+			m_mean[0] += d[0] / m_n;
+			m_mean[1] += d[1] / m_n;
+			m_mean[2] += d[2] / m_n;
+			double e[3] = {
+				x - m_mean[0],
+				y - m_mean[1],
+				z - m_mean[2] };
+			m_m2[0] += d[0] * e[0];
+			m_m2[1] += d[0] * e[1];
+			m_m2[2] += d[0] * e[2];
+			m_m2[3] += d[1] * e[1];
+			m_m2[4] += d[1] * e[2];
+			m_m2[5] += d[2] * e[2];
+		}
+		void Add(const FLIVR::Point &p)
+		{
+			Add(p.x(), p.y(), p.z());
+		}
+
+		//add a block of n points from their sums
+		//s: {x, y, z}; ss: {xx, xy, xz, yy, yz, zz}
+		//keep the coordinates local to the block and pass its origin
+		void AddSums(double n, const double s[3], const double ss[6],
+			double ox = 0.0, double oy = 0.0, double oz = 0.0)
+		{
+			if (n <= 0.0)
+				return;
+			CovAccum acc;
+			acc.m_n = n;
+			acc.m_mean[0] = s[0] / n;
+			acc.m_mean[1] = s[1] / n;
+			acc.m_mean[2] = s[2] / n;
+			acc.m_m2[0] = ss[0] - s[0] * s[0] / n;
+			acc.m_m2[1] = ss[1] - s[0] * s[1] / n;
+			acc.m_m2[2] = ss[2] - s[0] * s[2] / n;
+			acc.m_m2[3] = ss[3] - s[1] * s[1] / n;
+			acc.m_m2[4] = ss[4] - s[1] * s[2] / n;
+			acc.m_m2[5] = ss[5] - s[2] * s[2] / n;
+			acc.m_mean[0] += ox;
+			acc.m_mean[1] += oy;
+			acc.m_mean[2] += oz;
+			Merge(acc);
+		}
+
+		//combine two partial results (Chan et al.)
+		void Merge(const CovAccum &acc)
+		{
+			if (acc.m_n <= 0.0)
+				return;
+			if (m_n <= 0.0)
+			{
+				*this = acc;
+				return;
+			}
+			double n = m_n + acc.m_n;
+			double d[3] = {
+				acc.m_mean[0] - m_mean[0],
+				acc.m_mean[1] - m_mean[1],
+				acc.m_mean[2] - m_mean[2] };
+			double f = m_n * acc.m_n / n;
+			m_m2[0] += acc.m_m2[0] + d[0] * d[0] * f;
+			m_m2[1] += acc.m_m2[1] + d[0] * d[1] * f;
+			m_m2[2] += acc.m_m2[2] + d[0] * d[2] * f;
+			m_m2[3] += acc.m_m2[3] + d[1] * d[1] * f;
+			m_m2[4] += acc.m_m2[4] + d[1] * d[2] * f;
+			m_m2[5] += acc.m_m2[5] + d[2] * d[2] * f;
+			m_mean[0] += d[0] * acc.m_n / n;
+			m_mean[1] += d[1] * acc.m_n / n;
+			m_mean[2] += d[2] * acc.m_n / n;
+			m_n = n;
+		}
+
+		double GetCount()
+		{
+			return m_n;
+		}
+		FLIVR::Point GetMean()
+		{
+			return FLIVR::Point(m_mean[0], m_mean[1], m_mean[2]);
+		}
+		//sums of products of deviations {xx, xy, xz, yy, yz, zz}
+		void GetScatter(double m2[6])
+		{
+			std::memcpy(m2, m_m2, sizeof(double) * 6);
+		}
+
+	private:
+		double m_n;
+		double m_mean[3];
+		double m_m2[6];
+	};
+}
+#endif//FL_CovAccum_h
@@ -27,6 +27,8 @@ DEALINGS IN THE SOFTWARE.
 */
 #include "DistCalculator.h"
 #include <DataManager.h>
+#include <utility.h>
+#include <cmath>
 #include <limits>
 #include <algorithm>
 
@@ -43,6 +45,7 @@ DistCalculator::DistCalculator() :
 	m_f2 = 2;
 	m_f3 = 3;
 	m_infr = 2.5;
+	m_relax.SetUseCpu(true);
 }
 
 DistCalculator::~DistCalculator()
@@ -57,8 +60,11 @@ void DistCalculator::CenterRuler(int type, bool init, int iter)
 		m_relax.SetUseMask(false);
 	else if (m_type == 2)
 		m_relax.SetUseMask(true);
-	if (m_type != 3)
+	//gpu relax is slow to run many times
+	if (m_type != 3 && !m_relax.GetUseCpu())
 		iter = std::max(1, iter / 10);
+	//data may have changed since last time
+	m_relax.ClearCloud();
 
 	if (!m_init || init)
 	{
@@ -165,12 +171,54 @@ void DistCalculator::BuildCloud()
 	double sz = m_comp_list->sz;
 
 	Point p;
+	Point bmin(std::numeric_limits<double>::max(),
+		std::numeric_limits<double>::max(),
+		std::numeric_limits<double>::max());
+	Point bmax(-std::numeric_limits<double>::max(),
+		-std::numeric_limits<double>::max(),
+		-std::numeric_limits<double>::max());
 	for (auto it = m_comp_list->begin();
 		it != m_comp_list->end(); ++it)
 	{
 		p = it->second->GetPos(sx, sy, sz);
 		m_cloud.push_back(p);
+		bmin = Min(bmin, p);
+		bmax = Max(bmax, p);
 	}
+
+	//a few points in each cell on average
+	Vector ext = bmax - bmin;
+	double vol = std::max(ext.x(), EPS) *
+		std::max(ext.y(), EPS) *
+		std::max(ext.z(), EPS);
+	double cell = std::cbrt(vol / m_cloud.size()) * 2.0;
+	m_cloud_hash.Build(m_cloud, cell);
+}
+
+double DistCalculator::GetNearDist(Point &pos, int loc)
+{
+	int cz = m_cloud.size();
+	if (loc < 0 || loc >= cz)
+		return 0.0;
+	//grow the range until there are enough points in it
+	std::vector<double> lens;
+	double range = m_cloud_hash.GetCellSize();
+	while (true)
+	{
+		lens.clear();
+		m_cloud_hash.Query(pos, range, [&](unsigned int i)
+		{
+			double len = (m_cloud[i] - pos).length();
+			if (len <= range)
+				lens.push_back(len);
+		});
+		if (lens.size() > loc ||
+			lens.size() >= cz)
+			break;
+		range *= 2.0;
+	}
+	std::nth_element(lens.begin(), lens.begin() + loc, lens.end());
+	return lens[loc];
 }
 
 double DistCalculator::GetRestDist()
@@ -221,27 +269,22 @@ void DistCalculator::UpdateSpringNode(int idx)
 	else if (m_type == 3)
 	{
 		//from cloud
-		std::vector<double> lens;
-		for (int i = 0; i < cz; ++i)
-		{
-			dir = m_cloud[i] - pos;
-			lens.push_back(dir.length());
-		}
-		std::sort(lens.begin(), lens.end());
 		double scale = (node.prevd == 0.0 ||
 			node.nextd == 0.0) ? 1.0 : m_infr;
 		int loc = int(scale * cz / sz + 1.0);
 		loc = std::min(loc, cz - 1);
-		for (int i = 0; i < cz; ++i)
+		//only the nearest points in the cloud
+		double range = GetNearDist(pos, loc);
+		m_cloud_hash.Query(pos, range, [&](unsigned int i)
 		{
 			dir = m_cloud[i] - pos;
 			dist = dir.length();
-			if (dist > lens[loc])
-				continue;
+			if (dist > range)
+				return;
 			dist = std::max(m_rest, dist);
 			dir.normalize();
 			f1 += dir / dist / dist;
-		}
+		});
 	}
 	//from neighbors
 	if (idx > 0 && node.prevd > 0.0)
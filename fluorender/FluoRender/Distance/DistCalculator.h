@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #include <Components/CompGraph.h>
 #include <Distance/Ruler.h>
 #include <Distance/Relax.h>
+#include <Distance/SpatialHash.h>
 
 class VolumeData;
 namespace FL
@@ -109,6 +110,7 @@ namespace FL
 		};
 		std::vector<SpringNode> m_spring;
 		std::vector<Point> m_cloud;
+		SpatialHash m_cloud_hash;
 
 		//volume relax
 		Relax m_relax;
@@ -117,6 +119,8 @@ namespace FL
 		void BuildSpring();
 		void BuildCloud();
 		double GetRestDist();
+		//distance to the (loc+1)th nearest point in cloud
+		double GetNearDist(Point &pos, int loc);
 		void UpdateSpringNode(int idx);
 		void UpdateSpringDist();
 		void SpringProject(Point &p0, Point &pp);
@@ -26,6 +26,7 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
 #include <Distance/Pca.h>
+#include <Distance/CovAccum.h>
 #include <utility.h>
 #include <Algorithm>
 #include <cmath>
@@ -61,26 +62,13 @@ void Pca::Compute(bool upd_cov)
 		if (N < 2)
 			return;
 
-		std::vector<FLIVR::Point> points;
-		//mean
-		FLIVR::Point mean;
+		//one pass
+		CovAccum acc;
 		for (int i = 0; i < N; ++i)
-		{
-			points.push_back(m_points[i]);
-			mean += m_points[i];
-		}
-		mean /= N;
-		//centered matrix
-		for (int i = 0; i < N; ++i)
-			points[i] -= mean;
-
-		for (int i = 0; i < 3; ++i)
-		for (int j = 0; j < 3; ++j)
-		{
-			m_cov[i][j] = 0;
-			for (int n = 0; n < N; ++n)
-				m_cov[i][j] += (points[n])(i) * (points[n])(j);
-		}
+			acc.Add(m_points[i]);
+		std::vector<double> cov(6);
+		acc.GetScatter(&cov[0]);
+		SetCovMat(cov);
 	}
 
 	//eigen
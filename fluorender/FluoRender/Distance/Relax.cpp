@@ -27,6 +27,9 @@ DEALINGS IN THE SOFTWARE.
 */
 #include "Relax.h"
 #include <DataManager.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace FL;
 
@@ -98,7 +101,12 @@ Relax::Relax() :
 	m_snum(0),
 	m_use_mask(true),
 	m_rest(0.0f),
-	m_infr(0.0f)
+	m_infr(0.0f),
+	m_use_cpu(false),
+	m_cvalid(false),
+	m_cmask(false),
+	m_cinfr(0.0f),
+	m_cver(0)
 {
 }
 
@@ -203,10 +211,12 @@ bool Relax::Compute()
 	m_wsum.assign(m_snum, 0.0);
 
 	//create program and kernels
-	FLIVR::KernelProgram* kernel_prog = FLIVR::VolumeRenderer::
-		vol_kernel_factory_.kernel(str_cl_relax);
+	FLIVR::KernelProgram* kernel_prog = 0;
+	if (!m_use_cpu)
+		kernel_prog = FLIVR::VolumeRenderer::
+			vol_kernel_factory_.kernel(str_cl_relax);
 	if (!kernel_prog)
-		return false;
+		return ComputeCpu();
 	int kernel_0 = kernel_prog->createKernel("kernel_0");//init ordered
 
 	size_t brick_num = m_vd->GetTexture()->get_brick_num();
@@ -298,4 +308,142 @@ bool Relax::Compute()
 	}
 	
 	return true;
-}
\ No newline at end of file
+}
+
+bool Relax::CloudValid()
+{
+	if (!m_cvalid ||
+		m_cmask != m_use_mask ||
+		m_cinfr != m_infr ||
+		m_cver != m_vd->GetTexture()->get_version())
+		return false;
+	for (unsigned int i = 0; i < m_snum; ++i)
+	{
+		if (m_slock[i])
+			continue;
+		for (int j = 0; j < 3; ++j)
+		{
+			if (m_spoints[i * 3 + j] < m_cbox[j] ||
+				m_spoints[i * 3 + j] > m_cbox[j + 3])
+				return false;
+		}
+	}
+	return true;
+}
+
+bool Relax::BuildCloud()
+{
+	m_cvalid = false;
+	m_cpoints.clear();
+	m_cweights.clear();
+	m_hash.Clear();
+
+	FLIVR::Texture* tex = m_vd->GetTexture();
+	if (!tex)
+		return false;
+	Nrrd* nrrd_data = 0;
+	if (m_use_mask)
+		nrrd_data = m_vd->GetMask(true);
+	else
+		nrrd_data = tex->get_nrrd(0);
+	if (!nrrd_data || !nrrd_data->data)
+		return false;
+	int bits = 8;
+	if (nrrd_data->type == nrrdTypeUShort)
+		bits = 16;
+	else if (nrrd_data->type != nrrdTypeUChar)
+		return false;
+	int nx, ny, nz;
+	m_vd->GetResolution(nx, ny, nz);
+	double spc[3];
+	m_vd->GetSpacings(spc[0], spc[1], spc[2]);
+	if (spc[0] <= 0.0 || spc[1] <= 0.0 || spc[2] <= 0.0)
+		return false;
+
+	//bounding box of the spring
+	double bmin[3], bmax[3];
+	for (int j = 0; j < 3; ++j)
+	{
+		bmin[j] = std::numeric_limits<double>::max();
+		bmax[j] = -std::numeric_limits<double>::max();
+	}
+	for (unsigned int i = 0; i < m_snum; ++i)
+	for (int j = 0; j < 3; ++j)
+	{
+		bmin[j] = std::min(bmin[j], double(m_spoints[i * 3 + j]));
+		bmax[j] = std::max(bmax[j], double(m_spoints[i * 3 + j]));
+	}
+	//points can move by one range before the cloud is rebuilt
+	long long lb[3], ub[3];
+	long long res[3] = { nx, ny, nz };
+	for (int j = 0; j < 3; ++j)
+	{
+		m_cbox[j] = bmin[j] - m_infr;
+		m_cbox[j + 3] = bmax[j] + m_infr;
+		lb[j] = (long long)std::floor((m_cbox[j] - m_infr) / spc[j]);
+		ub[j] = (long long)std::ceil((m_cbox[j + 3] + m_infr) / spc[j]);
+		lb[j] = std::max(0ll, lb[j]);
+		ub[j] = std::min(res[j] - 1, ub[j]);
+	}
+
+	unsigned long long index;
+	float w;
+	for (long long k = lb[2]; k <= ub[2]; ++k)
+	for (long long j = lb[1]; j <= ub[1]; ++j)
+	for (long long i = lb[0]; i <= ub[0]; ++i)
+	{
+		index = (unsigned long long)nx * ny * k + (unsigned long long)nx * j + i;
+		if (bits == 8)
+			w = ((unsigned char*)nrrd_data->data)[index] / 255.0f;
+		else
+			w = ((unsigned short*)nrrd_data->data)[index] / 65535.0f;
+		if (w == 0.0f)
+			continue;
+		m_cpoints.push_back(FLIVR::Point(i * spc[0], j * spc[1], k * spc[2]));
+		m_cweights.push_back(w);
+	}
+	m_hash.Build(m_cpoints, m_infr);
+
+	m_cmask = m_use_mask;
+	m_cinfr = m_infr;
+	m_cver = tex->get_version();
+	m_cvalid = true;
+	return true;
+}
+
+bool Relax::ComputeCpu()
+{
+	if (m_infr <= 0.0f)
+		return false;
+	if (!CloudValid() && !BuildCloud())
+		return false;
+
+	FLIVR::Point pos;
+	FLIVR::Vector dir, dsp;
+	double dist, w, wsum;
+	for (unsigned int c = 0; c < m_snum; ++c)
+	{
+		if (m_slock[c])
+			continue;
+		pos = FLIVR::Point(m_spoints[c * 3],
+			m_spoints[c * 3 + 1], m_spoints[c * 3 + 2]);
+		dsp = FLIVR::Vector();
+		wsum = 0.0;
+		m_hash.Query(pos, m_infr, [&](unsigned int i)
+		{
+			dir = m_cpoints[i] - pos;
+			dist = dir.length();
+			if (dist > m_infr)
+				return;
+			dist = std::max(double(m_rest), dist);
+			w = m_cweights[i];
+			dsp += dir * w / dist / dist;
+			wsum += w;
+		});
+		m_dsp[c * 3] = dsp.x();
+		m_dsp[c * 3 + 1] = dsp.y();
+		m_dsp[c * 3 + 2] = dsp.z();
+		m_wsum[c] = wsum;
+	}
+	return true;
+}
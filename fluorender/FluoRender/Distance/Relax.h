@@ -29,6 +29,7 @@ DEALINGS IN THE SOFTWARE.
 #define FL_Relax_h
 
 #include <Distance/Ruler.h>
+#include <Distance/SpatialHash.h>
 #include <FLIVR/KernelProgram.h>
 #include <FLIVR/VolKernel.h>
 #include <FLIVR/Point.h>
@@ -76,6 +77,21 @@ namespace FL
 		{
 			m_infr = val;
 		}
+		//compute on cpu with voxels near the ruler
+		//also used when opencl is not available
+		void SetUseCpu(bool use_cpu)
+		{
+			m_use_cpu = use_cpu;
+		}
+		bool GetUseCpu()
+		{
+			return m_use_cpu;
+		}
+		//voxels are collected again at next compute
+		void ClearCloud()
+		{
+			m_cvalid = false;
+		}
 
 		bool Compute();
 
@@ -95,8 +111,23 @@ namespace FL
 		std::vector<float> m_dsp;//x, y, z for total displace of each point
 		std::vector<float> m_wsum;//total weight sum for each point
 
+		//cpu
+		bool m_use_cpu;
+		//nonzero voxels around the ruler
+		bool m_cvalid;
+		bool m_cmask;
+		float m_cinfr;
+		unsigned long long m_cver;
+		double m_cbox[6];//ruler points need to stay inside
+		std::vector<FLIVR::Point> m_cpoints;
+		std::vector<float> m_cweights;
+		SpatialHash m_hash;
+
 	private:
 		void BuildSpring();
+		bool CloudValid();
+		bool BuildCloud();
+		bool ComputeCpu();
 	};
 
 }
@@ -44,6 +44,7 @@ Ruler::Ruler()
 	m_ruler_type = 0;
 	m_finished = false;
 	m_use_color = false;
+	m_profile_key = 0;
 
 	//time-dependent
 	m_time_dep = false;
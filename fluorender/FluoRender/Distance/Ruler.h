@@ -292,6 +292,15 @@ namespace FL
 			return &m_profile;
 		}
 		void SaveProfile(wxString &filename);
+		//key of the geometry and data the profile was computed from
+		void SetProfileKey(size_t key)
+		{
+			m_profile_key = key;
+		}
+		size_t GetProfileKey()
+		{
+			return m_profile_key;
+		}
 
 		//color
 		void SetColor(Color& color)
@@ -333,6 +342,7 @@ namespace FL
 		//a profile
 		wxString m_info_profile;
 		std::vector<ProfileBin> m_profile;
+		size_t m_profile_key;
 		//color
 		bool m_use_color;
 		Color m_color;
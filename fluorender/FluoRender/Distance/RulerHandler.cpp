@@ -36,8 +36,12 @@ DEALINGS IN THE SOFTWARE.
 #include <Distance/Cov.h>
 #include <Calculate/Count.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <Formats/base_reader.h>
 #include <Nrrd/nrrd.h>
 #include <wx/fileconf.h>
+#include <algorithm>
+#include <fstream>
+#include <thread>
 
 using namespace FL;
 
@@ -739,15 +743,29 @@ void RulerHandler::Read(wxFileConfig &fconfig, int vi)
 }
 
 int RulerHandler::Profile(int index)
+{
+	std::vector<int> list;
+	list.push_back(index);
+	return Profile(list);
+}
+
+int RulerHandler::Profile(std::vector<int> &list)
 {
 	if (!m_view || !m_vd || !m_ruler_list)
 		return 0;
-	if (index < 0 ||
-		index >= m_ruler_list->size())
-		return 0;
 
-	FL::Ruler* ruler = (*m_ruler_list)[index];
-	if (ruler->GetNumPoint() < 1)
+	std::vector<FL::Ruler*> rulers;
+	for (size_t i = 0; i < list.size(); ++i)
+	{
+		if (list[i] < 0 ||
+			list[i] >= m_ruler_list->size())
+			continue;
+		FL::Ruler* ruler = (*m_ruler_list)[list[i]];
+		if (ruler->GetNumPoint() < 1)
+			continue;
+		rulers.push_back(ruler);
+	}
+	if (rulers.empty())
 		return 0;
 
 	double spcx, spcy, spcz;
@@ -762,173 +780,161 @@ int RulerHandler::Profile(int index)
 	FLIVR::Texture* tex = m_vd->GetTexture();
 	if (!tex) return 0;
 	Nrrd* nrrd_data = tex->get_nrrd(0);
-	if (!nrrd_data) return 0;
-	void* data = nrrd_data->data;
-	if (!data) return 0;
+	if (!nrrd_data || !nrrd_data->data) return 0;
 	//mask
 	Nrrd* nrrd_mask = tex->get_nrrd(tex->nmask());
-	void* mask = 0;
-	if (nrrd_mask)
-		mask = nrrd_mask->data;
-	double scale = m_vd->GetScalarScale();
 
-	if (ruler->GetRulerType() == 3 && mask)
+	m_profiler.SetData(nrrd_data, nrrd_mask, m_vd->GetScalarScale());
+	m_profiler.SetSpacings(spcx, spcy, spcz);
+	m_profiler.SetVersion(tex->get_version());
+	//unchanged rulers keep their profiles
+	m_profiler.Profile(rulers);
+
+	wxString str("Profile of volume ");
+	str = str + m_vd->GetName();
+	for (size_t i = 0; i < rulers.size(); ++i)
+		rulers[i]->SetInfoProfile(str);
+	return 1;
+}
+
+int RulerHandler::ProfileFrames(std::vector<int> &list, int t0, int t1, std::string filename)
+{
+	if (!m_vd || !m_ruler_list)
+		return 0;
+	BaseReader* reader = m_vd->GetReader();
+	if (!reader || m_vd->isBrxml())
+		return 0;
+	if (t0 > t1)
+		std::swap(t0, t1);
+	t0 = std::max(t0, 0);
+	t1 = std::min(t1, reader->GetTimeNum() - 1);
+	if (t0 > t1)
+		return 0;
+
+	std::vector<FL::Ruler*> all;
+	for (size_t i = 0; i < list.size(); ++i)
 	{
+		if (list[i] < 0 ||
+			list[i] >= m_ruler_list->size())
+			continue;
+		FL::Ruler* ruler = (*m_ruler_list)[list[i]];
 		if (ruler->GetNumPoint() < 1)
-			return 0;
-		FLIVR::Point p1, p2;
-		p1 = ruler->GetPoint(0)->GetPoint();
-		p2 = ruler->GetPoint(1)->GetPoint();
-		//object space
-		p1 = FLIVR::Point(p1.x() / spcx, p1.y() / spcy, p1.z() / spcz);
-		p2 = FLIVR::Point(p2.x() / spcx, p2.y() / spcy, p2.z() / spcz);
-		FLIVR::Vector dir = p2 - p1;
-		double dist = dir.length();
-		if (dist < EPS)
-			return 0;
-		dir.normalize();
-
-		//bin number
-		int bins = int(dist / 1 + 0.5);
-		if (bins <= 0) return 0;
-		double bin_dist = dist / bins;
-		std::vector<FL::ProfileBin>* profile = ruler->GetProfile();
-		if (!profile) return 0;
-		profile->clear();
-		profile->reserve(size_t(bins));
-		for (unsigned int b = 0; b < bins; ++b)
-			profile->push_back(FL::ProfileBin());
-
-		double brush_radius = ruler->GetBrushSize() + 1.0;
-
-		int i, j, k;
-		long long vol_index;
-		//go through data
-		for (i = 0; i < nx; ++i)
-		for (j = 0; j < ny; ++j)
-		for (k = 0; k < nz; ++k)
-		{
-			vol_index = (long long)nx*ny*k + nx * j + i;
-			unsigned char mask_value = ((unsigned char*)mask)[vol_index];
-			if (mask_value)
-			{
-				//find bin
-				FLIVR::Point p(i, j, k);
-				FLIVR::Vector pdir = p - p1;
-				double proj = Dot(pdir, dir);
-				int bin_num = int(proj / bin_dist);
-				if (bin_num < 0 || bin_num >= bins)
-					continue;
-				//make sure it's within the brush radius
-				FLIVR::Point p_ruler = p1 + proj * dir;
-				if ((p_ruler - p).length() > brush_radius)
-					continue;
+			continue;
+		all.push_back(ruler);
+	}
+	if (all.empty())
+		return 0;
 
-				double intensity = 0.0;
-				if (nrrd_data->type == nrrdTypeUChar)
-					intensity = double(((unsigned char*)data)[vol_index]) / 255.0;
-				else if (nrrd_data->type == nrrdTypeUShort)
-					intensity = double(((unsigned short*)data)[vol_index]) * scale / 65535.0;
+	double spcx, spcy, spcz;
+	m_vd->GetSpacings(spcx, spcy, spcz);
+	if (spcx <= 0.0 || spcy <= 0.0 || spcz <= 0.0)
+		return 0;
+	int chan = m_vd->GetCurChannel();
 
-				(*profile)[bin_num].m_pixels++;
-				(*profile)[bin_num].m_accum += intensity;
-			}
-		}
+	std::ofstream ofs;
+	ofs.open(filename, std::ofstream::out);
+	if (!ofs.is_open())
+		return 0;
+
+	//masks are per frame, so only intensities along the rulers
+	FL::RulerProfiler profiler;
+	profiler.SetSampleType(m_profiler.GetSampleType());
+	profiler.SetBoxSize(m_profiler.GetBoxSize());
+	profiler.SetSpacings(spcx, spcy, spcz);
+	double scale = m_vd->GetScalarScale();
+
+	//each ruler has a column for each bin, which only depends on
+	//its points, so the first frame sets the layout for all frames
+	Nrrd* data = reader->Convert(t0, chan, false);
+	if (!data)
+		return 0;
+	std::vector<std::vector<FL::ProfileBin>> first;
+	profiler.SetData(data, 0, scale);
+	profiler.Profile(all, first);
+	if (first.size() != all.size())
+	{
+		nrrdNuke(data);
+		return 0;
 	}
-	else
+	ofs << "Frame";
+	for (size_t i = 0; i < all.size(); ++i)
+	{
+		std::string name = all[i]->GetName().ToStdString();
+		for (size_t j = 0; j < first[i].size(); ++j)
+			ofs << "\t" << name << "_" << j + 1;
+	}
+	ofs << "\n";
+
+	//readers are not thread safe, but the next frame can be read
+	//while the current one is sampled
+	for (int t = t0; t <= t1; ++t)
 	{
-		//calculate length in object space
-		double total_length = ruler->GetLengthObject(spcx, spcy, spcz);
-		int bins = int(total_length);
-		std::vector<FL::ProfileBin>* profile = ruler->GetProfile();
-		if (!profile) return 0;
-		profile->clear();
-
-		//sample data through ruler
-		int i, j, k;
-		long long vol_index;
-		FLIVR::Point p;
-		double intensity;
-		if (bins == 0)
+		Nrrd* next = 0;
+		std::thread loader;
+		if (t < t1)
+			loader = std::thread([&]()
+			{
+				next = reader->Convert(t + 1, chan, false);
+			});
+
+		//rulers not at this time point are left empty
+		std::vector<FL::Ruler*> rulers;
+		std::vector<size_t> columns;
+		for (size_t i = 0; i < all.size(); ++i)
 		{
-			//allocate
-			profile->reserve(size_t(1));
-			profile->push_back(FL::ProfileBin());
-
-			p = ruler->GetPoint(0)->GetPoint();
-			//object space
-			p = FLIVR::Point(p.x() / spcx, p.y() / spcy, p.z() / spcz);
-			intensity = 0.0;
-			i = int(p.x() + 0.5);
-			j = int(p.y() + 0.5);
-			k = int(p.z() + 0.5);
-			if (i >= 0 && i <= nx && j >= 0 && j <= ny && k >= 0 && k <= nz)
+			if (!all[i]->GetTimeDep() ||
+				all[i]->GetTime() == t)
 			{
-				if (i == nx) i = nx - 1;
-				if (j == ny) j = ny - 1;
-				if (k == nz) k = nz - 1;
-				vol_index = (long long)nx*ny*k + nx * j + i;
-				if (nrrd_data->type == nrrdTypeUChar)
-					intensity = double(((unsigned char*)data)[vol_index]) / 255.0;
-				else if (nrrd_data->type == nrrdTypeUShort)
-					intensity = double(((unsigned short*)data)[vol_index]) * scale / 65535.0;
+				rulers.push_back(all[i]);
+				columns.push_back(i);
 			}
-			(*profile)[0].m_pixels++;
-			(*profile)[0].m_accum += intensity;
 		}
-		else
+		std::vector<std::vector<FL::ProfileBin>> profiles;
+		if (t == t0)
 		{
-			//allocate
-			profile->reserve(size_t(bins));
-			for (unsigned int b = 0; b < bins; ++b)
-				profile->push_back(FL::ProfileBin());
-
-			FLIVR::Point p1, p2;
-			FLIVR::Vector dir;
-			double dist;
-			int total_dist = 0;
-			for (unsigned int pn = 0; pn < ruler->GetNumPoint() - 1; ++pn)
+			for (size_t i = 0; i < columns.size(); ++i)
+				profiles.push_back(first[columns[i]]);
+		}
+		else if (data)
+		{
+			profiler.SetData(data, 0, scale);
+			profiler.Profile(rulers, profiles);
+		}
+
+		ofs << t;
+		size_t ri = 0;
+		for (size_t i = 0; i < all.size(); ++i)
+		{
+			std::vector<FL::ProfileBin>* profile = 0;
+			if (ri < columns.size() && columns[ri] == i)
 			{
-				p1 = ruler->GetPoint(pn)->GetPoint();
-				p2 = ruler->GetPoint(pn + 1)->GetPoint();
-				//object space
-				p1 = FLIVR::Point(p1.x() / spcx, p1.y() / spcy, p1.z() / spcz);
-				p2 = FLIVR::Point(p2.x() / spcx, p2.y() / spcy, p2.z() / spcz);
-				dir = p2 - p1;
-				dist = dir.length();
-				dir.normalize();
-
-				for (unsigned int dn = 0; dn < (unsigned int)(dist + 0.5); ++dn)
-				{
-					p = p1 + dir * double(dn);
-					intensity = 0.0;
-					i = int(p.x() + 0.5);
-					j = int(p.y() + 0.5);
-					k = int(p.z() + 0.5);
-					if (i >= 0 && i <= nx && j >= 0 && j <= ny && k >= 0 && k <= nz)
-					{
-						if (i == nx) i = nx - 1;
-						if (j == ny) j = ny - 1;
-						if (k == nz) k = nz - 1;
-						vol_index = (long long)nx*ny*k + nx * j + i;
-						if (nrrd_data->type == nrrdTypeUChar)
-							intensity = double(((unsigned char*)data)[vol_index]) / 255.0;
-						else if (nrrd_data->type == nrrdTypeUShort)
-							intensity = double(((unsigned short*)data)[vol_index]) * scale / 65535.0;
-					}
-					if (total_dist >= bins) break;
-					(*profile)[total_dist].m_pixels++;
-					(*profile)[total_dist].m_accum += intensity;
-					total_dist++;
-				}
+				if (ri < profiles.size())
+					profile = &profiles[ri];
+				ri++;
+			}
+			for (size_t j = 0; j < first[i].size(); ++j)
+			{
+				ofs << "\t";
+				if (!profile || j >= profile->size())
+					continue;
+				int pixels = (*profile)[j].m_pixels;
+				if (pixels <= 0)
+					ofs << 0.0;
+				else
+					ofs << (*profile)[j].m_accum / pixels;
 			}
-			if (total_dist < bins)
-				profile->erase(profile->begin() + total_dist, profile->begin() + bins - 1);
 		}
+		ofs << "\n";
+
+		if (loader.joinable())
+			loader.join();
+		if (data)
+			nrrdNuke(data);
+		data = next;
 	}
-	wxString str("Profile of volume ");
-	str = str + m_vd->GetName();
-	ruler->SetInfoProfile(str);
+	if (data)
+		nrrdNuke(data);
+	ofs.close();
 	return 1;
 }
 
@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #define _RulerHandler_H_
 
 #include <Distance/Ruler.h>
+#include <Distance/RulerProfiler.h>
 #include <Selection/VolumePoint.h>
 #include <string>
 
@@ -135,7 +136,20 @@ namespace FL
 		void Save(wxFileConfig &fconfig, int vi);
 		void Read(wxFileConfig &fconfig, int vi);
 
+		//sampling of profiles, 0: nearest; 1: trilinear; 2: box
+		void SetSampleType(int type)
+		{
+			m_profiler.SetSampleType(type);
+		}
+		int GetSampleType()
+		{
+			return m_profiler.GetSampleType();
+		}
+
 		int Profile(int index);
+		int Profile(std::vector<int> &list);
+		//profiles of frames from t0 to t1 saved to a file
+		int ProfileFrames(std::vector<int> &list, int t0, int t1, std::string filename);
 		int Distance(int index, std::string filename);
 
 	private:
@@ -143,6 +157,7 @@ namespace FL
 		VolumeData * m_vd;
 		ComponentAnalyzer* m_ca;
 		VolumePoint m_vp;
+		RulerProfiler m_profiler;
 		Ruler *m_ruler;
 		RulerList *m_ruler_list;
 		int m_type;	//0: 2 point; 1: multi point; 2:locator; 3: probe;
@@ -0,0 +1,358 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "RulerProfiler.h"
+#include <utility.h>
+#include <Formats/parallel_io.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using namespace FL;
+
+RulerProfiler::RulerProfiler() :
+	m_data(0),
+	m_mask(0),
+	m_bits(8),
+	m_nx(0),
+	m_ny(0),
+	m_nz(0),
+	m_scale(1.0),
+	m_spcx(1.0),
+	m_spcy(1.0),
+	m_spcz(1.0),
+	m_version(0),
+	m_sample_type(0),
+	m_box_size(1)
+{
+}
+
+RulerProfiler::~RulerProfiler()
+{
+}
+
+void RulerProfiler::SetData(Nrrd* data, Nrrd* mask, double scale)
+{
+	m_data = 0;
+	m_mask = 0;
+	m_nx = m_ny = m_nz = 0;
+	m_scale = scale;
+	if (!data || !data->data || data->dim != 3)
+		return;
+	if (data->type == nrrdTypeUChar)
+		m_bits = 8;
+	else if (data->type == nrrdTypeUShort)
+		m_bits = 16;
+	else
+		return;
+	m_data = data->data;
+	m_nx = data->axis[0].size;
+	m_ny = data->axis[1].size;
+	m_nz = data->axis[2].size;
+	if (mask && mask->data &&
+		mask->axis[0].size == m_nx &&
+		mask->axis[1].size == m_ny &&
+		mask->axis[2].size == m_nz)
+		m_mask = mask->data;
+}
+
+size_t RulerProfiler::GetKey(Ruler* ruler)
+{
+	if (!ruler)
+		return 0;
+	//probes depend on the mask, which can change anytime
+	if (ruler->GetRulerType() == 3 && m_mask)
+		return 0;
+
+	size_t key = 0;
+	std::hash<double> hd;
+	auto combine = [&key](size_t h)
+	{
+		key ^= h + 0x9e3779b9 + (key << 6) + (key >> 2);
+	};
+	combine(std::hash<unsigned long long>()(m_version));
+	combine(std::hash<int>()(ruler->GetRulerType()));
+	combine(std::hash<int>()(m_sample_type));
+	combine(std::hash<int>()(m_box_size));
+	combine(hd(m_scale));
+	combine(hd(m_spcx));
+	combine(hd(m_spcy));
+	combine(hd(m_spcz));
+	for (int i = 0; i < ruler->GetNumPoint(); ++i)
+	{
+		Point p = ruler->GetPoint(i)->GetPoint();
+		combine(hd(p.x()));
+		combine(hd(p.y()));
+		combine(hd(p.z()));
+	}
+	//reserve 0 for not cached
+	return key ? key : 1;
+}
+
+bool RulerProfiler::Profile(Ruler* ruler, std::vector<ProfileBin> &profile)
+{
+	if (!ruler || !Valid())
+		return false;
+	if (ruler->GetNumPoint() < 1)
+		return false;
+
+	if (ruler->GetRulerType() == 3 && m_mask)
+		return ProfileProbe(ruler, profile);
+	else
+		return ProfileLine(ruler, profile);
+}
+
+int RulerProfiler::Profile(std::vector<Ruler*> &rulers, bool use_cache)
+{
+	if (!Valid())
+		return 0;
+
+	//rulers to compute
+	std::vector<Ruler*> list;
+	std::vector<size_t> keys;
+	for (size_t i = 0; i < rulers.size(); ++i)
+	{
+		Ruler* ruler = rulers[i];
+		if (!ruler)
+			continue;
+		size_t key = GetKey(ruler);
+		if (use_cache && key &&
+			key == ruler->GetProfileKey() &&
+			!ruler->GetProfile()->empty())
+			continue;
+		list.push_back(ruler);
+		keys.push_back(key);
+	}
+	if (list.empty())
+		return 0;
+
+	return Run(list.size(), [&](size_t i)
+	{
+		if (Profile(list[i], *(list[i]->GetProfile())))
+		{
+			list[i]->SetProfileKey(keys[i]);
+			return true;
+		}
+		list[i]->SetProfileKey(0);
+		return false;
+	});
+}
+
+int RulerProfiler::Profile(std::vector<Ruler*> &rulers,
+	std::vector<std::vector<ProfileBin>> &profiles)
+{
+	profiles.clear();
+	if (!Valid())
+		return 0;
+	profiles.resize(rulers.size());
+	return Run(rulers.size(), [&](size_t i)
+	{
+		return Profile(rulers[i], profiles[i]);
+	});
+}
+
+int RulerProfiler::Run(size_t num, const std::function<bool(size_t)> &func)
+{
+	if (!num)
+		return 0;
+
+	std::atomic<int> count(0);
+	ParallelIO::Run(num, [&](size_t i)
+	{
+		if (func(i))
+			count++;
+	});
+	return count;
+}
+
+double RulerProfiler::Sample(const Point &p)
+{
+	//same bounds as nearest neighbor rounding
+	long long i = (long long)(p.x() + 0.5);
+	long long j = (long long)(p.y() + 0.5);
+	long long k = (long long)(p.z() + 0.5);
+	if (i < 0 || i > m_nx || j < 0 || j > m_ny || k < 0 || k > m_nz)
+		return 0.0;
+	if (i == m_nx) i = m_nx - 1;
+	if (j == m_ny) j = m_ny - 1;
+	if (k == m_nz) k = m_nz - 1;
+
+	switch (m_sample_type)
+	{
+	case 0:
+	default:
+		return GetValue(i, j, k);
+	case 1:
+		{
+			double x = std::max(0.0, std::min(p.x(), double(m_nx - 1)));
+			double y = std::max(0.0, std::min(p.y(), double(m_ny - 1)));
+			double z = std::max(0.0, std::min(p.z(), double(m_nz - 1)));
+			long long i0 = (long long)x;
+			long long j0 = (long long)y;
+			long long k0 = (long long)z;
+			long long i1 = std::min(i0 + 1, m_nx - 1);
+			long long j1 = std::min(j0 + 1, m_ny - 1);
+			long long k1 = std::min(k0 + 1, m_nz - 1);
+			double fx = x - i0;
+			double fy = y - j0;
+			double fz = z - k0;
+			double c00 = GetValue(i0, j0, k0) * (1.0 - fx) + GetValue(i1, j0, k0) * fx;
+			double c10 = GetValue(i0, j1, k0) * (1.0 - fx) + GetValue(i1, j1, k0) * fx;
+			double c01 = GetValue(i0, j0, k1) * (1.0 - fx) + GetValue(i1, j0, k1) * fx;
+			double c11 = GetValue(i0, j1, k1) * (1.0 - fx) + GetValue(i1, j1, k1) * fx;
+			double c0 = c00 * (1.0 - fy) + c10 * fy;
+			double c1 = c01 * (1.0 - fy) + c11 * fy;
+			return c0 * (1.0 - fz) + c1 * fz;
+		}
+	case 2:
+		{
+			double sum = 0.0;
+			int count = 0;
+			long long r = std::max(0, m_box_size);
+			long long ii, jj, kk;
+			for (kk = std::max(0ll, k - r); kk <= std::min(m_nz - 1, k + r); ++kk)
+			for (jj = std::max(0ll, j - r); jj <= std::min(m_ny - 1, j + r); ++jj)
+			for (ii = std::max(0ll, i - r); ii <= std::min(m_nx - 1, i + r); ++ii)
+			{
+				sum += GetValue(ii, jj, kk);
+				count++;
+			}
+			return count ? sum / count : 0.0;
+		}
+	}
+}
+
+bool RulerProfiler::ProfileLine(Ruler* ruler, std::vector<ProfileBin> &profile)
+{
+	//calculate length in object space
+	double total_length = ruler->GetLengthObject(m_spcx, m_spcy, m_spcz);
+	int bins = int(total_length);
+	profile.clear();
+
+	Point p;
+	if (bins == 0)
+	{
+		profile.push_back(ProfileBin());
+		p = ruler->GetPoint(0)->GetPoint();
+		//object space
+		p = Point(p.x() / m_spcx, p.y() / m_spcy, p.z() / m_spcz);
+		profile[0].m_pixels++;
+		profile[0].m_accum += Sample(p);
+		return true;
+	}
+
+	profile.resize(size_t(bins));
+	Point p1, p2;
+	Vector dir;
+	double dist;
+	int total_dist = 0;
+	for (int pn = 0; pn < ruler->GetNumPoint() - 1; ++pn)
+	{
+		p1 = ruler->GetPoint(pn)->GetPoint();
+		p2 = ruler->GetPoint(pn + 1)->GetPoint();
+		//object space
+		p1 = Point(p1.x() / m_spcx, p1.y() / m_spcy, p1.z() / m_spcz);
+		p2 = Point(p2.x() / m_spcx, p2.y() / m_spcy, p2.z() / m_spcz);
+		dir = p2 - p1;
+		dist = dir.length();
+		dir.normalize();
+
+		for (unsigned int dn = 0; dn < (unsigned int)(dist + 0.5); ++dn)
+		{
+			if (total_dist >= bins) break;
+			p = p1 + dir * double(dn);
+			profile[total_dist].m_pixels++;
+			profile[total_dist].m_accum += Sample(p);
+			total_dist++;
+		}
+	}
+	if (total_dist < bins)
+		profile.erase(profile.begin() + total_dist, profile.end());
+	return true;
+}
+
+bool RulerProfiler::ProfileProbe(Ruler* ruler, std::vector<ProfileBin> &profile)
+{
+	profile.clear();
+	if (ruler->GetNumPoint() < 2)
+		return false;
+	Point p1, p2;
+	p1 = ruler->GetPoint(0)->GetPoint();
+	p2 = ruler->GetPoint(1)->GetPoint();
+	//object space
+	p1 = Point(p1.x() / m_spcx, p1.y() / m_spcy, p1.z() / m_spcz);
+	p2 = Point(p2.x() / m_spcx, p2.y() / m_spcy, p2.z() / m_spcz);
+	Vector dir = p2 - p1;
+	double dist = dir.length();
+	if (dist < EPS)
+		return false;
+	dir.normalize();
+
+	//bin number
+	int bins = int(dist / 1 + 0.5);
+	if (bins <= 0)
+		return false;
+	double bin_dist = dist / bins;
+	profile.resize(size_t(bins));
+
+	double brush_radius = ruler->GetBrushSize() + 1.0;
+
+	//only voxels around the probe can contribute
+	long long minx = std::max(0ll, (long long)std::floor(std::min(p1.x(), p2.x()) - brush_radius));
+	long long miny = std::max(0ll, (long long)std::floor(std::min(p1.y(), p2.y()) - brush_radius));
+	long long minz = std::max(0ll, (long long)std::floor(std::min(p1.z(), p2.z()) - brush_radius));
+	long long maxx = std::min(m_nx - 1, (long long)std::ceil(std::max(p1.x(), p2.x()) + brush_radius));
+	long long maxy = std::min(m_ny - 1, (long long)std::ceil(std::max(p1.y(), p2.y()) + brush_radius));
+	long long maxz = std::min(m_nz - 1, (long long)std::ceil(std::max(p1.z(), p2.z()) + brush_radius));
+
+	long long i, j, k;
+	unsigned long long index;
+	for (k = minz; k <= maxz; ++k)
+	for (j = miny; j <= maxy; ++j)
+	for (i = minx; i <= maxx; ++i)
+	{
+		index = (unsigned long long)m_nx*m_ny*k + m_nx*j + i;
+		if (!((unsigned char*)m_mask)[index])
+			continue;
+		//find bin
+		Point p(i, j, k);
+		Vector pdir = p - p1;
+		double proj = Dot(pdir, dir);
+		int bin_num = int(proj / bin_dist);
+		if (bin_num < 0 || bin_num >= bins)
+			continue;
+		//make sure it's within the brush radius
+		Point p_ruler = p1 + proj * dir;
+		if ((p_ruler - p).length() > brush_radius)
+			continue;
+
+		profile[bin_num].m_pixels++;
+		profile[bin_num].m_accum += GetValue(i, j, k);
+	}
+	return true;
+}
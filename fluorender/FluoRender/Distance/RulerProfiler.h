@@ -0,0 +1,125 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FL_RulerProfiler_h
+#define FL_RulerProfiler_h
+
+#include <Distance/Ruler.h>
+#include <nrrd.h>
+#include <vector>
+#include <functional>
+
+namespace FL
+{
+	//samples intensity profiles of rulers on the cpu
+	//rulers are distributed to the shared io threads (ParallelIO)
+	class RulerProfiler
+	{
+	public:
+		RulerProfiler();
+		~RulerProfiler();
+
+		//data and mask in main memory
+		void SetData(Nrrd* data, Nrrd* mask, double scale);
+		void SetSpacings(double spcx, double spcy, double spcz)
+		{
+			m_spcx = spcx;
+			m_spcy = spcy;
+			m_spcz = spcz;
+		}
+		//version of the data for caching
+		void SetVersion(unsigned long long ver)
+		{
+			m_version = ver;
+		}
+		//0: nearest; 1: trilinear; 2: box
+		void SetSampleType(int type)
+		{
+			m_sample_type = type;
+		}
+		int GetSampleType()
+		{
+			return m_sample_type;
+		}
+		//half size of the box in voxels
+		void SetBoxSize(int size)
+		{
+			m_box_size = size;
+		}
+		int GetBoxSize()
+		{
+			return m_box_size;
+		}
+		//key from ruler geometry, settings and data version
+		//0 if the profile cannot be cached
+		size_t GetKey(Ruler* ruler);
+		//compute profile of one ruler
+		bool Profile(Ruler* ruler, std::vector<ProfileBin> &profile);
+		//compute profiles of rulers in their own profile lists
+		//return the number of profiles computed
+		int Profile(std::vector<Ruler*> &rulers, bool use_cache = true);
+		//compute profiles of rulers in separate lists, no caching
+		int Profile(std::vector<Ruler*> &rulers,
+			std::vector<std::vector<ProfileBin>> &profiles);
+
+	private:
+		void* m_data;
+		void* m_mask;
+		int m_bits;
+		long long m_nx, m_ny, m_nz;
+		double m_scale;
+		double m_spcx, m_spcy, m_spcz;
+		unsigned long long m_version;
+		int m_sample_type;
+		int m_box_size;
+
+	private:
+		bool Valid()
+		{
+			return m_data && m_nx > 0 && m_ny > 0 && m_nz > 0 &&
+				m_spcx > 0.0 && m_spcy > 0.0 && m_spcz > 0.0;
+		}
+		double GetValue(long long i, long long j, long long k)
+		{
+			unsigned long long index = (unsigned long long)m_nx*m_ny*k + m_nx*j + i;
+			if (m_bits == 8)
+				return double(((unsigned char*)m_data)[index]) / 255.0;
+			else
+				return double(((unsigned short*)m_data)[index]) * m_scale / 65535.0;
+		}
+		//run tasks on the io threads, return the number of successes
+		int Run(size_t num, const std::function<bool(size_t)> &func);
+		//sample at a point in voxel coordinates
+		double Sample(const Point &p);
+		//go along the ruler
+		bool ProfileLine(Ruler* ruler, std::vector<ProfileBin> &profile);
+		//voxels in mask near a probe
+		bool ProfileProbe(Ruler* ruler, std::vector<ProfileBin> &profile);
+	};
+}
+#endif//FL_RulerProfiler_h
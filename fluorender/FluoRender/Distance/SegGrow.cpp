@@ -733,6 +733,9 @@ void SegGrow::Compute()
 			continue;
 		//clear new grown flag
 		b->set_new_grown(false);
+		//nothing grows without selection
+		if (b->is_empty(b->nmask()))
+			continue;
 		int nx = b->nx();
 		int ny = b->ny();
 		int nz = b->nz();
@@ -1092,6 +1095,7 @@ void SegGrow::Compute()
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -1254,6 +1258,7 @@ void SegGrow::Compute()
 		//read back
 		kernel_prog->copyBufTex3D(arg_label, lid,
 			sizeof(unsigned int)*nx*ny*nz, region);
+		b->invalidate_summary(b->nlabel(), true);
 
 		//release buffer
 		kernel_prog->releaseAll();
@@ -0,0 +1,145 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FL_SpatialHash_h
+#define FL_SpatialHash_h
+
+#include <FLIVR/Point.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+namespace FL
+{
+	//uniform grid of buckets over a point cloud
+	//for neighbor queries within a fixed range
+	class SpatialHash
+	{
+	public:
+		SpatialHash() :
+			m_cell(1.0)
+		{}
+		~SpatialHash()
+		{}
+
+		//cell size is usually the query range
+		void Build(const std::vector<FLIVR::Point> &points, double cell)
+		{
+			Clear();
+			m_cell = cell > 0.0 ? cell : 1.0;
+			size_t num = points.size();
+			std::vector<std::pair<unsigned long long, unsigned int>> keys(num);
+			for (size_t i = 0; i < num; ++i)
+				keys[i] = std::make_pair(GetKey(points[i]), (unsigned int)i);
+			//points of a cell are stored together
+			std::sort(keys.begin(), keys.end());
+			m_index.resize(num);
+			for (size_t i = 0; i < num; ++i)
+			{
+				m_index[i] = keys[i].second;
+				if (i == 0 || keys[i].first != keys[i - 1].first)
+					m_cells[keys[i].first] = std::make_pair(i, i + 1);
+				else
+					m_cells[keys[i].first].second = i + 1;
+			}
+		}
+
+		void Clear()
+		{
+			m_cells.clear();
+			m_index.clear();
+		}
+
+		bool Empty()
+		{
+			return m_index.empty();
+		}
+
+		double GetCellSize()
+		{
+			return m_cell;
+		}
+
+		//call func(index) for points in cells overlapping the range
+		//the caller checks the actual distance
+		template<class F>
+		void Query(const FLIVR::Point &p, double range, F func)
+		{
+			long long lx = Cell(p.x() - range);
+			long long ly = Cell(p.y() - range);
+			long long lz = Cell(p.z() - range);
+			long long ux = Cell(p.x() + range);
+			long long uy = Cell(p.y() + range);
+			long long uz = Cell(p.z() + range);
+			//large ranges visit the occupied cells only
+			double cnum = double(ux - lx + 1) * double(uy - ly + 1) * double(uz - lz + 1);
+			if (cnum > double(m_cells.size()))
+			{
+				for (size_t n = 0; n < m_index.size(); ++n)
+					func(m_index[n]);
+				return;
+			}
+			for (long long k = lz; k <= uz; ++k)
+			for (long long j = ly; j <= uy; ++j)
+			for (long long i = lx; i <= ux; ++i)
+			{
+				auto it = m_cells.find(GetKey(i, j, k));
+				if (it == m_cells.end())
+					continue;
+				for (size_t n = it->second.first; n < it->second.second; ++n)
+					func(m_index[n]);
+			}
+		}
+
+	private:
+		double m_cell;
+		//cell key to a range in m_index
+		std::unordered_map<unsigned long long, std::pair<size_t, size_t>> m_cells;
+		std::vector<unsigned int> m_index;
+
+		long long Cell(double v)
+		{
+			return (long long)std::floor(v / m_cell);
+		}
+		unsigned long long GetKey(long long i, long long j, long long k)
+		{
+			//21 bits each
+			const long long off = 1ll << 20;
+			const unsigned long long mask = (1ull << 21) - 1;
+			return ((unsigned long long)(i + off) & mask) |
+				(((unsigned long long)(j + off) & mask) << 21) |
+				(((unsigned long long)(k + off) & mask) << 42);
+		}
+		unsigned long long GetKey(const FLIVR::Point &p)
+		{
+			return GetKey(Cell(p.x()), Cell(p.y()), Cell(p.z()));
+		}
+	};
+}
+#endif//FL_SpatialHash_h
@@ -39,6 +39,7 @@ using namespace std;
 namespace FLIVR
 {
 	size_t Texture::mask_undo_num_ = 0;
+	std::atomic<unsigned long long> Texture::version_seq_(0);
 	Texture::Texture():
 	build_max_tex_size_(0),
 	brick_size_(0),
@@ -78,6 +79,7 @@ namespace FLIVR
 			ntype_[i] = TYPE_NONE;
 		}
 		bricks_ = &default_vec_;
+		touch();
 	}
 
 	Texture::~Texture()
@@ -636,6 +638,12 @@ namespace FLIVR
 		pyramid_lv_num_ = pyramid.size();
 		pyramid_ = pyramid;
 		filenames_ = filenames;
+		//levels point to the caller's file lists
+		for (int i = 0; i < pyramid_.size(); i++)
+			for (int j = 0; j < filenames[i].size(); j++)
+				for (int k = 0; k < filenames[i][j].size(); k++)
+					if (pyramid_[i].filenames == &filenames[i][j][k])
+						pyramid_[i].filenames = &filenames_[i][j][k];
 		for (int i = 0; i < pyramid_.size(); i++)
 		{
 			if (!pyramid_[i].data || pyramid_[i].bricks.empty())
@@ -763,6 +771,8 @@ namespace FLIVR
 			}
 
 			data_[index] = data;
+			if (index == 0)
+				touch();
 			if (!existInPyramid)
 			{
 				for (int i = 0; i < (int)(*bricks_).size(); i++)
@@ -907,6 +917,7 @@ namespace FLIVR
 			mask_undos_[mask_undo_pointer_],
 			nrrdTypeUChar, 3, (size_t)nx_,
 			(size_t)ny_, (size_t)nz_);
+		invalidate_summary(nmask_);
 	}
 
 	void Texture:: mask_undos_backward()
@@ -925,6 +936,7 @@ namespace FLIVR
 			mask_undos_[mask_undo_pointer_],
 			nrrdTypeUChar, 3, (size_t)nx_,
 			(size_t)ny_, (size_t)nz_);
+		invalidate_summary(nmask_);
 	}
 
 	void Texture::mask_undos_forward()
@@ -943,6 +955,7 @@ namespace FLIVR
 			mask_undos_[mask_undo_pointer_],
 			nrrdTypeUChar, 3, (size_t)nx_,
 			(size_t)ny_, (size_t)nz_);
+		invalidate_summary(nmask_);
 	}
 
 } // namespace FLIVR
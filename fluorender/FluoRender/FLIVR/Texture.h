@@ -30,6 +30,7 @@
 #define SLIVR_Texture_h
 
 #include <vector>
+#include <atomic>
 #include <FLIVR/Transform.h>
 #include "TextureBrick.h"
 #include <FLIVR/Utils.h>
@@ -45,6 +46,7 @@ namespace FLIVR
 	{
 	public:
 		static size_t mask_undo_num_;
+		static std::atomic<unsigned long long> version_seq_;
 		Texture();
 		virtual ~Texture();
 
@@ -266,6 +268,18 @@ namespace FLIVR
 				(*bricks_)[i]->set_paint_mask(true);
 		}
 
+		//data version, changed when the intensity data are replaced
+		//results computed from the data can be cached against it
+		unsigned long long get_version() { return version_; }
+		void touch() { version_ = ++version_seq_; }
+
+		//invalidate data summaries of a component for all bricks
+		void invalidate_summary(int c, bool gpu = false)
+		{
+			for (size_t i = 0; i < bricks_->size(); ++i)
+				(*bricks_)[i]->invalidate_summary(c, gpu);
+		}
+
 		//get priority brick number
 		inline void set_use_priority(bool value) {use_priority_ = value;}
 		inline bool get_use_priority() {return use_priority_;}
@@ -321,6 +335,8 @@ namespace FLIVR
 		CompType									ntype_[TEXTURE_MAX_COMPONENTS];
 		//the index of current mask
 		int											nmask_;
+		//data version
+		unsigned long long							version_;
 		//the index of current label
 		int											nlabel_;
 		//! bytes per texel for each component.
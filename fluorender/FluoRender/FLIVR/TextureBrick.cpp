@@ -60,6 +60,10 @@ namespace FLIVR
 			data_[i] = 0;
 			nb_[i] = 0;
 			ntype_[i] = TYPE_NONE;
+			sum_state_[i] = BRICK_SUMMARY_NONE;
+			sum_min_[i] = 0.0;
+			sum_max_[i] = 0.0;
+			sum_count_[i] = 0;
 		}
 
 		for (int c = 0; c < nc_; c++)
@@ -495,6 +499,98 @@ namespace FLIVR
 		}
 	}
 
+	template<typename T>
+	void TextureBrick::compute_summary_aux(int c, double scale)
+	{
+		T* ptr = (T*)(tex_data(c));
+		if (!ptr)
+			return;
+		unsigned long long sx = (unsigned long long)(this->sx());
+		unsigned long long sxy = sx * (unsigned long long)(sy());
+		T vmin = ptr[0];
+		T vmax = ptr[0];
+		unsigned long long count = 0;
+		for (int k = 0; k < nz_; ++k)
+		for (int j = 0; j < ny_; ++j)
+		{
+			T* row = ptr + sxy * k + sx * j;
+			for (int i = 0; i < nx_; ++i)
+			{
+				T v = row[i];
+				if (v)
+					count++;
+				if (v < vmin) vmin = v;
+				if (v > vmax) vmax = v;
+			}
+		}
+		sum_min_[c] = vmin / scale;
+		sum_max_[c] = vmax / scale;
+		sum_count_[c] = count;
+		sum_state_[c] = BRICK_SUMMARY_VALID;
+	}
+
+	void TextureBrick::compute_summary(int c)
+	{
+		if (c < 0 || c >= TEXTURE_MAX_COMPONENTS)
+			return;
+		sum_state_[c] = BRICK_SUMMARY_NONE;
+		if (!data_[0] || !data_[c] || !data_[c]->data)
+			return;
+		//single channel only
+		if (size_t(nb_[c]) != tex_type_size(tex_type(c)))
+			return;
+
+		switch (tex_type(c))
+		{
+		case GL_UNSIGNED_BYTE:
+			compute_summary_aux<unsigned char>(c, 255.0);
+			break;
+		case GL_UNSIGNED_SHORT:
+			compute_summary_aux<unsigned short>(c, 65535.0);
+			break;
+		case GL_UNSIGNED_INT:
+			//labels keep their ids
+			compute_summary_aux<unsigned int>(c, 1.0);
+			break;
+		}
+	}
+
+	bool TextureBrick::get_summary(int c, double &vmin, double &vmax,
+		unsigned long long &count)
+	{
+		if (c < 0 || c >= TEXTURE_MAX_COMPONENTS)
+			return false;
+		if (sum_state_[c] == BRICK_SUMMARY_NONE)
+			compute_summary(c);
+#ifdef _DEBUG
+		else if (sum_state_[c] == BRICK_SUMMARY_VALID)
+		{
+			//a writer changed the data without invalidating the summary
+			unsigned long long old_count = sum_count_[c];
+			double old_min = sum_min_[c];
+			double old_max = sum_max_[c];
+			compute_summary(c);
+			assert(sum_count_[c] == old_count &&
+				sum_min_[c] == old_min && sum_max_[c] == old_max);
+		}
+#endif
+		if (sum_state_[c] != BRICK_SUMMARY_VALID)
+			return false;
+		vmin = sum_min_[c];
+		vmax = sum_max_[c];
+		count = sum_count_[c];
+		return true;
+	}
+
+	bool TextureBrick::is_empty(int c)
+	{
+		double vmin, vmax;
+		unsigned long long count;
+		if (!get_summary(c, vmin, vmax, count))
+			return false;
+		return count == 0;
+	}
+
 	void TextureBrick::freeBrkData()
 	{
 		if (brkdata_) delete[] brkdata_;
@@ -56,6 +56,11 @@ namespace FLIVR {
 #define BRICK_FILE_TYPE_JPEG	2
 #define BRICK_FILE_TYPE_ZLIB	3
 
+	//state of the data summary of a brick component
+#define BRICK_SUMMARY_NONE		0	//not computed, main memory is current
+#define BRICK_SUMMARY_VALID		1
+#define BRICK_SUMMARY_GPU		2	//changed on gpu, not returned yet
+
 	class FileLocInfo {
 	public:
 		FileLocInfo()
@@ -165,10 +170,41 @@ namespace FLIVR {
 
 		// Creator of the brick owns the nrrd memory.
 		void set_nrrd(Nrrd* data, int index)
-		{if (index>=0&&index<TEXTURE_MAX_COMPONENTS) data_[index] = data;}
+		{
+			if (index >= 0 && index < TEXTURE_MAX_COMPONENTS)
+			{
+				data_[index] = data;
+				sum_state_[index] = BRICK_SUMMARY_NONE;
+			}
+		}
 		Nrrd* get_nrrd(int index)
 		{if (index>=0&&index<TEXTURE_MAX_COMPONENTS) return data_[index]; else return 0;}
 
+		//data summary (min/max and nonzero count) of a component
+		//analysis passes use it to skip bricks with nothing in them
+		//it is not updated incrementally: any code changing a component
+		//in main memory must invalidate it, usually by clear_tex_mask()
+		//or clear_tex_label(), which the upload needs anyway
+		//gpu writers mark it BRICK_SUMMARY_GPU until the data are returned
+		//debug builds check a valid summary against the data when queried
+		void compute_summary(int c);
+		void invalidate_summary(int c, bool gpu = false)
+		{
+			if (c >= 0 && c < TEXTURE_MAX_COMPONENTS)
+				sum_state_[c] = gpu ? BRICK_SUMMARY_GPU : BRICK_SUMMARY_NONE;
+		}
+		bool summary_valid(int c)
+		{
+			if (c >= 0 && c < TEXTURE_MAX_COMPONENTS)
+				return sum_state_[c] == BRICK_SUMMARY_VALID;
+			return false;
+		}
+		//computed on demand, false if not available
+		bool get_summary(int c, double &vmin, double &vmax,
+			unsigned long long &count);
+		//true only if the component is known to be all zero
+		bool is_empty(int c);
+
 		//find out priority
 		void set_priority();
 		inline int get_priority() {return priority_;}
@@ -239,6 +275,8 @@ namespace FLIVR {
 		GLenum tex_type_aux(Nrrd* n);
 
 		bool raw_brick_reader(char* data, size_t size, const FileLocInfo* finfo);
+		template<typename T>
+		void compute_summary_aux(int c, double scale);
 
 		//! bbox edges
 		Ray edge_[12]; 
@@ -281,6 +319,11 @@ namespace FLIVR {
 		bool paint_mask_;
 		//new label for grow ruler merge
 		bool new_grown_;
+		//data summary
+		int sum_state_[TEXTURE_MAX_COMPONENTS];
+		double sum_min_[TEXTURE_MAX_COMPONENTS];
+		double sum_max_[TEXTURE_MAX_COMPONENTS];
+		unsigned long long sum_count_[TEXTURE_MAX_COMPONENTS];
 
 		int findex_;
 		long long offset_;
@@ -193,6 +193,13 @@ namespace FLIVR
 			return;
 		vector<TextureBrick*>* bricks = tex_->get_bricks();
 		TextureBrick* brick = 0;
+		//mask and label may have been changed in main memory
+		for (size_t j = 0; j < bricks->size(); ++j)
+		{
+			brick = (*bricks)[j];
+			brick->invalidate_summary(brick->nmask());
+			brick->invalidate_summary(brick->nlabel());
+		}
 		for (int i = tex_pool_.size() - 1; i >= 0; --i)
 		{
 			for (size_t j = 0; j < bricks->size(); ++j)
@@ -223,6 +230,13 @@ namespace FLIVR
 		vector<TextureBrick*>* bricks = tex_->get_bricks();
 		TextureBrick *brick = 0;
 		TextureBrick *locbk = 0;
+		//changed in main memory, including bricks skipped on the gpu
+		//summaries are rescanned when next queried
+		for (size_t j = 0; j < bricks->size(); ++j)
+		{
+			locbk = (*bricks)[j];
+			locbk->invalidate_summary(locbk->nmask());
+		}
 		for (int i = tex_pool_.size() - 1; i >= 0; --i)
 		{
 			brick = tex_pool_[i].brick;
@@ -257,6 +271,13 @@ namespace FLIVR
 		vector<TextureBrick*>* bricks = tex_->get_bricks();
 		TextureBrick *brick = 0;
 		TextureBrick *locbk = 0;
+		//changed in main memory, including bricks skipped on the gpu
+		//summaries are rescanned when next queried
+		for (size_t j = 0; j < bricks->size(); ++j)
+		{
+			locbk = (*bricks)[j];
+			locbk->invalidate_summary(locbk->nlabel());
+		}
 		for (int i = tex_pool_.size() - 1; i >= 0; --i)
 		{
 			brick = tex_pool_[i].brick;
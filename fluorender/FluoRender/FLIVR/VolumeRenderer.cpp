@@ -1285,6 +1285,9 @@ namespace FLIVR
 				b->set_skip_mask(true);
 				continue;
 			}
+			//mask in main memory is out of date until returned
+			if (type != 2)
+				b->invalidate_summary(b->nmask(), true);
 
 			BBox bbox = b->bbox();
 			matrix[0] = float(bbox.max().x()-bbox.min().x());
@@ -1701,7 +1704,10 @@ namespace FLIVR
 			glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 			glPixelStorei(GL_PACK_IMAGE_HEIGHT, 0);
 			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+			b->invalidate_summary(c);
 		}
+		tex_->touch();
 
 		//release 3d texture
 		glActiveTexture(GL_TEXTURE0);
@@ -1749,6 +1755,10 @@ namespace FLIVR
 			glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 			glPixelStorei(GL_PACK_IMAGE_HEIGHT, 0);
 			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+			//update summary of the returned brick
+			if (!b->summary_valid(c))
+				b->compute_summary(c);
 		}
 
 		//release mask texture
@@ -1785,6 +1795,10 @@ namespace FLIVR
 			glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 			glPixelStorei(GL_PACK_IMAGE_HEIGHT, 0);
 			//glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+			//update summary of the returned brick
+			if (!b->summary_valid(c))
+				b->compute_summary(c);
 		}
 
 		//release label texture
@@ -50,156 +50,19 @@ DEALINGS IN THE SOFTWARE.
  */
 
 #include "base_reader.h"
+#include "mapped_file.h"
+#include "lzw_codec.h"
+#include "../compatibility.h"
+#include <fstream>
+#include <atomic>
+#if TEEM_ZLIB
+#include <zlib.h>
+#endif
 
-int BaseReader::LZWDecode(tidata_t tif, tidata_t op0, tsize_t occ0)
+bool BaseReader::LZWDecode(const unsigned char* src, size_t src_size,
+	unsigned char* dst, size_t dst_size)
 {
-	//initialize codec state
-	LZWCodecState *sp = new LZWCodecState;
-	//sp->predictor = m_predictor;
-	sp->stride = 1;
-	//sp->rowsize = m_x_size;
-	sp->dec_codetab = new code_t[CSIZE*sizeof(code_t)];
-	int icode = 255;
-	do
-	{
-		sp->dec_codetab[icode].value = icode;
-		sp->dec_codetab[icode].firstchar = icode;
-		sp->dec_codetab[icode].length = 1;
-		sp->dec_codetab[icode].next = NULL;
-	} while (icode--);
-	sp->maxcode = MAXCODE(BITS_MIN)-1;
-	sp->nbits = BITS_MIN;
-	sp->nextbits = 0;
-	sp->nextdata = 0;
-	sp->dec_restart = 0;
-	sp->dec_nbitsmask = MAXCODE(BITS_MIN);
-	sp->dec_bitsleft = occ0 << 3;
-	sp->dec_free_entp = sp->dec_codetab + CODE_FIRST;
-	memset(sp->dec_free_entp, 0, (CSIZE-CODE_FIRST)*sizeof(code_t));
-	sp->dec_oldcodep = &sp->dec_codetab[-1];
-	sp->dec_maxcodep = &sp->dec_codetab[sp->dec_nbitsmask-1];
-
-	char *op = (char*) op0;
-	long occ = (long) occ0;
-	char *tp;
-	unsigned char *bp;
-	hcode_t code;
-	int len;
-	long nbits, nextbits, nextdata, nbitsmask;
-	code_t *codep, *free_entp, *maxcodep, *oldcodep;
-
-	bp = (unsigned char *)tif;
-	nbits = sp->nbits;
-	nextdata = sp->nextdata;
-	nextbits = sp->nextbits;
-	nbitsmask = sp->dec_nbitsmask;
-	oldcodep = sp->dec_oldcodep;
-	free_entp = sp->dec_free_entp;
-	maxcodep = sp->dec_maxcodep;
-
-	while (occ > 0)
-	{
-		GetNextCode(sp, bp, code);
-		//NextCode(tif, sp, bp, code, GetNextCode);
-		if (code == CODE_EOI)
-			break;
-		if (code == CODE_CLEAR)
-		{
-			free_entp = sp->dec_codetab + CODE_FIRST;
-			nbits = BITS_MIN;
-			nbitsmask = MAXCODE(BITS_MIN);
-			maxcodep = sp->dec_codetab + nbitsmask-1;
-			GetNextCode(sp, bp, code);
-			//NextCode(tif, sp, bp, code, GetNextCode);
-			if (code == CODE_EOI)
-				break;
-			*op++ = (char)code, occ--;
-			oldcodep = sp->dec_codetab + code;
-			continue;
-		}
-		codep = sp->dec_codetab + code;
-
-		/*
-	 	 * Add the new entry to the code table.
-	 	 */
-		if (free_entp < &sp->dec_codetab[0] ||
-			free_entp >= &sp->dec_codetab[CSIZE])
-			return 0;
-
-		free_entp->next = oldcodep;
-		if (free_entp->next < &sp->dec_codetab[0] ||
-			free_entp->next >= &sp->dec_codetab[CSIZE])
-			return 0;
-
-		free_entp->firstchar = free_entp->next->firstchar;
-		free_entp->length = free_entp->next->length+1;
-		free_entp->value = (codep < free_entp) ?
-		    codep->firstchar : free_entp->firstchar;
-		if (++free_entp > maxcodep)
-		{
-			if (++nbits > BITS_MAX)		/* should not happen */
-				nbits = BITS_MAX;
-			nbitsmask = MAXCODE(nbits);
-			maxcodep = sp->dec_codetab + nbitsmask-1;
-		}
-		oldcodep = codep;
-		if (code >= 256)
-		{
-			/*
-			 * Code maps to a string, copy string
-			 * value to output (written in reverse).
-			 */
-			if(codep->length == 0)
-				return 0;
-			if (codep->length > occ)
-			{
-				/*
-				 * String is too long for decode buffer,
-				 * locate portion that will fit, copy to
-				 * the decode buffer, and setup restart
-				 * logic for the next decoding call.
-				 */
-				sp->dec_codep = codep;
-				do
-				{
-					codep = codep->next;
-				} while (codep && codep->length > occ);
-				if (codep)
-				{
-					sp->dec_restart = occ;
-					tp = op + occ;
-					do
-					{
-						*--tp = codep->value;
-						codep = codep->next;
-					} while (--occ && codep);
-				}
-				break;
-			}
-			len = codep->length;
-			tp = op + len;
-			do
-			{
-				int t;
-				--tp;
-				t = codep->value;
-				codep = codep->next;
-				*tp = t;
-			} while (codep && tp > op);
-			if (codep)
-				break;
-			op += len, occ -= len;
-		} else
-			*op++ = (char)code, occ--;
-	}
-
-	delete []sp->dec_codetab;
-	delete sp;
-
-	if (occ > 0)
-		return 0;
-
-	return (1);
+	return LZWCodec::Decode(src, src_size, dst, dst_size);
 }
 
 void BaseReader::DecodeAcc8(tidata_t cp0, tsize_t cc, tsize_t stride)
@@ -323,4 +186,139 @@ string BaseReader::GetError(int code)
 		break;
 	}
 	return err_str;
-}
\ No newline at end of file
+}
+
+bool BaseReader::ReadFileData(const wstring &name, vector<char> &data)
+{
+	ifstream is;
+#ifdef _WIN32
+	is.open(name.c_str(), ios::binary);
+#else
+	is.open(ws2s(name).c_str(), ios::binary);
+#endif
+	if (!is.is_open())
+		return false;
+	is.seekg(0, ios::end);
+	size_t size = is.tellg();
+	is.seekg(0, ios::beg);
+	data.resize(size);
+	if (size)
+		is.read(&data[0], size);
+	is.close();
+	return true;
+}
+
+bool BaseReader::ReadNrrdData(const wstring &filename, long offset,
+	Nrrd* nrrd, NrrdIoState* nio,
+	const std::function<void(size_t, size_t)> &func)
+{
+	if (!nrrd || !nrrd->data || !nio || offset <= 0)
+		return false;
+	//detached data and skipped lines/bytes are left to teem
+	if (nio->dataFNArr && nio->dataFNArr->len > 0)
+		return false;
+	if (nio->lineSkip || nio->byteSkip)
+		return false;
+	size_t elem_size = nrrdElementSize(nrrd);
+	size_t elem_num = nrrdElementNumber(nrrd);
+	size_t data_size = elem_size * elem_num;
+	if (!data_size)
+		return false;
+	if (elem_size > 1 &&
+		nio->endian != airEndianUnknown &&
+		nio->endian != AIR_ENDIAN)
+		return false;
+
+	MappedFile file;
+	if (!file.Open(filename) ||
+		file.GetSize() <= (size_t)offset)
+		return false;
+	const unsigned char* src = file.GetData() + offset;
+	size_t src_size = file.GetSize() - offset;
+	unsigned char* dst = (unsigned char*)nrrd->data;
+
+	if (nio->encoding == nrrdEncodingRaw)
+	{
+		if (src_size < data_size)
+			return false;
+		//the mapping isn't handed to the nrrd
+		//nrrd data is freed with nrrdNuke and edited in place by
+		//the readers' conversions and by painting, so it must be
+		//heap memory; it is copied in chunks of whole elements
+		size_t chunk = (size_t(1) << 24) / elem_size;
+		size_t chunk_num = (elem_num + chunk - 1) / chunk;
+		ParallelFetch(chunk_num, [&](size_t i)
+		{
+			size_t begin = i * chunk;
+			size_t end = begin + chunk;
+			if (end > elem_num)
+				end = elem_num;
+			memcpy(dst + begin * elem_size, src + begin * elem_size,
+				(end - begin) * elem_size);
+			func(begin, end);
+		});
+		return true;
+	}
+#if TEEM_ZLIB
+	else if (nio->encoding == nrrdEncodingGzip)
+	{
+		char* value = nrrdKeyValueGet(nrrd, NRRD_GZIP_BLOCK_KEY);
+		if (!value)
+			return false;
+		std::istringstream iss(value);
+		free(value);
+		unsigned long long block_size = 0;
+		iss >> block_size;
+		if (!block_size || block_size % elem_size)
+			return false;
+		vector<unsigned long long> offsets;
+		unsigned long long comp_size, pos = 0;
+		while (iss >> comp_size)
+		{
+			offsets.push_back(pos);
+			pos += comp_size;
+		}
+		offsets.push_back(pos);
+		size_t block_num = size_t((data_size + block_size - 1) / block_size);
+		if (offsets.size() != block_num + 1 ||
+			pos > src_size)
+			return false;
+
+		std::atomic<bool> ok(true);
+		ParallelFetch(block_num, [&](size_t i)
+		{
+			if (!ok)
+				return;
+			size_t out_pos = size_t(i * block_size);
+			size_t out_size = size_t(block_size);
+			if (out_pos + out_size > data_size)
+				out_size = data_size - out_pos;
+
+			//each block is a complete gzip member
+			z_stream strm;
+			memset(&strm, 0, sizeof(z_stream));
+			if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK)
+			{
+				ok = false;
+				return;
+			}
+			strm.next_in = (Bytef*)(src + offsets[i]);
+			strm.avail_in = uInt(offsets[i + 1] - offsets[i]);
+			strm.next_out = (Bytef*)(dst + out_pos);
+			strm.avail_out = uInt(out_size);
+			int result = inflate(&strm, Z_FINISH);
+			bool good = result == Z_STREAM_END &&
+				strm.total_out == out_size;
+			inflateEnd(&strm);
+			if (!good)
+			{
+				ok = false;
+				return;
+			}
+			func(out_pos / elem_size, (out_pos + out_size) / elem_size);
+		});
+		return ok;
+	}
+#endif
+	return false;
+}
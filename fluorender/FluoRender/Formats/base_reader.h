@@ -32,6 +32,8 @@ DEALINGS IN THE SOFTWARE.
 #include <nrrd.h>
 #include <vector>
 #include <sstream>
+#include <functional>
+#include "parallel_io.h"
 
 using namespace std;
 
@@ -205,6 +207,18 @@ public:
 
 	static string GetError(int code);
 
+	//number of threads used to fetch the files of a slice sequence
+	//and to encode written data, see ParallelIO
+	//0 uses all available cores; 1 reads the files one after another
+	static void SetReadThreadNum(int num)
+	{
+		ParallelIO::SetThreadNum(num);
+	}
+	static int GetReadThreadNum()
+	{
+		return ParallelIO::GetThreadNum();
+	}
+
 protected:
 	wstring m_id_string;	//the path and file name used to read files
 	//resizing
@@ -221,75 +235,13 @@ protected:
 
 	wstring m_info;
 
-	//all the lzw decoding stuff
-	#define MAXCODE(n)	((1L<<(n))-1)
-	#define	BITS_MIN	9		/* start with 9 bits */
-	#define	BITS_MAX	12		/* max of 12 bit strings */
-	#define	CODE_CLEAR	256		/* code to clear string table */
-	#define	CODE_EOI	257		/* end-of-information code */
-	#define CODE_FIRST	258		/* first free code entry */
-	#define	CSIZE		(MAXCODE(BITS_MAX)+1024L)
+	//tiff decoding
 	typedef	unsigned short uint16;	/* sizeof (uint16) must == 2 */
 	typedef	int int32;
 	typedef	int32 tsize_t;		/* i/o size in bytes */
 	typedef	unsigned char tidataval_t;	/* internal image data value type */
 	typedef	tidataval_t* tidata_t;		/* reference to internal image data */
 	typedef	uint16 tsample_t;			/* sample number */
-	typedef uint16 hcode_t;			/* codes fit in 16 bits */
-	typedef struct code_ent
-	{
-		struct code_ent *next;
-		unsigned short	length;		/* string len, including this token */
-		unsigned char	value;		/* data value */
-		unsigned char	firstchar;	/* first token of string */
-	} code_t;
-
-	typedef struct
-	{
-		long	hash;
-		hcode_t	code;
-	} hash_t;
-
-	typedef struct
-	{
-		int		predictor;	/* predictor tag value */
-		int		stride;		/* sample stride over data */
-		tsize_t		rowsize;	/* tile/strip row size */
-
-		unsigned short	nbits;		/* # of bits/code */
-		unsigned short	maxcode;	/* maximum code for lzw_nbits */
-		unsigned short	free_ent;	/* next free entry in hash table */
-		long		nextdata;	/* next bits of i/o */
-		long		nextbits;	/* # of valid bits in lzw_nextdata */
-
-		/* Decoding specific data */
-		long	dec_nbitsmask;		/* lzw_nbits 1 bits, right adjusted */
-		long	dec_restart;		/* restart count */
-		long	dec_bitsleft;		/* available bits in raw data */
-		code_t*	dec_codep;		/* current recognized code */
-		code_t*	dec_oldcodep;		/* previously recognized code */
-		code_t*	dec_free_entp;		/* next free entry */
-		code_t*	dec_maxcodep;		/* max available entry */
-		code_t*	dec_codetab;		/* kept separate for small machines */
-	} LZWCodecState;
-	#define	NextCode(_tif, _sp, _bp, _code, _get) {				\
-		if ((_sp)->dec_bitsleft < nbits) {				\
-			_code = CODE_EOI;					\
-		} else {							\
-			_get(_sp,_bp,_code);					\
-			(_sp)->dec_bitsleft -= nbits;				\
-		}								\
-	}
-	#define	GetNextCode(sp, bp, code) {				\
-		nextdata = (nextdata<<8) | *(bp)++;			\
-		nextbits += 8;						\
-		if (nextbits < nbits) {					\
-			nextdata = (nextdata<<8) | *(bp)++;		\
-			nextbits += 8;					\
-		}							\
-		code = (hcode_t)((nextdata >> (nextbits-nbits)) & nbitsmask);	\
-		nextbits -= nbits;					\
-	}
 	#define REPEAT4(n, op)		\
 		switch (n) {		\
 		default: { int i; for (i = n-4; i > 0; i--) { op; } } \
@@ -300,12 +252,33 @@ protected:
 		case 0:  ;			\
 	}
 
-	int LZWDecode(tidata_t tif, tidata_t op0, tsize_t occ0);
+	//decode a strip of at most dst_size bytes, see LZWCodec
+	static bool LZWDecode(const unsigned char* src, size_t src_size,
+		unsigned char* dst, size_t dst_size);
 	void DecodeAcc8(tidata_t cp0, tsize_t cc, tsize_t stride);
 	void DecodeAcc16(tidata_t cp0, tsize_t cc, tsize_t stride);
 
 	//read number after a position in a string
 	int get_number(string &str, int64_t pos);
+
+	//file fetching for slice sequences
+	//run func(i) for i in [0, num) on a bounded set of threads
+	//the first exception thrown by func is rethrown to the caller
+	static void ParallelFetch(size_t num, const std::function<void(size_t)> &func)
+	{
+		ParallelIO::Run(num, func);
+	}
+	//read a whole file into memory
+	static bool ReadFileData(const wstring &name, vector<char> &data);
+	//read the data of a nrrd with an attached header into nrrd->data
+	//offset is where the data starts after the header
+	//raw data is copied from a file mapping, which is closed on return, since nrrd data is owned by malloc
+	//block compressed gzip data is inflated in parallel
+	//func(begin, end) is called on each decoded element range, so conversions can be fused
+	//returns false if the layout isn't supported and teem should be used
+	static bool ReadNrrdData(const wstring &filename, long offset,
+		Nrrd* nrrd, NrrdIoState* nio,
+		const std::function<void(size_t, size_t)> &func);
 };
 
 #endif//_BASE_READER_H_
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#include "base_writer.h"
+#include "lzw_codec.h"
+#include "../compatibility.h"
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <atomic>
+#if TEEM_ZLIB
+#include <zlib.h>
+#endif
+
+//uncompressed size of each gzip member
+#define NRRD_GZIP_BLOCK_SIZE	4194304
+//digits of a compressed size in the block list
+#define NRRD_GZIP_SIZE_WIDTH	10
+//uncompressed size of the blocks compressed together
+#define NRRD_WRITE_BATCH_SIZE	67108864
+
+bool BaseWriter::SaveNrrdBlocks(const wstring &filename, Nrrd* nrrd)
+{
+#if TEEM_ZLIB
+	if (!nrrd || !nrrd->data)
+		return false;
+	//detached headers are left to teem
+	if (filename.length() >= 5 &&
+		filename.substr(filename.length() - 5) == L".nhdr")
+		return false;
+	size_t data_size = nrrdElementNumber(nrrd) * nrrdElementSize(nrrd);
+	if (!data_size)
+		return false;
+
+	//the header lists the compressed size of each block so that they
+	//can be inflated in parallel
+	//the sizes are only known after compression, so fixed width
+	//placeholders are written first and filled in at the end
+	size_t block_num = (data_size + NRRD_GZIP_BLOCK_SIZE - 1) / NRRD_GZIP_BLOCK_SIZE;
+	vector<unsigned long long> comp_sizes(block_num, 0);
+	auto block_list = [&]()
+	{
+		ostringstream strs;
+		strs << NRRD_GZIP_BLOCK_SIZE;
+		strs << setfill('0');
+		for (size_t i = 0; i < block_num; ++i)
+			strs << " " << setw(NRRD_GZIP_SIZE_WIDTH) << comp_sizes[i];
+		return strs.str();
+	};
+	string value = block_list();
+	nrrdKeyValueAdd(nrrd, NRRD_GZIP_BLOCK_KEY, value.c_str());
+	NrrdIoState* nio = nrrdIoStateNew();
+	nio->format = nrrdFormatNRRD;
+	nio->encoding = nrrdEncodingGzip;
+	nio->skipData = AIR_TRUE;
+	char* header = 0;
+	bool result = !nrrdStringWrite(&header, nrrd, nio);
+	nrrdIoStateNix(nio);
+	nrrdKeyValueErase(nrrd, NRRD_GZIP_BLOCK_KEY);
+	if (!result || !header)
+		return false;
+	string str_header = header;
+	free(header);
+	//the string form leaves out the blank line before attached data
+	if (str_header.size() < 2 ||
+		str_header.compare(str_header.size() - 2, 2, "\n\n"))
+		str_header += "\n";
+	size_t value_pos = str_header.find(string(NRRD_GZIP_BLOCK_KEY) + ":=");
+	if (value_pos == string::npos)
+		return false;
+	value_pos += strlen(NRRD_GZIP_BLOCK_KEY) + 2;
+
+	FILE* fp = 0;
+	if (!WFOPEN(&fp, filename.c_str(), L"wb"))
+		return false;
+	result = fwrite(str_header.c_str(), 1, str_header.size(), fp) == str_header.size();
+
+	//compress a batch of blocks in parallel, then write them in order
+	//concatenated members form one valid gzip stream
+	size_t batch = NRRD_WRITE_BATCH_SIZE / NRRD_GZIP_BLOCK_SIZE;
+	vector<vector<unsigned char>> blocks;
+	unsigned char* src = (unsigned char*)nrrd->data;
+	for (size_t i0 = 0; result && i0 < block_num; i0 += batch)
+	{
+		size_t i1 = i0 + batch;
+		if (i1 > block_num)
+			i1 = block_num;
+		blocks.resize(i1 - i0);
+		std::atomic<bool> ok(true);
+		ParallelEncode(i1 - i0, [&](size_t k)
+		{
+			if (!ok)
+				return;
+			size_t pos = (i0 + k) * NRRD_GZIP_BLOCK_SIZE;
+			size_t size = NRRD_GZIP_BLOCK_SIZE;
+			if (pos + size > data_size)
+				size = data_size - pos;
+
+			z_stream strm;
+			memset(&strm, 0, sizeof(z_stream));
+			if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+				16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			{
+				ok = false;
+				return;
+			}
+			vector<unsigned char> &block = blocks[k];
+			block.resize(deflateBound(&strm, uLong(size)));
+			strm.next_in = (Bytef*)(src + pos);
+			strm.avail_in = uInt(size);
+			strm.next_out = (Bytef*)&block[0];
+			strm.avail_out = uInt(block.size());
+			if (deflate(&strm, Z_FINISH) == Z_STREAM_END)
+				block.resize(strm.total_out);
+			else
+				ok = false;
+			deflateEnd(&strm);
+		});
+		result = ok;
+		for (size_t k = 0; result && k < blocks.size(); ++k)
+		{
+			comp_sizes[i0 + k] = blocks[k].size();
+			result = fwrite(&blocks[k][0], 1, blocks[k].size(), fp) == blocks[k].size();
+		}
+	}
+
+	//fill in the sizes, which have the width of the placeholders
+	if (result)
+	{
+		value = block_list();
+		result = fseek(fp, long(value_pos), SEEK_SET) == 0 &&
+			fwrite(value.c_str(), 1, value.size(), fp) == value.size();
+	}
+	fclose(fp);
+	return result;
+#else
+	return false;
+#endif
+}
+
+void BaseWriter::LZWEncode(const unsigned char* src, size_t size,
+	vector<unsigned char> &dst)
+{
+	LZWCodec::Encode(src, size, dst);
+}
@@ -29,7 +29,10 @@ DEALINGS IN THE SOFTWARE.
 #define _BASE_WRITER_H_
 
 #include <string>
+#include <vector>
+#include <functional>
 #include <nrrd.h>
+#include "parallel_io.h"
 
 using namespace std;
 
@@ -48,6 +51,20 @@ public:
 	virtual void SetSpacings(double spcx, double spcy, double spcz) = 0;
 	virtual void SetCompression(bool value) = 0;
 	virtual void Save(wstring filename, int mode) = 0;
+
+protected:
+	//run func(i) for i in [0, num) on the threads set for file io
+	static void ParallelEncode(size_t num, const std::function<void(size_t)> &func)
+	{
+		ParallelIO::Run(num, func);
+	}
+	//write a nrrd file with its data split into gzip members,
+	//which are compressed in parallel and readable by any gzip reader
+	//return false if the data can't be written this way
+	static bool SaveNrrdBlocks(const wstring &filename, Nrrd* nrrd);
+	//compress one tiff strip with lzw
+	static void LZWEncode(const unsigned char* src, size_t size,
+		vector<unsigned char> &dst);
 };
 
 #endif//_BASE_WRITER_H_
\ No newline at end of file
@@ -10,6 +10,57 @@
 #include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+//header of the brick index cache
+#define BRK_INDEX_MAGIC		"FLBRKIDX"
+#define BRK_INDEX_VERSION	1
+#define BRK_INDEX_STRINGS	5//dir, ex metadata path, ex metadata url, metadata id, roi tree
+struct BrkIndexHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int level_size;//record sizes, to catch layout changes
+	unsigned int brick_size;
+	unsigned int file_size;
+	long long xml_size;//stamp of the xml the index is built from
+	long long xml_time;
+	int nChannel;
+	int nFrame;
+	int nLevel;
+	int copyableLv;
+	int level_num;
+	int landmark_num;
+	int string_num;
+	int reserved;
+	long long level_pos;
+	long long landmark_pos;
+	long long string_pos;
+};
+struct BrkIndexLandmark
+{
+	int name;
+	int reserved;
+	double x, y, z;
+	double spcx, spcy, spcz;
+};
+
+static bool GetFileStamp(const wstring &name, long long &size, long long &time)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_wstat64(name.c_str(), &st))
+		return false;
+#else
+	struct stat st;
+	if (stat(ws2s(name).c_str(), &st))
+		return false;
+#endif
+	size = (long long)st.st_size;
+	time = (long long)st.st_mtime;
+	return true;
+}
 
 template <typename _T> void clear2DVector(std::vector<std::vector<_T>> &vec2d)
 {
@@ -61,6 +112,8 @@ BRKXMLReader::BRKXMLReader()
    m_isURL = false;
 
    m_copy_lv = -1;
+
+   m_index = 0;
 }
 
 BRKXMLReader::~BRKXMLReader()
@@ -70,29 +123,12 @@ BRKXMLReader::~BRKXMLReader()
 
 void BRKXMLReader::Clear()
 {
-	if(m_pyramid.empty()) return;
-	for(int i = 0; i < m_pyramid.size(); i++){
-		if(!m_pyramid[i].bricks.empty()){
-			for(int j = 0; j < m_pyramid[i].bricks.size(); j++) SafeDelete(m_pyramid[i].bricks[j]);
-			vector<BrickInfo *>().swap(m_pyramid[i].bricks);
-		}
-		if(!m_pyramid[i].filename.empty()){
-			for(int j = 0; j < m_pyramid[i].filename.size(); j++){
-				if(!m_pyramid[i].filename[j].empty()){
-					for(int k = 0; k < m_pyramid[i].filename[j].size(); k++){
-						if(!m_pyramid[i].filename[j][k].empty()){
-							for(int m = 0; m < m_pyramid[i].filename[j][k].size(); m++)
-								SafeDelete(m_pyramid[i].filename[j][k][m]);
-							vector<FLIVR::FileLocInfo *>().swap(m_pyramid[i].filename[j][k]);
-						}
-					}
-					vector<vector<FLIVR::FileLocInfo *>>().swap(m_pyramid[i].filename[j]);
-				}
-			}
-			vector<vector<vector<FLIVR::FileLocInfo *>>>().swap(m_pyramid[i].filename);
-		}
-	}
 	vector<LevelInfo>().swap(m_pyramid);
+	vector<wstring>().swap(m_file_names);
+	map<wstring, int>().swap(m_name_ids);
+	m_index_file.Close();
+	vector<char>().swap(m_index_buf);
+	m_index = 0;
 
 	vector<Landmark>().swap(m_landmarks);
 }
@@ -194,27 +230,68 @@ int BRKXMLReader::Preprocess()
 	wstring path = m_path_name.substr(0, pos+1);
 	wstring name = m_path_name.substr(pos+1);
 
-	if (m_doc.LoadFile(ws2s(m_path_name).c_str()) != 0){
-		return READER_OPEN_FAIL;
-	}
-		
-	tinyxml2::XMLElement *root = m_doc.RootElement();
-	if (!root || strcmp(root->Name(), "BRK"))
-		return READER_OPEN_FAIL;
-	m_imageinfo = ReadImageInfo(root);
-
-	if (root->Attribute("exMetadataPath"))
+	//the xml is only parsed when the cached index is stale
+	wstring index_name = m_path_name + L".brkidx";
+	long long xml_size = 0, xml_time = 0;
+	//no cache for urls
+	bool stamped = GetFileStamp(m_path_name, xml_size, xml_time);
+	bool cached = stamped && m_index_file.Open(index_name) &&
+		LoadIndex((const char*)m_index_file.GetData(), m_index_file.GetSize(),
+			xml_size, xml_time);
+	if (!cached)
 	{
-		string str = root->Attribute("exMetadataPath");
-		m_ex_metadata_path = s2ws(str);
-	}
-	if (root->Attribute("exMetadataURL"))
-	{
-		string str = root->Attribute("exMetadataURL");
-		m_ex_metadata_url = s2ws(str);
-	}
+		m_index_file.Close();
+		if (m_doc.LoadFile(ws2s(m_path_name).c_str()) != 0){
+			return READER_OPEN_FAIL;
+		}
 
-	ReadPyramid(root, m_pyramid);
+		tinyxml2::XMLElement *root = m_doc.RootElement();
+		if (!root || strcmp(root->Name(), "BRK"))
+			return READER_OPEN_FAIL;
+		m_imageinfo = ReadImageInfo(root);
+
+		m_ex_metadata_path.clear();
+		m_ex_metadata_url.clear();
+		if (root->Attribute("exMetadataPath"))
+		{
+			string str = root->Attribute("exMetadataPath");
+			m_ex_metadata_path = s2ws(str);
+		}
+		if (root->Attribute("exMetadataURL"))
+		{
+			string str = root->Attribute("exMetadataURL");
+			m_ex_metadata_url = s2ws(str);
+		}
+
+		vector<LevelXml> pyramid;
+		ReadPyramid(root, pyramid);
+		m_metadata_id.clear();
+		m_roi_tree.clear();
+		ReadMetadata(root);
+		m_doc.Clear();
+
+		BuildIndex(pyramid, xml_size, xml_time);
+		if (!LoadIndex(&m_index_buf[0], m_index_buf.size(), xml_size, xml_time))
+			return READER_OPEN_FAIL;
+		//replace the old index by renaming, as other readers may have it mapped
+		//it's fine if the folder is read-only
+		wstring temp_name = index_name + L".tmp";
+		FILE* fp = 0;
+		if (stamped && WFOPEN(&fp, temp_name.c_str(), L"wb"))
+		{
+			bool written = fwrite(&m_index_buf[0], 1, m_index_buf.size(), fp) ==
+				m_index_buf.size();
+			fclose(fp);
+#ifdef _WIN32
+			_wremove(index_name.c_str());
+			if (!written || _wrename(temp_name.c_str(), index_name.c_str()))
+				_wremove(temp_name.c_str());
+#else
+			if (!written || rename(ws2s(temp_name).c_str(), ws2s(index_name).c_str()))
+				remove(ws2s(temp_name).c_str());
+#endif
+		}
+	}
 	
 	m_time_num = m_imageinfo.nFrame;
 	m_chan_num = m_imageinfo.nChannel;
@@ -238,7 +315,7 @@ int BRKXMLReader::Preprocess()
 	m_cur_level = 0;
 
 	wstring cur_dir_name = m_path_name.substr(0, m_path_name.find_last_of(slash)+1);
-	loadMetadata(m_path_name);
+	//metadata in the xml itself is in the index
 	loadMetadata(cur_dir_name + L"_metadata.xml");
 
 	if (!m_ex_metadata_path.empty())
@@ -290,7 +367,7 @@ BRKXMLReader::ImageInfo BRKXMLReader::ReadImageInfo(tinyxml2::XMLElement *infoNo
 	return iinfo;
 }
 
-void BRKXMLReader::ReadPyramid(tinyxml2::XMLElement *lvRootNode, vector<LevelInfo> &pylamid)
+void BRKXMLReader::ReadPyramid(tinyxml2::XMLElement *lvRootNode, vector<LevelXml> &pylamid)
 {
 	int ival;
 	int level;
@@ -314,9 +391,9 @@ void BRKXMLReader::ReadPyramid(tinyxml2::XMLElement *lvRootNode, vector<LevelInf
 	}
 }
 
-void BRKXMLReader::ReadLevel(tinyxml2::XMLElement* lvNode, LevelInfo &lvinfo)
+void BRKXMLReader::ReadLevel(tinyxml2::XMLElement* lvNode, LevelXml &lvxml)
 {
-	
+	LevelInfo &lvinfo = lvxml.info;
 	string strValue;
 
 	lvinfo.imageW = STOI(lvNode->Attribute("imageW"));
@@ -353,15 +430,15 @@ void BRKXMLReader::ReadLevel(tinyxml2::XMLElement* lvNode, LevelInfo &lvinfo)
 
 				lvinfo.brick_baseD = STOI(child->Attribute("brick_baseD"));
 
-				ReadPackedBricks(child, lvinfo.bricks);
+				ReadPackedBricks(child, lvxml.bricks);
 			}
-			if (strcmp(child->Name(), "Files") == 0)  ReadFilenames(child, lvinfo.filename);
+			if (strcmp(child->Name(), "Files") == 0)  ReadFilenames(child, lvxml.files);
 		}
 		child = child->NextSiblingElement();
 	}
 }
 
-void BRKXMLReader::ReadPackedBricks(tinyxml2::XMLElement* packNode, vector<BrickInfo *> &brks)
+void BRKXMLReader::ReadPackedBricks(tinyxml2::XMLElement* packNode, vector<BrickInfo> &brks)
 {
 	int id;
 	
@@ -374,11 +451,12 @@ void BRKXMLReader::ReadPackedBricks(tinyxml2::XMLElement* packNode, vector<Brick
 			{
 				id = STOI(child->Attribute("id"));
 
-				if(id + 1 > brks.size())
-					brks.resize(id + 1, NULL);
-
-				if (!brks[id]) brks[id] = new BrickInfo();
-				ReadBrick(child, *brks[id]);
+				if (id >= 0)
+				{
+					if(id + 1 > brks.size())
+						brks.resize(id + 1);
+					ReadBrick(child, brks[id]);
+				}
 			}
 		}
 		child = child->NextSiblingElement();
@@ -443,10 +521,13 @@ void BRKXMLReader::Readbox(tinyxml2::XMLElement* boxNode, double &x0, double &y0
     z1 = STOD(boxNode->Attribute("z1"));
 }
 
-void BRKXMLReader::ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vector<vector<FLIVR::FileLocInfo *>>> &filename)
+void BRKXMLReader::ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vector<vector<BrickFile>>> &filename)
 {
 	string str;
 	int frame, channel, id;
+	BrickFile missing;
+	memset(&missing, 0, sizeof(BrickFile));
+	missing.name = -1;
 
 	tinyxml2::XMLElement *child = fileRootNode->FirstChildElement();
 	while (child)
@@ -461,15 +542,19 @@ void BRKXMLReader::ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vect
 
 				id = STOI(child->Attribute("brickID"));
 
+				if (frame < 0 || channel < 0 || id < 0)
+				{
+					child = child->NextSiblingElement();
+					continue;
+				}
 				if(frame + 1 > filename.size())
 					filename.resize(frame + 1);
 				if(channel + 1 > filename[frame].size())
 					filename[frame].resize(channel + 1);
 				if(id + 1 > filename[frame][channel].size())
-					filename[frame][channel].resize(id + 1, NULL);
-
-				if (!filename[frame][channel][id])
-						filename[frame][channel][id] = new FLIVR::FileLocInfo();
+					filename[frame][channel].resize(id + 1, missing);
+				BrickFile &file = filename[frame][channel][id];
+				wstring name;
 
 				if (child->Attribute("filename")) //this option will be deprecated
 					str = child->Attribute("filename");
@@ -489,54 +574,64 @@ void BRKXMLReader::ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vect
 					if (str.length() >= 2 && str[1] != L':')
 						rel = true;
 #else
-					if (m_ex_metadata_path[0] != L'/')
+					if (str.empty() || str[0] != '/')
 						rel = true;
 #endif
 				}
 
 				if (url) //url
 				{
-					filename[frame][channel][id]->filename = s2ws(str);
-					filename[frame][channel][id]->isurl = true;
+					name = s2ws(str);
+					file.isurl = true;
 				}
 				else if (rel) //relative path
 				{
-					filename[frame][channel][id]->filename = m_dir_name + s2ws(str);
-					filename[frame][channel][id]->isurl = m_isURL;
+					name = m_dir_name + s2ws(str);
+					file.isurl = m_isURL;
 				}
 				else //absolute path
 				{
-					filename[frame][channel][id]->filename = s2ws(str);
-					filename[frame][channel][id]->isurl = false;
+					name = s2ws(str);
+					file.isurl = false;
 				}
 
-				filename[frame][channel][id]->offset = 0;
+				//bricks share few files
+				auto it = m_name_ids.find(name);
+				if (it == m_name_ids.end())
+				{
+					file.name = int(m_file_names.size());
+					m_name_ids[name] = file.name;
+					m_file_names.push_back(name);
+				}
+				else
+					file.name = it->second;
+
+				file.offset = 0;
 				if (child->Attribute("offset"))
-					filename[frame][channel][id]->offset = STOI(child->Attribute("offset"));
-				filename[frame][channel][id]->datasize = 0;
+					file.offset = STOI(child->Attribute("offset"));
+				file.datasize = 0;
 				if (child->Attribute("datasize"))
-					filename[frame][channel][id]->datasize = STOI(child->Attribute("datasize"));
+					file.datasize = STOI(child->Attribute("datasize"));
 				
 				if (child->Attribute("filetype"))
 				{
 					str = child->Attribute("filetype");
-					if (str == "RAW") filename[frame][channel][id]->type = BRICK_FILE_TYPE_RAW;
-					else if (str == "JPEG") filename[frame][channel][id]->type = BRICK_FILE_TYPE_JPEG;
-					else if (str == "ZLIB") filename[frame][channel][id]->type = BRICK_FILE_TYPE_ZLIB;
+					if (str == "RAW") file.type = BRICK_FILE_TYPE_RAW;
+					else if (str == "JPEG") file.type = BRICK_FILE_TYPE_JPEG;
+					else if (str == "ZLIB") file.type = BRICK_FILE_TYPE_ZLIB;
 				}
 				else
 				{
-					filename[frame][channel][id]->type = BRICK_FILE_TYPE_RAW;
-					wstring fname = filename[frame][channel][id]->filename;
-					auto pos = fname.find_last_of(L".");
-					if (pos != wstring::npos && pos < fname.length()-1)
+					file.type = BRICK_FILE_TYPE_RAW;
+					auto pos = name.find_last_of(L".");
+					if (pos != wstring::npos && pos < name.length()-1)
 					{
-						wstring ext = fname.substr(pos+1);
+						wstring ext = name.substr(pos+1);
 						transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 						if (ext == L"jpg" || ext == L"jpeg")
-							filename[frame][channel][id]->type = BRICK_FILE_TYPE_JPEG;
+							file.type = BRICK_FILE_TYPE_JPEG;
 						else if (ext == L"zlib")
-							filename[frame][channel][id]->type = BRICK_FILE_TYPE_ZLIB;
+							file.type = BRICK_FILE_TYPE_ZLIB;
 					}
 				}
 			}
@@ -545,16 +640,227 @@ void BRKXMLReader::ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vect
 	}
 }
 
-bool BRKXMLReader::loadMetadata(const wstring &file)
+void BRKXMLReader::BuildIndex(vector<LevelXml> &pyramid, long long xml_size, long long xml_time)
 {
-	string str;
-	double dval;
+	vector<char> &buf = m_index_buf;
+	buf.clear();
+	auto put = [&](const void* data, size_t size)
+	{
+		buf.insert(buf.end(), (const char*)data, (const char*)data + size);
+	};
+	auto align = [&]()
+	{
+		buf.resize((buf.size() + 7) / 8 * 8, 0);
+	};
+
+	BrkIndexHeader header;
+	memset(&header, 0, sizeof(BrkIndexHeader));
+	memcpy(header.magic, BRK_INDEX_MAGIC, 8);
+	header.version = BRK_INDEX_VERSION;
+	header.level_size = sizeof(LevelInfo);
+	header.brick_size = sizeof(BrickInfo);
+	header.file_size = sizeof(BrickFile);
+	header.xml_size = xml_size;
+	header.xml_time = xml_time;
+	header.nChannel = m_imageinfo.nChannel;
+	header.nFrame = m_imageinfo.nFrame;
+	header.nLevel = m_imageinfo.nLevel;
+	header.copyableLv = m_imageinfo.copyableLv;
+	put(&header, sizeof(BrkIndexHeader));
+
+	//brick and file tables of each level
+	BrickFile missing;
+	memset(&missing, 0, sizeof(BrickFile));
+	missing.name = -1;
+	vector<LevelInfo> levels;
+	for (size_t i = 0; i < pyramid.size(); i++)
+	{
+		LevelXml &lv = pyramid[i];
+		LevelInfo info = lv.info;
+
+		align();
+		info.brick_pos = buf.size();
+		info.brick_num = int(lv.bricks.size());
+		if (!lv.bricks.empty())
+			put(&lv.bricks[0], lv.bricks.size() * sizeof(BrickInfo));
+
+		info.file_frame_num = int(lv.files.size());
+		info.file_chan_num = 0;
+		info.file_brick_num = 0;
+		for (size_t j = 0; j < lv.files.size(); j++)
+		{
+			info.file_chan_num = max(info.file_chan_num, int(lv.files[j].size()));
+			for (size_t k = 0; k < lv.files[j].size(); k++)
+				info.file_brick_num = max(info.file_brick_num, int(lv.files[j][k].size()));
+		}
+		align();
+		info.file_pos = buf.size();
+		for (int j = 0; j < info.file_frame_num; j++)
+		for (int k = 0; k < info.file_chan_num; k++)
+		{
+			int num = k < lv.files[j].size() ? int(lv.files[j][k].size()) : 0;
+			if (num)
+				put(&lv.files[j][k][0], num * sizeof(BrickFile));
+			for (int n = num; n < info.file_brick_num; n++)
+				put(&missing, sizeof(BrickFile));
+		}
+		//free as we go
+		vector<BrickInfo>().swap(lv.bricks);
+		vector<vector<vector<BrickFile>>>().swap(lv.files);
+
+		levels.push_back(info);
+	}
+	align();
+	header.level_pos = buf.size();
+	header.level_num = int(levels.size());
+	if (!levels.empty())
+		put(&levels[0], levels.size() * sizeof(LevelInfo));
+
+	//strings
+	vector<wstring> strings;
+	strings.push_back(m_dir_name);
+	strings.push_back(m_ex_metadata_path);
+	strings.push_back(m_ex_metadata_url);
+	strings.push_back(m_metadata_id);
+	strings.push_back(m_roi_tree);
+
+	align();
+	header.landmark_pos = buf.size();
+	header.landmark_num = int(m_landmarks.size());
+	for (size_t i = 0; i < m_landmarks.size(); i++)
+	{
+		BrkIndexLandmark lm;
+		memset(&lm, 0, sizeof(BrkIndexLandmark));
+		lm.name = int(strings.size());
+		lm.x = m_landmarks[i].x;
+		lm.y = m_landmarks[i].y;
+		lm.z = m_landmarks[i].z;
+		lm.spcx = m_landmarks[i].spcx;
+		lm.spcy = m_landmarks[i].spcy;
+		lm.spcz = m_landmarks[i].spcz;
+		strings.push_back(m_landmarks[i].name);
+		put(&lm, sizeof(BrkIndexLandmark));
+	}
+	strings.insert(strings.end(), m_file_names.begin(), m_file_names.end());
+
+	header.string_pos = buf.size();
+	header.string_num = int(strings.size());
+	for (size_t i = 0; i < strings.size(); i++)
+	{
+		string str = ws2s(strings[i]);
+		unsigned int len = (unsigned int)str.size();
+		put(&len, sizeof(unsigned int));
+		put(str.data(), len);
+	}
+
+	memcpy(&buf[0], &header, sizeof(BrkIndexHeader));
+	map<wstring, int>().swap(m_name_ids);
+}
+
+bool BRKXMLReader::LoadIndex(const char* data, size_t size, long long xml_size, long long xml_time)
+{
+	if (!data || size < sizeof(BrkIndexHeader))
+		return false;
+	BrkIndexHeader header;
+	memcpy(&header, data, sizeof(BrkIndexHeader));
+	if (memcmp(header.magic, BRK_INDEX_MAGIC, 8) ||
+		header.version != BRK_INDEX_VERSION ||
+		header.level_size != sizeof(LevelInfo) ||
+		header.brick_size != sizeof(BrickInfo) ||
+		header.file_size != sizeof(BrickFile) ||
+		header.xml_size != xml_size ||
+		header.xml_time != xml_time)
+		return false;
+	//everything is checked against the size, the cache may be truncated
+	auto inside = [&](long long pos, unsigned long long num, size_t rec)
+	{
+		return pos >= 0 && pos % 8 == 0 && (unsigned long long)pos <= size &&
+			num <= (size - pos) / rec;
+	};
+	if (header.level_num < 0 || header.landmark_num < 0 ||
+		header.string_num < BRK_INDEX_STRINGS + header.landmark_num ||
+		!inside(header.level_pos, header.level_num, sizeof(LevelInfo)) ||
+		!inside(header.landmark_pos, header.landmark_num, sizeof(BrkIndexLandmark)) ||
+		header.string_pos < 0 || header.string_pos > size)
+		return false;
+
+	vector<wstring> strings(header.string_num);
+	size_t pos = header.string_pos;
+	for (int i = 0; i < header.string_num; i++)
+	{
+		unsigned int len;
+		if (size - pos < sizeof(unsigned int))
+			return false;
+		memcpy(&len, data + pos, sizeof(unsigned int));
+		pos += sizeof(unsigned int);
+		if (size - pos < len)
+			return false;
+		strings[i] = s2ws(string(data + pos, len));
+		pos += len;
+	}
+	//bricks are found by the directory
+	if (strings[0] != m_dir_name)
+		return false;
+
+	vector<LevelInfo> levels(header.level_num);
+	if (header.level_num)
+		memcpy(&levels[0], data + header.level_pos, header.level_num * sizeof(LevelInfo));
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		LevelInfo &lv = levels[i];
+		if (lv.brick_num < 0 || lv.file_frame_num < 0 ||
+			lv.file_chan_num < 0 || lv.file_brick_num < 0 ||
+			!inside(lv.brick_pos, lv.brick_num, sizeof(BrickInfo)) ||
+			!inside(lv.file_pos, (unsigned long long)lv.file_frame_num *
+				lv.file_chan_num * lv.file_brick_num, sizeof(BrickFile)))
+			return false;
+	}
+
+	m_index = data;
+	m_pyramid.swap(levels);
+	m_imageinfo.nChannel = header.nChannel;
+	m_imageinfo.nFrame = header.nFrame;
+	m_imageinfo.nLevel = header.nLevel;
+	m_imageinfo.copyableLv = header.copyableLv;
+	m_ex_metadata_path = strings[1];
+	m_ex_metadata_url = strings[2];
+	m_metadata_id = strings[3];
+	m_roi_tree = strings[4];
+	m_landmarks.resize(header.landmark_num);
+	for (int i = 0; i < header.landmark_num; i++)
+	{
+		BrkIndexLandmark lm;
+		memcpy(&lm, data + header.landmark_pos + i * sizeof(BrkIndexLandmark),
+			sizeof(BrkIndexLandmark));
+		m_landmarks[i].name = lm.name >= 0 && lm.name < strings.size() ?
+			strings[lm.name] : wstring();
+		m_landmarks[i].x = lm.x;
+		m_landmarks[i].y = lm.y;
+		m_landmarks[i].z = lm.z;
+		m_landmarks[i].spcx = lm.spcx;
+		m_landmarks[i].spcy = lm.spcy;
+		m_landmarks[i].spcz = lm.spcz;
+	}
+	m_file_names.assign(strings.begin() + BRK_INDEX_STRINGS + header.landmark_num,
+		strings.end());
 
+	return true;
+}
+
+bool BRKXMLReader::loadMetadata(const wstring &file)
+{
 	if (m_md_doc.LoadFile(ws2s(file).c_str()) != 0){
 		return false;
 	}
-		
-	tinyxml2::XMLElement *root = m_md_doc.RootElement();
+
+	return ReadMetadata(m_md_doc.RootElement());
+}
+
+bool BRKXMLReader::ReadMetadata(tinyxml2::XMLElement *root)
+{
+	string str;
+	double dval;
+
 	if (!root) return false;
 
 	tinyxml2::XMLElement *md_node = NULL;
@@ -947,7 +1253,7 @@ wstring BRKXMLReader::GetCurLabelName(int t, int c)
 	wstring label_name = woss.str();
 	return label_name;
 }
-FLIVR::FileLocInfo* BRKXMLReader::GetBrickFilePath(int fr, int ch, int id, int lv)
+FLIVR::FileLocInfo BRKXMLReader::GetBrickFilePath(int fr, int ch, int id, int lv)
 {
 	int level = lv;
 	int frame = fr;
@@ -957,23 +1263,17 @@ FLIVR::FileLocInfo* BRKXMLReader::GetBrickFilePath(int fr, int ch, int id, int l
 	if(lv < 0 || lv >= m_level_num) level = m_cur_level;
 	if(fr < 0 || fr >= m_time_num)  frame = m_cur_time;
 	if(ch < 0 || ch >= m_chan_num)	channel = m_cur_chan;
-	if(id < 0 || id >= m_pyramid[level].bricks.size()) brickID = 0;
+	if(id < 0 || id >= m_pyramid[level].brick_num) brickID = 0;
 	
-	return m_pyramid[level].filename[frame][channel][brickID];
+	const BrickFile* file = GetBrickFile(level, frame, channel, brickID);
+	if (!file)
+		return FLIVR::FileLocInfo();
+	return FLIVR::FileLocInfo(m_file_names[file->name],
+		int(file->offset), int(file->datasize), file->type, file->isurl != 0);
 }
 
 wstring BRKXMLReader::GetBrickFileName(int fr, int ch, int id, int lv)
 {
-	int level = lv;
-	int frame = fr;
-	int channel = ch;
-	int brickID = id;
-	
-	if(lv < 0 || lv >= m_level_num) level = m_cur_level;
-	if(fr < 0 || fr >= m_time_num)  frame = m_cur_time;
-	if(ch < 0 || ch >= m_chan_num)	channel = m_cur_chan;
-	if(id < 0 || id >= m_pyramid[level].bricks.size()) brickID = 0;
-
 	#ifdef _WIN32
 	wchar_t slash = L'\\';
 #else
@@ -981,12 +1281,29 @@ wstring BRKXMLReader::GetBrickFileName(int fr, int ch, int id, int lv)
 #endif
 	if(m_isURL) slash = L'/';
 	//separate path and name
-	size_t pos = m_pyramid[level].filename[frame][channel][brickID]->filename.find_last_of(slash);
-	wstring name = m_pyramid[level].filename[frame][channel][brickID]->filename.substr(pos+1);
+	wstring path = GetBrickFilePath(fr, ch, id, lv).filename;
+	size_t pos = path.find_last_of(slash);
+	wstring name = path.substr(pos+1);
 	
 	return name;
 }
 
+const BRKXMLReader::BrickFile* BRKXMLReader::GetBrickFile(int lv, int fr, int ch, int id)
+{
+	if (lv < 0 || lv >= m_pyramid.size())
+		return 0;
+	const LevelInfo &level = m_pyramid[lv];
+	if (fr < 0 || fr >= level.file_frame_num ||
+		ch < 0 || ch >= level.file_chan_num ||
+		id < 0 || id >= level.file_brick_num)
+		return 0;
+	const BrickFile* file = (const BrickFile*)(m_index + level.file_pos) +
+		((long long)fr * level.file_chan_num + ch) * level.file_brick_num + id;
+	if (file->name < 0 || file->name >= m_file_names.size())
+		return 0;
+	return file;
+}
+
 int BRKXMLReader::GetFileType(int lv)
 {
 	if(lv < 0 || lv > m_level_num-1) return m_file_type;
@@ -1016,37 +1333,42 @@ void BRKXMLReader::OutputInfo()
 		ofs << "\tbrick_baseD: " << m_pyramid[i].brick_baseD << "\n";
 		ofs << "\tbit_depth: " << m_pyramid[i].bit_depth << "\n";
 		ofs << "\tfile_type: " << m_pyramid[i].file_type << "\n\n";
-		for(int j = 0; j < m_pyramid[i].bricks.size(); j++){
-			ofs << "\tBrick: " << " id = " <<  m_pyramid[i].bricks[j]->id
-				<< " w = " << m_pyramid[i].bricks[j]->x_size
-				<< " h = " << m_pyramid[i].bricks[j]->y_size
-				<< " d = " << m_pyramid[i].bricks[j]->z_size
-				<< " st_x = " << m_pyramid[i].bricks[j]->x_start
-				<< " st_y = " << m_pyramid[i].bricks[j]->y_start
-				<< " st_z = " << m_pyramid[i].bricks[j]->z_start
-				<< " offset = " << m_pyramid[i].bricks[j]->offset
-				<< " fsize = " << m_pyramid[i].bricks[j]->fsize << "\n";
+		const BrickInfo* bricks = GetBricks(i);
+		for(int j = 0; j < m_pyramid[i].brick_num; j++){
+			ofs << "\tBrick: " << " id = " <<  bricks[j].id
+				<< " w = " << bricks[j].x_size
+				<< " h = " << bricks[j].y_size
+				<< " d = " << bricks[j].z_size
+				<< " st_x = " << bricks[j].x_start
+				<< " st_y = " << bricks[j].y_start
+				<< " st_z = " << bricks[j].z_start
+				<< " offset = " << bricks[j].offset
+				<< " fsize = " << bricks[j].fsize << "\n";
 
 			ofs << "\t\ttbox: "
-				<< " x0 = " << m_pyramid[i].bricks[j]->tx0
-				<< " y0 = " << m_pyramid[i].bricks[j]->ty0
-				<< " z0 = " << m_pyramid[i].bricks[j]->tz0
-				<< " x1 = " << m_pyramid[i].bricks[j]->tx1
-				<< " y1 = " << m_pyramid[i].bricks[j]->ty1
-				<< " z1 = " << m_pyramid[i].bricks[j]->tz1 << "\n";
+				<< " x0 = " << bricks[j].tx0
+				<< " y0 = " << bricks[j].ty0
+				<< " z0 = " << bricks[j].tz0
+				<< " x1 = " << bricks[j].tx1
+				<< " y1 = " << bricks[j].ty1
+				<< " z1 = " << bricks[j].tz1 << "\n";
 			ofs << "\t\tbbox: "
-				<< " x0 = " << m_pyramid[i].bricks[j]->bx0
-				<< " y0 = " << m_pyramid[i].bricks[j]->by0
-				<< " z0 = " << m_pyramid[i].bricks[j]->bz0
-				<< " x1 = " << m_pyramid[i].bricks[j]->bx1
-				<< " y1 = " << m_pyramid[i].bricks[j]->by1
-				<< " z1 = " << m_pyramid[i].bricks[j]->bz1 << "\n";
+				<< " x0 = " << bricks[j].bx0
+				<< " y0 = " << bricks[j].by0
+				<< " z0 = " << bricks[j].bz0
+				<< " x1 = " << bricks[j].bx1
+				<< " y1 = " << bricks[j].by1
+				<< " z1 = " << bricks[j].bz1 << "\n";
 		}
 		ofs << "\n";
-		for(int j = 0; j < m_pyramid[i].filename.size(); j++){
-			for(int k = 0; k < m_pyramid[i].filename[j].size(); k++){
-				for(int n = 0; n < m_pyramid[i].filename[j][k].size(); n++)
-					ofs << "\t<Frame = " << j << " Channel = " << k << " ID = " << n << " Filepath = " << ws2s(m_pyramid[i].filename[j][k][n]->filename) << ">\n";
+		for(int j = 0; j < m_pyramid[i].file_frame_num; j++){
+			for(int k = 0; k < m_pyramid[i].file_chan_num; k++){
+				for(int n = 0; n < m_pyramid[i].file_brick_num; n++)
+				{
+					const BrickFile* file = GetBrickFile(i, j, k, n);
+					if (file)
+						ofs << "\t<Frame = " << j << " Channel = " << k << " ID = " << n << " Filepath = " << ws2s(m_file_names[file->name]) << ">\n";
+				}
 			}
 		}
 		ofs << "\n";
@@ -1115,31 +1437,30 @@ void BRKXMLReader::build_bricks(vector<FLIVR::TextureBrick*> &tbrks, int lv)
 		}
 		tbrks.clear();
 	}
-	vector<BrickInfo *>::iterator bite = m_pyramid[lev].bricks.begin();
-	while (bite != m_pyramid[lev].bricks.end())
+	const BrickInfo* bricks = GetBricks(lev);
+	for (int i = 0; i < m_pyramid[lev].brick_num; i++)
 	{
-		FLIVR::BBox tbox(FLIVR::Point((*bite)->tx0, (*bite)->ty0, (*bite)->tz0), FLIVR::Point((*bite)->tx1, (*bite)->ty1, (*bite)->tz1));
-		FLIVR::BBox bbox(FLIVR::Point((*bite)->bx0, (*bite)->by0, (*bite)->bz0), FLIVR::Point((*bite)->bx1, (*bite)->by1, (*bite)->bz1));
+		const BrickInfo* bite = bricks + i;
+		FLIVR::BBox tbox(FLIVR::Point(bite->tx0, bite->ty0, bite->tz0), FLIVR::Point(bite->tx1, bite->ty1, bite->tz1));
+		FLIVR::BBox bbox(FLIVR::Point(bite->bx0, bite->by0, bite->bz0), FLIVR::Point(bite->bx1, bite->by1, bite->bz1));
 
 		double dx0, dy0, dz0, dx1, dy1, dz1;
-		dx0 = (double)((*bite)->x_start) / m_pyramid[lev].imageW;
-		dy0 = (double)((*bite)->y_start) / m_pyramid[lev].imageH;
-		dz0 = (double)((*bite)->z_start) / m_pyramid[lev].imageD;
-		dx1 = (double)((*bite)->x_start + (*bite)->x_size) / m_pyramid[lev].imageW;
-		dy1 = (double)((*bite)->y_start + (*bite)->y_size) / m_pyramid[lev].imageH;
-		dz1 = (double)((*bite)->z_start + (*bite)->z_size) / m_pyramid[lev].imageD;
+		dx0 = (double)(bite->x_start) / m_pyramid[lev].imageW;
+		dy0 = (double)(bite->y_start) / m_pyramid[lev].imageH;
+		dz0 = (double)(bite->z_start) / m_pyramid[lev].imageD;
+		dx1 = (double)(bite->x_start + bite->x_size) / m_pyramid[lev].imageW;
+		dy1 = (double)(bite->y_start + bite->y_size) / m_pyramid[lev].imageH;
+		dz1 = (double)(bite->z_start + bite->z_size) / m_pyramid[lev].imageD;
 
 		FLIVR::BBox dbox = FLIVR::BBox(FLIVR::Point(dx0, dy0, dz0), FLIVR::Point(dx1, dy1, dz1));
 
 		//numc? gm_nrrd?
 		FLIVR::TextureBrick *b = new FLIVR::TextureBrick(
-			0, 0, (*bite)->x_size, (*bite)->y_size, (*bite)->z_size, 1, numb, 
-			(*bite)->x_start, (*bite)->y_start, (*bite)->z_start,
-			(*bite)->x_size, (*bite)->y_size, (*bite)->z_size, bbox, tbox, dbox,
-			tbrks.size(), (*bite)->id, (*bite)->offset, (*bite)->fsize);
+			0, 0, bite->x_size, bite->y_size, bite->z_size, 1, numb, 
+			bite->x_start, bite->y_start, bite->z_start,
+			bite->x_size, bite->y_size, bite->z_size, bbox, tbox, dbox,
+			tbrks.size(), bite->id, bite->offset, bite->fsize);
 		tbrks.push_back(b);
-		
-		bite++;
 	}
 
 	return;
@@ -1168,6 +1489,29 @@ void BRKXMLReader::build_pyramid(vector<FLIVR::Pyramid_Level> &pyramid, vector<v
 		vector<vector<vector<vector<FLIVR::FileLocInfo *>>>>().swap(filenames);
 	}
 
+	//file lists are owned by the caller
+	filenames.resize(m_pyramid.size());
+	for (int i = 0; i < filenames.size(); i++)
+	{
+		filenames[i].resize(m_pyramid[i].file_frame_num);
+		for (int j = 0; j < filenames[i].size(); j++)
+		{
+			filenames[i][j].resize(m_pyramid[i].file_chan_num);
+			for (int k = 0; k < filenames[i][j].size(); k++)
+			{
+				filenames[i][j][k].resize(m_pyramid[i].file_brick_num, NULL);
+				for (int n = 0; n < filenames[i][j][k].size(); n++)
+				{
+					const BrickFile* file = GetBrickFile(i, j, k, n);
+					if (file)
+						filenames[i][j][k][n] = new FLIVR::FileLocInfo(
+							m_file_names[file->name], int(file->offset),
+							int(file->datasize), file->type, file->isurl != 0);
+				}
+			}
+		}
+	}
+
 	pyramid.resize(m_pyramid.size());
 
 	for (int i = 0; i < m_pyramid.size(); i++)
@@ -1175,7 +1519,10 @@ void BRKXMLReader::build_pyramid(vector<FLIVR::Pyramid_Level> &pyramid, vector<v
 		SetLevel(i);
 		pyramid[i].data = Convert(t, c, false);
 		build_bricks(pyramid[i].bricks);
-		pyramid[i].filenames = &m_pyramid[i].filename[t][c];
+		pyramid[i].filenames = 0;
+		if (t >= 0 && t < filenames[i].size() &&
+			c >= 0 && c < filenames[i][t].size())
+			pyramid[i].filenames = &filenames[i][t][c];
 		pyramid[i].filetype = GetFileType();
 		pyramid[i].szx = m_pyramid[i].imageW;
 		pyramid[i].szy = m_pyramid[i].imageH;
@@ -1193,25 +1540,6 @@ void BRKXMLReader::build_pyramid(vector<FLIVR::Pyramid_Level> &pyramid, vector<v
 			((pyramid[i].szz - 1) / (pyramid[i].bszz - 1) +
 			(((pyramid[i].szz - 1) % (pyramid[i].bszz - 1)) ? 1 : 0)) : 1;
 	}
-
-	filenames.resize(m_pyramid.size());
-	for (int i = 0; i < filenames.size(); i++)
-	{
-		filenames[i].resize(m_pyramid[i].filename.size());
-		for (int j = 0; j < filenames[i].size(); j++)
-		{
-			filenames[i][j].resize(m_pyramid[i].filename[j].size());
-			for (int k = 0; k < filenames[i][j].size(); k++)
-			{
-				filenames[i][j][k].resize(m_pyramid[i].filename[j][k].size());
-				for (int n = 0; n < filenames[i][j][k].size(); n++)
-				{
-					filenames[i][j][k][n] = new FLIVR::FileLocInfo(*m_pyramid[i].filename[j][k][n]);
-				}
-			}
-		}
-	}
-
 }
 
 void BRKXMLReader::SetInfo()
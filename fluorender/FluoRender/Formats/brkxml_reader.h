@@ -2,7 +2,9 @@
 #define _BRKXML_READER_H_
 
 #include <vector>
+#include <map>
 #include <base_reader.h>
+#include <mapped_file.h>
 #include <FLIVR/TextureBrick.h>
 #include <tinyxml2.h>
 
@@ -66,7 +68,7 @@ public:
 	wstring GetExMetadataURL() {return m_ex_metadata_url;}
 	void SetInfo();
 
-	FLIVR::FileLocInfo* GetBrickFilePath(int fr, int ch, int id, int lv = -1);
+	FLIVR::FileLocInfo GetBrickFilePath(int fr, int ch, int id, int lv = -1);
 	wstring GetBrickFileName(int fr, int ch, int id, int lv = -1);
 	int GetFileType(int lv = -1);
 
@@ -119,6 +121,16 @@ private:
 		//bbox
 		double bx0, by0, bz0, bx1, by1, bz1;
 	};
+	//file location of a brick
+	struct BrickFile
+	{
+		int name;//index to m_file_names, -1 if not listed
+		int type;
+		int isurl;
+		int reserved;
+		long long offset;
+		long long datasize;
+	};
 	struct LevelInfo
 	{
 		int imageW;
@@ -132,10 +144,23 @@ private:
 		int brick_baseD;
 		int bit_depth;
 		int file_type;
-		vector<vector<vector<FLIVR::FileLocInfo *>>> filename;//Frame->Channel->BrickID->Filename
-		vector<BrickInfo *> bricks;
+		//flat tables in the index
+		//files are indexed by (frame * file_chan_num + channel) * file_brick_num + brick id
+		int brick_num;
+		int file_frame_num;
+		int file_chan_num;
+		int file_brick_num;
+		long long brick_pos;
+		long long file_pos;
 	};
 	vector<LevelInfo> m_pyramid;
+	vector<wstring> m_file_names;
+
+	//binary index of the pyramid, mapped from the cache file
+	//or built from the xml when the cache is stale
+	MappedFile m_index_file;
+	vector<char> m_index_buf;
+	const char* m_index;
 
 	
 	struct ImageInfo
@@ -190,14 +215,31 @@ private:
 	vector<Landmark> m_landmarks;
 	wstring m_metadata_id;
 
+	//pyramid read from the xml, before it's flattened
+	struct LevelXml
+	{
+		LevelInfo info;
+		vector<BrickInfo> bricks;
+		vector<vector<vector<BrickFile>>> files;//Frame->Channel->BrickID
+	};
+	map<wstring, int> m_name_ids;
+
 private:
 	ImageInfo ReadImageInfo(tinyxml2::XMLElement *seqNode);
 	void ReadBrick(tinyxml2::XMLElement *brickNode, BrickInfo &binfo);
-	void ReadLevel(tinyxml2::XMLElement* lvNode, LevelInfo &lvinfo);
-	void ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vector<vector<FLIVR::FileLocInfo *>>> &filename);
-	void ReadPackedBricks(tinyxml2::XMLElement* packNode, vector<BrickInfo *> &brks);
+	void ReadLevel(tinyxml2::XMLElement* lvNode, LevelXml &lvinfo);
+	void ReadFilenames(tinyxml2::XMLElement* fileRootNode, vector<vector<vector<BrickFile>>> &filename);
+	void ReadPackedBricks(tinyxml2::XMLElement* packNode, vector<BrickInfo> &brks);
 	void Readbox(tinyxml2::XMLElement *boxNode, double &x0, double &y0, double &z0, double &x1, double &y1, double &z1);
-	void ReadPyramid(tinyxml2::XMLElement *lvRootNode, vector<LevelInfo> &pylamid);
+	void ReadPyramid(tinyxml2::XMLElement *lvRootNode, vector<LevelXml> &pylamid);
+	bool ReadMetadata(tinyxml2::XMLElement *root);
+
+	//brick index
+	void BuildIndex(vector<LevelXml> &pyramid, long long xml_size, long long xml_time);
+	bool LoadIndex(const char* data, size_t size, long long xml_size, long long xml_time);
+	const BrickInfo* GetBricks(int lv)
+	{ return (const BrickInfo*)(m_index + m_pyramid[lv].brick_pos); }
+	const BrickFile* GetBrickFile(int lv, int fr, int ch, int id);
 
 	void Clear();
 };
@@ -28,6 +28,7 @@ DEALINGS IN THE SOFTWARE.
 #include "imageJ_reader.h"
 #include "../compatibility.h"
 #include <wx/stdpaths.h>
+#include <new>
 
 ImageJReader::ImageJReader()
 {
@@ -345,6 +346,12 @@ Nrrd* ImageJReader::ReadFromImageJ(int t, int c, bool get_max) {
 	// ImageJ code to read the data.
 	string path_name = ws2s(m_path_name);
 
+	//read straight into native memory first
+	//the per-slice array copy below is kept for older bridges
+	void* t_data = ReadDirect(t, c);
+	if (t_data)
+		return WrapData(t_data, get_max);
+
 	jmethodID method_id = NULL;
 	if (m_eight_bit == true){
 		method_id = m_pJVMInstance->m_pEnv->GetStaticMethodID(m_imageJ_cls, "getByteData2D", "([Ljava/lang/String;II)[[B");
@@ -353,7 +360,6 @@ Nrrd* ImageJReader::ReadFromImageJ(int t, int c, bool get_max) {
 		method_id = m_pJVMInstance->m_pEnv->GetStaticMethodID(m_imageJ_cls, "getIntData2D", "([Ljava/lang/String;II)[[S");
 	}
 	
-	void* t_data = NULL;
 	if (method_id == nullptr) {
 		cerr << "ERROR: method void mymain() not found !" << endl;
 		return NULL;
@@ -443,11 +449,15 @@ Nrrd* ImageJReader::ReadFromImageJ(int t, int c, bool get_max) {
 			int test = *(body);
 			cout << "Error";
 		}
-		unsigned short int test = ((unsigned short int *)(t_data))[10*488 + 10];
 		m_pJVMInstance->m_pEnv->DeleteLocalRef(arr);
 		m_pJVMInstance->m_pEnv->DeleteLocalRef(val);
 	}
 
+	return WrapData(t_data, get_max);
+}
+
+Nrrd* ImageJReader::WrapData(void* t_data, bool get_max)
+{
 	// Creating Nrrd out of the data.
 	Nrrd *nrrdout = nrrdNew();	
 	
@@ -486,3 +496,88 @@ Nrrd* ImageJReader::ReadFromImageJ(int t, int c, bool get_max) {
 
 	return nrrdout;
 }
+
+void* ImageJReader::ReadDirect(int t, int c)
+{
+	JNIEnv* env = m_pJVMInstance->m_pEnv;
+	if (!env || m_x_size <= 0 || m_y_size <= 0 || m_slice_num <= 0)
+		return NULL;
+
+	jmethodID method_id = env->GetStaticMethodID(m_imageJ_cls, "readToBuffers",
+		"([Ljava/lang/String;III[Ljava/nio/ByteBuffer;)I");
+	if (!method_id)
+	{
+		//older bridge without the buffer interface
+		if (env->ExceptionCheck())
+			env->ExceptionClear();
+		return NULL;
+	}
+
+	int bytes = m_eight_bit ? 1 : 2;
+	unsigned long long slice_size = (unsigned long long)m_x_size *
+		(unsigned long long)m_y_size * bytes;
+	//a java buffer is indexed by int
+	if (slice_size > 0x7fffffffULL)
+		return NULL;
+	unsigned long long total_size = slice_size * m_slice_num;
+
+	void* t_data = NULL;
+	if (m_eight_bit)
+		t_data = new (std::nothrow) unsigned char[total_size];
+	else
+		t_data = new (std::nothrow) unsigned short[total_size / 2];
+	if (!t_data)
+		return NULL;
+
+	//one direct buffer per slice, all pointing into the final volume
+	jclass buf_cls = env->FindClass("java/nio/ByteBuffer");
+	jobjectArray slices = env->NewObjectArray(m_slice_num, buf_cls, NULL);
+	bool ok = slices != NULL;
+	for (int i = 0; ok && i < m_slice_num; ++i)
+	{
+		jobject buf = env->NewDirectByteBuffer(
+			(unsigned char*)t_data + slice_size * i, (jlong)slice_size);
+		if (!buf)
+		{
+			ok = false;
+			break;
+		}
+		env->SetObjectArrayElement(slices, i, buf);
+		env->DeleteLocalRef(buf);
+	}
+
+	jint result = -1;
+	if (ok)
+	{
+		string path_name = ws2s(m_path_name);
+		jclass str_cls = env->FindClass("java/lang/String");
+		jstring jpath = env->NewStringUTF(path_name.c_str());
+		jobjectArray arr = env->NewObjectArray(1, str_cls, jpath);
+		result = env->CallStaticIntMethod(m_imageJ_cls, method_id,
+			arr, (jint)t, (jint)c, (jint)bytes, slices);
+		if (env->ExceptionCheck())
+		{
+			env->ExceptionClear();
+			result = -1;
+		}
+		env->DeleteLocalRef(arr);
+		env->DeleteLocalRef(jpath);
+		env->DeleteLocalRef(str_cls);
+	}
+	else if (env->ExceptionCheck())
+		env->ExceptionClear();
+
+	if (slices)
+		env->DeleteLocalRef(slices);
+	env->DeleteLocalRef(buf_cls);
+
+	if (result != 0)
+	{
+		if (m_eight_bit)
+			delete[](unsigned char*)t_data;
+		else
+			delete[](unsigned short*)t_data;
+		return NULL;
+	}
+	return t_data;
+}
@@ -123,6 +123,11 @@ private:
 private:	
 	// read from imageJ
 	Nrrd* ReadFromImageJ(int i, int c, bool get_max);
+	//fill a native volume through direct byte buffers
+	//returns NULL if the bridge doesn't support it or reading fails
+	void* ReadDirect(int t, int c);
+	//wrap the volume read from imageJ in a nrrd
+	Nrrd* WrapData(void* t_data, bool get_max);
 };
 
 #endif//_IMAGEJ_READER_H_
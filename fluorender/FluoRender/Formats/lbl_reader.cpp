@@ -26,9 +26,12 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
 #include "lbl_reader.h"
+#include "mapped_file.h"
 #include "../compatibility.h"
 #include <sstream>
 #include <inttypes.h>
+#include <atomic>
+#include <new>
 
 LBLReader::LBLReader()
 {
@@ -116,24 +119,31 @@ Nrrd* LBLReader::Convert(int t, int c, bool get_max)
 	wostringstream strs;
 	strs << str_name /*<< "_t" << t << "_c" << c*/ << ".lbl";
 	str_name = strs.str();
+	Nrrd *output = ReadRLE(str_name);
+	if (output)
+		return output;
+
 	FILE* lbl_file = 0;
 	if (!WFOPEN(&lbl_file, str_name.c_str(), L"rb"))
 		return 0;
 
-	Nrrd *output = nrrdNew();
+	output = nrrdNew();
 	NrrdIoState *nio = nrrdIoStateNew();
 	nrrdIoStateSet(nio, nrrdIoStateSkipData, AIR_TRUE);
 	if (nrrdRead(output, lbl_file, nio))
 	{
+		nrrdIoStateNix(nio);
 		fclose(lbl_file);
 		return 0;
 	}
-	nio = nrrdIoStateNix(nio);
+	//data follows the header
+	long data_offset = ftell(lbl_file);
 	rewind(lbl_file);
 	if (output->dim != 3 ||
 		(output->type != nrrdTypeInt &&
 		output->type != nrrdTypeUInt))
 	{
+		nrrdIoStateNix(nio);
 		nrrdNuke(output);
 		fclose(lbl_file);
 		return 0;
@@ -141,10 +151,14 @@ Nrrd* LBLReader::Convert(int t, int c, bool get_max)
 	int slice_num = int(output->axis[2].size);
 	int x_size = int(output->axis[0].size);
 	int y_size = int(output->axis[1].size);
-	int data_size = slice_num * x_size * y_size;
+	size_t data_size = (size_t)slice_num * x_size * y_size;
 	output->data = new unsigned int[data_size];
 
-	if (nrrdRead(output, lbl_file, NULL))
+	//mapped or block decoded when possible
+	bool read = ReadNrrdData(str_name, data_offset, output, nio,
+		[](size_t, size_t) {});
+	nrrdIoStateNix(nio);
+	if (!read && nrrdRead(output, lbl_file, NULL))
 	{
 		nrrdNuke(output);
 		fclose(lbl_file);
@@ -169,3 +183,118 @@ wstring LBLReader::GetCurLabelName(int t, int c)
 {
 	return wstring(L"");
 }
+
+Nrrd* LBLReader::ReadRLE(const wstring &filename)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return 0;
+	const unsigned char* src = file.GetData();
+	size_t src_size = file.GetSize();
+	LBLRLEHeader header;
+	if (src_size < sizeof(LBLRLEHeader))
+		return 0;
+	memcpy(&header, src, sizeof(LBLRLEHeader));
+	if (memcmp(header.magic, LBL_RLE_MAGIC, sizeof(header.magic)) ||
+		header.version != LBL_RLE_VERSION ||
+		!header.nx || !header.ny || !header.nz ||
+		!header.bx || !header.by || !header.bz)
+		return 0;
+
+	size_t bnx = (header.nx + header.bx - 1) / header.bx;
+	size_t bny = (header.ny + header.by - 1) / header.by;
+	size_t bnz = (header.nz + header.bz - 1) / header.bz;
+	size_t brick_num = bnx * bny * bnz;
+	size_t data_pos = sizeof(LBLRLEHeader) + (brick_num + 1) * sizeof(unsigned long long);
+	if (data_pos > src_size)
+		return 0;
+	vector<unsigned long long> offsets(brick_num + 1);
+	memcpy(&offsets[0], src + sizeof(LBLRLEHeader), (brick_num + 1) * sizeof(unsigned long long));
+	for (size_t i = 0; i < brick_num; ++i)
+		if (offsets[i] > offsets[i + 1])
+			return 0;
+	if (offsets[0] || offsets[brick_num] > src_size - data_pos)
+		return 0;
+
+	size_t data_size = (size_t)header.nx * header.ny * header.nz;
+	unsigned int* data = new (std::nothrow) unsigned int[data_size];
+	if (!data)
+		return 0;
+	//every brick writes its own part of the volume
+	std::atomic<bool> ok(true);
+	ParallelFetch(brick_num, [&](size_t i)
+	{
+		if (ok && !DecodeRLEBrick(header, i, src + data_pos + offsets[i],
+			size_t(offsets[i + 1] - offsets[i]), data))
+			ok = false;
+	});
+	if (!ok)
+	{
+		delete[] data;
+		return 0;
+	}
+
+	Nrrd *output = nrrdNew();
+	nrrdWrap(output, data, nrrdTypeUInt, 3,
+		(size_t)header.nx, (size_t)header.ny, (size_t)header.nz);
+	nrrdAxisInfoSet(output, nrrdAxisInfoSpacing, header.spcx, header.spcy, header.spcz);
+	nrrdAxisInfoSet(output, nrrdAxisInfoMin, 0.0, 0.0, 0.0);
+	nrrdAxisInfoSet(output, nrrdAxisInfoMax, header.spcx*header.nx,
+		header.spcy*header.ny, header.spcz*header.nz);
+	return output;
+}
+
+bool LBLReader::DecodeRLEBrick(const LBLRLEHeader &header, size_t brick,
+	const unsigned char* src, size_t size, unsigned int* dst)
+{
+	size_t nx = header.nx;
+	size_t ny = header.ny;
+	size_t bnx = (header.nx + header.bx - 1) / header.bx;
+	size_t bny = (header.ny + header.by - 1) / header.by;
+	size_t x0 = (brick % bnx) * header.bx;
+	size_t y0 = (brick / bnx % bny) * header.by;
+	size_t z0 = (brick / (bnx * bny)) * header.bz;
+	size_t x1 = x0 + header.bx < nx ? x0 + header.bx : nx;
+	size_t y1 = y0 + header.by < ny ? y0 + header.by : ny;
+	size_t z1 = z0 + header.bz < header.nz ? z0 + header.bz : header.nz;
+	if (z0 >= header.nz)
+		return false;
+	size_t w = x1 - x0;
+
+	const unsigned char* p = src;
+	const unsigned char* end = src + size;
+	const unsigned int* prev = 0;
+	unsigned int run, id;
+	for (size_t z = z0; z < z1; ++z)
+	for (size_t y = y0; y < y1; ++y)
+	{
+		unsigned int* row = dst + (z * ny + y) * nx + x0;
+		if (!LBLGetVarint(p, end, run))
+			return false;
+		if (!run)
+		{
+			//same as the previous row
+			if (!prev)
+				return false;
+			memcpy(row, prev, w * sizeof(unsigned int));
+			prev = row;
+			continue;
+		}
+		size_t x = 0;
+		while (true)
+		{
+			if (!LBLGetVarint(p, end, id) ||
+				run > w - x)
+				return false;
+			for (unsigned int* v = row + x; v < row + x + run; ++v)
+				*v = id;
+			x += run;
+			if (x == w)
+				break;
+			if (!LBLGetVarint(p, end, run) || !run)
+				return false;
+		}
+		prev = row;
+	}
+	return p == end;
+}
@@ -29,6 +29,7 @@ DEALINGS IN THE SOFTWARE.
 #define _LBL_READER_H_
 
 #include <base_reader.h>
+#include <lbl_rle.h>
 
 using namespace std;
 
@@ -78,6 +79,12 @@ public:
 	bool GetBatch() {return false;}
 	int GetBatchNum() {return 0;}
 	int GetCurBatch() {return 0;}
+
+	//run length coded labels, 0 if the file isn't one
+	static Nrrd* ReadRLE(const wstring &filename);
+	//decode one brick into label memory of the volume's size
+	static bool DecodeRLEBrick(const LBLRLEHeader &header, size_t brick,
+		const unsigned char* src, size_t size, unsigned int* dst);
 };
 
 #endif//_LBL_READER_H_
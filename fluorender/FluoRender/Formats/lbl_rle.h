@@ -0,0 +1,80 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#ifndef _LBL_RLE_H_
+#define _LBL_RLE_H_
+
+#include <vector>
+#include <cstddef>
+
+//run length coded label volume
+//layout: LBLRLEHeader, a table of brick_num+1 offsets (unsigned long long)
+//relative to the end of the table, then the coded bricks
+//bricks are in x, y, z order and each brick is coded row by row
+//a row is a list of varint pairs (run length, label id) covering the row,
+//or a single 0 when it is the same as the previous row of the brick
+#define LBL_RLE_MAGIC	"FLLBLRLE"
+#define LBL_RLE_VERSION	1
+#define LBL_RLE_BRICK	128
+
+struct LBLRLEHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int nx, ny, nz;//volume size
+	unsigned int bx, by, bz;//brick size
+	unsigned int reserved;
+	double spcx, spcy, spcz;
+};
+
+inline void LBLPutVarint(std::vector<unsigned char> &buf, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		buf.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back((unsigned char)value);
+}
+
+//return false when the data ends before the value does
+inline bool LBLGetVarint(const unsigned char* &p, const unsigned char* end, unsigned int &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (p >= end)
+			return false;
+		unsigned char c = *p++;
+		value |= (unsigned int)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+#endif//_LBL_RLE_H_
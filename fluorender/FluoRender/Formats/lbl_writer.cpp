@@ -0,0 +1,177 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#include "lbl_writer.h"
+#include "lbl_rle.h"
+#include "msk_writer.h"
+#include "../compatibility.h"
+#include <cstring>
+#include <atomic>
+
+LBLWriter::LBLWriter()
+{
+	m_data = 0;
+	m_spcx = 0.0;
+	m_spcy = 0.0;
+	m_spcz = 0.0;
+	m_use_spacings = false;
+	m_compression = true;
+}
+
+LBLWriter::~LBLWriter()
+{
+}
+
+void LBLWriter::SetData(Nrrd *data)
+{
+	m_data = data;
+}
+
+void LBLWriter::SetSpacings(double spcx, double spcy, double spcz)
+{
+	m_spcx = spcx;
+	m_spcy = spcy;
+	m_spcz = spcz;
+	m_use_spacings = true;
+}
+
+void LBLWriter::SetCompression(bool value)
+{
+	m_compression = value;
+}
+
+void LBLWriter::Save(wstring filename, int mode)
+{
+	if (!m_data)
+		return;
+
+	if (m_compression &&
+		SaveRLE(filename))
+		return;
+
+	//nrrd label
+	MSKWriter msk_writer;
+	msk_writer.SetData(m_data);
+	if (m_use_spacings)
+		msk_writer.SetSpacings(m_spcx, m_spcy, m_spcz);
+	msk_writer.Save(filename, 1);
+}
+
+bool LBLWriter::SaveRLE(const wstring &filename)
+{
+	if (!m_data->data ||
+		m_data->dim != 3 ||
+		(m_data->type != nrrdTypeInt &&
+		m_data->type != nrrdTypeUInt))
+		return false;
+
+	LBLRLEHeader header;
+	memset(&header, 0, sizeof(LBLRLEHeader));
+	memcpy(header.magic, LBL_RLE_MAGIC, sizeof(header.magic));
+	header.version = LBL_RLE_VERSION;
+	header.nx = (unsigned int)m_data->axis[0].size;
+	header.ny = (unsigned int)m_data->axis[1].size;
+	header.nz = (unsigned int)m_data->axis[2].size;
+	header.bx = LBL_RLE_BRICK;
+	header.by = LBL_RLE_BRICK;
+	header.bz = LBL_RLE_BRICK;
+	if (m_use_spacings)
+	{
+		header.spcx = m_spcx;
+		header.spcy = m_spcy;
+		header.spcz = m_spcz;
+	}
+	else
+	{
+		header.spcx = m_data->axis[0].spacing;
+		header.spcy = m_data->axis[1].spacing;
+		header.spcz = m_data->axis[2].spacing;
+	}
+	if (!header.nx || !header.ny || !header.nz)
+		return false;
+
+	size_t nx = header.nx;
+	size_t ny = header.ny;
+	size_t bnx = (header.nx + header.bx - 1) / header.bx;
+	size_t bny = (header.ny + header.by - 1) / header.by;
+	size_t bnz = (header.nz + header.bz - 1) / header.bz;
+	size_t brick_num = bnx * bny * bnz;
+	unsigned int* data = (unsigned int*)m_data->data;
+
+	//bricks are coded independently
+	vector<vector<unsigned char>> bricks(brick_num);
+	ParallelEncode(brick_num, [&](size_t i)
+	{
+		size_t x0 = (i % bnx) * header.bx;
+		size_t y0 = (i / bnx % bny) * header.by;
+		size_t z0 = (i / (bnx * bny)) * header.bz;
+		size_t x1 = x0 + header.bx < nx ? x0 + header.bx : nx;
+		size_t y1 = y0 + header.by < ny ? y0 + header.by : ny;
+		size_t z1 = z0 + header.bz < header.nz ? z0 + header.bz : header.nz;
+		size_t w = x1 - x0;
+		vector<unsigned char> &buf = bricks[i];
+		const unsigned int* prev = 0;
+		for (size_t z = z0; z < z1; ++z)
+		for (size_t y = y0; y < y1; ++y)
+		{
+			const unsigned int* row = data + (z * ny + y) * nx + x0;
+			if (prev && !memcmp(row, prev, w * sizeof(unsigned int)))
+			{
+				LBLPutVarint(buf, 0);
+				prev = row;
+				continue;
+			}
+			size_t x = 0;
+			while (x < w)
+			{
+				unsigned int id = row[x];
+				size_t run = 1;
+				while (x + run < w && row[x + run] == id)
+					run++;
+				LBLPutVarint(buf, (unsigned int)run);
+				LBLPutVarint(buf, id);
+				x += run;
+			}
+			prev = row;
+		}
+	});
+
+	vector<unsigned long long> offsets(brick_num + 1, 0);
+	for (size_t i = 0; i < brick_num; ++i)
+		offsets[i + 1] = offsets[i] + bricks[i].size();
+
+	FILE* fp = 0;
+	if (!WFOPEN(&fp, filename.c_str(), L"wb"))
+		return false;
+	bool result = fwrite(&header, sizeof(LBLRLEHeader), 1, fp) == 1 &&
+		fwrite(&offsets[0], sizeof(unsigned long long), offsets.size(), fp) == offsets.size();
+	for (size_t i = 0; result && i < brick_num; ++i)
+		result = bricks[i].empty() ||
+			fwrite(&bricks[i][0], 1, bricks[i].size(), fp) == bricks[i].size();
+	fclose(fp);
+	return result;
+}
@@ -28,6 +28,8 @@ DEALINGS IN THE SOFTWARE.
 #include <stdio.h>
 #include "../compatibility.h"
 #include "lsm_reader.h"
+#include "mapped_file.h"
+#include <mutex>
 
 LSMReader::LSMReader()
 {
@@ -78,6 +80,16 @@ void LSMReader::SetFile(wstring &file)
 	m_id_string = m_path_name;
 }
 
+bool LSMReader::ReadValues(FILE* pfile, unsigned int offset, unsigned int num, vector<unsigned int> &values)
+{
+	values.clear();
+	if (!num || FSEEK64(pfile, offset, SEEK_SET) != 0)
+		return false;
+	values.resize(num);
+	values.resize(fread(&values[0], sizeof(unsigned int), num, pfile));
+	return !values.empty();
+}
+
 int LSMReader::Preprocess()
 {
 	FILE* pfile = 0;
@@ -110,6 +122,10 @@ int LSMReader::Preprocess()
 	unsigned int prev_offset = 0;
 	unsigned int offset_high = 0;
 
+	//each directory is read in one block
+	vector<unsigned char> ifd;
+	vector<unsigned int> values;
+
 	//images
 	while (FSEEK64(pfile, ioffset, SEEK_SET) == 0)
 	{
@@ -120,6 +136,13 @@ int LSMReader::Preprocess()
 			fclose(pfile);
 			return READER_FORMAT_ERROR;
 		}
+		//entries (12 bytes each) and the next offset
+		ifd.resize(entry_num * 12 + 4);
+		if (fread(&ifd[0], sizeof(unsigned char), ifd.size(), pfile) != ifd.size())
+		{
+			fclose(pfile);
+			return READER_FORMAT_ERROR;
+		}
 
 		vector<unsigned int> offsets;
 		vector<unsigned int> offset_highs;
@@ -127,33 +150,11 @@ int LSMReader::Preprocess()
 
 		for (i = 0; i < entry_num; i++)
 		{
-			unsigned short tag;
-			if (fread(&tag, sizeof(unsigned short), 1, pfile) < 1)
-			{
-				fclose(pfile);
-				return READER_FORMAT_ERROR;
-			}
-			unsigned short type;
-			if (fread(&type, sizeof(unsigned short), 1, pfile) < 1)
-			{
-				fclose(pfile);
-				return READER_FORMAT_ERROR;
-			}
-			unsigned int length;
-			if (fread(&length, sizeof(unsigned int), 1, pfile) < 1)
-			{
-				fclose(pfile);
-				return READER_FORMAT_ERROR;
-			}
-			unsigned int value;
-			if (fread(&value, sizeof(unsigned int), 1, pfile) < 1)
-			{
-				fclose(pfile);
-				return READER_FORMAT_ERROR;
-			}
-
-			//remember current position
-			long cur_pos = ftell(pfile);
+			unsigned char* entry = &ifd[12 * i];
+			unsigned short tag = *((unsigned short*)entry);
+			unsigned short type = *((unsigned short*)(entry + 2));
+			unsigned int length = *((unsigned int*)(entry + 4));
+			unsigned int value = *((unsigned int*)(entry + 8));
 
 			switch (tag)
 			{
@@ -186,37 +187,20 @@ int LSMReader::Preprocess()
 				if (full_image)
 				{
 					if (length == 1)
+						values.assign(1, value);
+					else
+						ReadValues(pfile, value, length, values);
+					for (j = 0; j < (int)values.size(); j++)
 					{
-						offsets.push_back(value);
-						if (value < prev_offset)
+						offsets.push_back(values[j]);
+						if (values[j] < prev_offset)
 						{
 							m_l4gb = true;
 							offset_high++;
 						}
-						prev_offset = value;
+						prev_offset = values[j];
 						offset_highs.push_back(offset_high);
 					}
-					else
-					{
-						if (FSEEK64(pfile, value, SEEK_SET) == 0)
-						{
-							unsigned int vtemp;
-							for (j = 0; j < (int)length; j++)
-							{
-								if (fread(&vtemp, sizeof(unsigned int), 1, pfile) == 1)
-								{
-									offsets.push_back(vtemp);
-									if (vtemp < prev_offset)
-									{
-										m_l4gb = true;
-										offset_high++;
-									}
-									prev_offset = vtemp;
-									offset_highs.push_back(offset_high);
-								}
-							}
-						}
-					}
 				}
 				break;
 			case 0x0115://277, samples per pixel
@@ -227,21 +211,9 @@ int LSMReader::Preprocess()
 				if (full_image)
 				{
 					if (length == 1)
-					{
 						sizes.push_back(value);
-					}
-					else
-					{
-						if (FSEEK64(pfile, value, SEEK_SET) == 0)
-						{
-							unsigned int vtemp;
-							for (j = 0; j < (int)length; j++)
-							{
-								if (fread(&vtemp, sizeof(unsigned int), 1, pfile) == 1)
-									sizes.push_back(vtemp);
-							}
-						}
-					}
+					else if (ReadValues(pfile, value, length, values))
+						sizes.insert(sizes.end(), values.begin(), values.end());
 				}
 				break;
 			case 0x011C://284, planar configuration
@@ -263,6 +235,7 @@ int LSMReader::Preprocess()
 					unsigned char* pdata = new unsigned char[length];
 					if (fread(pdata, sizeof(unsigned char), length, pfile) != length)
 					{
+						delete[]pdata;
 						fclose(pfile);
 						return READER_FORMAT_ERROR;
 					}
@@ -273,17 +246,12 @@ int LSMReader::Preprocess()
 				}
 				break;
 			}
-
-			//reset position
-			if (FSEEK64(pfile, cur_pos, SEEK_SET) != 0)
-			{
-				fclose(pfile);
-				return READER_FORMAT_ERROR;
-			}
 		}
 
 		//build lsm info, which contains all offset values and sizes
-		if (full_image)
+		if (full_image && m_slice_num > 0 &&
+			(int)offsets.size() >= m_chan_num &&
+			(int)sizes.size() >= m_chan_num)
 		{
 			int time = (cnt_image - 1) / m_slice_num;
 			if (time + 1 > (int)m_lsm_info.size())
@@ -309,11 +277,7 @@ int LSMReader::Preprocess()
 		}
 
 		//next image
-		if (fread(&ioffset, sizeof(unsigned int), 1, pfile) < 1)
-		{
-			fclose(pfile);
-			return READER_FORMAT_ERROR;
-		}
+		ioffset = *((unsigned int*)(&ifd[12 * entry_num]));
 		if (!ioffset)
 			break;
 	}
@@ -692,11 +656,12 @@ double LSMReader::GetExcitationWavelength(int chan)
 Nrrd* LSMReader::Convert(int t, int c, bool get_max)
 {
 	Nrrd *data = 0;
-	FILE* pfile = 0;
-	if (!WFOPEN(&pfile, m_path_name.c_str(), L"rb"))
-		return 0;
 
-	int i, j;
+	int bytes = 0;
+	if (m_datatype == 1)//8-bit
+		bytes = 1;
+	else if (m_datatype == 2 || m_datatype == 3)//16-bit
+		bytes = 2;
 
 	if (t >= 0 && t < m_time_num &&
 		c >= 0 && c < m_chan_num &&
@@ -704,86 +669,89 @@ Nrrd* LSMReader::Convert(int t, int c, bool get_max)
 		m_x_size > 0 &&
 		m_y_size > 0 &&
 		t < (int)m_lsm_info.size() &&
-		c < (int)m_lsm_info[t].size())
+		c < (int)m_lsm_info[t].size() &&
+		bytes)
 	{
+		//strips are decoded concurrently from the mapped file
+		//the file is read in order when it can't be mapped
+		MappedFile file;
+		FILE* pfile = 0;
+		if (!file.Open(m_path_name) &&
+			!WFOPEN(&pfile, m_path_name.c_str(), L"rb"))
+			return 0;
+		std::mutex file_mutex;
+
 		//allocate memory for nrrd
-		switch (m_datatype)
-		{
-		case 1://8-bit
+		unsigned long long mem_size = (unsigned long long)m_x_size*
+			(unsigned long long)m_y_size*(unsigned long long)m_slice_num;
+		void *val = 0;
+		if (bytes == 1)
+			val = new (std::nothrow) unsigned char[mem_size];
+		else
+			val = new (std::nothrow) unsigned short[mem_size];
+		size_t slice_size = (size_t)m_x_size*m_y_size*bytes;
+		ChannelInfo *cinfo = &m_lsm_info[t][c];
+		size_t slice_num = cinfo->size() < (size_t)m_slice_num ?
+			cinfo->size() : (size_t)m_slice_num;
+		if (val)
 		{
-			unsigned long long mem_size = (unsigned long long)m_x_size*
-				(unsigned long long)m_y_size*(unsigned long long)m_slice_num;
-			unsigned char *val = new (std::nothrow) unsigned char[mem_size];
-			ChannelInfo *cinfo = &m_lsm_info[t][c];
-			for (i = 0; i < (int)cinfo->size(); i++)
+			ParallelFetch(slice_num, [&](size_t i)
 			{
-				if (m_l4gb ?
-					FSEEK64(pfile, ((uint64_t((*cinfo)[i].offset_high)) << 32) + (*cinfo)[i].offset, SEEK_SET) == 0 :
-					FSEEK64(pfile, (*cinfo)[i].offset, SEEK_SET) == 0)
+				const SliceInfo &sinfo = (*cinfo)[i];
+				unsigned long long offset = m_l4gb ?
+					((unsigned long long)sinfo.offset_high << 32) + sinfo.offset :
+					sinfo.offset;
+				size_t size = sinfo.size;
+				const unsigned char* src = 0;
+				vector<unsigned char> strip;
+				if (file.IsOpen())
 				{
-					unsigned int val_pos = m_x_size*m_y_size*i;
-					if (m_compression == 1)
-						fread(val + val_pos, sizeof(unsigned char), (*cinfo)[i].size, pfile);
-					else if (m_compression == 5)
-					{
-						unsigned char* tif = new (std::nothrow) unsigned char[(*cinfo)[i].size];
-						fread(tif, sizeof(unsigned char), (*cinfo)[i].size, pfile);
-						LZWDecode(tif, val + val_pos, (*cinfo)[i].size);
-						for (j = 0; j < m_y_size; j++)
-							DecodeAcc8(val + val_pos + j*m_x_size, m_x_size, 1);
-						delete[]tif;
-					}
+					if (offset > file.GetSize() || size > file.GetSize() - offset)
+						return;
+					src = file.GetData() + offset;
 				}
-			}
-			//create nrrd
-			data = nrrdNew();
-			nrrdWrap(data, val, nrrdTypeUChar, 3, (size_t)m_x_size, (size_t)m_y_size, (size_t)m_slice_num);
-			nrrdAxisInfoSet(data, nrrdAxisInfoSpacing, m_xspc, m_yspc, m_zspc);
-			nrrdAxisInfoSet(data, nrrdAxisInfoMax, m_xspc*m_x_size, m_yspc*m_y_size, m_zspc*m_slice_num);
-			nrrdAxisInfoSet(data, nrrdAxisInfoMin, 0.0, 0.0, 0.0);
-			nrrdAxisInfoSet(data, nrrdAxisInfoSize, (size_t)m_x_size, (size_t)m_y_size, (size_t)m_slice_num);
-		}
-		break;
-		case 2://16-bit
-		case 3:
-		{
-			unsigned long long mem_size = (unsigned long long)m_x_size*
-				(unsigned long long)m_y_size*(unsigned long long)m_slice_num;
-			unsigned short *val = new (std::nothrow) unsigned short[mem_size];
-			ChannelInfo *cinfo = &m_lsm_info[t][c];
-			for (i = 0; i < (int)cinfo->size(); i++)
-			{
-				if (m_l4gb ?
-					FSEEK64(pfile, ((uint64_t((*cinfo)[i].offset_high)) << 32) + (*cinfo)[i].offset, SEEK_SET) == 0 :
-					FSEEK64(pfile, (*cinfo)[i].offset, SEEK_SET) == 0)
+				else
+				{
+					std::lock_guard<std::mutex> lock(file_mutex);
+					if (!size || FSEEK64(pfile, offset, SEEK_SET) != 0)
+						return;
+					strip.resize(size);
+					size = fread(&strip[0], sizeof(unsigned char), size, pfile);
+					src = &strip[0];
+				}
+
+				unsigned char* dst = (unsigned char*)val + slice_size*i;
+				if (m_compression == 1)
+					memcpy(dst, src, size < slice_size ? size : slice_size);
+				else if (m_compression == 5)
 				{
-					unsigned int val_pos = m_x_size*m_y_size*i;
-					if (m_compression == 1)
-						fread(val + val_pos, sizeof(unsigned char), (*cinfo)[i].size, pfile);
-					else if (m_compression == 5)
+					LZWDecode(src, size, dst, slice_size);
+					for (int j = 0; j < m_y_size; j++)
 					{
-						unsigned char* tif = new (std::nothrow) unsigned char[(*cinfo)[i].size];
-						fread(tif, sizeof(unsigned char), (*cinfo)[i].size, pfile);
-						LZWDecode(tif, (tidata_t)(val + val_pos), (*cinfo)[i].size);
-						for (j = 0; j < m_y_size; j++)
-							DecodeAcc16((tidata_t)(val + val_pos + j*m_x_size), m_x_size, 1);
-						delete[]tif;
+						if (bytes == 1)
+							DecodeAcc8(dst + j*m_x_size, m_x_size, 1);
+						else
+							DecodeAcc16((tidata_t)((unsigned short*)dst + j*m_x_size), m_x_size, 1);
 					}
 				}
-			}
-			//create nrrd
+			});
+		}
+		if (pfile)
+			fclose(pfile);
+
+		//create nrrd
+		if (val)
+		{
 			data = nrrdNew();
-			nrrdWrap(data, val, nrrdTypeUShort, 3, (size_t)m_x_size, (size_t)m_y_size, (size_t)m_slice_num);
+			nrrdWrap(data, val, bytes == 1 ? nrrdTypeUChar : nrrdTypeUShort, 3,
+				(size_t)m_x_size, (size_t)m_y_size, (size_t)m_slice_num);
 			nrrdAxisInfoSet(data, nrrdAxisInfoSpacing, m_xspc, m_yspc, m_zspc);
 			nrrdAxisInfoSet(data, nrrdAxisInfoMax, m_xspc*m_x_size, m_yspc*m_y_size, m_zspc*m_slice_num);
 			nrrdAxisInfoSet(data, nrrdAxisInfoMin, 0.0, 0.0, 0.0);
 			nrrdAxisInfoSet(data, nrrdAxisInfoSize, (size_t)m_x_size, (size_t)m_y_size, (size_t)m_slice_num);
 		}
-		break;
-		}
 	}
 
-	fclose(pfile);
 	m_cur_time = t;
 	return data;
 }
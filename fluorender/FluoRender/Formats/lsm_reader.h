@@ -123,6 +123,7 @@ private:
 	vector<WavelengthInfo> m_excitation_wavelength_list;
 
 private:
+	static bool ReadValues(FILE* pfile, unsigned int offset, unsigned int num, vector<unsigned int> &values);
 	void ReadLsmInfo(FILE* pfile, unsigned char* pdata, unsigned int size);
 
 };
@@ -0,0 +1,273 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+/*
+ * Copyright (c) 1988-1997 Sam Leffler
+ * Copyright (c) 1991-1997 Silicon Graphics, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+#include "lzw_codec.h"
+#include <cstring>
+#include <algorithm>
+
+#define LZW_BITS_MIN	9
+#define LZW_BITS_MAX	12
+#define LZW_CODE_CLEAR	256
+#define LZW_CODE_EOI	257
+#define LZW_CODE_FIRST	258
+#define LZW_TABLE_SIZE	(1 << LZW_BITS_MAX)
+
+//copy a string of earlier output, short ones in two 8-byte moves
+//the source always ends before op, only bytes past n may be garbage
+static inline void CopyString(unsigned char* op, const unsigned char* s,
+	size_t n, const unsigned char* oe)
+{
+	if (n <= 16 && oe - op >= 16)
+	{
+		unsigned long long a, b;
+		memcpy(&a, s, 8);
+		memcpy(op, &a, 8);
+		memcpy(&b, s + 8, 8);
+		memcpy(op + 8, &b, 8);
+	}
+	else
+		memcpy(op, s, n);
+}
+
+bool LZWCodec::Decode(const unsigned char* src, size_t src_size,
+	unsigned char* dst, size_t dst_size)
+{
+	//every string of the table is a run of earlier output
+	//so an entry is only its position and length in dst
+	size_t pos[LZW_TABLE_SIZE];
+	unsigned int len[LZW_TABLE_SIZE];
+
+	const unsigned char* sp = src;
+	const unsigned char* se = src + src_size;
+	unsigned char* op = dst;
+	unsigned char* oe = dst + dst_size;
+
+	unsigned long long nextdata = 0;
+	int nextbits = 0;
+	int nbits = LZW_BITS_MIN;
+	unsigned int nbitsmask = (1 << LZW_BITS_MIN) - 1;
+	unsigned int free_ent = LZW_CODE_FIRST;
+	//previous string
+	size_t prev_pos = 0;
+	size_t prev_len = 0;
+
+	while (op < oe)
+	{
+		//refill up to 7 bytes at a time
+		if (nextbits < nbits)
+		{
+			while (nextbits <= 56 && sp < se)
+			{
+				nextdata = (nextdata << 8) | *sp++;
+				nextbits += 8;
+			}
+			if (nextbits < nbits)
+				break;
+		}
+		unsigned int code = (unsigned int)(nextdata >> (nextbits - nbits)) & nbitsmask;
+		nextbits -= nbits;
+
+		if (code == LZW_CODE_EOI)
+			break;
+		if (code == LZW_CODE_CLEAR)
+		{
+			free_ent = LZW_CODE_FIRST;
+			nbits = LZW_BITS_MIN;
+			nbitsmask = (1 << LZW_BITS_MIN) - 1;
+			prev_len = 0;
+			continue;
+		}
+
+		size_t cur = op - dst;
+		size_t n;
+		if (code < 256)
+		{
+			*op++ = (unsigned char)code;
+			n = 1;
+		}
+		else if (code < free_ent)
+		{
+			n = len[code];
+			if (n > size_t(oe - op))
+			{
+				//partial string at the end of dst
+				memcpy(op, dst + pos[code], oe - op);
+				op = oe;
+				break;
+			}
+			CopyString(op, dst + pos[code], n, oe);
+			op += n;
+		}
+		else if (code == free_ent && prev_len)
+		{
+			//the previous string followed by its first byte
+			n = prev_len + 1;
+			if (n > size_t(oe - op))
+			{
+				memcpy(op, dst + prev_pos, oe - op);
+				op = oe;
+				break;
+			}
+			CopyString(op, dst + prev_pos, prev_len, oe);
+			op[prev_len] = dst[prev_pos];
+			op += n;
+		}
+		else
+			return false;
+
+		//new entry: previous string and the first byte of this one
+		if (prev_len && free_ent < LZW_TABLE_SIZE)
+		{
+			pos[free_ent] = prev_pos;
+			len[free_ent] = (unsigned int)(prev_len + 1);
+			free_ent++;
+			if (free_ent >= nbitsmask && nbits < LZW_BITS_MAX)
+			{
+				nbits++;
+				nbitsmask = (1 << nbits) - 1;
+			}
+		}
+		prev_pos = cur;
+		prev_len = n;
+	}
+
+	return op == oe;
+}
+
+void LZWCodec::Encode(const unsigned char* src, size_t size,
+	std::vector<unsigned char> &dst)
+{
+	//same code layout as libtiff
+	const int code_max = LZW_TABLE_SIZE - 1;
+	const int hshift = 5;
+	const int hsize = 9001;//prime, about 225% of the table
+
+	dst.clear();
+	dst.reserve(size / 2 + 16);
+	std::vector<int> hkey(hsize, -1);
+	std::vector<unsigned short> hcode(hsize);
+	int nbits = LZW_BITS_MIN;
+	int maxcode = (1 << nbits) - 1;
+	int free_ent = LZW_CODE_FIRST;
+	unsigned long nextdata = 0;
+	int nextbits = 0;
+	//codes are packed msb first
+	auto put = [&](int code)
+	{
+		nextdata = (nextdata << nbits) | code;
+		nextbits += nbits;
+		while (nextbits >= 8)
+		{
+			nextbits -= 8;
+			dst.push_back((unsigned char)(nextdata >> nextbits));
+		}
+	};
+
+	put(LZW_CODE_CLEAR);
+	if (size)
+	{
+		int ent = src[0];
+		for (size_t i = 1; i < size; ++i)
+		{
+			int c = src[i];
+			int key = (c << LZW_BITS_MAX) | ent;
+			int h = (c << hshift) ^ ent;
+			bool found = false;
+			while (hkey[h] != -1)
+			{
+				if (hkey[h] == key)
+				{
+					found = true;
+					break;
+				}
+				if (++h == hsize)
+					h = 0;
+			}
+			if (found)
+			{
+				ent = hcode[h];
+				continue;
+			}
+			put(ent);
+			ent = c;
+			hkey[h] = key;
+			hcode[h] = (unsigned short)(free_ent++);
+			if (free_ent == code_max - 1)
+			{
+				//table is full
+				std::fill(hkey.begin(), hkey.end(), -1);
+				put(LZW_CODE_CLEAR);
+				free_ent = LZW_CODE_FIRST;
+				nbits = LZW_BITS_MIN;
+				maxcode = (1 << nbits) - 1;
+			}
+			else if (free_ent > maxcode)
+			{
+				nbits++;
+				maxcode = (1 << nbits) - 1;
+			}
+		}
+		put(ent);
+		//the decoder adds one more entry after the last code
+		free_ent++;
+		if (free_ent == code_max - 1)
+		{
+			put(LZW_CODE_CLEAR);
+			nbits = LZW_BITS_MIN;
+		}
+		else if (free_ent > maxcode)
+			nbits++;
+	}
+	put(LZW_CODE_EOI);
+	if (nextbits > 0)
+		dst.push_back((unsigned char)(nextdata << (8 - nextbits)));
+}
@@ -0,0 +1,47 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#ifndef _LZW_CODEC_H_
+#define _LZW_CODEC_H_
+
+#include <vector>
+#include <cstddef>
+
+//tiff lzw (compression 5), codes are msb first with early change
+//the coder keeps no state between calls, so strips can be coded concurrently
+class LZWCodec
+{
+public:
+	//decode until eoi, the end of src or dst_size bytes
+	//returns true if dst is filled
+	static bool Decode(const unsigned char* src, size_t src_size,
+		unsigned char* dst, size_t dst_size);
+	static void Encode(const unsigned char* src, size_t size,
+		std::vector<unsigned char> &dst);
+};
+
+#endif//_LZW_CODEC_H_
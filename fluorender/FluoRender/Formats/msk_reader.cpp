@@ -118,15 +118,18 @@ Nrrd* MSKReader::Convert(int t, int c, bool get_max)
 	nrrdIoStateSet(nio, nrrdIoStateSkipData, AIR_TRUE);
 	if (nrrdRead(output, msk_file, nio))
 	{
+		nrrdIoStateNix(nio);
 		fclose(msk_file);
 		return 0;
 	}
-	nio = nrrdIoStateNix(nio);
+	//data follows the header
+	long data_offset = ftell(msk_file);
 	rewind(msk_file);
 	if (output->dim != 3 ||
 		(output->type != nrrdTypeChar &&
 		output->type != nrrdTypeUChar))
 	{
+		nrrdIoStateNix(nio);
 		nrrdNuke(output);
 		fclose(msk_file);
 		return 0;
@@ -134,10 +137,14 @@ Nrrd* MSKReader::Convert(int t, int c, bool get_max)
 	int slice_num = int(output->axis[2].size);
 	int x_size = int(output->axis[0].size);
 	int y_size = int(output->axis[1].size);
-	int data_size = slice_num * x_size * y_size;
+	size_t data_size = (size_t)slice_num * x_size * y_size;
 	output->data = new unsigned char[data_size];
 
-	if (nrrdRead(output, msk_file, NULL))
+	//mapped or block decoded when possible
+	bool read = ReadNrrdData(m_path_name, data_offset, output, nio,
+		[](size_t, size_t) {});
+	nrrdIoStateNix(nio);
+	if (!read && nrrdRead(output, msk_file, NULL))
 	{
 		nrrdNuke(output);
 		fclose(msk_file);
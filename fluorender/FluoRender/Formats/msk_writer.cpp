@@ -36,6 +36,8 @@ MSKWriter::MSKWriter()
 	m_spcy = 0.0;
 	m_spcz = 0.0;
 	m_use_spacings = false;
+	//masks and labels compress well
+	m_compression = true;
 	m_time = 0;
 	m_channel = 0;
 }
@@ -59,6 +61,7 @@ void MSKWriter::SetSpacings(double spcx, double spcy, double spcz)
 
 void MSKWriter::SetCompression(bool value)
 {
+	m_compression = value;
 }
 
 void MSKWriter::Save(wstring filename, int mode)
@@ -87,6 +90,12 @@ void MSKWriter::Save(wstring filename, int mode)
 			m_spcz*m_data->axis[2].size);
 	}
 
+	if (m_compression &&
+		SaveNrrdBlocks(filename, m_data))
+		return;
+
+	//stale block sizes would mislead the reader
+	nrrdKeyValueErase(m_data, NRRD_GZIP_BLOCK_KEY);
 	string str;
 	str.assign(filename.length(), 0);
 	for (int i=0; i<(int)filename.length(); i++)
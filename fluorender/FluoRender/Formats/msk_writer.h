@@ -47,6 +47,7 @@ private:
 	Nrrd* m_data;
 	double m_spcx, m_spcy, m_spcz;
 	bool m_use_spacings;
+	bool m_compression;
 
 	int m_time;
 	int m_channel;
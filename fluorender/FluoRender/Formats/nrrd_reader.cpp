@@ -26,9 +26,11 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
 #include "nrrd_reader.h"
+#include "lbl_reader.h"
 #include "../compatibility.h"
 #include <algorithm>
 #include <sstream>
+#include <mutex>
 
 NRRDReader::NRRDReader()
 {
@@ -231,25 +233,35 @@ Nrrd* NRRDReader::Convert(int t, int c, bool get_max)
 
 	wstring str_name = m_4d_seq[t].filename;
 	m_data_name = GET_NAME(str_name);
+	//run length coded labels have no nrrd header
+	Nrrd *output = LBLReader::ReadRLE(str_name);
 	FILE* nrrd_file = 0;
-	if (!WFOPEN(&nrrd_file, str_name.c_str(), L"rb"))
-		return 0;
-
-	Nrrd *output = nrrdNew();
-	NrrdIoState *nio = nrrdIoStateNew();
-	nrrdIoStateSet(nio, nrrdIoStateSkipData, AIR_TRUE);
-	if (nrrdRead(output, nrrd_file, nio))
-	{
-		fclose(nrrd_file);
-		return 0;
-	}
-	nio = nrrdIoStateNix(nio);
-	rewind(nrrd_file);
-	if (output->dim != 3)
+	NrrdIoState *nio = 0;
+	long data_offset = 0;
+	if (!output)
 	{
-		nrrdNuke(output);
-		fclose(nrrd_file);
-		return 0;
+		if (!WFOPEN(&nrrd_file, str_name.c_str(), L"rb"))
+			return 0;
+
+		output = nrrdNew();
+		nio = nrrdIoStateNew();
+		nrrdIoStateSet(nio, nrrdIoStateSkipData, AIR_TRUE);
+		if (nrrdRead(output, nrrd_file, nio))
+		{
+			nrrdIoStateNix(nio);
+			fclose(nrrd_file);
+			return 0;
+		}
+		//data follows the header
+		data_offset = ftell(nrrd_file);
+		rewind(nrrd_file);
+		if (output->dim != 3)
+		{
+			nrrdIoStateNix(nio);
+			nrrdNuke(output);
+			fclose(nrrd_file);
+			return 0;
+		}
 	}
 	m_slice_num = int(output->axis[2].size);
 	m_x_size = int(output->axis[0].size);
@@ -276,54 +288,86 @@ Nrrd* NRRDReader::Convert(int t, int c, bool get_max)
 	else if (output->type == nrrdTypeInt ||
 		output->type == nrrdTypeUInt)
 		data_size *= 4;
-	output->data = new unsigned char[data_size];
 
-	if (nrrdRead(output, nrrd_file, NULL))
+	//signed to unsigned conversion and min/max are done
+	//on each range as soon as it is read
+	int in_type = output->type;
+	unsigned short min_value = 0;
+	double max_value = 0.0;
+	if (!output->data)
 	{
-		nrrdNuke(output);
-		fclose(nrrd_file);
-		return 0;
-	}
+		output->data = new unsigned char[data_size];
 
-	m_max_value = 0.0;
-	// turn signed into unsigned
-	if (output->type == nrrdTypeChar)
-	{
-		for (unsigned long long idx=0; idx < nsize; ++idx)
-		{
-			char val = ((char*)output->data)[idx];
-			unsigned char n = val + 128;
-			((unsigned char*)output->data)[idx] = n;
-		}
-		output->type = nrrdTypeUChar;
-	}
-	// turn signed into unsigned
-	unsigned short min_value, n;
-	if (output->type == nrrdTypeShort)
-	{
-		min_value = 32768;
-		for (unsigned long long idx = 0; idx < nsize; ++idx)
+		std::mutex minmax_mutex;
+		auto convert = [&](size_t begin, size_t end)
 		{
-			short val = ((short*)output->data)[idx];
-			n = val + 32768;
-			((unsigned short*)output->data)[idx] = n;
-			min_value = (n < min_value) ? n : min_value;
-			if (get_max)
-				m_max_value = (n > m_max_value) ? n : m_max_value;
-		}
-		output->type = nrrdTypeUShort;
-	}
-	else if (output->type == nrrdTypeUShort)
-	{
-		min_value = 0;
-		for (unsigned long long idx = 0; idx < nsize; ++idx)
+			if (in_type == nrrdTypeChar)
+			{
+				for (size_t idx = begin; idx < end; ++idx)
+				{
+					char val = ((char*)output->data)[idx];
+					unsigned char n = val + 128;
+					((unsigned char*)output->data)[idx] = n;
+				}
+			}
+			else if (in_type == nrrdTypeShort)
+			{
+				unsigned short n, cmin = 32768, cmax = 0;
+				for (size_t idx = begin; idx < end; ++idx)
+				{
+					short val = ((short*)output->data)[idx];
+					n = val + 32768;
+					((unsigned short*)output->data)[idx] = n;
+					cmin = (n < cmin) ? n : cmin;
+					cmax = (n > cmax) ? n : cmax;
+				}
+				std::lock_guard<std::mutex> lock(minmax_mutex);
+				min_value = (cmin < min_value) ? cmin : min_value;
+				if (get_max)
+					max_value = (cmax > max_value) ? cmax : max_value;
+			}
+			else if (in_type == nrrdTypeUShort && get_max)
+			{
+				unsigned short n, cmax = 0;
+				for (size_t idx = begin; idx < end; ++idx)
+				{
+					n = ((unsigned short*)output->data)[idx];
+					cmax = (n > cmax) ? n : cmax;
+				}
+				std::lock_guard<std::mutex> lock(minmax_mutex);
+				max_value = (cmax > max_value) ? cmax : max_value;
+			}
+		};
+		if (in_type == nrrdTypeShort)
+			min_value = 32768;
+
+		if (!ReadNrrdData(str_name, data_offset, output, nio, convert))
 		{
-			n =  ((unsigned short*)output->data)[idx];
-			if (get_max)
-				m_max_value = (n > m_max_value)?n:m_max_value;
+			//let teem decode it
+			nrrdIoStateNix(nio);
+			nio = 0;
+			max_value = 0.0;
+			min_value = in_type == nrrdTypeShort ? 32768 : 0;
+			if (nrrdRead(output, nrrd_file, NULL))
+			{
+				nrrdNuke(output);
+				fclose(nrrd_file);
+				return 0;
+			}
+			convert(0, size_t(nsize));
 		}
 	}
+	if (nio)
+		nrrdIoStateNix(nio);
+
+	m_max_value = max_value;
+	unsigned short n;
+	if (in_type == nrrdTypeChar)
+		output->type = nrrdTypeUChar;
+	else if (in_type == nrrdTypeShort)
+		output->type = nrrdTypeUShort;
 	//compress int
+	//narrowed in place, which needs to go front to back
 	if (output->type == nrrdTypeInt)
 	{
 		min_value = 32768;
@@ -363,9 +407,18 @@ Nrrd* NRRDReader::Convert(int t, int c, bool get_max)
 	{
 		//16 bit
 		m_max_value -= min_value;
-		for (unsigned long long idx=0; idx < nsize; ++idx) {
-			((unsigned short*)output->data)[idx] =
-				((unsigned short*)output->data)[idx] - min_value;
+		if (min_value)
+		{
+			unsigned short* data = (unsigned short*)output->data;
+			size_t chunk = size_t(1) << 22;
+			ParallelFetch(size_t((nsize + chunk - 1) / chunk), [&](size_t i)
+			{
+				size_t end = (i + 1) * chunk;
+				if (end > nsize)
+					end = size_t(nsize);
+				for (size_t idx = i * chunk; idx < end; ++idx)
+					data[idx] -= min_value;
+			});
 		}
 		if (m_max_value > 0.0)
 			m_scalar_scale = 65535.0 / m_max_value;
@@ -375,12 +428,14 @@ Nrrd* NRRDReader::Convert(int t, int c, bool get_max)
 	else
 	{
 		nrrdNuke(output);
-		fclose(nrrd_file);
+		if (nrrd_file)
+			fclose(nrrd_file);
 		return 0;
 	}
 
 	m_cur_time = t;
-	fclose(nrrd_file);
+	if (nrrd_file)
+		fclose(nrrd_file);
 	return output;
 }
 
@@ -34,6 +34,7 @@ NRRDWriter::NRRDWriter()
    m_spcy = 0.0;
    m_spcz = 0.0;
    m_use_spacings = false;
+   m_compression = false;
 }
 
 NRRDWriter::~NRRDWriter()
@@ -55,6 +56,7 @@ void NRRDWriter::SetSpacings(double spcx, double spcy, double spcz)
 
 void NRRDWriter::SetCompression(bool value)
 {
+   m_compression = value;
 }
 
 void NRRDWriter::Save(wstring filename, int mode)
@@ -72,6 +74,12 @@ void NRRDWriter::Save(wstring filename, int mode)
             m_spcz*m_data->axis[2].size);
    }
 
+   if (m_compression &&
+      SaveNrrdBlocks(filename, m_data))
+      return;
+
+   //stale block sizes would mislead the reader
+   nrrdKeyValueErase(m_data, NRRD_GZIP_BLOCK_KEY);
    string str;
    str.assign(filename.length(), 0);
    for (int i=0; i<(int)filename.length(); i++)
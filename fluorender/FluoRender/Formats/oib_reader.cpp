@@ -28,6 +28,8 @@ DEALINGS IN THE SOFTWARE.
 #include "oib_reader.h"
 #include "../compatibility.h"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 OIBReader::OIBReader()
 {
@@ -52,10 +54,13 @@ OIBReader::OIBReader()
 	m_time_id = L"_T";
 	m_type = 0;
 	m_oib_t = 0;
+
+	m_storage = 0;
 }
 
 OIBReader::~OIBReader()
 {
+	CloseStorage();
 }
 
 void OIBReader::SetFile(string &file)
@@ -145,28 +150,53 @@ bool OIBReader::oib_sort(const TimeDataInfo& info1, const TimeDataInfo& info2)
 void OIBReader::ReadSingleOib()
 {
 	//read the current file info
-	//storage
-	//use POLE's own function to convert string from wstring
-	POLE::Storage pStg(ws2s(m_path_name).c_str());
-	//open
-	if (pStg.open()) {
+	POLE::Storage* pStg = GetStorage(m_path_name);
+	if (!pStg)
+		return;
+	//enumerate
+	std::list<std::string> entries =
+		pStg->entries();
+	for (std::list<std::string>::iterator it = entries.begin();
+	it != entries.end(); ++it) {
+		if (!pStg->isDirectory(*it)) {
+			vector<unsigned char> data;
+			if (ReadStreamData(*pStg, *it, data))
+			{
+				std::wstring st = s2ws(*it);
+				ReadStream(st, data);
+			}
+		}
+	}
+}
+
+void OIBReader::ReadSequenceOib()
+{
+	//the info streams of each file are extracted concurrently
+	//and interpreted in order
+	typedef vector<pair<string, vector<unsigned char>>> StreamList;
+	vector<StreamList> file_streams(m_oib_info.size());
+	ParallelFetch(m_oib_info.size(), [&](size_t i)
+	{
+		//storage
+		POLE::Storage pStg(ws2s(m_oib_info[i].filename).c_str());
+		//open
+		if (!pStg.open())
+			return;
 		//enumerate
 		std::list<std::string> entries =
 			pStg.entries();
 		for (std::list<std::string>::iterator it = entries.begin();
 		it != entries.end(); ++it) {
 			if (!pStg.isDirectory(*it)) {
-				std::wstring st = s2ws(*it);
-				ReadStream(pStg, st);
+				file_streams[i].push_back(make_pair(*it, vector<unsigned char>()));
+				if (!ReadStreamData(pStg, *it, file_streams[i].back().second))
+					file_streams[i].pop_back();
 			}
 		}
-	}
-	//release
-	pStg.close();
-}
+		//release
+		pStg.close();
+	});
 
-void OIBReader::ReadSequenceOib()
-{
 	for (int i = 0; i < (int)m_oib_info.size(); i++)
 	{
 		wstring path_name = m_oib_info[i].filename;
@@ -174,24 +204,13 @@ void OIBReader::ReadSequenceOib()
 		if (path_name == m_path_name)
 			m_cur_time = i;
 
-		//storage
-		POLE::Storage pStg("temp_storage.txt");
-		//open
-		if (pStg.open()) {
-			//enumerate
-			std::list<std::string> entries =
-				pStg.entries();
-			for (std::list<std::string>::iterator it = entries.begin();
-			it != entries.end(); ++it) {
-				m_oib_t = i;
-				if (!pStg.isDirectory(*it)) {
-					std::wstring st = s2ws(*it);
-					ReadStream(pStg, st);
-				}
-			}
+		m_oib_t = i;
+		for (size_t j = 0; j < file_streams[i].size(); j++)
+		{
+			std::wstring st = s2ws(file_streams[i][j].first);
+			ReadStream(st, file_streams[i][j].second);
 		}
-		//release
-		pStg.close();
+		StreamList().swap(file_streams[i]);
 	}
 }
 
@@ -264,35 +283,64 @@ int OIBReader::LoadBatch(int index)
 	return result;
 }
 
-void OIBReader::ReadStream(POLE::Storage &pStg, wstring &stream_name)
+POLE::Storage* OIBReader::GetStorage(const wstring &path_name)
 {
-	POLE::Stream pStm(&pStg, ws2s(stream_name));
-	unsigned char *pbyData = 0;
+	if (m_storage && m_storage_name == path_name)
+		return m_storage;
 
-	//open
-	if (!pStm.eof() && !pStm.fail())
+	CloseStorage();
+	//use POLE's own function to convert string from wstring
+	POLE::Storage* pStg = new POLE::Storage(ws2s(path_name).c_str());
+	if (!pStg->open())
 	{
-		//get stream size
-		size_t sz = pStm.size();
-		//allocate 
-		pbyData = new unsigned char[sz];
-		if (!pbyData) return;
-		//read
-		if (pStm.read(pbyData, sz)) {
-			//read oib info
-			if (stream_name == wstring(L"OibInfo.txt")) {
-				ReadOibInfo(pbyData, sz);
-			}
-			else {
-				if (m_type == 0 || (m_type == 1 && m_oib_t == 0))
-					ReadOif(pbyData, sz);
-			}
-		}
+		delete pStg;
+		return 0;
 	}
+	m_storage = pStg;
+	m_storage_name = path_name;
+	return m_storage;
+}
+
+void OIBReader::CloseStorage()
+{
+	if (m_storage)
+	{
+		m_storage->close();
+		delete m_storage;
+		m_storage = 0;
+	}
+	m_storage_name.clear();
+}
+
+bool OIBReader::ReadStreamData(POLE::Storage &pStg, const string &stream_name, vector<unsigned char> &data)
+{
+	POLE::Stream pStm(&pStg, stream_name);
 
-	//release
-	if (pbyData)
-		delete[] pbyData;
+	//open
+	if (pStm.eof() || pStm.fail())
+		return false;
+	//get stream size
+	size_t sz = pStm.size();
+	if (!sz)
+		return false;
+	//read
+	data.resize(sz);
+	return pStm.read(&data[0], sz) > 0;
+}
+
+void OIBReader::ReadStream(wstring &stream_name, vector<unsigned char> &data)
+{
+	if (data.empty())
+		return;
+
+	//read oib info
+	if (stream_name == wstring(L"OibInfo.txt")) {
+		ReadOibInfo(&data[0], data.size());
+	}
+	else {
+		if (m_type == 0 || (m_type == 1 && m_oib_t == 0))
+			ReadOif(&data[0], data.size());
+	}
 }
 
 void OIBReader::ReadOibInfo(unsigned char* pbyData, size_t size)
@@ -697,83 +745,97 @@ Nrrd *OIBReader::Convert(int t, int c, bool get_max)
 		m_x_size > 0 &&
 		m_y_size > 0)
 	{
-		unsigned char *pbyData = 0;
 		wstring path_name = m_type == 0 ? m_path_name : m_oib_info[t].filename;
 		//storage
-		POLE::Storage pStg(ws2s(path_name).c_str());
-		//open
-		if (pStg.open()) {
-			//allocate memory for nrrd
-			unsigned long long mem_size = (unsigned long long)m_x_size*
-				(unsigned long long)m_y_size*(unsigned long long)m_slice_num;
-			unsigned short *val = new (std::nothrow) unsigned short[mem_size];
-			//enumerate
+		POLE::Storage* pStg = GetStorage(path_name);
+		//allocate memory for nrrd
+		unsigned long long mem_size = (unsigned long long)m_x_size*
+			(unsigned long long)m_y_size*(unsigned long long)m_slice_num;
+		unsigned short *val = pStg ?
+			new (std::nothrow) unsigned short[mem_size] : 0;
+		if (val) {
+			//list the slice streams
+			ChannelInfo *cinfo = &m_oib_info[t].dataset[c];
+			vector<pair<string, int>> slices;
 			std::list<std::string> entries =
-				pStg.entries();
+				pStg->entries();
 			for (std::list<std::string>::iterator it = entries.begin();
 			it != entries.end(); ++it) {
-				if (pStg.isDirectory(*it)) {
-					std::list<std::string> streams = pStg.GetAllStreams(*it);
+				if (pStg->isDirectory(*it)) {
+					std::list<std::string> streams = pStg->GetAllStreams(*it);
 					size_t num = 0;
-					ChannelInfo *cinfo = &m_oib_info[t].dataset[c];
 					for (std::list<std::string>::iterator its = streams.begin();
 					its != streams.end(); ++its) {
 						if (num >= cinfo->size()) break;
 						//fix the stream name
 						std::string str_name = ws2s((*cinfo)[num].stream_name);
 						std::string name = (*it) + std::string("/") + str_name;
-
-						POLE::Stream pStm(&pStg, name);
-
-						//open
-						if (!pStm.eof() && !pStm.fail())
-						{
-							//get stream size
-							size_t sz = pStm.size();
-							//allocate 
-							pbyData = new unsigned char[sz];
-							if (!pbyData)
-								return NULL;
-							//read
-							if (pStm.read(pbyData, sz)) {
-
-								//copy tiff to val
-								ReadTiff(pbyData, val, num);
-
-								//increase
-								sl_num++;
-							}
-						}
-
-						//release
-						if (pbyData)
-							delete[] pbyData;
+						slices.push_back(make_pair(name, int(num)));
 						num++;
 					}
 				}
 			}
 
-			//create nrrd
-			if (val && sl_num == m_slice_num)
+			//the storage can't be shared between threads
+			//streams are extracted in order, in batches bounded by size,
+			//and each batch is decoded concurrently
+			const size_t batch_size = 64 << 20;
+			std::atomic<int> read_num(0);
+			std::mutex max_mutex;
+			size_t si = 0;
+			while (si < slices.size())
 			{
-				//ok
-				data = nrrdNew();
-				nrrdWrap(data, val, nrrdTypeUShort, 3, (size_t)m_x_size, (size_t)m_y_size,
-					(size_t)m_slice_num);
-				nrrdAxisInfoSet(data, nrrdAxisInfoSpacing, m_xspc, m_yspc, m_zspc);
-				nrrdAxisInfoSet(data, nrrdAxisInfoMax, m_xspc*m_x_size, m_yspc*m_y_size,
-					m_zspc*m_slice_num);
-				nrrdAxisInfoSet(data, nrrdAxisInfoMin, 0.0, 0.0, 0.0);
-				nrrdAxisInfoSet(data, nrrdAxisInfoSize, (size_t)m_x_size,
-					(size_t)m_y_size, (size_t)m_slice_num);
-			}
-			else {
-				//something is wrong
-				if (val)
-					delete[]val;
+				vector<vector<unsigned char>> batch;
+				vector<int> batch_z;
+				size_t bytes = 0;
+				while (si < slices.size() && bytes < batch_size)
+				{
+					batch.push_back(vector<unsigned char>());
+					batch_z.push_back(slices[si].second);
+					if (ReadStreamData(*pStg, slices[si].first, batch.back()))
+						bytes += batch.back().size();
+					si++;
+				}
+
+				ParallelFetch(batch.size(), [&](size_t i)
+				{
+					if (batch[i].size() < 8)
+						return;
+
+					//copy tiff to val
+					double max_value = ReadTiff(&batch[i][0], val, batch_z[i]);
+					if (max_value > 0.0)
+					{
+						std::lock_guard<std::mutex> lock(max_mutex);
+						if (max_value > m_max_value)
+							m_max_value = max_value;
+					}
+
+					//increase
+					read_num++;
+				});
 			}
-			//release
-			pStg.close();
+			sl_num = read_num;
+		}
+
+		//create nrrd
+		if (val && sl_num == m_slice_num)
+		{
+			//ok
+			data = nrrdNew();
+			nrrdWrap(data, val, nrrdTypeUShort, 3, (size_t)m_x_size, (size_t)m_y_size,
+				(size_t)m_slice_num);
+			nrrdAxisInfoSet(data, nrrdAxisInfoSpacing, m_xspc, m_yspc, m_zspc);
+			nrrdAxisInfoSet(data, nrrdAxisInfoMax, m_xspc*m_x_size, m_yspc*m_y_size,
+				m_zspc*m_slice_num);
+			nrrdAxisInfoSet(data, nrrdAxisInfoMin, 0.0, 0.0, 0.0);
+			nrrdAxisInfoSet(data, nrrdAxisInfoSize, (size_t)m_x_size,
+				(size_t)m_y_size, (size_t)m_slice_num);
+		}
+		else {
+			//something is wrong
+			if (val)
+				delete[]val;
 		}
 	}
 
@@ -837,10 +899,11 @@ wstring OIBReader::GetCurLabelName(int t, int c)
 	}
 }
 
-void OIBReader::ReadTiff(unsigned char *pbyData, unsigned short *val, int z)
+double OIBReader::ReadTiff(unsigned char *pbyData, unsigned short *val, int z)
 {
+	double max_value = 0.0;
 	if (*((unsigned int*)pbyData) != 0x002A4949)
-		return;
+		return max_value;
 
 	int compression = 0;
 	unsigned int offset = 0;
@@ -945,8 +1008,8 @@ void OIBReader::ReadTiff(unsigned char *pbyData, unsigned short *val, int z)
 		{
 			unsigned short value;
 			value = *((unsigned short*)(pbyData + offset + 2 + 12 * i + 8));
-			if ((double)value > m_max_value)
-				m_max_value = (double)value;
+			if ((double)value > max_value)
+				max_value = (double)value;
 		}
 		break;
 		}
@@ -959,15 +1022,19 @@ void OIBReader::ReadTiff(unsigned char *pbyData, unsigned short *val, int z)
 		strips = s_num1;
 
 		unsigned int val_pos = z*m_x_size*m_y_size;
+		unsigned int val_end = val_pos + m_x_size*m_y_size;
 		for (int i = 0; i < strips; i++)
 		{
 			unsigned int data_pos = strip_offsets[i];
 			unsigned int data_size = strip_bytes[i];
 			if (compression == 1)//no copmression
 				memcpy((void*)(val + val_pos), (void*)(pbyData + data_pos), data_size);
-			else if (compression == 5)
-				LZWDecode((tidata_t)(pbyData + data_pos), (tidata_t)(val + val_pos), m_x_size*rows * 2);
+			else if (compression == 5 && val_pos < val_end)
+				LZWDecode(pbyData + data_pos, data_size, (unsigned char*)(val + val_pos),
+					(rows*m_x_size < val_end - val_pos ? rows*m_x_size : val_end - val_pos) * 2);
 			val_pos += rows*m_x_size;
 		}
 	}
+
+	return max_value;
 }
@@ -129,14 +129,21 @@ class OIBReader : public BaseReader
       //time sequence id
       wstring m_time_id;
 
+      //the compound document stays open, so its directory is only parsed once
+      POLE::Storage* m_storage;
+      wstring m_storage_name;
+
    private:
       static bool oib_sort(const TimeDataInfo& info1, const TimeDataInfo& info2);
       void ReadSingleOib();
       void ReadSequenceOib();
-	void ReadStream(POLE::Storage &pStg, wstring &stream_name);
+	POLE::Storage* GetStorage(const wstring &path_name);
+	void CloseStorage();
+	static bool ReadStreamData(POLE::Storage &pStg, const string &stream_name, vector<unsigned char> &data);
+	void ReadStream(wstring &stream_name, vector<unsigned char> &data);
 	void ReadOibInfo(unsigned char* pbyData, size_t size);
 	void ReadOif(unsigned char* pbyData, size_t size);
-	void ReadTiff(unsigned char* pbyData, unsigned short *val, int z);
+	double ReadTiff(unsigned char* pbyData, unsigned short *val, int z);
 };
 
 #endif//_OIB_READER_H_
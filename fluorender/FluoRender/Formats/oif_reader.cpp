@@ -28,6 +28,8 @@ DEALINGS IN THE SOFTWARE.
 #include "oif_reader.h"
 #include "../compatibility.h"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 OIFReader::OIFReader()
 {
@@ -391,7 +393,7 @@ void OIFReader::ReadOif()
 
 		while (!is.eof())
 		{
-			wchar_t c;
+			wchar_t c = 0;
 			is.read(((char*)(&c)), 1);
 			if (!is.eof())
 				is.read(((char*)(&c)) + 1, 1);
@@ -609,39 +611,33 @@ Nrrd* OIFReader::Convert(int t, int c, bool get_max)
 		unsigned short *val = new (std::nothrow) unsigned short[mem_size];
 
 		//read the channel
+		//slice files are fetched and decoded concurrently
 		ChannelInfo *cinfo = &m_oif_info[t].dataset[c];
-		int i;
-		for (i = 0; i<int(cinfo->size()); i++)
+		std::atomic<int> read_num(0);
+		std::mutex max_mutex;
+		if (val)
 		{
-			char *pbyData = 0;
-			wstring file_name = (*cinfo)[i];
-
-			//open file
-			ifstream is;
-#ifdef _WIN32
-			is.open(file_name.c_str(), ios::binary);
-#else
-			is.open(ws2s(file_name).c_str(), ios::binary);
-#endif
-			if (is.is_open())
+			ParallelFetch(cinfo->size(), [&](size_t i)
 			{
-				is.seekg(0, ios::end);
-				size_t size = is.tellg();
-				pbyData = new char[size];
-				is.seekg(0, ios::beg);
-				is.read(pbyData, size);
-				is.close();
+				vector<char> file_data;
+				if (!ReadFileData((*cinfo)[i], file_data) ||
+					file_data.size() < 8)
+					return;
 
 				//read
-				ReadTiff(pbyData, val, i);
+				double max_value = ReadTiff(&file_data[0], val, int(i));
+				if (max_value > 0.0)
+				{
+					std::lock_guard<std::mutex> lock(max_mutex);
+					if (max_value > m_max_value)
+						m_max_value = max_value;
+				}
 
 				//increase
-				sl_num++;
-			}
-
-			if (pbyData)
-				delete[]pbyData;
+				read_num++;
+			});
 		}
+		sl_num = read_num;
 
 		//create nrrd
 		if (val && sl_num == m_slice_num)
@@ -688,10 +684,11 @@ wstring OIFReader::GetCurLabelName(int t, int c)
 	return label_name;
 }
 
-void OIFReader::ReadTiff(char *pbyData, unsigned short *val, int z)
+double OIFReader::ReadTiff(char *pbyData, unsigned short *val, int z)
 {
+	double max_value = 0.0;
 	if (*((unsigned int*)pbyData) != 0x002A4949)
-		return;
+		return max_value;
 
 	int compression = 0;
 	unsigned int offset = 0;
@@ -796,8 +793,8 @@ void OIFReader::ReadTiff(char *pbyData, unsigned short *val, int z)
 		{
 			unsigned short value;
 			value = *((unsigned short*)(pbyData + offset + 2 + 12 * i + 8));
-			if ((double)value > m_max_value)
-				m_max_value = (double)value;
+			if ((double)value > max_value)
+				max_value = (double)value;
 		}
 		break;
 		}
@@ -810,15 +807,18 @@ void OIFReader::ReadTiff(char *pbyData, unsigned short *val, int z)
 		strips = s_num1;
 
 		unsigned int val_pos = z*m_x_size*m_y_size;
+		unsigned int val_end = val_pos + m_x_size*m_y_size;
 		for (int i = 0; i < strips; i++)
 		{
 			unsigned int data_pos = strip_offsets[i];
 			unsigned int data_size = strip_bytes[i];
 			if (compression == 1)//no copmression
 				memcpy((void*)(val + val_pos), (void*)(pbyData + data_pos), data_size);
-			else if (compression == 5)
-				LZWDecode((tidata_t)(pbyData + data_pos), (tidata_t)(val + val_pos), m_x_size*rows * 2);
+			else if (compression == 5 && val_pos < val_end)
+				LZWDecode((unsigned char*)(pbyData + data_pos), data_size, (unsigned char*)(val + val_pos),
+					(rows*m_x_size < val_end - val_pos ? rows*m_x_size : val_end - val_pos) * 2);
 			val_pos += rows*m_x_size;
 		}
 	}
+	return max_value;
 }
@@ -127,7 +127,8 @@ private:
 	void ReadTifSequence(wstring file_name, int t=0);
 	void ReadOif();
 	void ReadOifLine(wstring oneline);
-	void ReadTiff(char* pbyData, unsigned short *val, int z);
+	//returns the max sample value in the tags
+	double ReadTiff(char* pbyData, unsigned short *val, int z);
 
 	//axis count
 	int axis_num;
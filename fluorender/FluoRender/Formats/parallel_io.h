@@ -0,0 +1,62 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#ifndef _PARALLEL_IO_H_
+#define _PARALLEL_IO_H_
+
+#include <functional>
+#include <cstddef>
+
+//nrrd key listing the gzip members of block compressed data
+//value: uncompressed block size, followed by the compressed size of each block
+//written by BaseWriter and read by BaseReader
+#define NRRD_GZIP_BLOCK_KEY "fluorender_gzip_blocks"
+
+//thread pool shared by file reading and writing
+class ParallelIO
+{
+public:
+	//number of threads used for file reading and writing
+	//0 uses all available cores; 1 runs everything on the calling thread
+	static void SetThreadNum(int num)
+	{
+		m_thread_num = num < 0 ? 0 : num;
+	}
+	static int GetThreadNum()
+	{
+		return m_thread_num;
+	}
+
+	//run func(i) for i in [0, num) on at most the set number of threads
+	//the first exception thrown by func is rethrown to the caller
+	static void Run(size_t num, const std::function<void(size_t)> &func);
+
+private:
+	static int m_thread_num;
+};
+
+#endif//_PARALLEL_IO_H_
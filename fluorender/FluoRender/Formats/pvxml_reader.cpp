@@ -30,6 +30,8 @@ DEALINGS IN THE SOFTWARE.
 #include "../compatibility.h"
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 
 PVXMLReader::PVXMLReader()
 {
@@ -700,145 +702,107 @@ double PVXMLReader::GetExcitationWavelength(int chan)
 
 bool PVXMLReader::ConvertN(int c, TimeDataInfo* time_data_info, unsigned short *val)
 {
-	int i, j, k;
-	for (i=0; i<(int)time_data_info->size(); i++)
+	vector<FrameInfo*> frames;
+	for (size_t i=0; i<time_data_info->size(); i++)
 	{
 		SequenceInfo* sequence_info = &((*time_data_info)[i]);
-		for (j=0; j<(int)sequence_info->frames.size(); j++)
+		for (size_t j=0; j<sequence_info->frames.size(); j++)
 		{
 			FrameInfo *frame_info = &((sequence_info->frames)[j]);
-
 			if ((size_t)c >= frame_info->channels.size())
 				continue;
-
-			unsigned long long frame_size = (unsigned long long)(frame_info->x_size) *
-				(unsigned long long)(frame_info->y_size);
-			unsigned short *frame_val = new (std::nothrow) unsigned short[frame_size];
-			if (!val) return 0;
-
-			char *pbyData = 0;
-			wstring file_name = frame_info->channels[c].file_name;
-
-			//open file
-			ifstream is;
-#ifdef _WIN32
-			is.open(file_name.c_str(), ios::binary);
-#else
-			is.open(ws2s(file_name).c_str(), ios::binary);
-#endif
-			if (is.is_open())
-			{
-				is.seekg(0, ios::end);
-				size_t size = is.tellg();
-				pbyData = new char[size];
-				is.seekg(0, ios::beg);
-				is.read(pbyData, size);
-				is.close();
-
-				//read
-				ReadTiff(pbyData, frame_val);
-
-				if (pbyData)
-					delete []pbyData;
-
-				//copy frame val to val
-				unsigned long long index = (unsigned long long)m_x_size*m_y_size*frame_info->z + m_x_size*(m_y_size-frame_info->y-frame_info->y_size) + frame_info->x;
-				long frame_index = 0;
-				if (m_flip_y)
-					frame_index = frame_info->x_size * (frame_info->y_size-1);
-				for (k=0; k<frame_info->y_size; k++)
-				{
-					memcpy((void*)(val+index), (void*)(frame_val+frame_index), frame_info->x_size*sizeof(unsigned short));
-					index += m_x_size;
-					if (m_flip_y)
-						frame_index -= frame_info->x_size;
-					else
-						frame_index += frame_info->x_size;
-				}
-			}
-
-			if (frame_val)
-				delete []frame_val;
+			frames.push_back(frame_info);
 		}
 	}
 
+	FetchFrames(frames, c, val);
 	return true;
 }
 
 bool PVXMLReader::ConvertS(int c, TimeDataInfo* time_data_info, unsigned short *val)
 {
 	int cur_chan = 0;
-	size_t i, j, k;
-	for (i=0; i<time_data_info->size(); ++i)
+	vector<FrameInfo*> frames;
+	int index = 0;
+	for (size_t i=0; i<time_data_info->size(); ++i)
 	{
 		if (c>=cur_chan && c<cur_chan+m_chan_num)
 		{
-			int index = c - cur_chan;
+			index = c - cur_chan;
 			SequenceInfo* sequence_info = &((*time_data_info)[i]);
 
-			for (j=0; j<(int)sequence_info->frames.size(); j++)
+			for (size_t j=0; j<sequence_info->frames.size(); j++)
 			{
 				FrameInfo *frame_info = &((sequence_info->frames)[j]);
 				if ((size_t)index >= frame_info->channels.size())
 					continue;
-
-				unsigned long long frame_size = (unsigned long long)(frame_info->x_size) *
-					(unsigned long long)(frame_info->y_size);
-				unsigned short *frame_val = new (std::nothrow) unsigned short[frame_size];
-				if (!val) return 0;
-
-				char *pbyData = 0;
-				wstring file_name = frame_info->channels[index].file_name;
-
-				//open file
-				ifstream is;
-#ifdef _WIN32
-				is.open(file_name.c_str(), ios::binary);
-#else
-				is.open(ws2s(file_name).c_str(), ios::binary);
-#endif
-				if (is.is_open())
-				{
-					is.seekg(0, ios::end);
-					size_t size = is.tellg();
-					pbyData = new char[size];
-					is.seekg(0, ios::beg);
-					is.read(pbyData, size);
-					is.close();
-
-					//read
-					ReadTiff(pbyData, frame_val);
-
-					if (pbyData)
-						delete []pbyData;
-
-					//copy frame val to val
-					unsigned long long index = (unsigned long long)m_x_size*m_y_size*frame_info->z + m_x_size*(m_y_size-frame_info->y-frame_info->y_size) + frame_info->x;
-					long frame_index = 0;
-					if (m_flip_y)
-						frame_index = frame_info->x_size * (frame_info->y_size-1);
-					for (k=0; k<frame_info->y_size; k++)
-					{
-						memcpy((void*)(val+index), (void*)(frame_val+frame_index), frame_info->x_size*sizeof(unsigned short));
-						index += m_x_size;
-						if (m_flip_y)
-							frame_index -= frame_info->x_size;
-						else
-							frame_index += frame_info->x_size;
-					}
-				}
-
-				if (frame_val)
-					delete []frame_val;
+				frames.push_back(frame_info);
 			}
 
 			break;
 		}
 		cur_chan += m_chan_num;
 	}
+
+	FetchFrames(frames, index, val);
 	return true;
 }
 
+void PVXMLReader::FetchFrames(vector<FrameInfo*> &frames, int chan, unsigned short *val)
+{
+	//tiles of the same slice may overlap, keep their order in one task
+	map<int, vector<FrameInfo*>> slice_map;
+	for (size_t i=0; i<frames.size(); ++i)
+		slice_map[frames[i]->z].push_back(frames[i]);
+	vector<vector<FrameInfo*>*> slices;
+	for (auto it=slice_map.begin(); it!=slice_map.end(); ++it)
+		slices.push_back(&(it->second));
+
+	std::mutex max_mutex;
+	ParallelFetch(slices.size(), [&](size_t si)
+	{
+		vector<char> file_data;
+		vector<FrameInfo*> &slice = *(slices[si]);
+		for (size_t j=0; j<slice.size(); ++j)
+		{
+			FrameInfo *frame_info = slice[j];
+			unsigned long long frame_size = (unsigned long long)(frame_info->x_size) *
+				(unsigned long long)(frame_info->y_size);
+			if (!frame_size)
+				continue;
+			vector<unsigned short> frame_val(frame_size);
+
+			if (!ReadFileData(frame_info->channels[chan].file_name, file_data) ||
+				file_data.size() < 8)
+				continue;
+
+			//read
+			double max_value = ReadTiff(&file_data[0], &frame_val[0], frame_val.size());
+			if (max_value > 0.0)
+			{
+				std::lock_guard<std::mutex> lock(max_mutex);
+				if (max_value > m_max_value)
+					m_max_value = max_value;
+			}
+
+			//copy frame val to val
+			unsigned long long index = (unsigned long long)m_x_size*m_y_size*frame_info->z + m_x_size*(m_y_size-frame_info->y-frame_info->y_size) + frame_info->x;
+			long frame_index = 0;
+			if (m_flip_y)
+				frame_index = frame_info->x_size * (frame_info->y_size-1);
+			for (int k=0; k<frame_info->y_size; k++)
+			{
+				memcpy((void*)(val+index), (void*)(&frame_val[0]+frame_index), frame_info->x_size*sizeof(unsigned short));
+				index += m_x_size;
+				if (m_flip_y)
+					frame_index -= frame_info->x_size;
+				else
+					frame_index += frame_info->x_size;
+			}
+		}
+	});
+}
+
 Nrrd *PVXMLReader::Convert(int t, int c, bool get_max)
 {
 	Nrrd *data = 0;
@@ -898,10 +862,11 @@ Nrrd *PVXMLReader::Convert(int t, int c, bool get_max)
 	return data;
 }
 
-void PVXMLReader::ReadTiff(char *pbyData, unsigned short *val)
+double PVXMLReader::ReadTiff(char *pbyData, unsigned short *val, size_t val_size)
 {
+	double max_value = 0.0;
 	if (*((unsigned int*)pbyData) != 0x002A4949)
-		return;
+		return max_value;
 
 	int compression = 0;
 	unsigned int offset = 0;
@@ -1040,8 +1005,8 @@ void PVXMLReader::ReadTiff(char *pbyData, unsigned short *val)
 			{
 				unsigned short value;
 				value = *((unsigned short*)(pbyData+offset+2+12*i+8));
-				if ((double)value > m_max_value)
-					m_max_value = (double)value;
+				if ((double)value > max_value)
+					max_value = (double)value;
 			}
 			break;
 		}
@@ -1053,18 +1018,20 @@ void PVXMLReader::ReadTiff(char *pbyData, unsigned short *val)
 	{
 		strips = s_num1;
 
-		unsigned int val_pos = 0;
+		size_t val_pos = 0;
 		for (int i=0; i<strips; i++)
 		{
 			unsigned int data_pos = strip_offsets[i];
 			unsigned int data_size = strip_bytes[i];
 			if (compression == 1)//no copmression
 				memcpy((void*)(val+val_pos), (void*)(pbyData+data_pos), data_size);
-			else if (compression == 5)
-				LZWDecode((tidata_t)(pbyData+data_pos), (tidata_t)(val+val_pos), m_x_size*rows*2);
+			else if (compression == 5 && val_pos < val_size)
+				LZWDecode((unsigned char*)(pbyData+data_pos), data_size, (unsigned char*)(val+val_pos),
+					(size_t(rows)*width < val_size-val_pos ? size_t(rows)*width : val_size-val_pos)*2);
 			val_pos += rows*width;
 		}
 	}
+	return max_value;
 }
 
 wstring PVXMLReader::GetCurDataName(int t, int c)
@@ -227,13 +227,17 @@ private:
 private:
 	bool ConvertS(int c, TimeDataInfo* time_data_info, unsigned short *val);
 	bool ConvertN(int c, TimeDataInfo* time_data_info, unsigned short *val);
+	//read frame files of one channel into the volume
+	//frames at different z are fetched concurrently
+	void FetchFrames(vector<FrameInfo*> &frames, int chan, unsigned short *val);
 	void ReadSystemConfig(wxXmlNode *systemNode);
 	void UpdateStateShard(wxXmlNode *stateNode);
 	void ReadKey(wxXmlNode *keyNode);
 	void ReadIndexedKey(wxXmlNode *keyNode, wxString &key);
 	void ReadSequence(wxXmlNode *seqNode);
 	void ReadFrame(wxXmlNode *frameNode);
-	void ReadTiff(char* pbyData, unsigned short *val);
+	//returns the max sample value in the tags
+	double ReadTiff(char* pbyData, unsigned short *val, size_t val_size);
 };
 
 #endif//_PVXML_READER_H_
@@ -0,0 +1,412 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#include "table_writer.h"
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#define TABLE_BUF_SIZE	(1 << 20)
+
+//powers of ten that are exact in double
+static const double s_pow10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+TableWriter::TableWriter() :
+	m_format(TABLE_CSV),
+	m_buf_size(0),
+	m_col(0),
+	m_chunk_rows(0),
+	m_row_num(0)
+{
+}
+
+TableWriter::~TableWriter()
+{
+	Close();
+}
+
+void TableWriter::AddColumn(const std::string &name, Type type)
+{
+	if (IsOpen())
+		return;
+	Column col;
+	col.name = name;
+	col.type = type;
+	m_cols.push_back(col);
+}
+
+bool TableWriter::Open(const std::string &filename, Format format)
+{
+	Close();
+	if (m_cols.empty())
+		return false;
+	m_ofs.open(filename, std::ios::out | std::ios::binary);
+	if (!m_ofs.is_open())
+		return false;
+
+	m_format = format;
+	m_col = 0;
+	m_chunk_rows = 0;
+	m_row_num = 0;
+	if (m_format == TABLE_CSV)
+	{
+		m_buf.resize(TABLE_BUF_SIZE);
+		m_buf_size = 0;
+		//header, names with separators or quotes are quoted
+		std::string header;
+		for (size_t i = 0; i < m_cols.size(); ++i)
+		{
+			const std::string &name = m_cols[i].name;
+			if (i)
+				header += ',';
+			if (name.find_first_of(",\"\n") == std::string::npos)
+			{
+				header += name;
+				continue;
+			}
+			header += '"';
+			for (size_t j = 0; j < name.size(); ++j)
+			{
+				if (name[j] == '"')
+					header += '"';
+				header += name[j];
+			}
+			header += '"';
+		}
+		header += '\n';
+		m_ofs.write(header.c_str(), header.size());
+	}
+	else
+	{
+		TableHeader header;
+		memset(&header, 0, sizeof(TableHeader));
+		memcpy(header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC));
+		header.version = TABLE_VERSION;
+		header.col_num = (unsigned int)m_cols.size();
+		m_ofs.write((char*)&header, sizeof(TableHeader));
+		for (size_t i = 0; i < m_cols.size(); ++i)
+		{
+			Column &col = m_cols[i];
+			unsigned char type = (unsigned char)col.type;
+			unsigned int len = (unsigned int)col.name.size();
+			m_ofs.write((char*)&type, sizeof(unsigned char));
+			m_ofs.write((char*)&len, sizeof(unsigned int));
+			m_ofs.write(col.name.c_str(), len);
+			col.data.clear();
+			col.data.reserve(TABLE_CHUNK_ROWS *
+				(col.type == COL_DOUBLE ? sizeof(double) : sizeof(unsigned int)));
+		}
+	}
+	return m_ofs.good();
+}
+
+bool TableWriter::Close()
+{
+	if (!IsOpen())
+		return false;
+	if (m_col)
+		EndRow();
+	if (m_format == TABLE_CSV)
+	{
+		FlushText();
+		std::vector<char>().swap(m_buf);
+	}
+	else
+	{
+		FlushChunk();
+		unsigned int end = 0;
+		m_ofs.write((char*)&end, sizeof(unsigned int));
+		for (size_t i = 0; i < m_cols.size(); ++i)
+			std::vector<unsigned char>().swap(m_cols[i].data);
+	}
+	bool result = m_ofs.good();
+	m_ofs.close();
+	return result;
+}
+
+void TableWriter::Put(unsigned int value)
+{
+	PutValue(value);
+}
+
+void TableWriter::Put(int value)
+{
+	PutValue(value);
+}
+
+void TableWriter::Put(double value)
+{
+	PutValue(value);
+}
+
+void TableWriter::EndRow()
+{
+	if (!IsOpen())
+		return;
+	if (m_format == TABLE_CSV)
+	{
+		//missing values are left empty
+		size_t n = m_cols.size() - m_col;
+		char* p = Reserve(n + 1);
+		for (size_t i = m_col ? 0 : 1; i < n; ++i)
+			*p++ = ',';
+		*p = '\n';
+		m_buf_size += (m_col ? n : n - 1) + 1;
+		m_col = 0;
+		m_row_num++;
+		return;
+	}
+	//missing values are zeros
+	while (m_col < m_cols.size())
+		PutValue(0u);
+	m_col = 0;
+	m_row_num++;
+	if (++m_chunk_rows >= TABLE_CHUNK_ROWS)
+		FlushChunk();
+}
+
+template<typename T>
+void TableWriter::PutValue(T value)
+{
+	if (!IsOpen() || m_col >= m_cols.size())
+		return;
+	Column &col = m_cols[m_col];
+	if (m_format == TABLE_CSV)
+	{
+		char* p = Reserve(40);
+		size_t n = 0;
+		if (m_col)
+			p[n++] = ',';
+		switch (col.type)
+		{
+		case COL_UINT:
+			n += FormatUint(p + n, (unsigned int)value);
+			break;
+		case COL_INT:
+			n += FormatInt(p + n, (int)value);
+			break;
+		case COL_FLOAT:
+			n += FormatDouble(p + n, (float)value);
+			break;
+		case COL_DOUBLE:
+			n += FormatDouble(p + n, (double)value);
+			break;
+		}
+		m_buf_size += n;
+	}
+	else
+	{
+		size_t size = col.data.size();
+		switch (col.type)
+		{
+		case COL_UINT:
+		{
+			unsigned int v = (unsigned int)value;
+			col.data.resize(size + sizeof(v));
+			memcpy(&col.data[size], &v, sizeof(v));
+		}
+		break;
+		case COL_INT:
+		{
+			int v = (int)value;
+			col.data.resize(size + sizeof(v));
+			memcpy(&col.data[size], &v, sizeof(v));
+		}
+		break;
+		case COL_FLOAT:
+		{
+			float v = (float)value;
+			col.data.resize(size + sizeof(v));
+			memcpy(&col.data[size], &v, sizeof(v));
+		}
+		break;
+		case COL_DOUBLE:
+		{
+			double v = (double)value;
+			col.data.resize(size + sizeof(v));
+			memcpy(&col.data[size], &v, sizeof(v));
+		}
+		break;
+		}
+	}
+	m_col++;
+}
+
+char* TableWriter::Reserve(size_t size)
+{
+	if (m_buf_size + size > m_buf.size())
+	{
+		FlushText();
+		if (size > m_buf.size())
+			m_buf.resize(size);
+	}
+	return &m_buf[m_buf_size];
+}
+
+void TableWriter::FlushText()
+{
+	if (m_buf_size)
+		m_ofs.write(&m_buf[0], m_buf_size);
+	m_buf_size = 0;
+}
+
+void TableWriter::FlushChunk()
+{
+	if (!m_chunk_rows)
+		return;
+	unsigned int rows = (unsigned int)m_chunk_rows;
+	m_ofs.write((char*)&rows, sizeof(unsigned int));
+	for (size_t i = 0; i < m_cols.size(); ++i)
+	{
+		std::vector<unsigned char> &data = m_cols[i].data;
+		if (!data.empty())
+			m_ofs.write((char*)&data[0], data.size());
+		data.clear();
+	}
+	m_chunk_rows = 0;
+}
+
+size_t TableWriter::FormatUint(char* str, unsigned long long value)
+{
+	char digits[20];
+	size_t n = 0;
+	do
+	{
+		digits[n++] = char('0' + value % 10);
+		value /= 10;
+	} while (value);
+	for (size_t i = 0; i < n; ++i)
+		str[i] = digits[n - 1 - i];
+	return n;
+}
+
+size_t TableWriter::FormatInt(char* str, long long value)
+{
+	if (value >= 0)
+		return FormatUint(str, (unsigned long long)value);
+	str[0] = '-';
+	return FormatUint(str + 1, 0ull - (unsigned long long)value) + 1;
+}
+
+//same text as printf("%g"), six significant digits
+//the digits come from one scaling by an exact power of ten,
+//which is off by at most an ulp, so near ties, numbers beyond
+//the table and non-finite ones go to snprintf
+size_t TableWriter::FormatDouble(char* str, double value)
+{
+	if (!std::isfinite(value))
+		return snprintf(str, 32, "%g", value);
+	size_t n = 0;
+	if (std::signbit(value))
+		str[n++] = '-';
+	double a = std::fabs(value);
+	if (a == 0.0)
+	{
+		str[n++] = '0';
+		return n;
+	}
+
+	//k: power of ten that brings a to six digits before the point
+	//estimated from the binary exponent, may be one short
+	int b;
+	std::frexp(a, &b);
+	int k = 5 - (int)std::floor((b - 1) * 0.30102999566398120);
+	double r = 0.0;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (k < -22 || k > 22)
+			return snprintf(str, 32, "%g", value);
+		double m = k >= 0 ? a * s_pow10[k] : a / s_pow10[-k];
+		//too close to a tie to tell from the rounded product
+		if (std::fabs(m - std::floor(m) - 0.5) <= m * 1e-15)
+			return snprintf(str, 32, "%g", value);
+		r = std::nearbyint(m);
+		if (r >= 1e6)
+			k--;
+		else if (r < 1e5)
+			k++;
+		else
+			break;
+	}
+	if (r >= 1e6 || r < 1e5)
+		return snprintf(str, 32, "%g", value);
+
+	char digits[6];
+	unsigned int d = (unsigned int)r;
+	for (int i = 5; i >= 0; --i)
+	{
+		digits[i] = char('0' + d % 10);
+		d /= 10;
+	}
+	int nd = 6;
+	while (nd > 1 && digits[nd - 1] == '0')
+		nd--;
+
+	int e = 5 - k;//decimal exponent of the first digit
+	if (e < -4 || e >= 6)
+	{
+		str[n++] = digits[0];
+		if (nd > 1)
+		{
+			str[n++] = '.';
+			for (int i = 1; i < nd; ++i)
+				str[n++] = digits[i];
+		}
+		str[n++] = 'e';
+		str[n++] = e < 0 ? '-' : '+';
+		unsigned int ea = e < 0 ? -e : e;
+		if (ea >= 100)
+			str[n++] = char('0' + ea / 100);
+		str[n++] = char('0' + ea / 10 % 10);
+		str[n++] = char('0' + ea % 10);
+	}
+	else if (e >= 0)
+	{
+		for (int i = 0; i <= e; ++i)
+			str[n++] = i < nd ? digits[i] : '0';
+		if (nd > e + 1)
+		{
+			str[n++] = '.';
+			for (int i = e + 1; i < nd; ++i)
+				str[n++] = digits[i];
+		}
+	}
+	else
+	{
+		str[n++] = '0';
+		str[n++] = '.';
+		for (int i = 0; i < -e - 1; ++i)
+			str[n++] = '0';
+		for (int i = 0; i < nd; ++i)
+			str[n++] = digits[i];
+	}
+	return n;
+}
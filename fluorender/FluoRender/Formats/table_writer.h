@@ -0,0 +1,124 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#ifndef _TABLE_WRITER_H_
+#define _TABLE_WRITER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+
+//streaming writer of tables for analysis
+//rows are formatted straight into a buffer that goes out in large writes
+//TABLE_CSV: comma separated text with a header line,
+//numbers are written like the default iostream output (%g)
+//TABLE_CHUNK: binary column chunks, layout:
+//TableHeader, then each column as a type byte, a name length (unsigned int)
+//and the name, then chunks of up to TABLE_CHUNK_ROWS rows
+//a chunk is its row count (unsigned int) followed by the values of each
+//column stored contiguously; a row count of 0 ends the table
+#define TABLE_MAGIC	"FLTABLE"
+#define TABLE_VERSION	1
+#define TABLE_CHUNK_ROWS	65536
+
+struct TableHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int col_num;
+};
+
+class TableWriter
+{
+public:
+	enum Format
+	{
+		TABLE_CSV = 0,
+		TABLE_CHUNK
+	};
+	//column types, also the type bytes of the chunk format
+	enum Type
+	{
+		COL_UINT = 0,//unsigned int
+		COL_INT,//int
+		COL_FLOAT,//float
+		COL_DOUBLE//double
+	};
+
+	TableWriter();
+	~TableWriter();
+
+	//columns are added before the table is opened
+	void AddColumn(const std::string &name, Type type);
+	bool Open(const std::string &filename, Format format);
+	//returns false if anything failed to be written
+	bool Close();
+	bool IsOpen() { return m_ofs.is_open(); }
+
+	//values of a row are put in column order
+	//and stored as the type of their column
+	void Put(unsigned int value);
+	void Put(int value);
+	void Put(double value);
+	void EndRow();
+
+	size_t GetRowNum() { return m_row_num; }
+
+	//format a number into str, which holds at least 32 chars
+	//return the number of chars written
+	static size_t FormatUint(char* str, unsigned long long value);
+	static size_t FormatInt(char* str, long long value);
+	static size_t FormatDouble(char* str, double value);
+
+private:
+	struct Column
+	{
+		std::string name;
+		Type type;
+		std::vector<unsigned char> data;//chunk values
+	};
+	std::vector<Column> m_cols;
+	Format m_format;
+	std::ofstream m_ofs;
+	std::vector<char> m_buf;//csv text
+	size_t m_buf_size;
+	size_t m_col;//current column of the row
+	size_t m_chunk_rows;
+	size_t m_row_num;
+
+	TableWriter(const TableWriter&);
+	TableWriter& operator=(const TableWriter&);
+
+	char* Reserve(size_t size);
+	template<typename T>
+	void PutValue(T value);
+	void FlushText();
+	void FlushChunk();
+};
+
+#endif//_TABLE_WRITER_H_
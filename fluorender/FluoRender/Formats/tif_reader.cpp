@@ -28,6 +28,7 @@ DEALINGS IN THE SOFTWARE.
 #include "tif_reader.h"
 #include <boost/filesystem.hpp>
 #include "../compatibility.h"
+#include <mutex>
 
 TIFReader::TIFReader()
 {
@@ -1344,11 +1345,11 @@ void TIFReader::GetTiffStrip(uint64_t page, uint64_t strip,
 	//uint64_t rows_per_strip = GetTiffField(kRowsPerStripTag,NULL,0);
 	uint64_t rows_per_strip = strip_size /
 		GetTiffField(kImageWidthTag) /
-		samples;
+		samples / (eight_bits ? 1 : 2);
 	bool isCompressed = tmp == 5;
 	if (isCompressed)
 	{
-		LZWDecode((tidata_t)temp, (tidata_t)data, strip_size);
+		LZWDecode((unsigned char*)temp, byte_count, (unsigned char*)data, strip_size);
 		if (prediction == 2)
 		{
 			for (size_t j = 0; j < rows_per_strip; j++)
@@ -1391,14 +1392,16 @@ void TIFReader::GetTiffTile(uint64_t page, uint64_t tile,
 	bool isCompressed = tmp == 5;
 	if (isCompressed)
 	{
-		LZWDecode((tidata_t)temp, (tidata_t)data, tile_size);
-		if (prediction == 2)
+		LZWDecode((unsigned char*)temp, byte_count, (unsigned char*)data, tile_size);
+		if (prediction == 2 && tile_height)
 		{
+			//rows of a tile are as wide as the tile
+			uint64_t row_size = tile_size / tile_height;
 			for (size_t j = 0; j < tile_height; j++)
 				if (eight_bits)
-					DecodeAcc8((tidata_t)data + j*m_x_size*samples, m_x_size*samples, stride);
+					DecodeAcc8((tidata_t)data + j*row_size, row_size, stride);
 				else
-					DecodeAcc16((tidata_t)data + j*m_x_size*samples * 2, m_x_size*samples * 2, stride);
+					DecodeAcc16((tidata_t)data + j*row_size, row_size, stride);
 		}
 	}
 	else
@@ -1574,13 +1577,13 @@ Nrrd* TIFReader::ReadTiff(std::vector<SliceInfo> &filelist,
 	int max_value = 0;
 
 	void* buf = 0;
-	uint64_t strip_size;
-	uint64_t tile_size;
-	uint64_t tile_w;
-	uint64_t tile_h;
-	uint64_t tile_w_last;//last tile width
-	uint64_t x_tile_num;
-	uint64_t y_tile_num;
+	uint64_t strip_size = 0;
+	uint64_t tile_size = 0;
+	uint64_t tile_w = 0;
+	uint64_t tile_h = 0;
+	uint64_t tile_w_last = 0;//last tile width
+	uint64_t x_tile_num = 0;
+	uint64_t y_tile_num = 0;
 	if (GetTiffUseTiles())
 	{
 		uint64_t tile_num = GetTiffTileNum();
@@ -1611,6 +1614,19 @@ Nrrd* TIFReader::ReadTiff(std::vector<SliceInfo> &filelist,
 			strip_size = height * width * samples * (bits / 8);
 	}
 
+	PageLayout layout;
+	layout.width = width;
+	layout.samples = samples;
+	layout.eight_bit = eight_bit;
+	layout.pagepixels = pagepixels;
+	layout.total_size = total_size;
+	layout.strip_size = strip_size;
+	layout.tile_size = tile_size;
+	layout.tile_w = tile_w;
+	layout.tile_h = tile_h;
+	layout.tile_w_last = tile_w_last;
+	layout.x_tile_num = x_tile_num;
+
 	if (isHyperstack_)
 	{
 		uint64_t pageindex = filelist[0].pagenumber + c;
@@ -1642,6 +1658,100 @@ Nrrd* TIFReader::ReadTiff(std::vector<SliceInfo> &filelist,
 			//	InvalidatePageInfo();
 		}
 	}
+	else if (sequence && !imagej_raw_ &&
+		GetReadThreadNum() != 1)
+	{
+		//collect the slice files of the channel
+		vector<wstring> files;
+		for (size_t i = 0; i < filelist.size(); ++i)
+		{
+			filename = filelist[i].slice;
+			if (m_chann_seq)
+			{
+				int cn = GetPatternNumber(filename, 1);
+				int cindex = 0;
+				for (auto it = m_chann_count.begin();
+					it != m_chann_count.end(); ++it)
+				{
+					if (*it == cn)
+						break;
+					cindex++;
+				}
+				if (cindex != c)
+					continue;
+			}
+			files.push_back(filename);
+		}
+
+		//each slice file is read by its own reader into its z offset
+		//thumbnails are skipped like in the serial read: the slices after
+		//them are moved down and more files are read to fill the volume
+		size_t page_bytes = size_t(pagepixels) * (eight_bit ? 1 : 2);
+		size_t val_pageindex = 0;
+		size_t file_index = 0;
+		vector<char> read_flags;
+		std::mutex max_mutex;
+		while (val_pageindex < (size_t)numPages && file_index < files.size())
+		{
+			size_t batch = std::min((size_t)numPages - val_pageindex,
+				files.size() - file_index);
+			read_flags.assign(batch, 0);
+			ParallelFetch(batch, [&](size_t i)
+			{
+				TIFReader reader;
+				reader.m_x_size = m_x_size;
+				reader.m_y_size = m_y_size;
+				reader.imagej_raw_ = false;
+				reader.imagej_raw_possible_ = false;
+				reader.OpenTiff(files[file_index + i]);
+				reader.InvalidatePageInfo();
+
+				void* page_buf = 0;
+				int page_max = 0;
+				bool read = false;
+				try
+				{
+					read = reader.ReadTiffPage(0, val_pageindex + i, true,
+						c, get_max, layout, val, page_buf, page_max);
+				}
+				catch (...)
+				{
+					if (page_buf)
+						free(page_buf);
+					throw;
+				}
+				if (page_buf)
+					free(page_buf);
+				reader.CloseTiff();
+
+				if (!read)
+					return;
+				read_flags[i] = 1;
+				if (page_max > 0)
+				{
+					std::lock_guard<std::mutex> lock(max_mutex);
+					if (page_max > max_value)
+						max_value = page_max;
+				}
+			});
+			//compact, slices only move down
+			size_t src = val_pageindex;
+			for (size_t i = 0; i < batch; ++i, ++src)
+			{
+				if (!read_flags[i])
+					continue;
+				if (src != val_pageindex)
+					memmove((unsigned char*)val + val_pageindex * page_bytes,
+						(unsigned char*)val + src * page_bytes, page_bytes);
+				val_pageindex++;
+			}
+			file_index += batch;
+		}
+		//too few slices, leave the rest empty
+		if (val_pageindex < (size_t)numPages)
+			memset((unsigned char*)val + val_pageindex * page_bytes, 0,
+				((size_t)numPages - val_pageindex) * page_bytes);
+	}
 	else
 	{
 		uint64_t val_pageindex = 0;
@@ -1673,167 +1783,13 @@ Nrrd* TIFReader::ReadTiff(std::vector<SliceInfo> &filelist,
 				InvalidatePageInfo();
 			}
 
-			if (!imagej_raw_ && !sequence)
-				TurnToPage(pageindex);
-			if (!imagej_raw_)
-				ReadTiffFields();
-
-			//this is a thumbnail, skip
-			if (GetTiffField(kSubFileTypeTag) == 1)
+			if (!ReadTiffPage(pageindex, val_pageindex, sequence,
+				c, get_max, layout, val, buf, max_value))
 			{
 				if (sequence) CloseTiff();
 				continue;
 			}
 
-			//tile storage
-			if (GetTiffUseTiles())
-			{
-				if (!buf)
-					buf = malloc(tile_size);
-
-				uint64_t num_tiles = GetTiffTileNum();
-				num_tiles = num_tiles ? num_tiles : 1;
-
-				//read file
-				for (uint64_t tile = 0; tile < num_tiles; ++tile)
-				{
-					uint64_t valindex;
-					uint64_t indexinpage;
-					if (samples > 1)
-					{
-						GetTiffTile(sequence ? 0 : val_pageindex, tile, buf, tile_size, tile_h);
-						int num_pixels = tile_size / samples / (eight_bit ? 1 : 2);
-						uint64_t tx, ty;//tile coord
-						tx = tile % x_tile_num;
-						ty = tile / x_tile_num;
-						indexinpage = width * ty * tile_h + tx * tile_w;
-						valindex = val_pageindex * pagepixels + indexinpage;
-						for (int i = 0; i<num_pixels; i++)
-						{
-							if (tx == x_tile_num - 1)
-							{
-								if (i % tile_w == tile_w_last)
-									i += tile_w - tile_w_last;
-							}
-							if (i % tile_w == 0 && i)
-							{
-								if (tx < x_tile_num - 1)
-								{
-									indexinpage += width - tile_w;
-									valindex += width - tile_w;
-								}
-								else
-								{
-									indexinpage += width - tile_w_last;
-									valindex += width - tile_w_last;
-								}
-							}
-							if (indexinpage >= pagepixels) break;
-							if (eight_bit)
-								memcpy((uint8_t*)val + valindex,
-								(uint8_t*)buf + samples*i + c,
-									sizeof(uint8_t));
-							else
-								memcpy((uint16_t*)val + valindex,
-								(uint16_t*)buf + samples*i + c,
-									sizeof(uint16_t));
-							indexinpage++;
-							valindex++;
-						}
-					}
-					else
-					{
-						GetTiffTile(sequence ? 0 : val_pageindex, tile, buf, tile_size, tile_h);
-						uint64_t tx, ty;//tile coord
-						tx = tile % x_tile_num;
-						ty = tile / x_tile_num;
-						indexinpage = width * ty * tile_h + tx * tile_w;
-						valindex = val_pageindex * pagepixels + indexinpage;
-						//copy tile
-						for (int i = 0; i < tile_h; ++i)
-						{
-							if (indexinpage >= pagepixels) break;
-							if (tx < x_tile_num-1)
-							{
-								if (eight_bit)
-									memcpy((uint8_t*)val + valindex,
-									(uint8_t*)buf + i*tile_w,
-										sizeof(uint8_t)*tile_w);
-								else
-									memcpy((uint16_t*)val + valindex,
-									(uint16_t*)buf + i*tile_w,
-										sizeof(uint16_t)*tile_w);
-							}
-							else
-							{
-								if (eight_bit)
-									memcpy((uint8_t*)val + valindex,
-									(uint8_t*)buf + i*tile_w,
-										sizeof(uint8_t)*tile_w_last);
-								else
-									memcpy((uint16_t*)val + valindex,
-									(uint16_t*)buf + i*tile_w,
-										sizeof(uint16_t)*tile_w_last);
-							}
-							indexinpage += width;
-							valindex += width;
-						}
-					}
-				}
-			}
-			else//strip storage
-			{
-				if (samples > 1 && !buf)
-					buf = malloc(strip_size);
-
-				uint64_t num_strips = GetTiffStripNum();
-				num_strips = num_strips ? num_strips : 1;
-
-				//read file
-				for (uint64_t strip = 0; strip < num_strips; ++strip)
-				{
-					long long valindex;
-					int indexinpage;
-					if (samples > 1)
-					{
-						GetTiffStrip(sequence ? 0 : val_pageindex, strip, buf, strip_size);
-						int num_pixels = strip_size / samples / (eight_bit ? 1 : 2);
-						indexinpage = strip*num_pixels;
-						valindex = val_pageindex *pagepixels + indexinpage;
-						for (int i = 0; i<num_pixels; i++)
-						{
-							if (indexinpage++ >= pagepixels) break;
-							if (eight_bit)
-								memcpy((uint8_t*)val + valindex,
-									(uint8_t*)buf + samples*i + c, sizeof(uint8_t));
-							else
-								memcpy((uint16_t*)val + valindex,
-									(uint16_t*)buf + samples*i + c, sizeof(uint16_t));
-							if (!eight_bit && get_max &&
-								*((uint16_t*)val + valindex) > max_value)
-								max_value = *((uint16_t*)val + valindex);
-							valindex++;
-						}
-					}
-					else
-					{
-						valindex = val_pageindex *pagepixels +
-							strip*strip_size / (eight_bit ? 1 : 2);
-						uint64_t strip_size_used = strip_size;
-						if (valindex + strip_size / (eight_bit ? 1 : 2) >= total_size)
-							strip_size_used = (total_size - valindex) * (eight_bit ? 1 : 2);
-						if (strip_size_used > 0)
-						{
-							if (eight_bit)
-								GetTiffStrip(sequence ? 0 : val_pageindex, strip,
-									(uint8_t*)val + valindex, strip_size_used);
-							else
-								GetTiffStrip(sequence ? 0 : val_pageindex, strip,
-									(uint16_t*)val + valindex, strip_size_used);
-						}
-					}
-				}
-			}
 			if (sequence) CloseTiff();
 			val_pageindex++;
 			if (val_pageindex >= numPages)
@@ -1884,6 +1840,183 @@ Nrrd* TIFReader::ReadTiff(std::vector<SliceInfo> &filelist,
 	return nrrdout;
 }
 
+bool TIFReader::ReadTiffPage(uint64_t pageindex, uint64_t val_pageindex,
+	bool sequence, int c, bool get_max, const PageLayout &layout,
+	void* val, void* &buf, int &max_value)
+{
+	uint64_t width = layout.width;
+	uint64_t samples = layout.samples;
+	bool eight_bit = layout.eight_bit;
+	int64_t pagepixels = layout.pagepixels;
+	unsigned long long total_size = layout.total_size;
+	uint64_t strip_size = layout.strip_size;
+	uint64_t tile_size = layout.tile_size;
+	uint64_t tile_w = layout.tile_w;
+	uint64_t tile_h = layout.tile_h;
+	uint64_t tile_w_last = layout.tile_w_last;
+	uint64_t x_tile_num = layout.x_tile_num;
+
+	if (!imagej_raw_ && !sequence)
+		TurnToPage(pageindex);
+	if (!imagej_raw_)
+		ReadTiffFields();
+
+	//this is a thumbnail, skip
+	if (GetTiffField(kSubFileTypeTag) == 1)
+		return false;
+
+	//tile storage
+	if (GetTiffUseTiles())
+	{
+		if (!buf)
+			buf = malloc(tile_size);
+
+		uint64_t num_tiles = GetTiffTileNum();
+		num_tiles = num_tiles ? num_tiles : 1;
+
+		//read file
+		for (uint64_t tile = 0; tile < num_tiles; ++tile)
+		{
+			uint64_t valindex;
+			uint64_t indexinpage;
+			if (samples > 1)
+			{
+				GetTiffTile(sequence ? 0 : val_pageindex, tile, buf, tile_size, tile_h);
+				int num_pixels = tile_size / samples / (eight_bit ? 1 : 2);
+				uint64_t tx, ty;//tile coord
+				tx = tile % x_tile_num;
+				ty = tile / x_tile_num;
+				indexinpage = width * ty * tile_h + tx * tile_w;
+				valindex = val_pageindex * pagepixels + indexinpage;
+				for (int i = 0; i<num_pixels; i++)
+				{
+					if (tx == x_tile_num - 1)
+					{
+						if (i % tile_w == tile_w_last)
+							i += tile_w - tile_w_last;
+					}
+					if (i % tile_w == 0 && i)
+					{
+						if (tx < x_tile_num - 1)
+						{
+							indexinpage += width - tile_w;
+							valindex += width - tile_w;
+						}
+						else
+						{
+							indexinpage += width - tile_w_last;
+							valindex += width - tile_w_last;
+						}
+					}
+					if (indexinpage >= pagepixels) break;
+					if (eight_bit)
+						memcpy((uint8_t*)val + valindex,
+						(uint8_t*)buf + samples*i + c,
+							sizeof(uint8_t));
+					else
+						memcpy((uint16_t*)val + valindex,
+						(uint16_t*)buf + samples*i + c,
+							sizeof(uint16_t));
+					indexinpage++;
+					valindex++;
+				}
+			}
+			else
+			{
+				GetTiffTile(sequence ? 0 : val_pageindex, tile, buf, tile_size, tile_h);
+				uint64_t tx, ty;//tile coord
+				tx = tile % x_tile_num;
+				ty = tile / x_tile_num;
+				indexinpage = width * ty * tile_h + tx * tile_w;
+				valindex = val_pageindex * pagepixels + indexinpage;
+				//copy tile
+				for (int i = 0; i < tile_h; ++i)
+				{
+					if (indexinpage >= pagepixels) break;
+					if (tx < x_tile_num-1)
+					{
+						if (eight_bit)
+							memcpy((uint8_t*)val + valindex,
+							(uint8_t*)buf + i*tile_w,
+								sizeof(uint8_t)*tile_w);
+						else
+							memcpy((uint16_t*)val + valindex,
+							(uint16_t*)buf + i*tile_w,
+								sizeof(uint16_t)*tile_w);
+					}
+					else
+					{
+						if (eight_bit)
+							memcpy((uint8_t*)val + valindex,
+							(uint8_t*)buf + i*tile_w,
+								sizeof(uint8_t)*tile_w_last);
+						else
+							memcpy((uint16_t*)val + valindex,
+							(uint16_t*)buf + i*tile_w,
+								sizeof(uint16_t)*tile_w_last);
+					}
+					indexinpage += width;
+					valindex += width;
+				}
+			}
+		}
+	}
+	else//strip storage
+	{
+		if (samples > 1 && !buf)
+			buf = malloc(strip_size);
+
+		uint64_t num_strips = GetTiffStripNum();
+		num_strips = num_strips ? num_strips : 1;
+
+		//read file
+		for (uint64_t strip = 0; strip < num_strips; ++strip)
+		{
+			long long valindex;
+			int indexinpage;
+			if (samples > 1)
+			{
+				GetTiffStrip(sequence ? 0 : val_pageindex, strip, buf, strip_size);
+				int num_pixels = strip_size / samples / (eight_bit ? 1 : 2);
+				indexinpage = strip*num_pixels;
+				valindex = val_pageindex *pagepixels + indexinpage;
+				for (int i = 0; i<num_pixels; i++)
+				{
+					if (indexinpage++ >= pagepixels) break;
+					if (eight_bit)
+						memcpy((uint8_t*)val + valindex,
+							(uint8_t*)buf + samples*i + c, sizeof(uint8_t));
+					else
+						memcpy((uint16_t*)val + valindex,
+							(uint16_t*)buf + samples*i + c, sizeof(uint16_t));
+					if (!eight_bit && get_max &&
+						*((uint16_t*)val + valindex) > max_value)
+						max_value = *((uint16_t*)val + valindex);
+					valindex++;
+				}
+			}
+			else
+			{
+				valindex = val_pageindex *pagepixels +
+					strip*strip_size / (eight_bit ? 1 : 2);
+				uint64_t strip_size_used = strip_size;
+				if (valindex + strip_size / (eight_bit ? 1 : 2) >= total_size)
+					strip_size_used = (total_size - valindex) * (eight_bit ? 1 : 2);
+				if (strip_size_used > 0)
+				{
+					if (eight_bit)
+						GetTiffStrip(sequence ? 0 : val_pageindex, strip,
+							(uint8_t*)val + valindex, strip_size_used);
+					else
+						GetTiffStrip(sequence ? 0 : val_pageindex, strip,
+							(uint16_t*)val + valindex, strip_size_used);
+				}
+			}
+		}
+	}
+	return true;
+}
+
 void TIFReader::AnalyzeNamePattern(std::wstring &path_name)
 {
 	m_name_patterns.clear();
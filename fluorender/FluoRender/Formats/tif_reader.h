@@ -398,6 +398,26 @@ private:
 	static bool tif_slice_sort(const SliceInfo& info1, const SliceInfo& info2);
 	//read tiff
 	Nrrd* ReadTiff(vector<SliceInfo> &filelist, int c, bool get_max);
+	//page layout shared by all pages of a stack
+	struct PageLayout
+	{
+		uint64_t width;
+		uint64_t samples;
+		bool eight_bit;
+		int64_t pagepixels;
+		unsigned long long total_size;
+		uint64_t strip_size;
+		uint64_t tile_size;
+		uint64_t tile_w;
+		uint64_t tile_h;
+		uint64_t tile_w_last;
+		uint64_t x_tile_num;
+	};
+	//read one page into slice val_pageindex of the volume
+	//returns false if the page is a thumbnail
+	bool ReadTiffPage(uint64_t pageindex, uint64_t val_pageindex,
+		bool sequence, int c, bool get_max, const PageLayout &layout,
+		void* val, void* &buf, int &max_value);
 
 	//name pattern
 	void AnalyzeNamePattern(std::wstring &path_name);
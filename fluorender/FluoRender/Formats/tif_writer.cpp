@@ -30,6 +30,9 @@ DEALINGS IN THE SOFTWARE.
 #include <tiffio.h>
 #include <sstream>
 
+//uncompressed size of the pages compressed together
+#define TIF_WRITE_BATCH_SIZE	67108864
+
 TIFWriter::TIFWriter()
 {
 	m_data = 0;
@@ -101,66 +104,80 @@ void TIFWriter::SaveSingleFile(wstring filename)
 		z_res = m_data->axis[2].spacing;
 	}
 
-	//buffers
-	uint16 *buf16 = 0;
-	uint8 *buf8 = 0;
-	if (bits == 16)
-	{
-		buf16 = (uint16*)_TIFFmalloc(width*sizeof(uint16)*samples);
-	}
-	else
-	{
-		buf8 = (uint8*)_TIFFmalloc(width*sizeof(uint8)*samples);
-	}
+	size_t line_size = size_t(width)*samples*(bits/8);
+	size_t page_size = line_size*height;
+	int rows_per_strip = GetRowsPerStrip(line_size);
+	int strip_num = (height + rows_per_strip - 1) / rows_per_strip;
 
-	TIFF* outfile = TIFFOpenW(filename, "wb");
-	for (int i=0; i<numPages; i++)
+	//use bigtiff when 32-bit offsets may overflow
+	//lzw expands data by 1.5 at most
+	double file_size = double(page_size) * numPages;
+	if (m_compression)
+		file_size *= 1.5;
+	TIFF* outfile = TIFFOpenW(filename, file_size > 4.0e9 ? "w8" : "w");
+	if (!outfile)
+		return;
+
+	int batch = int(TIF_WRITE_BATCH_SIZE / page_size);
+	if (batch < 1)
+		batch = 1;
+	unsigned char* data = (unsigned char*)m_data->data;
+	vector<vector<unsigned char>> strips;
+	for (int i0=0; i0<numPages; i0+=batch)
 	{
-		TIFFSetField(outfile, TIFFTAG_IMAGEWIDTH, width);
-		TIFFSetField(outfile, TIFFTAG_IMAGELENGTH, height);
-		TIFFSetField(outfile, TIFFTAG_BITSPERSAMPLE, bits);
-		TIFFSetField(outfile, TIFFTAG_SAMPLESPERPIXEL, samples);
-		TIFFSetField(outfile, TIFFTAG_XRESOLUTION, x_res);
-		TIFFSetField(outfile, TIFFTAG_YRESOLUTION, y_res);
-		TIFFSetField(outfile, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-		TIFFSetField(outfile, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-		TIFFSetField(outfile, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-		TIFFSetField(outfile, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
-		TIFFSetField(outfile, TIFFTAG_PAGENUMBER, i);
-		TIFFSetField(outfile, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(outfile, 0));
-		if (m_compression)
-			TIFFSetField(outfile, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-		ostringstream strs;
-		strs << "ImageJ=1.52a\n";
-		strs << "spacing=" << z_res << "\n";
-		strs << "images=" << numPages << "\n";
-		strs << "slices=" << numPages << "\n";
-		strs << "loop=false";
-		string desc = strs.str();
-		TIFFSetField(outfile, TIFFTAG_IMAGEDESCRIPTION, desc.c_str());
+		int i1 = i0 + batch;
+		if (i1 > numPages)
+			i1 = numPages;
 
-		for (int j=0; j<height; j++)
+		//compress all strips of the batch in parallel
+		if (m_compression)
 		{
-			int lineindex = (width*height*i + width*j)*samples;
-			if (bits == 16)
-			{
-				memcpy(buf16, ((uint16*)m_data->data)+lineindex, width*sizeof(uint16)*samples);
-				TIFFWriteScanline(outfile, buf16, j, 0);
-			}
-			else
+			strips.resize(size_t(i1-i0)*strip_num);
+			ParallelEncode(strips.size(), [&](size_t k)
 			{
-				memcpy(buf8, ((uint8*)m_data->data)+lineindex, width*sizeof(uint8)*samples);
-				TIFFWriteScanline(outfile, buf8, j, 0);
-			}
+				size_t page = i0 + k / strip_num;
+				int row = int(k % strip_num) * rows_per_strip;
+				int rows = height - row;
+				if (rows > rows_per_strip)
+					rows = rows_per_strip;
+				LZWEncode(data + page*page_size + row*line_size,
+					rows*line_size, strips[k]);
+			});
 		}
 
-		TIFFWriteDirectory(outfile);
+		//then write them in order
+		for (int i=i0; i<i1; i++)
+		{
+			TIFFSetField(outfile, TIFFTAG_IMAGEWIDTH, width);
+			TIFFSetField(outfile, TIFFTAG_IMAGELENGTH, height);
+			TIFFSetField(outfile, TIFFTAG_BITSPERSAMPLE, bits);
+			TIFFSetField(outfile, TIFFTAG_SAMPLESPERPIXEL, samples);
+			TIFFSetField(outfile, TIFFTAG_XRESOLUTION, x_res);
+			TIFFSetField(outfile, TIFFTAG_YRESOLUTION, y_res);
+			TIFFSetField(outfile, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+			TIFFSetField(outfile, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+			TIFFSetField(outfile, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+			TIFFSetField(outfile, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+			TIFFSetField(outfile, TIFFTAG_PAGENUMBER, i);
+			TIFFSetField(outfile, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+			if (m_compression)
+				TIFFSetField(outfile, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+			ostringstream strs;
+			strs << "ImageJ=1.52a\n";
+			strs << "spacing=" << z_res << "\n";
+			strs << "images=" << numPages << "\n";
+			strs << "slices=" << numPages << "\n";
+			strs << "loop=false";
+			string desc = strs.str();
+			TIFFSetField(outfile, TIFFTAG_IMAGEDESCRIPTION, desc.c_str());
+
+			WriteStrips(outfile, data + i*page_size, line_size, height, rows_per_strip,
+				m_compression ? &strips[size_t(i-i0)*strip_num] : 0);
+
+			TIFFWriteDirectory(outfile);
+		}
 	}
 	TIFFClose(outfile);
-	if (buf16)
-		_TIFFfree(buf16);
-	if (buf8)
-		_TIFFfree(buf8);
 }
 
 void TIFWriter::SaveSequence(wstring filename)
@@ -193,27 +210,23 @@ void TIFWriter::SaveSequence(wstring filename)
 		z_res = m_data->axis[2].spacing;
 	}
 
-	//buffers
-	uint16 *buf16 = 0;
-	uint8 *buf8 = 0;
-	if (bits == 16)
-	{
-		buf16 = (uint16*)_TIFFmalloc(width*sizeof(uint16)*samples);
-	}
-	else
-	{
-		buf8 = (uint8*)_TIFFmalloc(width*sizeof(uint8)*samples);
-	}
+	size_t line_size = size_t(width)*samples*(bits/8);
+	size_t page_size = line_size*height;
+	int rows_per_strip = GetRowsPerStrip(line_size);
+	unsigned char* data = (unsigned char*)m_data->data;
+	wchar_t format[32];
+	int ndigit = int(log10(double(numPages))) + 1;
+	swprintf_s(format, 32, L"%%0%dd", ndigit);
 
-	for (int i=0; i<numPages; i++)
+	//each file is written by its own thread
+	ParallelEncode(numPages, [&](size_t i)
 	{
 		wchar_t fileindex[32];
-		wchar_t format[32];
-		int ndigit = int(log10(double(numPages))) + 1;
-		swprintf_s(format, 32, L"%%0%dd", ndigit);
-		swprintf_s(fileindex, 32, format, i+1);
+		swprintf_s(fileindex, 32, format, int(i)+1);
 		wstring pagefilename = filename + fileindex + L".tif";
-		TIFF* outfile = TIFFOpenW(pagefilename, "wb");
+		TIFF* outfile = TIFFOpenW(pagefilename, page_size > 4.0e9 ? "w8" : "w");
+		if (!outfile)
+			return;
 
 		TIFFSetField(outfile, TIFFTAG_IMAGEWIDTH, width);
 		TIFFSetField(outfile, TIFFTAG_IMAGELENGTH, height);
@@ -226,7 +239,7 @@ void TIFWriter::SaveSequence(wstring filename)
 		TIFFSetField(outfile, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
 		TIFFSetField(outfile, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
 		TIFFSetField(outfile, TIFFTAG_PAGENUMBER, 0);
-		TIFFSetField(outfile, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(outfile, 0));
+		TIFFSetField(outfile, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
 		ostringstream strs;
 		strs << "ImageJ=1.52a\n";
 		strs << "spacing=" << z_res << "\n";
@@ -238,24 +251,42 @@ void TIFWriter::SaveSequence(wstring filename)
 		if (m_compression)
 			TIFFSetField(outfile, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
 
-		for (int j=0; j<height; j++)
+		WriteStrips(outfile, data + i*page_size, line_size, height, rows_per_strip, 0);
+		TIFFClose(outfile);
+	});
+}
+
+int TIFWriter::GetRowsPerStrip(size_t line_size)
+{
+	//about 8k per strip, same as libtiff's default
+	int rows = int(8192 / line_size);
+	return rows < 1 ? 1 : rows;
+}
+
+void TIFWriter::WriteStrips(TIFF* outfile, unsigned char* page,
+	size_t line_size, int height, int rows_per_strip,
+	vector<unsigned char>* strips)
+{
+	//strips are written as they are, in the file's native byte order
+	vector<unsigned char> buf;
+	int strip_num = (height + rows_per_strip - 1) / rows_per_strip;
+	for (int j=0; j<strip_num; j++)
+	{
+		int row = j * rows_per_strip;
+		int rows = height - row;
+		if (rows > rows_per_strip)
+			rows = rows_per_strip;
+		unsigned char* src = page + row*line_size;
+		size_t size = rows*line_size;
+		if (m_compression)
 		{
-			int lineindex = (width*height*i + width*j)*samples;
-			if (bits == 16)
-			{
-				memcpy(buf16, ((uint16*)m_data->data)+lineindex, width*sizeof(uint16)*samples);
-				TIFFWriteScanline(outfile, buf16, j, 0);
-			}
+			if (strips)
+				buf.swap(strips[j]);
 			else
-			{
-				memcpy(buf8, ((uint8*)m_data->data)+lineindex, width*sizeof(uint8)*samples);
-				TIFFWriteScanline(outfile, buf8, j, 0);
-			}
+				LZWEncode(src, size, buf);
+			src = &buf[0];
+			size = buf.size();
 		}
-		TIFFClose(outfile);
+		TIFFWriteRawStrip(outfile, j, src, tmsize_t(size));
 	}
-	if (buf16)
-		_TIFFfree(buf16);
-	if (buf8)
-		_TIFFfree(buf8);
 }
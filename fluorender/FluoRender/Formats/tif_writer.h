@@ -30,6 +30,8 @@ DEALINGS IN THE SOFTWARE.
 
 #include <base_writer.h>
 
+typedef struct tiff TIFF;
+
 class TIFWriter : public BaseWriter
 {
 public:
@@ -51,6 +53,12 @@ private:
 private:
 	void SaveSingleFile(wstring filename);
 	void SaveSequence(wstring filename);
+	int GetRowsPerStrip(size_t line_size);
+	//write the strips of one page
+	//strips holds the lzw data if already compressed
+	void WriteStrips(TIFF* outfile, unsigned char* page,
+		size_t line_size, int height, int rows_per_strip,
+		vector<unsigned char>* strips);
 };
 
 #endif//_TIF_WRITER_H_
@@ -1539,8 +1539,7 @@ void MeasureDlg::OnProfile(wxCommandEvent& event)
 		if (m_rulerlist->GetCurrSelection(sel))
 		{
 			//export selected
-			for (size_t i = 0; i < sel.size(); ++i)
-				m_rhdl->Profile(sel[i]);
+			m_rhdl->Profile(sel);
 		}
 		else
 		{
@@ -1549,8 +1548,9 @@ void MeasureDlg::OnProfile(wxCommandEvent& event)
 			for (size_t i = 0; i < ruler_list->size(); ++i)
 			{
 				if ((*ruler_list)[i]->GetDisp())
-					m_rhdl->Profile(i);
+					sel.push_back(i);
 			}
+			m_rhdl->Profile(sel);
 		}
 	}
 }
@@ -32,6 +32,7 @@ DEALINGS IN THE SOFTWARE.
 #include <VRenderGLView.h>
 #include <VRenderFrame.h>
 #include <utility.h>
+#include <Selection/Diffusion.h>
 #include <wx/filefn.h>
 #include <wx/stdpaths.h>
 
@@ -102,6 +103,8 @@ void ScriptProc::Run4DScript(int index, wxString &scriptname)
 					RunGenerateComp(index, fconfig);
 				else if (str == "ruler_profile")
 					RunRulerProfile(index, fconfig);
+				else if (str == "ruler_profile_frames")
+					RunRulerProfileFrames(index, fconfig);
 				else if (str == "save_volume")
 					RunSaveVolume(index, fconfig);
 				else if (str == "calculate")
@@ -244,24 +247,50 @@ void ScriptProc::RunSelectionTracking(int index, wxFileConfig &fconfig)
 			UPDATE_TRACE_DLG_AND_RETURN;
 		int nx, ny, nz;
 		cur_vol->GetResolution(nx, ny, nz);
+		//grow the selection after updating the mask
+		int grow_iter;
+		fconfig.Read("grow_iter", &grow_iter, 0);
+		//the selected voxels are the front to grow from
+		vector<unsigned long long> front;
 		//update the mask according to the new label
-		unsigned long long for_size = nx * ny * nz;
+		unsigned long long for_size = (unsigned long long)nx * ny * nz;
 		memset((void*)mask_data, 0, sizeof(uint8)*for_size);
 		for (unsigned long long idx = 0;
 			idx < for_size; ++idx)
 		{
 			unsigned int label_value = label_data[idx];
+			bool sel;
 			if (tg->GetTrackMap()->GetFrameNum())
-			{
-				if (tg->FindCell(label_value))
-					mask_data[idx] = 255;
-			}
+				sel = tg->FindCell(label_value);
 			else
+				sel = m_sel_labels.find(label_value) != m_sel_labels.end();
+			if (sel)
 			{
-				if (m_sel_labels.find(label_value) != m_sel_labels.end())
-					mask_data[idx] = 255;
+				mask_data[idx] = 255;
+				if (grow_iter > 0)
+					front.push_back(idx);
 			}
 		}
+		if (cur_vol->GetTexture())
+			cur_vol->GetTexture()->invalidate_summary(
+				cur_vol->GetTexture()->nmask());
+		if (grow_iter > 0 && !front.empty())
+		{
+			double ini_thresh, gm_falloff, scl_falloff, scl_translate;
+			fconfig.Read("grow_thresh", &ini_thresh, 0.0);
+			fconfig.Read("gm_falloff", &gm_falloff, 1.0);
+			fconfig.Read("scl_falloff", &scl_falloff, 0.0);
+			fconfig.Read("scl_translate", &scl_translate, 0.0);
+			//main memory is current here, so no opencl is needed
+			FL::Diffusion diffusion(cur_vol);
+			diffusion.SetUseCpu(true);
+			diffusion.SetFront(front);
+			diffusion.Grow(grow_iter, ini_thresh,
+				gm_falloff, scl_falloff, scl_translate);
+			if (cur_vol->GetTexture())
+				cur_vol->GetTexture()->invalidate_summary(
+					cur_vol->GetTexture()->nmask());
+		}
 		UPDATE_TRACE_DLG_AND_RETURN;
 	}
 }
@@ -844,48 +873,18 @@ void ScriptProc::RunRulerProfile(int index, wxFileConfig &fconfig)
 			return;
 	}
 
+	int sample_type;
+	fconfig.Read("sample_type", &sample_type, 0);//0-nearest;1-trilinear;2-box
+	ruler_handler->SetSampleType(sample_type);
 	ruler_handler->SetVolumeData(cur_vol);
+	std::vector<int> list;
 	for (size_t i = 0; i < ruler_list->size(); ++i)
-		ruler_handler->Profile(i);
+		list.push_back(i);
+	ruler_handler->Profile(list);
 
 	if (tseq_cur_num == 0 ||
 		m_script_output.IsEmpty())
-	{
-		wxString path;
-		if (cur_vol)
-		{
-			path = cur_vol->GetPath();
-			path = wxPathOnly(path);
-		}
-		path += GETSLASH();
-		path += "profiles_1.txt";
-
-		while (wxFileExists(path))
-		{
-			int pos = path.Find('_', true);
-			if (pos == wxNOT_FOUND)
-			{
-				path = path.SubString(0, path.Length() - 4);
-				path += "_1.txt";
-			}
-			else
-			{
-				wxString digits;
-				for (int i = pos + 1; i < path.Length() - 1; ++i)
-				{
-					if (wxIsdigit(path[i]))
-						digits += path[i];
-					else
-						break;
-				}
-				long num = 0;
-				digits.ToLong(&num);
-				path = path.SubString(0, pos);
-				path += wxString::Format("%d.txt", num + 1);
-			}
-		}
-		m_script_output = path;
-	}
+		m_script_output = GetProfilePath(cur_vol);
 
 	//save append
 	bool sf_script = tseq_cur_num == view_begin_frame;
@@ -953,6 +952,76 @@ void ScriptProc::RunRulerProfile(int index, wxFileConfig &fconfig)
 	file.Close();
 }
 
+//profiles of all frames in one pass
+void ScriptProc::RunRulerProfileFrames(int index, wxFileConfig &fconfig)
+{
+	if (!m_view || !m_frame) return;
+	VolumeData* cur_vol = m_view->m_cur_vol;
+	if (!cur_vol) return;
+	RulerHandler* ruler_handler = m_view->GetRulerHandler();
+	if (!ruler_handler) return;
+	RulerList* ruler_list = m_view->GetRulerList();
+	if (!ruler_list || ruler_list->empty()) return;
+
+	//run once at the start frame
+	if (index != 0 ||
+		m_view->m_tseq_cur_num != m_view->m_begin_frame)
+		return;
+
+	int sample_type;
+	fconfig.Read("sample_type", &sample_type, 0);//0-nearest;1-trilinear;2-box
+	ruler_handler->SetSampleType(sample_type);
+	ruler_handler->SetVolumeData(cur_vol);
+	std::vector<int> list;
+	for (size_t i = 0; i < ruler_list->size(); ++i)
+	{
+		if ((*ruler_list)[i]->GetDisp())
+			list.push_back(i);
+	}
+	wxString path = GetProfilePath(cur_vol);
+	ruler_handler->ProfileFrames(list,
+		m_view->m_begin_frame, m_view->m_end_frame,
+		path.ToStdString());
+}
+
+wxString ScriptProc::GetProfilePath(VolumeData* vd)
+{
+	wxString path;
+	if (vd)
+	{
+		path = vd->GetPath();
+		path = wxPathOnly(path);
+	}
+	path += GETSLASH();
+	path += "profiles_1.txt";
+
+	while (wxFileExists(path))
+	{
+		int pos = path.Find('_', true);
+		if (pos == wxNOT_FOUND)
+		{
+			path = path.SubString(0, path.Length() - 4);
+			path += "_1.txt";
+		}
+		else
+		{
+			wxString digits;
+			for (int i = pos + 1; i < path.Length() - 1; ++i)
+			{
+				if (wxIsdigit(path[i]))
+					digits += path[i];
+				else
+					break;
+			}
+			long num = 0;
+			digits.ToLong(&num);
+			path = path.SubString(0, pos);
+			path += wxString::Format("%d.txt", num + 1);
+		}
+	}
+	return path;
+}
+
 void ScriptProc::RunAddCells(int index, wxFileConfig &fconfig)
 {
 	if (!m_view || !m_frame) return;
@@ -1085,15 +1154,15 @@ void ScriptProc::DelVolCache(FL::VolCache& vol_cache)
 		double spcx, spcy, spcz;
 		cur_vol->GetSpacings(spcx, spcy, spcz);
 
-		MSKWriter msk_writer;
-		msk_writer.SetData((Nrrd*)(vol_cache.nrrd_label));
-		msk_writer.SetSpacings(spcx, spcy, spcz);
+		LBLWriter lbl_writer;
+		lbl_writer.SetData((Nrrd*)(vol_cache.nrrd_label));
+		lbl_writer.SetSpacings(spcx, spcy, spcz);
 		BaseReader* reader = cur_vol->GetReader();
 		if (reader)
 		{
 			wstring filename;
 			filename = reader->GetCurLabelName(frame, chan);
-			msk_writer.Save(filename, 1);
+			lbl_writer.Save(filename, 0);
 		}
 
 		nrrdNuke((Nrrd*)vol_cache.nrrd_label);
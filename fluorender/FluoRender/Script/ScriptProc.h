@@ -76,10 +76,14 @@ namespace FL
 		void RunCompAnalysis(int index, wxFileConfig &fconfig);
 		void RunGenerateComp(int index, wxFileConfig &fconfig);
 		void RunRulerProfile(int index, wxFileConfig &fconfig);
+		void RunRulerProfileFrames(int index, wxFileConfig &fconfig);
 		void RunAddCells(int index, wxFileConfig &fconfig);
 		void RunLinkCells(int index, wxFileConfig &fconfig);
 		void RunUnlinkCells(int index, wxFileConfig &fconfig);
 
+		//new file for profiles next to the volume
+		wxString GetProfilePath(VolumeData* vd);
+
 		//read/delete volume cache
 		//for sparse tracking
 		void ReadVolCache(VolCache& vol_cache);
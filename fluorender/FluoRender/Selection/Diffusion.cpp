@@ -27,6 +27,8 @@ DEALINGS IN THE SOFTWARE.
 */
 #include "DataManager.h"
 #include "Diffusion.h"
+#include <algorithm>
+#include <cmath>
 #ifdef _DEBUG
 #include <fstream>
 #endif
@@ -177,7 +179,12 @@ const char* str_cl_diffusion = \
 ;
 
 Diffusion::Diffusion(VolumeData* vd)
-	: m_vd(vd)
+	: m_vd(vd),
+	m_use_cpu(!KernelProgram::init()),
+	m_nx(0), m_ny(0), m_nz(0),
+	m_bits(8),
+	m_data(0),
+	m_mask(0)
 {
 }
 
@@ -264,6 +271,13 @@ void Diffusion::ReleaseMask(void* val, size_t brick_num, TextureBrick* b)
 
 void Diffusion::Init(Point &ip, double ini_thresh)
 {
+	//without opencl, main memory is used
+	if (m_use_cpu || !KernelProgram::init())
+	{
+		InitCpu(ip, ini_thresh);
+		return;
+	}
+
 	//debug
 #ifdef _DEBUG
 	unsigned int* val = 0;
@@ -383,6 +397,12 @@ void Diffusion::Init(Point &ip, double ini_thresh)
 
 void Diffusion::Grow(int iter, double ini_thresh, double gm_falloff, double scl_falloff, double scl_translate)
 {
+	if (m_use_cpu || !KernelProgram::init())
+	{
+		GrowCpu(iter, ini_thresh, gm_falloff, scl_falloff, scl_translate);
+		return;
+	}
+
 	//debug
 #ifdef _DEBUG
 	unsigned int* val = 0;
@@ -506,4 +526,265 @@ void Diffusion::Grow(int iter, double ini_thresh, double gm_falloff, double scl_
 		kernel_prog->releaseAll();
 		ReleaseMask(val, brick_num, b);
 	}
-}
\ No newline at end of file
+}
+
+bool Diffusion::GetCpuData()
+{
+	if (!m_vd)
+		return false;
+	Nrrd* nrrd_data = m_vd->GetVolume(false);
+	if (!nrrd_data || !nrrd_data->data)
+		return false;
+	Nrrd* nrrd_mask = m_vd->GetMask(true);
+	if (!nrrd_mask || !nrrd_mask->data)
+		return false;
+	m_data = nrrd_data->data;
+	m_mask = (unsigned char*)(nrrd_mask->data);
+	m_bits = m_vd->GetBits();
+	m_vd->GetResolution(m_nx, m_ny, m_nz);
+	if (m_nx <= 0 || m_ny <= 0 || m_nz <= 0)
+		return false;
+
+	//clipping planes, everything passes without a renderer
+	for (size_t i = 0; i < 6; ++i)
+	{
+		m_planes[i][0] = m_planes[i][1] = m_planes[i][2] = 0.0;
+		m_planes[i][3] = 1.0;
+	}
+	if (m_vd->GetVR())
+	{
+		vector<Plane*> *planes = m_vd->GetVR()->get_planes();
+		if (planes && planes->size() >= 6)
+			for (size_t i = 0; i < 6; ++i)
+				(*planes)[i]->get(m_planes[i]);
+	}
+	return true;
+}
+
+bool Diffusion::InsideClip(int i, int j, int k)
+{
+	double x = double(i) / double(m_nx);
+	double y = double(j) / double(m_ny);
+	double z = double(k) / double(m_nz);
+	for (size_t n = 0; n < 6; ++n)
+	{
+		if (x * m_planes[n][0] + y * m_planes[n][1] +
+			z * m_planes[n][2] + m_planes[n][3] < 0.0)
+			return false;
+	}
+	return true;
+}
+
+void Diffusion::InitCpu(Point &ip, double ini_thresh)
+{
+	if (!m_vd)
+		return;
+
+	//add empty mask if there is no mask
+	//then, push the mask for undos
+	m_vd->AddEmptyMask(0, false);
+	if (Texture::mask_undo_num_ > 0 &&
+		m_vd->GetTexture())
+		m_vd->GetTexture()->push_mask();
+
+	if (!GetCpuData())
+		return;
+
+	int i = int(ip.x());
+	int j = int(ip.y());
+	int k = int(ip.z());
+	if (i < 0 || i >= m_nx ||
+		j < 0 || j >= m_ny ||
+		k < 0 || k >= m_nz)
+		return;
+	unsigned long long index = (unsigned long long)m_nx*m_ny*k +
+		(unsigned long long)m_nx*j + i;
+	if (GetData(index) <= ini_thresh)
+		return;
+	if (!InsideClip(i, j, k))
+		return;
+	m_mask[index] = 255;
+	//the seed is the initial front
+	m_front.clear();
+	m_front.push_back(index);
+
+	//invalidate mask in gpu
+	if (m_vd->GetVR())
+		m_vd->GetVR()->clear_tex_mask();
+}
+
+//start from the selected voxels when there is no front
+//bricks whose mask summary is empty are skipped
+void Diffusion::SeedFront()
+{
+	m_front.clear();
+	Texture* tex = m_vd->GetTexture();
+	vector<TextureBrick*> *bricks = tex ? tex->get_bricks() : 0;
+	if (!bricks || bricks->empty())
+		return;
+	unsigned long long nxy = (unsigned long long)m_nx * m_ny;
+	for (size_t bi = 0; bi < bricks->size(); ++bi)
+	{
+		TextureBrick* b = (*bricks)[bi];
+		if (b->is_empty(b->nmask()))
+			continue;
+		int x1 = std::min(b->ox() + b->nx(), m_nx);
+		int y1 = std::min(b->oy() + b->ny(), m_ny);
+		int z1 = std::min(b->oz() + b->nz(), m_nz);
+		for (int k = b->oz(); k < z1; ++k)
+		for (int j = b->oy(); j < y1; ++j)
+		{
+			unsigned long long row = nxy * k + (unsigned long long)m_nx * j;
+			for (int i = b->ox(); i < x1; ++i)
+				if (m_mask[row + i])
+					m_front.push_back(row + i);
+		}
+	}
+	//bricks overlap at their borders
+	std::sort(m_front.begin(), m_front.end());
+	m_front.erase(std::unique(m_front.begin(), m_front.end()), m_front.end());
+}
+
+//narrow band growing
+//the rule is the same as kernel_1
+//only the neighbors of voxels changed in the previous iteration are
+//evaluated, as nothing else can change with the same parameters
+//the front is kept between grows, so selected voxels away from it aren't
+//revisited; clear it after changing the mask elsewhere
+//unlike the kernel, updates are applied after each sweep
+void Diffusion::GrowCpu(int iter, double ini_thresh, double gm_falloff, double scl_falloff, double scl_translate)
+{
+	if (!GetCpuData())
+		return;
+
+	unsigned long long nxy = (unsigned long long)m_nx * m_ny;
+	if (m_front.empty())
+		SeedFront();
+	if (m_front.empty())
+		return;
+
+	//params
+	bool inv = m_vd->GetInvert();
+	float scalar_scale = float(inv ? -m_vd->GetScalarScale() : m_vd->GetScalarScale());
+	float lo_thresh = float(m_vd->GetLeftThresh());
+	float hi_thresh = float(m_vd->GetRightThresh());
+	float gamma = float(1.0 / m_vd->Get3DGamma());
+	float gm_thresh = float(m_vd->GetBoundary());
+	float offset = float(m_vd->GetOffset());
+	float sw = float(m_vd->GetSoftThreshold());
+	float gmf = float(gm_falloff);
+	float sclf = float(scl_falloff);
+	float sclt = float(scl_translate);
+	//z step for gradient
+	float zstep = std::min(float(m_nz) / float(m_nx), 1.0f);
+
+	vector<unsigned long long> cand;
+	vector<pair<unsigned long long, unsigned char>> updates;
+	for (int it = 0; it < iter; ++it)
+	{
+		//candidates are the front and its neighbors
+		cand.clear();
+		for (auto fit = m_front.begin(); fit != m_front.end(); ++fit)
+		{
+			int i = int(*fit % m_nx);
+			int j = int((*fit / m_nx) % m_ny);
+			int k = int(*fit / nxy);
+			for (int kk = std::max(k - 1, 0); kk <= std::min(k + 1, m_nz - 1); ++kk)
+			for (int jj = std::max(j - 1, 0); jj <= std::min(j + 1, m_ny - 1); ++jj)
+			for (int ii = std::max(i - 1, 0); ii <= std::min(i + 1, m_nx - 1); ++ii)
+				cand.push_back(nxy*kk + (unsigned long long)m_nx*jj + ii);
+		}
+		std::sort(cand.begin(), cand.end());
+		cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+
+		updates.clear();
+		for (auto cit = cand.begin(); cit != cand.end(); ++cit)
+		{
+			unsigned long long index = *cit;
+			int i = int(index % m_nx);
+			int j = int((index / m_nx) % m_ny);
+			int k = int(index / nxy);
+			if (!InsideClip(i, j, k))
+				continue;
+
+			//gradient
+			float vx = GetData(index);
+			float gx = (i < m_nx - 1 ? GetData(index + 1) : vx) -
+				(i > 0 ? GetData(index - 1) : vx);
+			float gy = (j < m_ny - 1 ? GetData(index + m_nx) : vx) -
+				(j > 0 ? GetData(index - m_nx) : vx);
+			float zp = k < m_nz - 1 ? GetData(index + nxy) : vx;
+			float zn = k > 0 ? GetData(index - nxy) : vx;
+			float gz = (vx + (zp - vx) * zstep) - (vx + (zn - vx) * zstep);
+			float vy = std::sqrt(gx * gx + gy * gy + gz * gz);
+			vy = 0.5f * (scalar_scale < 0.0f ? (1.0f + vy * scalar_scale) : vy * scalar_scale);
+			//transfer function
+			float c;
+			vx = scalar_scale < 0.0f ? (1.0f + vx * scalar_scale) : vx * scalar_scale;
+			if (vx < lo_thresh - sw || (hi_thresh < 1.0f && vx > hi_thresh + sw))
+				c = 0.0f;
+			else
+			{
+				vx = (vx < lo_thresh ? (sw - lo_thresh + vx) / sw :
+					(hi_thresh < 1.0f && vx > hi_thresh ? (sw - vx + hi_thresh) / sw : 1.0f)) * vx;
+				vx = (gm_thresh > 0.0f ? std::min(std::max(vy / gm_thresh, 0.0f), 1.0f + gm_thresh * 10.0f) : 1.0f) * vx;
+				c = std::pow(std::min(std::max(vx / offset,
+					gamma < 1.0f ? -(gamma - 1.0f)*0.00001f : 0.0f),
+					gamma > 1.0f ? 0.9999f : 1.0f), gamma);
+			}
+			//stop function
+			if (c <= 0.0001f)
+				continue;
+			vx = c > 1.0f ? 1.0f : c;
+			float stop =
+				(gmf >= 1.0f ? 1.0f : (vy > std::sqrt(gmf)*2.12f ? 0.0f : std::exp(-vy * vy / gmf)))*
+				(vx > sclt ? 1.0f : (sclf > 0.0f ? (vx < sclt - std::sqrt(sclf)*2.12f ? 0.0f :
+					std::exp(-(vx - sclt)*(vx - sclt) / sclf)) : 0.0f));
+			if (stop <= 0.0001f)
+				continue;
+
+			//blend append
+			unsigned char cv = m_mask[index];
+			unsigned char cc = cv;
+			unsigned long long max_nb = index;
+			for (int kk = std::max(k - 1, 0); kk <= std::min(k + 1, m_nz - 1); ++kk)
+			for (int jj = std::max(j - 1, 0); jj <= std::min(j + 1, m_ny - 1); ++jj)
+			for (int ii = std::max(i - 1, 0); ii <= std::min(i + 1, m_nx - 1); ++ii)
+			{
+				unsigned long long nb_index = nxy*kk + (unsigned long long)m_nx*jj + ii;
+				if (m_mask[nb_index] > cc)
+				{
+					cc = m_mask[nb_index];
+					max_nb = nb_index;
+				}
+			}
+			if (gmf > 0.0f)
+			{
+				//conversions saturate where the kernel's are undefined
+				unsigned char m = (unsigned char)std::min(
+					(GetData(max_nb) + gmf) * 255.0f, 255.0f);
+				unsigned char mx = (unsigned char)(GetData(index) * 255.0f);
+				if (m < mx || m - mx > (unsigned char)std::min(510.0f * gmf, 255.0f))
+					continue;
+			}
+			int nv = int(cc) * int((unsigned char)(stop * 255.0f));
+			nv = std::min(std::max(nv, 0), 255);
+			if (nv != cv)
+				updates.push_back(pair<unsigned long long, unsigned char>(index, (unsigned char)nv));
+		}
+
+		if (updates.empty())
+			break;
+		//apply after the sweep so that the result doesn't depend on order
+		m_front.clear();
+		for (auto uit = updates.begin(); uit != updates.end(); ++uit)
+		{
+			m_mask[uit->first] = uit->second;
+			m_front.push_back(uit->first);
+		}
+	}
+
+	//invalidate mask in gpu
+	if (m_vd->GetVR())
+		m_vd->GetVR()->clear_tex_mask();
+}
@@ -43,16 +43,52 @@ namespace FL
 		Diffusion(VolumeData* vd);
 		~Diffusion();
 
+		//run on cpu memory instead of opencl
+		//on by default when there is no opencl device
+		void SetUseCpu(bool val) { m_use_cpu = val; }
+		bool GetUseCpu() { return m_use_cpu; }
+		//voxel indices the cpu path grows from, kept between grows
+		//when empty, it starts from the selected voxels of non-empty bricks
+		void SetFront(vector<unsigned long long> &front)
+		{ m_front.swap(front); }
+		void ClearFront() { m_front.clear(); }
+
 		void Init(Point& ip, double ini_thresh);
 		void Grow(int iter, double ini_thresh, double gm_falloff, double scl_falloff, double scl_translate);
 
 	private:
 		VolumeData *m_vd;
+		bool m_use_cpu;
+
+		//cpu path
+		//volume info
+		int m_nx, m_ny, m_nz;
+		int m_bits;
+		void* m_data;
+		unsigned char* m_mask;
+		//clipping planes
+		double m_planes[6][4];
+		//active front: voxels changed in the last iteration
+		vector<unsigned long long> m_front;
 
 	private:
 		bool CheckBricks();
 		void GetMask(size_t brick_num, TextureBrick* b, void** val);
 		void ReleaseMask(void* val, size_t brick_num, TextureBrick* b);
+
+		//cpu path
+		bool GetCpuData();
+		float GetData(unsigned long long index)
+		{
+			if (m_bits == 8)
+				return float(((unsigned char*)m_data)[index]) / 255.0f;
+			else
+				return float(((unsigned short*)m_data)[index]) / 65535.0f;
+		}
+		bool InsideClip(int i, int j, int k);
+		void SeedFront();
+		void InitCpu(Point& ip, double ini_thresh);
+		void GrowCpu(int iter, double ini_thresh, double gm_falloff, double scl_falloff, double scl_translate);
 	};
 
 }
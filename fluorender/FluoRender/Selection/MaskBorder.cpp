@@ -112,7 +112,9 @@ void MaskBorder::Compute(int order)
 	std::vector<FLIVR::TextureBrick*> bricks;
 	for (int i = 0; i < bn; ++i)
 	{
-		if ((*all_bricks)[i]->get_paint_mask())
+		//no border to check without selection
+		if ((*all_bricks)[i]->get_paint_mask() &&
+			!(*all_bricks)[i]->is_empty((*all_bricks)[i]->nmask()))
 			bricks.push_back((*all_bricks)[i]);
 	}
 	bn = bricks.size();
@@ -71,6 +71,9 @@ EVT_COMBOBOX(ID_WavColor4Cmb, SettingDlg::OnWavColor4Change)
 //texture size
 EVT_CHECKBOX(ID_MaxTextureSizeChk, SettingDlg::OnMaxTextureSizeChk)
 EVT_TEXT(ID_MaxTextureSizeText, SettingDlg::OnMaxTextureSizeEdit)
+//file sequence reading
+EVT_COMMAND_SCROLL(ID_ReadThreadSldr, SettingDlg::OnReadThreadChange)
+EVT_TEXT(ID_ReadThreadText, SettingDlg::OnReadThreadEdit)
 //memory settings
 EVT_CHECKBOX(ID_StreamingChk, SettingDlg::OnStreamingChk)
 EVT_RADIOBOX(ID_UpdateOrderRbox, SettingDlg::OnUpdateOrderChange)
@@ -632,6 +635,27 @@ wxWindow* SettingDlg::CreateFormatPage(wxWindow *parent)
 	group3->Add(st, 0);
 	group3->Add(10, 5);
 
+	//file sequence reading
+	wxBoxSizer *group4 = new wxStaticBoxSizer(
+		new wxStaticBox(page, wxID_ANY, "File Sequence Reading"), wxVERTICAL);
+	wxBoxSizer *sizer4_1 = new wxBoxSizer(wxHORIZONTAL);
+	m_read_thread_sldr = new wxSlider(page, ID_ReadThreadSldr, 0, 0, 64,
+		wxDefaultPosition, wxDefaultSize, wxSL_HORIZONTAL);
+	m_read_thread_text = new wxTextCtrl(page, ID_ReadThreadText, "0",
+		wxDefaultPosition, wxSize(40, -1), 0, vald_int);
+	sizer4_1->Add(m_read_thread_sldr, 1, wxEXPAND);
+	sizer4_1->Add(m_read_thread_text, 0, wxALIGN_CENTER);
+	st = new wxStaticText(page, 0,
+		"The number of files read at the same time for OIF, PrairieView and\n"\
+		"TIFF sequences. Set to 0 to use all processor cores; set to 1 to read\n"\
+		"files one after another. Use a larger number for network drives.\n"\
+		"The same number of threads compresses data when saving.");
+	group4->Add(10, 5);
+	group4->Add(sizer4_1, 0, wxEXPAND);
+	group4->Add(10, 5);
+	group4->Add(st, 0);
+	group4->Add(10, 5);
+
 	wxBoxSizer *sizerV = new wxBoxSizer(wxVERTICAL);
 	sizerV->Add(10, 10);
 	sizerV->Add(group1, 0, wxEXPAND);
@@ -639,6 +663,8 @@ wxWindow* SettingDlg::CreateFormatPage(wxWindow *parent)
 	sizerV->Add(group2, 0, wxEXPAND);
 	sizerV->Add(10, 10);
 	sizerV->Add(group3, 0, wxEXPAND);
+	sizerV->Add(10, 10);
+	sizerV->Add(group4, 0, wxEXPAND);
 
 	page->SetSizer(sizerV);
 	return page;
@@ -850,6 +876,7 @@ void SettingDlg::GetSettings()
 	m_similarity = 0.5;
 	m_use_max_texture_size = false;
 	m_max_texture_size = 2048;
+	m_read_thread_num = 0;
 	m_plane_mode = 0;
 	m_ij_mode = 0;
 
@@ -1120,6 +1147,13 @@ void SettingDlg::GetSettings()
 		fconfig.Read("use_max_texture_size", &m_use_max_texture_size);
 		fconfig.Read("max_texture_size", &m_max_texture_size);
 	}
+	//file sequence reading
+	if (fconfig.Exists("/read threads"))
+	{
+		fconfig.SetPath("/read threads");
+		fconfig.Read("value", &m_read_thread_num);
+	}
+	BaseReader::SetReadThreadNum(m_read_thread_num);
 	//cl device
 	if (fconfig.Exists("/cl device"))
 	{
@@ -1211,6 +1245,9 @@ void SettingDlg::UpdateUI()
 				max_texture_size()));
 		m_max_texture_size_text->Disable();
 	}
+	//file sequence reading
+	m_read_thread_sldr->SetValue(m_read_thread_num);
+	m_read_thread_text->ChangeValue(wxString::Format("%d", m_read_thread_num));
 	//font
 	wxString str = m_font_file.BeforeLast('.');
 	int font_sel = m_font_cmb->FindString(str);
@@ -1439,6 +1476,10 @@ void SettingDlg::SaveSettings()
 	fconfig.Write("use_max_texture_size", m_use_max_texture_size);
 	fconfig.Write("max_texture_size", m_max_texture_size);
 
+	//file sequence reading
+	fconfig.SetPath("/read threads");
+	fconfig.Write("value", m_read_thread_num);
+
 	//cl device
 	fconfig.SetPath("/cl device");
 	fconfig.Write("platform_id", m_cl_platform_id);
@@ -2000,6 +2041,26 @@ void SettingDlg::OnMaxTextureSizeEdit(wxCommandEvent &event)
 	}
 }
 
+//file sequence reading
+void SettingDlg::OnReadThreadChange(wxScrollEvent &event)
+{
+	int ival = event.GetPosition();
+	wxString str = wxString::Format("%d", ival);
+	if (str != m_read_thread_text->GetValue())
+		m_read_thread_text->SetValue(str);
+}
+
+void SettingDlg::OnReadThreadEdit(wxCommandEvent &event)
+{
+	wxString str = m_read_thread_text->GetValue();
+	unsigned long ival;
+	if (!str.ToULong(&ival))
+		return;
+	m_read_thread_sldr->SetValue(ival);
+	m_read_thread_num = ival;
+	BaseReader::SetReadThreadNum(m_read_thread_num);
+}
+
 //memory settings
 void SettingDlg::OnStreamingChk(wxCommandEvent &event)
 {
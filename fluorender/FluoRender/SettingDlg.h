@@ -98,6 +98,9 @@ class SettingDlg : public wxPanel
 		//texture size
 		ID_MaxTextureSizeChk,
 		ID_MaxTextureSizeText,
+		//file sequence reading
+		ID_ReadThreadSldr,
+		ID_ReadThreadText,
 		//font
 		ID_FontCmb,
 		ID_FontSizeCmb,
@@ -283,6 +286,9 @@ public:
 	bool GetUseMaxTextureSize() { return m_use_max_texture_size; }
 	void SetMaxTextureSize(int size) { m_max_texture_size = size; }
 	int GetMaxTextureSize() { return m_max_texture_size; }
+	//file sequence reading
+	void SetReadThreadNum(int num) { m_read_thread_num = num; }
+	int GetReadThreadNum() { return m_read_thread_num; }
 	int GetPlaneMode() { return m_plane_mode; }
 	
 	//Getting the java paths.
@@ -397,6 +403,8 @@ private:
 	//max texture size
 	bool m_use_max_texture_size;
 	int m_max_texture_size;
+	//threads for reading file sequences, 0 for all cores
+	int m_read_thread_num;
 	//rot center anchor thresh
 	double m_pin_threshold;
 	//clipping plane display mode
@@ -445,6 +453,9 @@ private:
 	//texture size
 	wxCheckBox *m_max_texture_size_chk;
 	wxTextCtrl *m_max_texture_size_text;
+	//file sequence reading
+	wxSlider *m_read_thread_sldr;
+	wxTextCtrl *m_read_thread_text;
 	//memory settings
 	wxCheckBox *m_streaming_chk;
 	wxRadioBox *m_update_order_rbox;
@@ -538,6 +549,9 @@ private:
 	//texture size
 	void OnMaxTextureSizeChk(wxCommandEvent &event);
 	void OnMaxTextureSizeEdit(wxCommandEvent &event);
+	//file sequence reading
+	void OnReadThreadChange(wxScrollEvent &event);
+	void OnReadThreadEdit(wxCommandEvent &event);
 	//memory settings
 	void OnStreamingChk(wxCommandEvent &event);
 	void OnUpdateOrderChange(wxCommandEvent & event);
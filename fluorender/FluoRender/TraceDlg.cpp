@@ -1063,13 +1063,28 @@ void TraceDlg::OnSaveasTrace(wxCommandEvent& event)
 
 	wxFileDialog *fopendlg = new wxFileDialog(
 		m_frame, "Save a FluoRender track file",
-		"", "", "*.track", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+		"", "", "FluoRender track file (*.track)|*.track|"\
+		"Track tables, CSV (*.csv)|*.csv|"\
+		"Track tables, column chunks (*.flt)|*.flt",
+		wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
 
 	int rval = fopendlg->ShowModal();
 	if (rval == wxID_OK)
 	{
 		wxString filename = fopendlg->GetPath();
-		SaveTrackFile(filename);
+		int index = fopendlg->GetFilterIndex();
+		if (index == 0)
+			SaveTrackFile(filename);
+		else
+		{
+			//tables are named after the file without its extension
+			TraceGroup* trace_group = m_view->GetTraceGroup();
+			wxString prefix = filename.BeforeLast('.');
+			if (prefix.IsEmpty())
+				prefix = filename;
+			if (trace_group)
+				trace_group->ExportTables(prefix, index - 1);
+		}
 	}
 
 	if (fopendlg)
@@ -3195,13 +3210,13 @@ void TraceDlg::DelVolCache(FL::VolCache& vol_cache)
 	{
 		//save it first if modified
 		//assume that only label is modified
-		MSKWriter msk_writer;
-		msk_writer.SetData((Nrrd*)vol_cache.nrrd_label);
+		LBLWriter lbl_writer;
+		lbl_writer.SetData((Nrrd*)vol_cache.nrrd_label);
 		double spcx, spcy, spcz;
 		vd->GetSpacings(spcx, spcy, spcz);
-		msk_writer.SetSpacings(spcx, spcy, spcz);
+		lbl_writer.SetSpacings(spcx, spcy, spcz);
 		wstring filename = reader->GetCurLabelName(frame, chan);
-		msk_writer.Save(filename, 1);
+		lbl_writer.Save(filename, 0);
 	}
 
 	vol_cache.valid = false;
@@ -3275,6 +3290,7 @@ void TraceDlg::GenMap()
 		boost::bind(&TraceDlg::ReadVolCache, this, _1),
 		boost::bind(&TraceDlg::DelVolCache, this, _1));
 	tm_processor.SetVolCacheSize(4);
+	tm_processor.SetGraphCacheSize(2);
 	//merge/split
 	tm_processor.SetMerge(m_try_merge);
 	tm_processor.SetSplit(m_try_split);
@@ -3404,6 +3420,7 @@ void TraceDlg::RefineMap(int t)
 		boost::bind(&TraceDlg::ReadVolCache, this, _1),
 		boost::bind(&TraceDlg::DelVolCache, this, _1));
 	tm_processor.SetVolCacheSize(4);
+	tm_processor.SetGraphCacheSize(2);
 	//merge/split
 	tm_processor.SetMerge(m_try_merge);
 	tm_processor.SetSplit(m_try_split);
@@ -3413,18 +3430,34 @@ void TraceDlg::RefineMap(int t)
 	//not sure if counters need to be cleared for all refinement
 	//if (clear_counters)
 	//	tm_processor.ClearCounters();
+	//after edits at a time point, only the cells around them are processed
+	//frames without edits, or whose edits have nothing to start from,
+	//are processed as a whole
+	bool local = t >= 0;
 	//iterations
 	for (size_t iteri = 0; iteri < m_iter_num; ++iteri)
 	{
 		for (int i = start_frame - 1; i <= end_frame; ++i)
 		{
 			//further process
-			tm_processor.ProcessFrames(i, i + 1);
-			tm_processor.ProcessFrames(i + 1, i);
+			bool dirty = local && tm_processor.HasDirty(i, i + 1);
+			if (!dirty || !tm_processor.ProcessDirty(i, i + 1))
+				tm_processor.ProcessFrames(i, i + 1);
+			if (!dirty || !tm_processor.ProcessDirty(i + 1, i))
+				tm_processor.ProcessFrames(i + 1, i);
 			(*m_stat_text) << wxString::Format("Time point %d processed.\n", i + 1);
 			wxGetApp().Yield();
 		}
 	}
+	//edits in other frames are kept for their own refinement
+	if (local)
+	{
+		for (int i = start_frame - 1; i <= end_frame + 1; ++i)
+			if (i >= 0)
+				tm_processor.ClearDirty(i);
+	}
+	else
+		tm_processor.ClearDirty();
 
 	//consistent colors
 	if (m_consistent_color)
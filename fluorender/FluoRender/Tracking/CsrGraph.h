@@ -0,0 +1,245 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#ifndef FL_CsrGraph_h
+#define FL_CsrGraph_h
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace FL
+{
+	//packed form of a track map graph that isn't being edited
+	//vertices and edges are kept in the order they were added to the graph
+	//so that unpacking restores the same iteration order
+	//each vertex lists its edges in a shared adjacency array
+	//a lookup array groups vertices by frame and sorts them by id
+	//edits are made on the boost graph, which is unpacked from here
+	//when it's needed and packed again when it leaves the working range
+	template<class VertexData, class EdgeData>
+	class CsrGraph
+	{
+	public:
+		struct Edge
+		{
+			unsigned int v1;
+			unsigned int v2;
+			EdgeData data;
+		};
+
+		CsrGraph() :
+			m_packed(false),
+			m_frame0(0)
+		{}
+
+		bool packed() const;
+		size_t vertex_num() const;
+		size_t edge_num() const;
+		VertexData &vertex(size_t v);
+		Edge &edge(size_t e);
+		//vertex on the other end of an edge
+		unsigned int opposite(size_t e, size_t v) const;
+		//edges of a vertex, as indices into the edge array
+		const unsigned int* adj_begin(size_t v) const;
+		const unsigned int* adj_end(size_t v) const;
+		//returns vertex_num() if not found
+		size_t find(size_t frame, unsigned int id) const;
+
+		//build: add all vertices and edges, then finish
+		void clear();
+		unsigned int add_vertex(size_t frame, unsigned int id, const VertexData &data);
+		void add_edge(unsigned int v1, unsigned int v2, const EdgeData &data);
+		void finish();
+
+	private:
+		bool m_packed;
+		size_t m_frame0;//first frame
+		std::vector<VertexData> m_verts;
+		std::vector<Edge> m_edges;
+		std::vector<unsigned int> m_offsets;//first adjacency of each vertex
+		std::vector<unsigned int> m_adj;
+		//lookup
+		std::vector<unsigned int> m_frames;//first lookup entry of each frame
+		std::vector<unsigned int> m_ids;//sorted by id in a frame
+		std::vector<unsigned int> m_order;//vertex of each lookup entry
+		std::vector<std::pair<size_t, unsigned int> > m_keys;//only while building
+	};
+
+	template<class VertexData, class EdgeData>
+	inline bool CsrGraph<VertexData, EdgeData>::packed() const
+	{
+		return m_packed;
+	}
+
+	template<class VertexData, class EdgeData>
+	inline size_t CsrGraph<VertexData, EdgeData>::vertex_num() const
+	{
+		return m_verts.size();
+	}
+
+	template<class VertexData, class EdgeData>
+	inline size_t CsrGraph<VertexData, EdgeData>::edge_num() const
+	{
+		return m_edges.size();
+	}
+
+	template<class VertexData, class EdgeData>
+	inline VertexData &CsrGraph<VertexData, EdgeData>::vertex(size_t v)
+	{
+		return m_verts[v];
+	}
+
+	template<class VertexData, class EdgeData>
+	inline typename CsrGraph<VertexData, EdgeData>::Edge &
+		CsrGraph<VertexData, EdgeData>::edge(size_t e)
+	{
+		return m_edges[e];
+	}
+
+	template<class VertexData, class EdgeData>
+	inline unsigned int CsrGraph<VertexData, EdgeData>::opposite(
+		size_t e, size_t v) const
+	{
+		return m_edges[e].v1 == v ? m_edges[e].v2 : m_edges[e].v1;
+	}
+
+	template<class VertexData, class EdgeData>
+	inline const unsigned int* CsrGraph<VertexData, EdgeData>::adj_begin(
+		size_t v) const
+	{
+		return m_adj.data() + m_offsets[v];
+	}
+
+	template<class VertexData, class EdgeData>
+	inline const unsigned int* CsrGraph<VertexData, EdgeData>::adj_end(
+		size_t v) const
+	{
+		return m_adj.data() + m_offsets[v + 1];
+	}
+
+	template<class VertexData, class EdgeData>
+	inline size_t CsrGraph<VertexData, EdgeData>::find(
+		size_t frame, unsigned int id) const
+	{
+		if (frame < m_frame0 || frame - m_frame0 + 1 >= m_frames.size())
+			return m_verts.size();
+		std::vector<unsigned int>::const_iterator first =
+			m_ids.begin() + m_frames[frame - m_frame0];
+		std::vector<unsigned int>::const_iterator last =
+			m_ids.begin() + m_frames[frame - m_frame0 + 1];
+		std::vector<unsigned int>::const_iterator iter =
+			std::lower_bound(first, last, id);
+		if (iter == last || *iter != id)
+			return m_verts.size();
+		return m_order[iter - m_ids.begin()];
+	}
+
+	template<class VertexData, class EdgeData>
+	inline void CsrGraph<VertexData, EdgeData>::clear()
+	{
+		m_packed = false;
+		m_frame0 = 0;
+		//release the memory
+		std::vector<VertexData>().swap(m_verts);
+		std::vector<Edge>().swap(m_edges);
+		std::vector<unsigned int>().swap(m_offsets);
+		std::vector<unsigned int>().swap(m_adj);
+		std::vector<unsigned int>().swap(m_frames);
+		std::vector<unsigned int>().swap(m_ids);
+		std::vector<unsigned int>().swap(m_order);
+		std::vector<std::pair<size_t, unsigned int> >().swap(m_keys);
+	}
+
+	template<class VertexData, class EdgeData>
+	inline unsigned int CsrGraph<VertexData, EdgeData>::add_vertex(
+		size_t frame, unsigned int id, const VertexData &data)
+	{
+		m_keys.push_back(std::pair<size_t, unsigned int>(frame, id));
+		m_verts.push_back(data);
+		return (unsigned int)(m_verts.size() - 1);
+	}
+
+	template<class VertexData, class EdgeData>
+	inline void CsrGraph<VertexData, EdgeData>::add_edge(
+		unsigned int v1, unsigned int v2, const EdgeData &data)
+	{
+		Edge edge = { v1, v2, data };
+		m_edges.push_back(edge);
+	}
+
+	template<class VertexData, class EdgeData>
+	inline void CsrGraph<VertexData, EdgeData>::finish()
+	{
+		size_t vnum = m_verts.size();
+		//adjacency: count, then fill in edge order
+		m_offsets.assign(vnum + 1, 0);
+		for (size_t e = 0; e < m_edges.size(); ++e)
+		{
+			m_offsets[m_edges[e].v1 + 1]++;
+			if (m_edges[e].v2 != m_edges[e].v1)
+				m_offsets[m_edges[e].v2 + 1]++;
+		}
+		for (size_t v = 0; v < vnum; ++v)
+			m_offsets[v + 1] += m_offsets[v];
+		m_adj.resize(m_offsets.back());
+		std::vector<unsigned int> pos(m_offsets.begin(), m_offsets.end() - 1);
+		for (size_t e = 0; e < m_edges.size(); ++e)
+		{
+			m_adj[pos[m_edges[e].v1]++] = (unsigned int)e;
+			if (m_edges[e].v2 != m_edges[e].v1)
+				m_adj[pos[m_edges[e].v2]++] = (unsigned int)e;
+		}
+
+		//lookup: sort by frame, then id
+		m_order.resize(vnum);
+		for (size_t v = 0; v < vnum; ++v)
+			m_order[v] = (unsigned int)v;
+		std::vector<std::pair<size_t, unsigned int> > &keys = m_keys;
+		std::sort(m_order.begin(), m_order.end(),
+			[&keys](unsigned int a, unsigned int b)
+			{ return keys[a] < keys[b]; });
+		m_ids.resize(vnum);
+		m_frames.clear();
+		m_frame0 = vnum ? keys[m_order[0]].first : 0;
+		m_frames.push_back(0);
+		for (size_t i = 0; i < vnum; ++i)
+		{
+			const std::pair<size_t, unsigned int> &key = keys[m_order[i]];
+			m_ids[i] = key.second;
+			//close the frames up to this one
+			while (m_frame0 + m_frames.size() <= key.first)
+				m_frames.push_back((unsigned int)i);
+		}
+		m_frames.push_back((unsigned int)vnum);
+		std::vector<std::pair<size_t, unsigned int> >().swap(m_keys);
+		m_packed = true;
+	}
+
+}//namespace FL
+
+#endif//FL_CsrGraph_h
@@ -0,0 +1,154 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2020 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+#ifndef FL_LinkIndex_h
+#define FL_LinkIndex_h
+
+#include "Vertex.h"
+#include <vector>
+#include <algorithm>
+
+namespace FL
+{
+	//linked vertices between two adjacent frames, flattened from an inter graph
+	//side 0 lists the links forward from the earlier frame,
+	//side 1 lists the links backward from the later one
+	//the lists keep the adjacency order of the graph
+	//it's built on first query and dropped when the links of the frames change
+	class LinkIndex
+	{
+	public:
+		typedef std::vector<pwVertex>::iterator LinkIter;
+
+		LinkIndex() : m_valid(false) {}
+
+		bool valid() const;
+		void clear();
+		//vertices linked to a vertex
+		std::pair<LinkIter, LinkIter> links(int side, Vertex* vertex);
+		size_t link_num(int side, Vertex* vertex);
+
+		//build: add links in adjacency order, then finish
+		void add(int side, Vertex* vertex, const pwVertex &linked);
+		void finish();
+
+	private:
+		struct Entry
+		{
+			Vertex* vertex;
+			size_t order;
+			pwVertex linked;
+
+			bool operator<(const Entry &e) const
+			{
+				return vertex < e.vertex ||
+					(vertex == e.vertex && order < e.order);
+			}
+		};
+
+		bool m_valid;
+		std::vector<Vertex*> m_keys[2];//sorted
+		std::vector<unsigned int> m_offsets[2];//first link of each key
+		std::vector<pwVertex> m_links[2];
+		std::vector<Entry> m_entries[2];//only while building
+	};
+
+	inline bool LinkIndex::valid() const
+	{
+		return m_valid;
+	}
+
+	inline void LinkIndex::clear()
+	{
+		m_valid = false;
+		for (int s = 0; s < 2; ++s)
+		{
+			std::vector<Vertex*>().swap(m_keys[s]);
+			std::vector<unsigned int>().swap(m_offsets[s]);
+			std::vector<pwVertex>().swap(m_links[s]);
+			std::vector<Entry>().swap(m_entries[s]);
+		}
+	}
+
+	inline std::pair<LinkIndex::LinkIter, LinkIndex::LinkIter>
+		LinkIndex::links(int side, Vertex* vertex)
+	{
+		std::vector<Vertex*> &keys = m_keys[side];
+		std::vector<Vertex*>::iterator iter =
+			std::lower_bound(keys.begin(), keys.end(), vertex);
+		if (iter == keys.end() || *iter != vertex)
+			return std::pair<LinkIter, LinkIter>(
+				m_links[side].end(), m_links[side].end());
+		size_t i = iter - keys.begin();
+		return std::pair<LinkIter, LinkIter>(
+			m_links[side].begin() + m_offsets[side][i],
+			m_links[side].begin() + m_offsets[side][i + 1]);
+	}
+
+	inline size_t LinkIndex::link_num(int side, Vertex* vertex)
+	{
+		std::pair<LinkIter, LinkIter> range = links(side, vertex);
+		return range.second - range.first;
+	}
+
+	inline void LinkIndex::add(int side, Vertex* vertex, const pwVertex &linked)
+	{
+		Entry entry;
+		entry.vertex = vertex;
+		entry.order = m_entries[side].size();
+		entry.linked = linked;
+		m_entries[side].push_back(entry);
+	}
+
+	inline void LinkIndex::finish()
+	{
+		for (int s = 0; s < 2; ++s)
+		{
+			std::vector<Entry> &entries = m_entries[s];
+			std::sort(entries.begin(), entries.end());
+			m_keys[s].clear();
+			m_offsets[s].clear();
+			m_links[s].clear();
+			m_links[s].reserve(entries.size());
+			for (size_t i = 0; i < entries.size(); ++i)
+			{
+				if (i == 0 || entries[i].vertex != entries[i - 1].vertex)
+				{
+					m_keys[s].push_back(entries[i].vertex);
+					m_offsets[s].push_back((unsigned int)i);
+				}
+				m_links[s].push_back(entries[i].linked);
+			}
+			m_offsets[s].push_back((unsigned int)entries.size());
+			std::vector<Entry>().swap(entries);
+		}
+		m_valid = true;
+	}
+
+}//namespace FL
+
+#endif//FL_LinkIndex_h
@@ -30,6 +30,11 @@ DEALINGS IN THE SOFTWARE.
 
 #include <FLIVR/BBox.h>
 #include "boost/unordered_map.hpp"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <array>
 
 namespace FL
 {
@@ -187,13 +192,154 @@ namespace FL
 		return result;
 	}
 
+	//stencil values of a region as floats, in x, y, z order
+	struct StencilBlock
+	{
+		StencilBlock() : nx(0), ny(0), nz(0) {}
+		std::vector<float> data;
+		size_t nx;
+		size_t ny;
+		size_t nz;
+	};
+
+	//copy a region within the volume of s
+	inline void get_block(const Stencil& s,
+		size_t x0, size_t y0, size_t z0,
+		size_t nx, size_t ny, size_t nz,
+		StencilBlock &block)
+	{
+		block.nx = nx;
+		block.ny = ny;
+		block.nz = nz;
+		block.data.resize(nx * ny * nz);
+		float* dst = block.data.empty() ? 0 : &block.data[0];
+		for (size_t k = 0; k < nz; ++k)
+		for (size_t j = 0; j < ny; ++j)
+		{
+			size_t index = s.nx*s.ny*(z0 + k) + s.nx*(y0 + j) + x0;
+			if (s.bits == 8)
+			{
+				unsigned char* src = (unsigned char*)(s.data) + index;
+				for (size_t i = 0; i < nx; ++i)
+					*dst++ = src[i] / 255.0f;
+			}
+			else
+			{
+				unsigned short* src = (unsigned short*)(s.data) + index;
+				for (size_t i = 0; i < nx; ++i)
+					*dst++ = src[i] * s.scale / 65535.0f;
+			}
+		}
+	}
+
+	//average pairs of voxels along the axes that are halved
+	//a last odd voxel stays by itself
+	inline void half_block(const StencilBlock &src,
+		const bool half[3], StencilBlock &dst)
+	{
+		size_t fx = half[0] ? 2 : 1;
+		size_t fy = half[1] ? 2 : 1;
+		size_t fz = half[2] ? 2 : 1;
+		dst.nx = (src.nx + fx - 1) / fx;
+		dst.ny = (src.ny + fy - 1) / fy;
+		dst.nz = (src.nz + fz - 1) / fz;
+		dst.data.resize(dst.nx * dst.ny * dst.nz);
+		for (size_t k = 0; k < dst.nz; ++k)
+		for (size_t j = 0; j < dst.ny; ++j)
+		for (size_t i = 0; i < dst.nx; ++i)
+		{
+			float sum = 0.0f;
+			size_t count = 0;
+			for (size_t kk = k * fz; kk < std::min(k * fz + fz, src.nz); ++kk)
+			for (size_t jj = j * fy; jj < std::min(j * fy + fy, src.ny); ++jj)
+			for (size_t ii = i * fx; ii < std::min(i * fx + fx, src.nx); ++ii)
+			{
+				sum += src.data[src.nx*src.ny*kk + src.nx*jj + ii];
+				count++;
+			}
+			dst.data[dst.nx*dst.ny*k + dst.nx*j + i] = sum / count;
+		}
+	}
+
+	//sum of absolute differences of t placed at (ox, oy, oz) in r
+	//the part of t outside r is left out, as in operator*
+	//stops after the slice that goes above limit
+	inline float block_sad(const StencilBlock &t, const StencilBlock &r,
+		size_t ox, size_t oy, size_t oz, float limit)
+	{
+		if (ox >= r.nx || oy >= r.ny || oz >= r.nz)
+			return 0.0f;
+		size_t nx = std::min(t.nx, r.nx - ox);
+		size_t ny = std::min(t.ny, r.ny - oy);
+		size_t nz = std::min(t.nz, r.nz - oz);
+		float result = 0.0f;
+		for (size_t k = 0; k < nz; ++k)
+		{
+			for (size_t j = 0; j < ny; ++j)
+			{
+				const float* tp = &t.data[t.nx*t.ny*k + t.nx*j];
+				const float* rp = &r.data[r.nx*r.ny*(oz + k) + r.nx*(oy + j) + ox];
+				//four sums to keep the adds independent
+				float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+				size_t i = 0;
+				for (; i + 4 <= nx; i += 4)
+				{
+					s0 += fabs(tp[i] - rp[i]);
+					s1 += fabs(tp[i + 1] - rp[i + 1]);
+					s2 += fabs(tp[i + 2] - rp[i + 2]);
+					s3 += fabs(tp[i + 3] - rp[i + 3]);
+				}
+				for (; i < nx; ++i)
+					s0 += fabs(tp[i] - rp[i]);
+				result += (s0 + s1) + (s2 + s3);
+			}
+			if (result > limit)
+				return result;
+		}
+		return result;
+	}
+
+	//offset of a stencil in the search region and its difference
+	struct StencilOffset
+	{
+		size_t x, y, z;
+		float p;
+
+		bool operator<(const StencilOffset &o) const
+		{
+			if (p != o.p)
+				return p < o.p;
+			if (z != o.z)
+				return z < o.z;
+			if (y != o.y)
+				return y < o.y;
+			return x < o.x;
+		}
+	};
+
+	//keep the num best offsets, sorted
+	inline void add_offset(std::vector<StencilOffset> &best,
+		size_t num, const StencilOffset &offset)
+	{
+		if (best.size() >= num && !(offset < best.back()))
+			return;
+		best.insert(std::upper_bound(best.begin(),
+			best.end(), offset), offset);
+		if (best.size() > num)
+			best.pop_back();
+	}
+
+	//find where s1 moves to in s2
+	//the difference is operator* at each corner of the extended box
+	//small searches try all corners; larger ones go coarse to fine
+	//on a pyramid of halved blocks: all corners at the coarsest level,
+	//then the neighbors of the few best ones at each finer level
+	//prob is the least difference over the mean difference,
+	//estimated at the coarsest level for a pyramid search
 	inline bool match_stencils(const Stencil& s1,
 		Stencil& s2, const FLIVR::Vector &ext,
 		FLIVR::Point &center, float &prob)
 	{
-		//std::ofstream file;
-		//file.open("E:/Data/Holly/test/test.txt");
-
 		FLIVR::BBox range = s1.box;
 		range.extend_ani(ext);
 		range.clamp(FLIVR::BBox(FLIVR::Point(0, 0, 0),
@@ -206,46 +352,124 @@ namespace FL
 		size_t maxx = size_t(vmax.x() + 0.5);
 		size_t maxy = size_t(vmax.y() + 0.5);
 		size_t maxz = size_t(vmax.z() + 0.5);
+		if (maxx < minx || maxy < miny || maxz < minz)
+			return false;
 
-		size_t total = (maxx - minx + 1) *
-			(maxy - miny + 1) * (maxz - minz + 1);
-		float p;
-		float minp = total;
+		//template and search region
+		size_t x1 = size_t(s1.box.min().x() + 0.5);
+		size_t y1 = size_t(s1.box.min().y() + 0.5);
+		size_t z1 = size_t(s1.box.min().z() + 0.5);
+		size_t dx = size_t(s1.box.max().x() + 0.5) - x1;
+		size_t dy = size_t(s1.box.max().y() + 0.5) - y1;
+		size_t dz = size_t(s1.box.max().z() + 0.5) - z1;
+		size_t rx = std::min(maxx + dx, s2.nx - 1) + 1 - minx;
+		size_t ry = std::min(maxy + dy, s2.ny - 1) + 1 - miny;
+		size_t rz = std::min(maxz + dz, s2.nz - 1) + 1 - minz;
+		std::vector<StencilBlock> temps(1), regions(1);
+		get_block(s1, x1, y1, z1, dx + 1, dy + 1, dz + 1, temps[0]);
+		get_block(s2, minx, miny, minz, rx, ry, rz, regions[0]);
+
+		//corners to try at each level
+		std::vector<size_t> ox(1, maxx - minx + 1);
+		std::vector<size_t> oy(1, maxy - miny + 1);
+		std::vector<size_t> oz(1, maxz - minz + 1);
+		std::vector<std::array<bool, 3> > halves;
+		const size_t brute_max = 1 << 22;
+		const size_t temp_min = 8;
+		if (ox[0] * oy[0] * oz[0] * temps[0].data.size() > brute_max)
+		{
+			while (true)
+			{
+				StencilBlock &t = temps.back();
+				std::array<bool, 3> half = {{ t.nx >= temp_min,
+					t.ny >= temp_min, t.nz >= temp_min }};
+				if (!half[0] && !half[1] && !half[2])
+					break;
+				StencilBlock t2, r2;
+				half_block(t, half.data(), t2);
+				half_block(regions.back(), half.data(), r2);
+				temps.push_back(t2);
+				regions.push_back(r2);
+				halves.push_back(half);
+				ox.push_back(half[0] ? (ox.back() + 1) / 2 : ox.back());
+				oy.push_back(half[1] ? (oy.back() + 1) / 2 : oy.back());
+				oz.push_back(half[2] ? (oz.back() + 1) / 2 : oz.back());
+			}
+		}
+
+		//all corners at the coarsest level
+		size_t level = temps.size() - 1;
+		size_t cand_num = level ? 8 : 1;
+		std::vector<StencilOffset> best;
+		size_t total = ox[level] * oy[level] * oz[level];
 		float sump = 0;
-		FLIVR::Point s2min(minx, miny, minz);
-		s2.box = FLIVR::BBox(s2min, s2min);
-		FLIVR::BBox s2temp = s2.box;
-		size_t i, j, k, ti, tj, tk;
-		for (k = minz, tk = 0; k <= maxz; ++k, ++tk)
-		for (j = miny, tj = 0; j <= maxy; ++j, ++tj)
-		for (i = minx, ti = 0; i <= maxx; ++i, ++ti)
+		StencilOffset offset;
+		for (offset.z = 0; offset.z < oz[level]; ++offset.z)
+		for (offset.y = 0; offset.y < oy[level]; ++offset.y)
+		for (offset.x = 0; offset.x < ox[level]; ++offset.x)
 		{
-			s2.box = s2temp;
-			s2.box.translate(FLIVR::Vector(ti, tj, tk));
-			p = s1 * s2;
-			//p = similar(s1, s2);
-
-			//file << p;
-			//if (i < maxx)
-			//	file << "\t";
-			//else
-			//	file << "\n";
+			offset.p = block_sad(temps[level], regions[level],
+				offset.x, offset.y, offset.z,
+				std::numeric_limits<float>::max());
+			sump += offset.p;
+			add_offset(best, cand_num, offset);
+		}
+		float meanp = level ? sump / total /
+			temps[level].data.size() * temps[0].data.size() :
+			sump / total;
 
-			sump += p;
-			if (p < minp)
+		//neighbors of the best ones at finer levels
+		while (level > 0)
+		{
+			level--;
+			const std::array<bool, 3> &half = halves[level];
+			std::vector<StencilOffset> cands;
+			for (size_t c = 0; c < best.size(); ++c)
 			{
-				minp = p;
-				center = s2.box.min();
+				size_t cx = half[0] ? best[c].x * 2 : best[c].x;
+				size_t cy = half[1] ? best[c].y * 2 : best[c].y;
+				size_t cz = half[2] ? best[c].z * 2 : best[c].z;
+				for (offset.z = cz ? cz - 1 : 0; offset.z <= std::min(cz + 1, oz[level] - 1); ++offset.z)
+				for (offset.y = cy ? cy - 1 : 0; offset.y <= std::min(cy + 1, oy[level] - 1); ++offset.y)
+				for (offset.x = cx ? cx - 1 : 0; offset.x <= std::min(cx + 1, ox[level] - 1); ++offset.x)
+				{
+					offset.p = 0;
+					cands.push_back(offset);
+				}
+			}
+			//each corner once
+			std::sort(cands.begin(), cands.end(),
+				[](const StencilOffset &a, const StencilOffset &b)
+			{ return a.z != b.z ? a.z < b.z : a.y != b.y ? a.y < b.y : a.x < b.x; });
+			cands.erase(std::unique(cands.begin(), cands.end(),
+				[](const StencilOffset &a, const StencilOffset &b)
+			{ return a.x == b.x && a.y == b.y && a.z == b.z; }), cands.end());
+
+			if (level == 0)
+				cand_num = 1;
+			best.clear();
+			for (size_t c = 0; c < cands.size(); ++c)
+			{
+				offset = cands[c];
+				float limit = best.size() < cand_num ?
+					std::numeric_limits<float>::max() : best.back().p;
+				offset.p = block_sad(temps[level], regions[level],
+					offset.x, offset.y, offset.z, limit);
+				add_offset(best, cand_num, offset);
 			}
 		}
-		prob = minp * total / sump;
-		//center += s1.box.size() / 2;
+
+		if (best.empty())
+			return false;
+		float minp = best[0].p;
+		prob = meanp > 0 ? minp / meanp : 0;
 		//center is actually the corner
+		center = FLIVR::Point(minx + best[0].x,
+			miny + best[0].y, minz + best[0].z);
 		s2.box = FLIVR::BBox(center,
 			FLIVR::Point(center + s1.box.size()));
 		s2.id = s1.id;
 
-		//file.close();
 		return true;
 	}
 
@@ -31,10 +31,15 @@ DEALINGS IN THE SOFTWARE.
 #include "Cluster/dbscan.h"
 #include "Cluster/kmeans.h"
 #include "Cluster/exmax.h"
+#include <Formats/table_writer.h>
 #include <functional>
 #include <algorithm>
 #include <limits>
+#include <thread>
+#include <atomic>
+#include <array>
 #include <boost/qvm/vec_access.hpp>
+#include <boost/unordered_set.hpp>
 
 using namespace FL;
 
@@ -56,6 +61,178 @@ TrackMap::~TrackMap()
 {
 }
 
+void TrackMap::PackGraphs(size_t frame1, size_t frame2, size_t range)
+{
+	size_t fmin = std::min(frame1, frame2);
+	size_t fmax = std::max(frame1, frame2);
+	fmin = fmin > range ? fmin - range : 0;
+	fmax += range;
+	for (size_t i = 0; i < m_intra_graph_list.size(); ++i)
+		if (i < fmin || i > fmax)
+			PackIntraGraph(i);
+	//an inter graph links frames i and i+1
+	for (size_t i = 0; i < m_inter_graph_list.size(); ++i)
+		if (i + 1 < fmin || i > fmax)
+			PackInterGraph(i);
+}
+
+void TrackMap::PackIntraGraph(size_t frame)
+{
+	if (frame >= m_intra_graph_list.size())
+		return;
+	if (m_intra_csr_list.size() < m_intra_graph_list.size())
+		m_intra_csr_list.resize(m_intra_graph_list.size());
+	CsrIntraGraph &csr = m_intra_csr_list.at(frame);
+	if (csr.packed())
+		return;
+	IntraGraph &graph = m_intra_graph_list.at(frame);
+
+	boost::unordered_map<IntraVert, unsigned int> index;
+	for (auto iv : boost::make_iterator_range(vertices(graph)))
+	{
+		index[iv] = csr.add_vertex(frame, graph[iv].id, graph[iv]);
+		pCell cell = graph[iv].cell.lock();
+		if (cell)
+			cell->SetIntraVert(IntraGraph::null_vertex());
+	}
+	for (auto ie : boost::make_iterator_range(edges(graph)))
+		csr.add_edge(index[boost::source(ie, graph)],
+			index[boost::target(ie, graph)], graph[ie]);
+	csr.finish();
+	graph.clear();
+}
+
+void TrackMap::UnpackIntraGraph(size_t frame)
+{
+	if (frame >= m_intra_csr_list.size())
+		return;
+	CsrIntraGraph &csr = m_intra_csr_list.at(frame);
+	if (!csr.packed())
+		return;
+	IntraGraph &graph = m_intra_graph_list.at(frame);
+
+	//same order as they were added, so iterations don't change
+	std::vector<IntraVert> verts(csr.vertex_num());
+	for (size_t i = 0; i < verts.size(); ++i)
+	{
+		verts[i] = boost::add_vertex(csr.vertex(i), graph);
+		pCell cell = graph[verts[i]].cell.lock();
+		if (cell)
+			cell->SetIntraVert(verts[i]);
+	}
+	for (size_t i = 0; i < csr.edge_num(); ++i)
+	{
+		CsrIntraGraph::Edge &edge = csr.edge(i);
+		boost::add_edge(verts[edge.v1], verts[edge.v2], edge.data, graph);
+	}
+	csr.clear();
+}
+
+void TrackMap::PackInterGraph(size_t frame)
+{
+	if (frame >= m_inter_graph_list.size())
+		return;
+	if (m_inter_csr_list.size() < m_inter_graph_list.size())
+		m_inter_csr_list.resize(m_inter_graph_list.size());
+	CsrInterGraph &csr = m_inter_csr_list.at(frame);
+	if (csr.packed())
+		return;
+	InterGraph &graph = m_inter_graph_list.at(frame);
+
+	boost::unordered_map<InterVert, unsigned int> index;
+	for (auto iv : boost::make_iterator_range(vertices(graph)))
+	{
+		index[iv] = csr.add_vertex(graph[iv].frame, graph[iv].id, graph[iv]);
+		pVertex vertex = graph[iv].vertex.lock();
+		if (vertex)
+			vertex->PackInterVert(graph);
+	}
+	for (auto ie : boost::make_iterator_range(edges(graph)))
+		csr.add_edge(index[boost::source(ie, graph)],
+			index[boost::target(ie, graph)], graph[ie]);
+	csr.finish();
+	graph.clear();
+}
+
+void TrackMap::UnpackInterGraph(size_t frame)
+{
+	if (frame >= m_inter_csr_list.size())
+		return;
+	CsrInterGraph &csr = m_inter_csr_list.at(frame);
+	if (!csr.packed())
+		return;
+	InterGraph &graph = m_inter_graph_list.at(frame);
+
+	std::vector<InterVert> verts(csr.vertex_num());
+	for (size_t i = 0; i < verts.size(); ++i)
+	{
+		verts[i] = boost::add_vertex(csr.vertex(i), graph);
+		pVertex vertex = graph[verts[i]].vertex.lock();
+		if (vertex)
+			vertex->UnpackInterVert(graph, verts[i]);
+	}
+	for (size_t i = 0; i < csr.edge_num(); ++i)
+	{
+		CsrInterGraph::Edge &edge = csr.edge(i);
+		boost::add_edge(verts[edge.v1], verts[edge.v2], edge.data, graph);
+	}
+	csr.clear();
+}
+
+void TrackMap::BuildLinkIndex(size_t frame)
+{
+	LinkIndex &link_index = m_link_list.at(frame);
+	link_index.clear();
+	if (frame >= m_inter_graph_list.size())
+		return;
+
+	//side 0 for vertices in the earlier frame
+	//read packed graphs without unpacking
+	if (frame < m_inter_csr_list.size() &&
+		m_inter_csr_list[frame].packed())
+	{
+		CsrInterGraph &csr = m_inter_csr_list[frame];
+		for (size_t iv = 0; iv < csr.vertex_num(); ++iv)
+		{
+			pVertex vertex = csr.vertex(iv).vertex.lock();
+			if (!vertex)
+				continue;
+			int side = csr.vertex(iv).frame == frame ? 0 : 1;
+			for (const unsigned int* ie = csr.adj_begin(iv);
+				ie != csr.adj_end(iv); ++ie)
+			{
+				if (!csr.edge(*ie).data.link)
+					continue;
+				unsigned int iv2 = csr.opposite(*ie, iv);
+				if (iv2 == iv)
+					continue;
+				link_index.add(side, vertex.get(), csr.vertex(iv2).vertex);
+			}
+		}
+	}
+	else
+	{
+		InterGraph &graph = m_inter_graph_list.at(frame);
+		for (auto iv : boost::make_iterator_range(vertices(graph)))
+		{
+			pVertex vertex = graph[iv].vertex.lock();
+			if (!vertex)
+				continue;
+			int side = graph[iv].frame == frame ? 0 : 1;
+			for (auto ie : boost::make_iterator_range(out_edges(iv, graph)))
+			{
+				if (!graph[ie].link)
+					continue;
+				InterVert iv2 = boost::target(ie, graph);
+				if (iv2 == iv)
+					continue;
+				link_index.add(side, vertex.get(), graph[iv2].vertex);
+			}
+		}
+	}
+	link_index.finish();
+}
+
 void TrackMapProcessor::SetSizes(size_t nx, size_t ny, size_t nz)
 {
 	m_map->m_size_x = nx;
@@ -85,6 +262,258 @@ void TrackMapProcessor::SetVolCacheSize(size_t size)
 	m_vol_cache.set_max_size(size);
 }
 
+void TrackMapProcessor::SetGraphCacheSize(size_t size)
+{
+	m_graph_cache = size;
+}
+
+//voxel sums of a cell, kept as integers so that the totals don't depend
+//on the order the voxels are visited in or how the volume is split
+struct CellSum
+{
+	unsigned long long count;
+	unsigned long long sum_i, sum_j, sum_k;
+	unsigned long long sum_v;//raw intensity
+	size_t min_i, min_j, min_k;
+	size_t max_i, max_j, max_k;
+};
+typedef boost::unordered_map<unsigned int, CellSum> CellSumList;
+
+//contact between two cells, both directions counted
+struct ContactSum
+{
+	unsigned int count;
+	unsigned long long sum_v;//raw intensity
+};
+typedef boost::unordered_map<unsigned long long, ContactSum> ContactSumList;
+
+//boundary voxels of a cell
+struct ExternalSum
+{
+	unsigned int count;
+	unsigned long long sum_v;//raw intensity
+};
+
+//a frame is swept in z slabs, one for each thread
+//each slab is traversed x fastest, so rows are read contiguously
+static size_t GetSlabNum(size_t nz)
+{
+	size_t thread_num = std::thread::hardware_concurrency();
+	return std::max(size_t(1), std::min(thread_num, nz));
+}
+
+static void RunSlabs(size_t slab_num, size_t nz,
+	const std::function<void(size_t, size_t, size_t)> &func)
+{
+	auto slab = [&](size_t s)
+	{
+		func(s, nz * s / slab_num, nz * (s + 1) / slab_num);
+	};
+	std::vector<std::thread> threads;
+	for (size_t s = 1; s < slab_num; ++s)
+		threads.push_back(std::thread(slab, s));
+	slab(0);
+	for (size_t s = 0; s < threads.size(); ++s)
+		threads[s].join();
+}
+
+//same conversion as a single voxel, applied to a sum
+inline float GetVoxelValue(unsigned int raw, size_t bits, float scale)
+{
+	if (bits == 8)
+		return raw / 255.0f;
+	else if (bits == 16)
+		return raw * scale / 65535.0f;
+	return 0.0f;
+}
+
+inline float GetSumValue(unsigned long long sum, size_t bits, float scale)
+{
+	if (bits == 8)
+		return float(sum / 255.0);
+	else if (bits == 16)
+		return float(sum * double(scale) / 65535.0);
+	return 0.0f;
+}
+
+//accumulate runs of the same label along x
+template<typename T>
+static void SumCells(const T* data, const unsigned int* label,
+	size_t nx, size_t ny, size_t z0, size_t z1, CellSumList &sums)
+{
+	CellSum* sum = 0;
+	unsigned int last = 0;
+	for (size_t k = z0; k < z1; ++k)
+	for (size_t j = 0; j < ny; ++j)
+	{
+		size_t row = nx*ny*k + nx*j;
+		const unsigned int* lrow = label + row;
+		const T* drow = data + row;
+		size_t i = 0;
+		while (i < nx)
+		{
+			unsigned int id = lrow[i];
+			if (!id)
+			{
+				++i;
+				continue;
+			}
+			size_t i0 = i;
+			unsigned long long v = 0;
+			for (; i < nx && lrow[i] == id; ++i)
+				v += drow[i];
+			size_t len = i - i0;
+
+			if (!sum || id != last)
+			{
+				CellSumList::iterator iter = sums.find(id);
+				if (iter == sums.end())
+				{
+					CellSum s = { 0, 0, 0, 0, 0,
+						i0, j, k, i - 1, j, k };
+					iter = sums.insert(std::pair<unsigned int, CellSum>(id, s)).first;
+				}
+				sum = &(iter->second);
+				last = id;
+			}
+			sum->count += len;
+			sum->sum_i += (unsigned long long)(i0 + i - 1) * len / 2;
+			sum->sum_j += (unsigned long long)j * len;
+			sum->sum_k += (unsigned long long)k * len;
+			sum->sum_v += v;
+			sum->min_i = std::min(sum->min_i, i0);
+			sum->max_i = std::max(sum->max_i, i - 1);
+			sum->min_j = std::min(sum->min_j, j);
+			sum->max_j = std::max(sum->max_j, j);
+			sum->min_k = std::min(sum->min_k, k);
+			sum->max_k = std::max(sum->max_k, k);
+		}
+	}
+}
+
+//prune labels of small cells and find contacts and boundaries of the rest
+//cells is the index of each kept label in externals
+//a voxel touches the outside if any face neighbor is a different label,
+//background or the volume border
+//the first and last planes of a slab are read by the neighboring slabs,
+//so their pruning is left to the caller
+template<typename T>
+static void CheckContacts(const T* data, unsigned int* label,
+	size_t nx, size_t ny, size_t nz, size_t z0, size_t z1,
+	size_t bits, float scale, float contact_thresh,
+	const boost::unordered_map<unsigned int, unsigned int> &cells,
+	std::vector<ExternalSum> &externals, ContactSumList &contacts)
+{
+	const unsigned int none = std::numeric_limits<unsigned int>::max();
+	unsigned int last = 0, cur = none;
+	unsigned int lastn = 0, curn = none;
+	size_t nxy = nx * ny;
+	auto find = [&](unsigned int id)
+	{
+		boost::unordered_map<unsigned int, unsigned int>::const_iterator iter =
+			cells.find(id);
+		return iter == cells.end() ? none : iter->second;
+	};
+	for (size_t k = z0; k < z1; ++k)
+	for (size_t j = 0; j < ny; ++j)
+	{
+		size_t index = nxy*k + nx*j;
+		for (size_t i = 0; i < nx; ++i, ++index)
+		{
+			unsigned int id = label[index];
+			if (!id)
+				continue;
+			if (id != last)
+			{
+				last = id;
+				cur = find(id);
+			}
+			if (cur == none)
+			{
+				if (k != z0 && k + 1 != z1)
+					label[index] = 0;
+				continue;
+			}
+
+			unsigned int raw = data[index];
+			int ec = 0;//external count
+			auto check = [&](size_t indexn)
+			{
+				unsigned int idn = label[indexn];
+				if (idn == id)
+					return;
+				ec++;
+				if (!idn)
+					return;
+				if (idn != lastn)
+				{
+					lastn = idn;
+					curn = find(idn);
+				}
+				if (curn == none)
+					return;
+				unsigned int rawc = std::min(raw, (unsigned int)data[indexn]);
+				if (GetVoxelValue(rawc, bits, scale) > contact_thresh)
+				{
+					unsigned long long key = std::min(cur, curn);
+					key = (key << 32) | std::max(cur, curn);
+					ContactSum &contact = contacts[key];
+					contact.count++;
+					contact.sum_v += rawc;
+				}
+			};
+			if (i == 0) ec++; else check(index - 1);
+			if (i + 1 >= nx) ec++; else check(index + 1);
+			if (j == 0) ec++; else check(index - nx);
+			if (j + 1 >= ny) ec++; else check(index + nx);
+			if (k == 0) ec++; else check(index - nxy);
+			if (k + 1 >= nz) ec++; else check(index + nxy);
+
+			if (ec)
+			{
+				externals[cur].count++;
+				externals[cur].sum_v += raw;
+			}
+		}
+	}
+}
+
+//voxels where a label of one frame meets a label of the next
+//keyed by the two labels
+struct OverlapSum
+{
+	unsigned int count;
+	unsigned long long sum_v;//raw intensity, lower of the two frames
+};
+typedef boost::unordered_map<unsigned long long, OverlapSum> OverlapSumList;
+
+//overlap only needs the same voxel of both frames,
+//so a slab is swept as one flat range
+template<typename T>
+static void SumOverlaps(const T* data1, const T* data2,
+	const unsigned int* label1, const unsigned int* label2,
+	size_t begin, size_t end, OverlapSumList &sums)
+{
+	OverlapSum* sum = 0;
+	unsigned long long last = 0;
+	for (size_t index = begin; index < end; ++index)
+	{
+		unsigned int l1 = label1[index];
+		unsigned int l2 = label2[index];
+		if (!l1 || !l2)
+			continue;
+		unsigned long long key = l1;
+		key = (key << 32) | l2;
+		if (!sum || key != last)
+		{
+			sum = &sums[key];
+			last = key;
+		}
+		sum->count++;
+		sum->sum_v += std::min(data1[index], data2[index]);
+	}
+}
+
 bool TrackMapProcessor::InitializeFrame(size_t frame)
 {
 	//get label and data from cache
@@ -94,105 +523,177 @@ bool TrackMapProcessor::InitializeFrame(size_t frame)
 	if (!data || !label)
 		return false;
 
+	//keep the frames around the current ones unpacked
+	if (m_graph_cache)
+		m_map->PackGraphs(frame, frame, m_graph_cache);
+
 	//add one empty cell list to track_map
 	m_map->m_cells_list.push_back(CellList());
 	CellList &cell_list = m_map->m_cells_list.back();
-	CellListIter iter;
 	//in the meanwhile build the intra graph
 	m_map->m_intra_graph_list.push_back(IntraGraph());
+	IntraGraph &intra_graph = m_map->m_intra_graph_list.back();
 
-	size_t index;
-	size_t i, j, k;
 	size_t nx = m_map->m_size_x;
 	size_t ny = m_map->m_size_y;
 	size_t nz = m_map->m_size_z;
-	float data_value;
-	unsigned int label_value;
+	size_t bits = m_map->m_data_bits;
+	float scale = m_map->m_scale;
+	unsigned int* lbl = (unsigned int*)label;
+	size_t slab_num = GetSlabNum(nz);
 
-	//build cell list
-	for (i = 0; i < nx; ++i)
-	for (j = 0; j < ny; ++j)
-	for (k = 0; k < nz; ++k)
+	//sum up cells, each slab into its own list
+	std::vector<CellSumList> slab_sums(slab_num);
+	RunSlabs(slab_num, nz, [&](size_t s, size_t z0, size_t z1)
 	{
-		index = nx*ny*k + nx*j + i;
-		label_value = ((unsigned int*)label)[index];
-
-		if (!label_value)
-			continue;
-
-		if (m_map->m_data_bits == 8)
-			data_value = ((unsigned char*)data)[index] / 255.0f;
-		else if (m_map->m_data_bits == 16)
-			data_value = ((unsigned short*)data)[index] * m_map->m_scale / 65535.0f;
-
-		iter = cell_list.find(label_value);
-		if (iter != cell_list.end())
-		{
-			iter->second->Inc(i, j, k, data_value);
-		}
+		if (bits == 16)
+			SumCells((unsigned short*)data, lbl, nx, ny, z0, z1, slab_sums[s]);
 		else
+			SumCells((unsigned char*)data, lbl, nx, ny, z0, z1, slab_sums[s]);
+	});
+	CellSumList &sums = slab_sums[0];
+	for (size_t s = 1; s < slab_num; ++s)
+	for (auto iter = slab_sums[s].begin();
+		iter != slab_sums[s].end(); ++iter)
+	{
+		CellSumList::iterator iter0 = sums.find(iter->first);
+		if (iter0 == sums.end())
 		{
-			Cell* cell = new Cell(label_value);
-			cell->Inc(i, j, k, data_value);
-			cell_list.insert(std::pair<unsigned int, pCell>
-				(label_value, pCell(cell)));
+			sums.insert(*iter);
+			continue;
 		}
+		CellSum &s0 = iter0->second;
+		const CellSum &s1 = iter->second;
+		s0.count += s1.count;
+		s0.sum_i += s1.sum_i;
+		s0.sum_j += s1.sum_j;
+		s0.sum_k += s1.sum_k;
+		s0.sum_v += s1.sum_v;
+		s0.min_i = std::min(s0.min_i, s1.min_i);
+		s0.min_j = std::min(s0.min_j, s1.min_j);
+		s0.min_k = std::min(s0.min_k, s1.min_k);
+		s0.max_i = std::max(s0.max_i, s1.max_i);
+		s0.max_j = std::max(s0.max_j, s1.max_j);
+		s0.max_k = std::max(s0.max_k, s1.max_k);
+	}
+
+	//all ids in the label, for choosing new ones
+	size_t cur_frame = m_map->m_cells_list.size() - 1;
+	if (m_map->m_used_ids_list.size() <= cur_frame)
+		m_map->m_used_ids_list.resize(cur_frame + 1);
+	std::vector<unsigned int> &used_ids = m_map->m_used_ids_list[cur_frame];
+	used_ids.clear();
+	used_ids.reserve(sums.size());
+	for (auto iter = sums.begin(); iter != sums.end(); ++iter)
+		used_ids.push_back(iter->first);
+	std::sort(used_ids.begin(), used_ids.end());
+
+	//keep cells above the size threshold, in id order
+	std::vector<pCell> cells;
+	for (auto iter = sums.begin(); iter != sums.end(); ++iter)
+	{
+		const CellSum &sum = iter->second;
+		double count = double(sum.count);
+		float size_f = GetSumValue(sum.sum_v, bits, scale);
+		if (size_f < m_size_thresh)
+			continue;
+		pCell cell(new Cell(iter->first));
+		cell->SetCenter(FLIVR::Point(
+			sum.sum_i / count, sum.sum_j / count, sum.sum_k / count));
+		cell->SetSizeUi((unsigned int)sum.count);
+		cell->SetSizeF(size_f);
+		cell->SetBox(FLIVR::BBox(
+			FLIVR::Point(double(sum.min_i), double(sum.min_j), double(sum.min_k)),
+			FLIVR::Point(double(sum.max_i), double(sum.max_j), double(sum.max_k))));
+		cells.push_back(cell);
+	}
+	std::sort(cells.begin(), cells.end(),
+		[](const pCell &c1, const pCell &c2) { return c1->Id() < c2->Id(); });
+	boost::unordered_map<unsigned int, unsigned int> cell_index;
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		cell_index[cells[i]->Id()] = (unsigned int)i;
+		cell_list.insert(std::pair<unsigned int, pCell>
+			(cells[i]->Id(), cells[i]));
 	}
 
-	//prune list
-	for (auto celli = cell_list.begin();
-		celli != cell_list.end(); )
+	//prune data and build intra graph in one sweep
+	std::vector<std::vector<ExternalSum>> slab_externals(slab_num);
+	std::vector<ContactSumList> slab_contacts(slab_num);
+	RunSlabs(slab_num, nz, [&](size_t s, size_t z0, size_t z1)
 	{
-		if (celli->second->GetSizeF() < m_size_thresh)
-			celli = cell_list.erase(celli);
+		ExternalSum zero = { 0, 0 };
+		slab_externals[s].assign(cells.size(), zero);
+		if (bits == 16)
+			CheckContacts((unsigned short*)data, lbl, nx, ny, nz, z0, z1,
+				bits, scale, m_contact_thresh, cell_index,
+				slab_externals[s], slab_contacts[s]);
 		else
-			++celli;
-	}
-	//prune data
-	size_t tsize = nx * ny * nz;
-	for (index = 0; index < tsize; ++index)
-	{
-		label_value = ((unsigned int*)label)[index];
-		if (label_value &&
-			cell_list.find(label_value) ==
-			cell_list.end())
-			((unsigned int*)label)[index] = 0;
+			CheckContacts((unsigned char*)data, lbl, nx, ny, nz, z0, z1,
+				bits, scale, m_contact_thresh, cell_index,
+				slab_externals[s], slab_contacts[s]);
+	});
+	//prune the planes shared by slabs
+	for (size_t s = 0; s < slab_num; ++s)
+	{
+		size_t zs[2] = { nz * s / slab_num, nz * (s + 1) / slab_num - 1 };
+		for (size_t p = 0; p < 2; ++p)
+		{
+			unsigned int* plane = lbl + nx*ny*zs[p];
+			for (size_t index = 0; index < nx*ny; ++index)
+				if (plane[index] &&
+					cell_index.find(plane[index]) == cell_index.end())
+					plane[index] = 0;
+		}
 	}
 	//label modified, save before delete
 	m_vol_cache.set_modified(frame);
 
-	//build intra graph
-	for (i = 0; i < nx; ++i)
-	for (j = 0; j < ny; ++j)
-	for (k = 0; k < nz; ++k)
+	for (size_t i = 0; i < cells.size(); ++i)
 	{
-		index = nx*ny*k + nx*j + i;
-		label_value = ((unsigned int*)label)[index];
-		if (!label_value)
-			continue;
-
-		iter = cell_list.find(label_value);
-		if (iter != cell_list.end())
+		unsigned long long count = 0, sum_v = 0;
+		for (size_t s = 0; s < slab_num; ++s)
 		{
-			CheckCellContact(iter->second, data, label,
-				i, j, k);
+			count += slab_externals[s][i].count;
+			sum_v += slab_externals[s][i].sum_v;
 		}
+		cells[i]->SetExternalUi((unsigned int)count);
+		cells[i]->SetExternalF(GetSumValue(sum_v, bits, scale));
+	}
+	ContactSumList &contacts = slab_contacts[0];
+	for (size_t s = 1; s < slab_num; ++s)
+	for (auto iter = slab_contacts[s].begin();
+		iter != slab_contacts[s].end(); ++iter)
+	{
+		ContactSum &contact = contacts[iter->first];
+		contact.count += iter->second.count;
+		contact.sum_v += iter->second.sum_v;
+	}
+	std::vector<unsigned long long> keys;
+	keys.reserve(contacts.size());
+	for (auto iter = contacts.begin(); iter != contacts.end(); ++iter)
+		keys.push_back(iter->first);
+	std::sort(keys.begin(), keys.end());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		const ContactSum &contact = contacts[keys[i]];
+		AddIntraEdge(intra_graph, cells[keys[i] >> 32],
+			cells[keys[i] & 0xffffffff], contact.count,
+			GetSumValue(contact.sum_v, bits, scale), 0.0f, 0.0f);
 	}
 
 	//build vertex list
 	m_map->m_vertices_list.push_back(VertexList());
 	VertexList &vertex_list = m_map->m_vertices_list.back();
-	for (CellList::iterator cell_iterator = cell_list.begin();
-	cell_iterator != cell_list.end(); ++cell_iterator)
+	for (size_t i = 0; i < cells.size(); ++i)
 	{
-		if (cell_iterator->second->GetSizeF() < m_size_thresh)
-			continue;
-		pVertex vertex(new Vertex(cell_iterator->second->Id()));
-		vertex->SetCenter(cell_iterator->second->GetCenter());
-		vertex->SetSizeUi(cell_iterator->second->GetSizeUi());
-		vertex->SetSizeF(cell_iterator->second->GetSizeF());
-		vertex->AddCell(cell_iterator->second);
-		cell_iterator->second->AddVertex(vertex);
+		pCell &cell = cells[i];
+		pVertex vertex(new Vertex(cell->Id()));
+		vertex->SetCenter(cell->GetCenter());
+		vertex->SetSizeUi(cell->GetSizeUi());
+		vertex->SetSizeF(cell->GetSizeF());
+		vertex->AddCell(cell);
+		cell->AddVertex(vertex);
 		vertex_list.insert(std::pair<unsigned int, pVertex>
 			(vertex->Id(), vertex));
 	}
@@ -201,108 +702,6 @@ bool TrackMapProcessor::InitializeFrame(size_t frame)
 	return true;
 }
 
-#define ADD_CONTACT \
-	idn = ((unsigned int*)label)[indexn]; \
-	if (!idn) \
-		ec++; \
-		else if (idn != id) \
-	{ \
-		ec++; \
-		if (data_bits == 8) \
-			valuen = ((unsigned char*)data)[indexn] / 255.0f; \
-		else if (data_bits == 16) \
-			valuen = ((unsigned short*)data)[indexn] * scale / 65535.0f; \
-		contact_value = std::min(value, valuen); \
-		if (contact_value > m_contact_thresh) \
-		{ \
-			cc++; \
-			iter = cell_list.find(idn); \
-			if (iter != cell_list.end()) \
-				AddContact(intra_graph, cell, iter->second, contact_value); \
-		} \
-	}
-
-bool TrackMapProcessor::CheckCellContact(
-	pCell &cell, void *data, void *label,
-	size_t ci, size_t cj, size_t ck)
-{
-	int ec = 0;//external count
-	int cc = 0;//contact count
-	size_t nx = m_map->m_size_x;
-	size_t ny = m_map->m_size_y;
-	size_t nz = m_map->m_size_z;
-	size_t indexn;//neighbor index
-	unsigned int idn;//neighbor id
-	float valuen;//neighbor vlaue
-	size_t index = nx*ny*ck + nx*cj + ci;
-	unsigned int id = cell->Id();
-	float value;
-	size_t data_bits = m_map->m_data_bits;
-	float scale = m_map->m_scale;
-	if (data_bits == 8)
-		value = ((unsigned char*)data)[index] / 255.0f;
-	else if (data_bits == 16)
-		value = ((unsigned short*)data)[index] * scale / 65535.0f;
-	float contact_value;
-	IntraGraph &intra_graph = m_map->m_intra_graph_list.back();
-	CellList &cell_list = m_map->m_cells_list.back();
-	CellListIter iter;
-
-	if (ci == 0)
-		ec++;
-	else
-	{
-		indexn = index - 1;
-		ADD_CONTACT;
-	}
-	if (ci >= nx - 1)
-		ec++;
-	else
-	{
-		indexn = index + 1;
-		ADD_CONTACT;
-	}
-	if (cj == 0)
-		ec++;
-	else
-	{
-		indexn = index - nx;
-		ADD_CONTACT;
-	}
-	if (cj >= ny - 1)
-		ec++;
-	else
-	{
-		indexn = index + nx;
-		ADD_CONTACT;
-	}
-	if (ck == 0)
-		ec++;
-	else
-	{
-		indexn = index - nx*ny;
-		ADD_CONTACT;
-	}
-	if (ck >= nz - 1)
-		ec++;
-	else
-	{
-		indexn = index + nx*ny;
-		ADD_CONTACT;
-	}
-
-	if (ec)
-	{
-		cell->IncExternal(value);
-
-		//expand search range if it's external but not contacting
-		//if (cc == 0)
-		//	CheckCellDist(cell, label, ci, cj, ck);
-	}
-
-	return true;
-}
-
 bool TrackMapProcessor::CheckCellDist(
 	pCell &cell, void *label, size_t ci, size_t cj, size_t ck)
 {
@@ -346,46 +745,6 @@ bool TrackMapProcessor::CheckCellDist(
 	return true;
 }
 
-bool TrackMapProcessor::AddContact(IntraGraph& graph,
-	pCell &cell1, pCell &cell2, float contact_value)
-{
-	IntraVert v1 = cell1->GetIntraVert();
-	IntraVert v2 = cell2->GetIntraVert();
-	if (v1 == IntraGraph::null_vertex())
-	{
-		v1 = boost::add_vertex(graph);
-		graph[v1].id = cell1->Id();
-		graph[v1].cell = cell1;
-		cell1->SetIntraVert(v1);
-	}
-	if (v2 == IntraGraph::null_vertex())
-	{
-		v2 = boost::add_vertex(graph);
-		graph[v2].id = cell2->Id();
-		graph[v2].cell = cell2;
-		cell2->SetIntraVert(v2);
-	}
-
-	std::pair<IntraEdge, bool> e = boost::edge(v1, v2, graph);
-	if (!e.second)
-	{
-		e = boost::add_edge(v1, v2, graph);
-		graph[e.first].size_ui = 1;
-		graph[e.first].size_f = contact_value;
-		graph[e.first].dist_v = 0.0f;
-		graph[e.first].dist_s = 0.0f;
-	}
-	else
-	{
-		graph[e.first].size_ui++;
-		graph[e.first].size_f += contact_value;
-		graph[e.first].dist_v = 0.0f;
-		graph[e.first].dist_s = 0.0f;
-	}
-
-	return true;
-}
-
 bool TrackMapProcessor::AddNeighbor(IntraGraph& graph,
 	pCell &cell1, pCell &cell2,
 	float dist_v, float dist_s)
@@ -434,10 +793,15 @@ bool TrackMapProcessor::AddNeighbor(IntraGraph& graph,
 bool TrackMapProcessor::LinkFrames(
 	size_t f1, size_t f2)
 {
+	m_map->DirtyLinks(f1, f2);
 	size_t frame_num = m_map->m_frame_num;
 	if (f1 >= frame_num || f2 >= frame_num || f1 == f2)
 		return false;
 
+	//keep the frames around the current ones unpacked
+	if (m_graph_cache)
+		m_map->PackGraphs(f1, f2, m_graph_cache);
+
 	//get data and label
 	VolCache cache = m_vol_cache.get(f1);
 	m_vol_cache.protect(f1);
@@ -456,40 +820,48 @@ bool TrackMapProcessor::LinkFrames(
 	inter_graph.index = f1;
 	inter_graph.counter = 0;
 
-	size_t index;
-	size_t i, j, k;
 	size_t nx = m_map->m_size_x;
 	size_t ny = m_map->m_size_y;
 	size_t nz = m_map->m_size_z;
-	float data_value1, data_value2;
-	unsigned int label_value1, label_value2;
+	size_t bits = m_map->m_data_bits;
+	float scale = m_map->m_scale;
+	size_t slab_num = GetSlabNum(nz);
+
+	//histogram of overlapping label pairs, each slab into its own list
+	std::vector<OverlapSumList> slab_sums(slab_num);
+	RunSlabs(slab_num, nz, [&](size_t s, size_t z0, size_t z1)
+	{
+		if (bits == 16)
+			SumOverlaps((unsigned short*)data1, (unsigned short*)data2,
+				(unsigned int*)label1, (unsigned int*)label2,
+				nx*ny*z0, nx*ny*z1, slab_sums[s]);
+		else
+			SumOverlaps((unsigned char*)data1, (unsigned char*)data2,
+				(unsigned int*)label1, (unsigned int*)label2,
+				nx*ny*z0, nx*ny*z1, slab_sums[s]);
+	});
+	OverlapSumList &sums = slab_sums[0];
+	for (size_t s = 1; s < slab_num; ++s)
+	for (auto iter = slab_sums[s].begin();
+		iter != slab_sums[s].end(); ++iter)
+	{
+		OverlapSum &sum = sums[iter->first];
+		sum.count += iter->second.count;
+		sum.sum_v += iter->second.sum_v;
+	}
+
+	//link vertices once for each pair, in label order
+	std::vector<unsigned long long> keys;
+	keys.reserve(sums.size());
+	for (auto iter = sums.begin(); iter != sums.end(); ++iter)
+		keys.push_back(iter->first);
+	std::sort(keys.begin(), keys.end());
 	pVertex v1, v2;
 	pCell cl1, cl2;
-
-	for (i = 0; i < nx; ++i)
-	for (j = 0; j < ny; ++j)
-	for (k = 0; k < nz; ++k)
+	for (size_t i = 0; i < keys.size(); ++i)
 	{
-		index = nx*ny*k + nx*j + i;
-		label_value1 = ((unsigned int*)label1)[index];
-		label_value2 = ((unsigned int*)label2)[index];
-
-		if (!label_value1 || !label_value2)
-			continue;
-
-		if (m_map->m_data_bits == 8)
-		{
-			data_value1 = ((unsigned char*)data1)[index] / 255.0f;
-			data_value2 = ((unsigned char*)data2)[index] / 255.0f;
-		}
-		else if (m_map->m_data_bits == 16)
-		{
-			data_value1 = ((unsigned short*)data1)[index] * m_map->m_scale / 65535.0f;
-			data_value2 = ((unsigned short*)data2)[index] * m_map->m_scale / 65535.0f;
-		}
-
-		cl1 = GetCell(f1, label_value1);
-		cl2 = GetCell(f2, label_value2);
+		cl1 = GetCell(f1, (unsigned int)(keys[i] >> 32));
+		cl2 = GetCell(f2, (unsigned int)(keys[i] & 0xffffffff));
 		v1 = GetVertex(cl1);
 		v2 = GetVertex(cl2);
 		if (!v1 || !v2)
@@ -499,9 +871,11 @@ bool TrackMapProcessor::LinkFrames(
 			v2->GetSizeUi() < m_size_thresh)
 			continue;
 
+		const OverlapSum &sum = sums[keys[i]];
 		LinkVertices(inter_graph,
 			v1, v2, f1, f2,
-			std::min(data_value1, data_value2));
+			GetSumValue(sum.sum_v, bits, scale),
+			sum.count);
 	}
 
 	m_vol_cache.unprotect(f1);
@@ -511,7 +885,8 @@ bool TrackMapProcessor::LinkFrames(
 
 bool TrackMapProcessor::LinkVertices(InterGraph& graph,
 	pVertex &vertex1, pVertex &vertex2,
-	size_t f1, size_t f2, float overlap_value)
+	size_t f1, size_t f2, float overlap_value,
+	unsigned int overlap_size)
 {
 	InterVert v1 = vertex1->GetInterVert(graph);
 	InterVert v2 = vertex2->GetInterVert(graph);
@@ -538,7 +913,7 @@ bool TrackMapProcessor::LinkVertices(InterGraph& graph,
 	if (!e.second)
 	{
 		e = boost::add_edge(v1, v2, graph);
-		graph[e.first].size_ui = 1;
+		graph[e.first].size_ui = overlap_size;
 		graph[e.first].size_f = overlap_value;
 		FLIVR::Point p1 = vertex1->GetCenter();
 		FLIVR::Point p2 = vertex2->GetCenter();
@@ -548,7 +923,7 @@ bool TrackMapProcessor::LinkVertices(InterGraph& graph,
 	}
 	else
 	{
-		graph[e.first].size_ui++;
+		graph[e.first].size_ui += overlap_size;
 		graph[e.first].size_f += overlap_value;
 	}
 
@@ -773,58 +1148,121 @@ bool TrackMapProcessor::UnlinkVertices(InterGraph& graph,
 
 bool TrackMapProcessor::ResolveGraph(size_t frame1, size_t frame2)
 {
+	m_map->DirtyLinks(frame1, frame2);
 	if (frame1 >= m_map->m_frame_num ||
 		frame2 >= m_map->m_frame_num ||
 		frame1 == frame2)
 		return false;
 
+	//keep the frames around the current ones unpacked
+	if (m_graph_cache)
+		m_map->PackGraphs(frame1, frame2, m_graph_cache);
+
 	VertexList &vertex_list1 = m_map->m_vertices_list.at(frame1);
 	VertexList &vertex_list2 = m_map->m_vertices_list.at(frame2);
-	IntraGraph &intra_graph = m_map->m_intra_graph_list.at(frame2);
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	IntraGraph &intra_graph = m_map->GetIntraGraph(frame2);
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		frame1 > frame2 ? frame2 : frame1);
 
-	VertexListIter iter;
-	InterVert v1, v2;
-	std::pair<InterAdjIter, InterAdjIter> adj_verts;
-	InterAdjIter inter_iter;
-	std::vector<pwCell> cells;
-	std::vector<CellBin> cell_bins;
-	CellBinIter pwcell_iter;
-	pVertex vertex2;
-
-	//check all vertices in the time frame
-	for (iter = vertex_list1.begin();
-	iter != vertex_list1.end(); ++iter)
+	//cells of frame2 vertices linked to a frame1 vertex
+	auto get_cells = [&](pVertex &vertex1, std::vector<pwCell> &cells)
 	{
-		v1 = iter->second->GetInterVert(inter_graph);
+		InterVert v1 = vertex1->GetInterVert(inter_graph);
 		if (v1 == InterGraph::null_vertex())
-			continue;
-		adj_verts = boost::adjacent_vertices(v1, inter_graph);
+			return false;
+		std::pair<InterAdjIter, InterAdjIter> adj_verts =
+			boost::adjacent_vertices(v1, inter_graph);
 		//for each adjacent vertex
 		//add cells to cells the list
-		cells.clear();
-		for (inter_iter = adj_verts.first;
+		for (InterAdjIter inter_iter = adj_verts.first;
 		inter_iter != adj_verts.second; ++inter_iter)
 		{
-			v2 = *inter_iter;
-			vertex2 = inter_graph[v2].vertex.lock();
+			pVertex vertex2 = inter_graph[*inter_iter].vertex.lock();
 			if (!vertex2)
 				continue;
 			//store all cells in the list temporarily
-			for (pwcell_iter = vertex2->GetCellsBegin();
+			for (CellBinIter pwcell_iter = vertex2->GetCellsBegin();
 			pwcell_iter != vertex2->GetCellsEnd(); ++pwcell_iter)
 				cells.push_back(*pwcell_iter);
 		}
-		//if a cell in the list has contacts that are also in the list,
-		//try to group them
-		cell_bins.clear();
-		if (GroupCells(cells, cell_bins, intra_graph,
-			&TrackMapProcessor::merge_cell_size))
+		return true;
+	};
+
+	std::vector<pVertex> verts;
+	verts.reserve(vertex_list1.size());
+	for (VertexListIter iter = vertex_list1.begin();
+		iter != vertex_list1.end(); ++iter)
+		verts.push_back(iter->second);
+
+	//grouping only reads the graphs, so it runs on threads
+	std::vector<std::vector<CellBin>> bins_list(verts.size());
+	std::vector<char> group_list(verts.size(), 0);
+	RunSlabs(GetSlabNum(verts.size()), verts.size(),
+		[&](size_t s, size_t i0, size_t i1)
+	{
+		std::vector<pwCell> cells;
+		for (size_t i = i0; i < i1; ++i)
 		{
-			//modify vertex list 2 if necessary
-			for (size_t i = 0; i < cell_bins.size(); ++i)
-				MergeCells(vertex_list2, cell_bins[i], frame2);
+			cells.clear();
+			//if a cell in the list has contacts that are also in the list,
+			//try to group them
+			if (get_cells(verts[i], cells))
+				group_list[i] = GroupCells(cells, bins_list[i], intra_graph,
+					&TrackMapProcessor::merge_cell_size);
+		}
+	});
+
+	//merge in list order
+	//a vertex next to merged ones groups its cells again
+	std::set<Vertex*> merged;
+	std::vector<pwCell> cells;
+	for (size_t i = 0; i < verts.size(); ++i)
+	{
+		InterVert v1 = verts[i]->GetInterVert(inter_graph);
+		if (v1 == InterGraph::null_vertex())
+			continue;
+		bool regroup = false;
+		if (!merged.empty())
+		{
+			std::pair<InterAdjIter, InterAdjIter> adj_verts =
+				boost::adjacent_vertices(v1, inter_graph);
+			for (InterAdjIter inter_iter = adj_verts.first;
+				inter_iter != adj_verts.second && !regroup; ++inter_iter)
+			{
+				pVertex vertex2 = inter_graph[*inter_iter].vertex.lock();
+				regroup = vertex2 && merged.count(vertex2.get());
+			}
+		}
+		if (regroup)
+		{
+			cells.clear();
+			bins_list[i].clear();
+			get_cells(verts[i], cells);
+			group_list[i] = GroupCells(cells, bins_list[i], intra_graph,
+				&TrackMapProcessor::merge_cell_size);
+		}
+		if (!group_list[i])
+			continue;
+		//modify vertex list 2 if necessary
+		std::vector<CellBin> &cell_bins = bins_list[i];
+		for (size_t j = 0; j < cell_bins.size(); ++j)
+		{
+			if (cell_bins[j].size() <= 1)
+				continue;
+			//keep vertices alive while they are marked
+			std::vector<pVertex> bin_verts;
+			for (size_t k = 0; k < cell_bins[j].size(); ++k)
+			{
+				pCell cell = cell_bins[j][k].lock();
+				if (!cell)
+					continue;
+				pVertex vertex = cell->GetVertex().lock();
+				if (vertex)
+					bin_verts.push_back(vertex);
+			}
+			if (MergeCells(vertex_list2, cell_bins[j], frame2))
+				for (size_t k = 0; k < bin_verts.size(); ++k)
+					merged.insert(bin_verts[k].get());
 		}
 	}
 
@@ -833,13 +1271,18 @@ bool TrackMapProcessor::ResolveGraph(size_t frame1, size_t frame2)
 
 bool TrackMapProcessor::ProcessFrames(size_t frame1, size_t frame2)
 {
+	m_map->DirtyLinks(frame1, frame2);
 	if (frame1 >= m_map->m_frame_num ||
 		frame2 >= m_map->m_frame_num ||
 		frame1 == frame2)
 		return false;
 
+	//keep the frames around the current ones unpacked
+	if (m_graph_cache)
+		m_map->PackGraphs(frame1, frame2, m_graph_cache);
+
 	VertexList &vertex_list = m_map->m_vertices_list.at(frame1);
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		frame1 > frame2 ? frame2 : frame1);
 	m_frame1 = frame1;
 	m_frame2 = frame2;
@@ -850,15 +1293,12 @@ bool TrackMapProcessor::ProcessFrames(size_t frame1, size_t frame2)
 	if (m_merge || m_split)
 		m_major_converge = get_segment(vertex_list, inter_graph, count_min);
 
-	VertexListIter iter;
+	ProcessVertices(vertex_list, inter_graph, count_min);
 
-	for (iter = vertex_list.begin();
+	//see if any is removed
+	for (VertexListIter iter = vertex_list.begin();
 		iter != vertex_list.end();)
 	{
-		ProcessVertex(iter->second, inter_graph, count_min);
-		//see if it is removed
-		////debug
-		//pVertex vert = iter->second;
 		if (iter->second->GetRemovedFromGraph())
 			iter = vertex_list.erase(iter);
 		else
@@ -870,6 +1310,194 @@ bool TrackMapProcessor::ProcessFrames(size_t frame1, size_t frame2)
 	return true;
 }
 
+bool TrackMapProcessor::ProcessDirty(size_t frame1, size_t frame2)
+{
+	if (frame1 >= m_map->m_frame_num ||
+		frame2 >= m_map->m_frame_num ||
+		frame1 == frame2)
+		return false;
+
+	//keep the frames around the current ones unpacked
+	if (m_graph_cache)
+		m_map->PackGraphs(frame1, frame2, m_graph_cache);
+	m_map->DirtyLinks(frame1, frame2);
+
+	VertexList &vertex_list = m_map->m_vertices_list.at(frame1);
+	InterGraph &inter_graph = m_map->GetInterGraph(
+		frame1 > frame2 ? frame2 : frame1);
+
+	//vertices of frame1 in the subgraphs containing edited vertices
+	//an edit changes the edges of edited vertices, so their neighbors
+	//are included, and from there the subgraphs connected by links
+	VertexList region;
+	VertVisitList visited;
+	std::vector<InterVert> stack;
+	std::vector<InterVert> seeds;
+	size_t frames[2] = { frame1, frame2 };
+	for (int i = 0; i < 2; ++i)
+	{
+		if (frames[i] >= m_map->m_dirty_list.size())
+			continue;
+		VertexList &dirty_list = m_map->m_dirty_list.at(frames[i]);
+		for (VertexListIter iter = dirty_list.begin();
+			iter != dirty_list.end(); ++iter)
+		{
+			InterVert v = iter->second->GetInterVert(inter_graph);
+			if (v != InterGraph::null_vertex())
+				seeds.push_back(v);
+			else if (i == 0)
+			{
+				//not linked yet
+				VertexListIter vert_iter = vertex_list.find(iter->first);
+				if (vert_iter != vertex_list.end() &&
+					vert_iter->second == iter->second)
+					region.insert(*vert_iter);
+			}
+		}
+	}
+	if (seeds.empty() && region.empty())
+		return false;
+	for (size_t i = 0; i < seeds.size(); ++i)
+	{
+		if (visited.insert(seeds[i]).second)
+			stack.push_back(seeds[i]);
+		std::pair<InterAdjIter, InterAdjIter> adj_verts =
+			boost::adjacent_vertices(seeds[i], inter_graph);
+		for (InterAdjIter iter = adj_verts.first;
+			iter != adj_verts.second; ++iter)
+			if (visited.insert(*iter).second)
+				stack.push_back(*iter);
+	}
+	while (!stack.empty())
+	{
+		InterVert v = stack.back();
+		stack.pop_back();
+		if (inter_graph[v].frame == frame1)
+		{
+			pVertex vertex = inter_graph[v].vertex.lock();
+			VertexListIter vert_iter = vertex_list.find(inter_graph[v].id);
+			if (vertex && vert_iter != vertex_list.end() &&
+				vert_iter->second == vertex)
+				region.insert(*vert_iter);
+		}
+		std::pair<InterGraph::out_edge_iterator,
+			InterGraph::out_edge_iterator> out_edges =
+			boost::out_edges(v, inter_graph);
+		for (InterGraph::out_edge_iterator iter = out_edges.first;
+			iter != out_edges.second; ++iter)
+		{
+			if (!inter_graph[*iter].link)
+				continue;
+			InterVert v2 = boost::target(*iter, inter_graph);
+			if (visited.insert(v2).second)
+				stack.push_back(v2);
+		}
+	}
+
+	m_frame1 = frame1;
+	m_frame2 = frame2;
+
+	//segmentation is still computed from the whole frame
+	unsigned int count_min = 0;
+	m_major_converge = false;
+	if (m_merge || m_split)
+		m_major_converge = get_segment(vertex_list, inter_graph, count_min);
+
+	ProcessVertices(region, inter_graph, count_min);
+
+	for (VertexListIter iter = region.begin();
+		iter != region.end(); ++iter)
+	{
+		if (!iter->second->GetRemovedFromGraph())
+			continue;
+		VertexListIter vert_iter = vertex_list.find(iter->first);
+		if (vert_iter != vertex_list.end() &&
+			vert_iter->second == iter->second)
+			vertex_list.erase(vert_iter);
+	}
+
+	//the frame counter isn't increased since most vertices are skipped
+	return true;
+}
+
+bool TrackMapProcessor::HasDirty()
+{
+	for (size_t i = 0; i < m_map->m_dirty_list.size(); ++i)
+		if (!m_map->m_dirty_list[i].empty())
+			return true;
+	return false;
+}
+
+bool TrackMapProcessor::HasDirty(size_t frame1, size_t frame2)
+{
+	size_t frames[2] = { frame1, frame2 };
+	for (int i = 0; i < 2; ++i)
+		if (frames[i] < m_map->m_dirty_list.size() &&
+			!m_map->m_dirty_list[frames[i]].empty())
+			return true;
+	return false;
+}
+
+void TrackMapProcessor::ClearDirty()
+{
+	m_map->m_dirty_list.clear();
+}
+
+void TrackMapProcessor::ClearDirty(size_t frame)
+{
+	if (frame < m_map->m_dirty_list.size())
+		m_map->m_dirty_list[frame].clear();
+}
+
+void TrackMapProcessor::DirtyCells(CellList &list, size_t frame)
+{
+	if (frame >= m_map->m_frame_num)
+		return;
+	CellList &cell_list = m_map->m_cells_list.at(frame);
+	for (CellListIter iter = list.begin();
+		iter != list.end(); ++iter)
+	{
+		CellListIter cell_iter = cell_list.find(iter->second->Id());
+		if (cell_iter == cell_list.end())
+			continue;
+		pVertex vertex = cell_iter->second->GetVertex().lock();
+		DirtyVertex(vertex, frame);
+	}
+}
+
+void TrackMapProcessor::DirtyVertex(pVertex &vertex, size_t frame)
+{
+	if (!vertex || frame >= m_map->m_frame_num)
+		return;
+	if (m_map->m_dirty_list.size() < m_map->m_frame_num)
+		m_map->m_dirty_list.resize(m_map->m_frame_num);
+	m_map->m_dirty_list.at(frame)[vertex->Id()] = vertex;
+
+	//neighbors, in case the vertex is removed
+	for (size_t i = 0; i < 2; ++i)
+	{
+		if (i == 0 && frame == 0)
+			continue;
+		size_t gi = i == 0 ? frame - 1 : frame;
+		if (gi >= m_map->m_inter_graph_list.size())
+			continue;
+		InterGraph &inter_graph = m_map->GetInterGraph(gi);
+		InterVert v = vertex->GetInterVert(inter_graph);
+		if (v == InterGraph::null_vertex())
+			continue;
+		std::pair<InterAdjIter, InterAdjIter> adj_verts =
+			boost::adjacent_vertices(v, inter_graph);
+		for (InterAdjIter iter = adj_verts.first;
+			iter != adj_verts.second; ++iter)
+		{
+			pVertex vertex2 = inter_graph[*iter].vertex.lock();
+			size_t frame2 = inter_graph[*iter].frame;
+			if (vertex2 && frame2 < m_map->m_frame_num)
+				m_map->m_dirty_list.at(frame2)[vertex2->Id()] = vertex2;
+		}
+	}
+}
+
 //make id consistent
 bool TrackMapProcessor::MakeConsistent(size_t f)
 {
@@ -944,7 +1572,7 @@ bool TrackMapProcessor::MakeConsistent(size_t f1, size_t f2)
 		(unsigned long long)ny * (unsigned long long)nz;
 	unsigned long long index;
 
-	//InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	//InterGraph &inter_graph = m_map->GetInterGraph(
 	//	f1 > f2 ? f2 : f1);
 	CellIDMap id_map;
 	//scan label for cell ids
@@ -997,8 +1625,19 @@ bool TrackMapProcessor::ClearCounters()
 	size_t listsize = m_map->m_inter_graph_list.size();
 	for (size_t i = 0; i < listsize; ++i)
 	{
+		//don't unpack the whole map
 		InterGraph &graph = m_map->m_inter_graph_list.at(i);
 		graph.counter = 0;
+		if (i < m_map->m_inter_csr_list.size() &&
+			m_map->m_inter_csr_list[i].packed())
+		{
+			CsrInterGraph &csr = m_map->m_inter_csr_list[i];
+			for (size_t iv = 0; iv < csr.vertex_num(); ++iv)
+				csr.vertex(iv).count = 0;
+			for (size_t ie = 0; ie < csr.edge_num(); ++ie)
+				csr.edge(ie).data.count = 0;
+			continue;
+		}
 
 		for (auto iv : boost::make_iterator_range(vertices(graph)))
 		{
@@ -1173,7 +1812,7 @@ bool TrackMapProcessor::LinkEdgeSize(InterGraph &graph, pVertex &vertex,
 		//sort edges
 		std::sort(edges.begin(), edges.end(),
 			std::bind(comp_edge_size, std::placeholders::_1,
-				std::placeholders::_2, graph));
+				std::placeholders::_2, std::ref(graph)));
 
 	//link edges by size
 	bool result = false;
@@ -1219,7 +1858,7 @@ bool TrackMapProcessor::UnlinkEdgeSize(InterGraph &graph, pVertex &vertex,
 	//sort edges
 	std::sort(edges.begin(), edges.end(),
 		std::bind(comp_edge_size, std::placeholders::_1,
-			std::placeholders::_2, graph));
+			std::placeholders::_2, std::ref(graph)));
 	//suppose we have more than 2 edges, find where to cut
 	//if 0 hasn't been linked/unlinked many times
 	if (calc_sim)
@@ -1249,7 +1888,7 @@ bool TrackMapProcessor::UnlinkEdgeCount(InterGraph &graph, pVertex &vertex,
 	//sort edges
 	std::sort(edges.begin(), edges.end(),
 		std::bind(comp_edge_count, std::placeholders::_1,
-			std::placeholders::_2, graph));
+			std::placeholders::_2, std::ref(graph)));
 	//suppose we have more than 2 edges, find where to cut
 	//if 0 hasn't been linked/unlinked many times
 	for (size_t i = 1; i < edges.size(); ++i)
@@ -1278,10 +1917,10 @@ bool TrackMapProcessor::UnlinkAlterPath(InterGraph &graph, pVertex &vertex,
 	bool calc_sim)
 {
 	//expand the search range with alternating paths
-	m_level_thresh = calc_sim ? 2 : 3;
+	int level_thresh = calc_sim ? 2 : 3;
 
 	PathList paths;
-	if (!GetAlterPath(graph, vertex, paths))
+	if (!GetAlterPath(graph, vertex, paths, level_thresh))
 		return false;
 	if (paths.size() < 2)
 		return false;
@@ -1296,7 +1935,7 @@ bool TrackMapProcessor::UnlinkAlterPath(InterGraph &graph, pVertex &vertex,
 }
 
 bool TrackMapProcessor::GetAlterPath(InterGraph &graph, pVertex &vertex,
-	PathList &paths)
+	PathList &paths, int level_thresh)
 {
 	//get all potential alternating paths
 	bool got_list;
@@ -1306,7 +1945,7 @@ bool TrackMapProcessor::GetAlterPath(InterGraph &graph, pVertex &vertex,
 		Path alt_path(graph);
 		got_list = get_alter_path(
 			graph, vertex, alt_path,
-			visited, 0);
+			visited, 0, level_thresh);
 		if (got_list)
 			paths.push_back(alt_path);
 		else
@@ -1600,7 +2239,7 @@ bool TrackMapProcessor::SplitVertex(InterGraph &graph, pVertex &vertex,
 		size_t gindex = graph.index == frame ? frame - 1 : frame;
 		if (gindex < m_map->m_frame_num - 1)
 		{
-			InterGraph &graph2 = m_map->m_inter_graph_list.at(gindex);
+			InterGraph &graph2 = m_map->GetInterGraph(gindex);
 			RemoveVertex(graph2, vertex);
 		}
 
@@ -1613,8 +2252,114 @@ bool TrackMapProcessor::SplitVertex(InterGraph &graph, pVertex &vertex,
 	return false;
 }
 
+void TrackMapProcessor::ProcessVertices(VertexList &vertex_list,
+	InterGraph &graph, unsigned int seg_count_min)
+{
+	std::vector<pVertex> verts;
+	verts.reserve(vertex_list.size());
+	for (VertexListIter iter = vertex_list.begin();
+		iter != vertex_list.end(); ++iter)
+		verts.push_back(iter->second);
+
+	//connected subgraphs of all edges, linked or not
+	//link changes stay within a subgraph
+	std::vector<std::vector<size_t>> comps;
+	boost::unordered_map<InterVert, size_t> labels;
+	std::vector<InterVert> stack;
+	for (size_t i = 0; i < verts.size(); ++i)
+	{
+		InterVert v0 = verts[i]->GetInterVert(graph);
+		if (v0 == InterGraph::null_vertex())
+		{
+			comps.push_back(std::vector<size_t>(1, i));
+			continue;
+		}
+		auto label_iter = labels.find(v0);
+		if (label_iter != labels.end())
+		{
+			comps[label_iter->second].push_back(i);
+			continue;
+		}
+		size_t label = comps.size();
+		comps.push_back(std::vector<size_t>(1, i));
+		labels.insert(std::make_pair(v0, label));
+		stack.push_back(v0);
+		while (!stack.empty())
+		{
+			InterVert v = stack.back();
+			stack.pop_back();
+			std::pair<InterAdjIter, InterAdjIter> adj_verts =
+				boost::adjacent_vertices(v, graph);
+			for (InterAdjIter iter = adj_verts.first;
+				iter != adj_verts.second; ++iter)
+				if (labels.insert(std::make_pair(*iter, label)).second)
+					stack.push_back(*iter);
+		}
+	}
+
+	//largest subgraphs first, each to the least loaded thread
+	size_t thread_num = GetSlabNum(comps.size());
+	std::vector<size_t> comp_order(comps.size());
+	for (size_t i = 0; i < comps.size(); ++i)
+		comp_order[i] = i;
+	std::stable_sort(comp_order.begin(), comp_order.end(),
+		[&](size_t c1, size_t c2)
+		{ return comps[c1].size() > comps[c2].size(); });
+	std::vector<std::vector<size_t>> thread_comps(thread_num);
+	std::vector<size_t> loads(thread_num, 0);
+	for (size_t i = 0; i < comp_order.size(); ++i)
+	{
+		size_t t = std::min_element(loads.begin(), loads.end()) - loads.begin();
+		thread_comps[t].push_back(comp_order[i]);
+		loads[t] += comps[comp_order[i]].size();
+	}
+
+	//vertices of a subgraph are processed in list order
+	std::vector<PendingList> pendings(thread_num);
+	RunSlabs(thread_num, thread_num, [&](size_t s, size_t, size_t)
+	{
+		for (size_t ci = 0; ci < thread_comps[s].size(); ++ci)
+		{
+			std::vector<size_t> &comp = comps[thread_comps[s][ci]];
+			for (size_t i = 0; i < comp.size(); ++i)
+				ProcessVertex(verts[comp[i]], graph,
+					seg_count_min, comp[i], pendings[s]);
+		}
+	});
+
+	//the rest change vertices, so they are serial and
+	//in list order regardless of the threads
+	PendingList pending;
+	for (size_t i = 0; i < pendings.size(); ++i)
+		pending.insert(pending.end(),
+			pendings[i].begin(), pendings[i].end());
+	std::sort(pending.begin(), pending.end(),
+		[](const PendingVertex &p1, const PendingVertex &p2)
+		{ return p1.order < p2.order; });
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		PendingVertex &p = pending[i];
+		//valence may be changed by previous ones
+		size_t valence;
+		std::vector<InterEdge> all_edges;
+		std::vector<InterEdge> linked_edges;
+		GetValence(p.vertex, graph, valence, all_edges, linked_edges);
+		if (p.orphan)
+		{
+			//find and link neighboring orphans
+			//unless a previous one has linked it
+			if (valence == 0)
+				LinkOrphans(graph, p.vertex);
+			continue;
+		}
+		if (valence > 1)
+			UnlinkSegment(graph, p.vertex, linked_edges,
+				p.calc_sim, seg_count_min < p.count, seg_count_min);
+	}
+}
+
 bool TrackMapProcessor::ProcessVertex(pVertex &vertex, InterGraph &graph,
-	unsigned int seg_count_min)
+	unsigned int seg_count_min, size_t order, PendingList &pending)
 {
 	bool result = false;
 
@@ -1624,7 +2369,14 @@ bool TrackMapProcessor::ProcessVertex(pVertex &vertex, InterGraph &graph,
 	if (inter_vert != InterGraph::null_vertex())
 		count = graph[inter_vert].count;
 	//compute similarity
-	bool calc_sim = get_random(count, graph);
+	bool calc_sim = get_random(count, vertex->Id(), graph);
+
+	PendingVertex p;
+	p.order = order;
+	p.vertex = vertex;
+	p.count = count;
+	p.calc_sim = calc_sim;
+	p.orphan = false;
 
 	//get valence
 	size_t valence;
@@ -1635,7 +2387,10 @@ bool TrackMapProcessor::ProcessVertex(pVertex &vertex, InterGraph &graph,
 	{
 		result = LinkEdgeSize(graph, vertex, all_edges, calc_sim);
 		if (!result)	//find and link neighboring orphans
-			result = LinkOrphans(graph, vertex);
+		{
+			p.orphan = true;
+			pending.push_back(p);
+		}
 	}
 	else if (valence > 1)
 	{
@@ -1652,9 +2407,9 @@ bool TrackMapProcessor::ProcessVertex(pVertex &vertex, InterGraph &graph,
 			result = UnlinkEdgeCount(graph, vertex, linked_edges);
 
 		//segmentation
-		if (!result)
-			result = UnlinkSegment(graph, vertex, linked_edges,
-				calc_sim, seg_count_min < count, seg_count_min);
+		if (!result && (m_merge || m_split) &&
+			(m_major_converge || seg_count_min < count))
+			pending.push_back(p);
 	}
 
 	return result;
@@ -1823,7 +2578,7 @@ void TrackMapProcessor::unlink_edge(InterEdge edge, InterGraph &graph, unsigned
 }
 
 bool TrackMapProcessor::get_alter_path(InterGraph &graph, pVertex &vertex,
-	Path &alt_path, VertVisitList &visited, int curl)
+	Path &alt_path, VertVisitList &visited, int curl, int level_thresh)
 {
 	if (!vertex)
 		return false;
@@ -1842,7 +2597,7 @@ bool TrackMapProcessor::get_alter_path(InterGraph &graph, pVertex &vertex,
 	graph[v0].max_value = 0;
 	graph[v0].max_valid = false;
 
-	if (curl >= m_level_thresh)
+	if (curl >= level_thresh)
 		return true;
 
 	InterVert v1;
@@ -1870,7 +2625,7 @@ bool TrackMapProcessor::get_alter_path(InterGraph &graph, pVertex &vertex,
 				alt_path.back().link = graph[edge.first].link;
 
 				return get_alter_path(graph, vertex1,
-					alt_path, visited, curl + 1);
+					alt_path, visited, curl + 1, level_thresh);
 			}
 		}
 	}
@@ -2321,12 +3076,12 @@ bool TrackMapProcessor::MergeCells(
 			//relink inter graph
 			if (frame > 0)
 			{
-				InterGraph &graph = m_map->m_inter_graph_list.at(frame - 1);
+				InterGraph &graph = m_map->GetInterGraph(frame - 1);
 				RelinkInterGraph(vertex, vertex0, frame, graph, false);
 			}
 			if (frame < m_map->m_frame_num - 1)
 			{
-				InterGraph &graph = m_map->m_inter_graph_list.at(frame);
+				InterGraph &graph = m_map->GetInterGraph(frame);
 				RelinkInterGraph(vertex, vertex0, frame, graph, false);
 			}
 
@@ -2521,34 +3276,56 @@ bool TrackMapProcessor::Export(std::string &filename)
 			WriteVertex(ofs, vertex);
 		}
 		//write intra edges
-		IntraGraph &intra_graph = m_map->m_intra_graph_list.at(i);
-		intra_pair = edges(intra_graph);
-		edge_num = 0;
-		for (intra_iter = intra_pair.first;
-		intra_iter != intra_pair.second;
-			++intra_iter)
-			edge_num++;
-		//intra edge num
-		WriteUint(ofs, edge_num);
-		//write each intra edge
-		for (intra_iter = intra_pair.first;
-		intra_iter != intra_pair.second;
-			++intra_iter)
+		//packed graphs are written as they are
+		if (i < m_map->m_intra_csr_list.size() &&
+			m_map->m_intra_csr_list[i].packed())
 		{
-			WriteTag(ofs, TAG_INTRA_EDGE);
-			//first cell
-			intra_vert = boost::source(*intra_iter, intra_graph);
-			WriteUint(ofs, intra_graph[intra_vert].id);
-			//second cell
-			intra_vert = boost::target(*intra_iter, intra_graph);
-			WriteUint(ofs, intra_graph[intra_vert].id);
-			//size
-			WriteUint(ofs, intra_graph[*intra_iter].size_ui);
-			WriteFloat(ofs, intra_graph[*intra_iter].size_f);
-			//distance
-			WriteTag(ofs, TAG_VER220);
-			WriteFloat(ofs, intra_graph[*intra_iter].dist_v);
-			WriteFloat(ofs, intra_graph[*intra_iter].dist_s);
+			CsrIntraGraph &csr = m_map->m_intra_csr_list[i];
+			WriteUint(ofs, csr.edge_num());
+			for (size_t ie = 0; ie < csr.edge_num(); ++ie)
+			{
+				CsrIntraGraph::Edge &edge = csr.edge(ie);
+				WriteTag(ofs, TAG_INTRA_EDGE);
+				WriteUint(ofs, csr.vertex(edge.v1).id);
+				WriteUint(ofs, csr.vertex(edge.v2).id);
+				WriteUint(ofs, edge.data.size_ui);
+				WriteFloat(ofs, edge.data.size_f);
+				WriteTag(ofs, TAG_VER220);
+				WriteFloat(ofs, edge.data.dist_v);
+				WriteFloat(ofs, edge.data.dist_s);
+			}
+		}
+		else
+		{
+			IntraGraph &intra_graph = m_map->m_intra_graph_list.at(i);
+			intra_pair = edges(intra_graph);
+			edge_num = 0;
+			for (intra_iter = intra_pair.first;
+			intra_iter != intra_pair.second;
+				++intra_iter)
+				edge_num++;
+			//intra edge num
+			WriteUint(ofs, edge_num);
+			//write each intra edge
+			for (intra_iter = intra_pair.first;
+			intra_iter != intra_pair.second;
+				++intra_iter)
+			{
+				WriteTag(ofs, TAG_INTRA_EDGE);
+				//first cell
+				intra_vert = boost::source(*intra_iter, intra_graph);
+				WriteUint(ofs, intra_graph[intra_vert].id);
+				//second cell
+				intra_vert = boost::target(*intra_iter, intra_graph);
+				WriteUint(ofs, intra_graph[intra_vert].id);
+				//size
+				WriteUint(ofs, intra_graph[*intra_iter].size_ui);
+				WriteFloat(ofs, intra_graph[*intra_iter].size_f);
+				//distance
+				WriteTag(ofs, TAG_VER220);
+				WriteFloat(ofs, intra_graph[*intra_iter].dist_v);
+				WriteFloat(ofs, intra_graph[*intra_iter].dist_s);
+			}
 		}
 		//write inter edges
 		if (i == 0)
@@ -2560,6 +3337,31 @@ bool TrackMapProcessor::Export(std::string &filename)
 		WriteUint(ofs, inter_graph.index);
 		//counter
 		WriteUint(ofs, inter_graph.counter);
+		if (i - 1 < m_map->m_inter_csr_list.size() &&
+			m_map->m_inter_csr_list[i - 1].packed())
+		{
+			CsrInterGraph &csr = m_map->m_inter_csr_list[i - 1];
+			WriteUint(ofs, csr.edge_num());
+			for (size_t ie = 0; ie < csr.edge_num(); ++ie)
+			{
+				CsrInterGraph::Edge &edge = csr.edge(ie);
+				InterVertexData &vd0 = csr.vertex(edge.v1);
+				InterVertexData &vd1 = csr.vertex(edge.v2);
+				bool order = vd0.frame < vd1.frame;
+				WriteTag(ofs, TAG_INTER_EDGE);
+				WriteUint(ofs, order ? vd0.id : vd1.id);
+				WriteUint(ofs, order ? vd1.id : vd0.id);
+				WriteUint(ofs, edge.data.size_ui);
+				WriteFloat(ofs, edge.data.size_f);
+				WriteFloat(ofs, edge.data.dist_f);
+				WriteUint(ofs, edge.data.link);
+				WriteTag(ofs, TAG_VER219);
+				WriteUint(ofs, order ? vd0.count : vd1.count);
+				WriteUint(ofs, order ? vd1.count : vd0.count);
+				WriteUint(ofs, edge.data.count);
+			}
+			continue;
+		}
 		//get edge number
 		inter_pair = boost::edges(inter_graph);
 		edge_num = 0;
@@ -2621,6 +3423,212 @@ bool TrackMapProcessor::Export(std::string &filename)
 	return true;
 }
 
+bool TrackMapProcessor::ExportTables(const std::string &prefix, int format)
+{
+	if (m_map->m_frame_num == 0 ||
+		m_map->m_frame_num != m_map->m_cells_list.size() ||
+		m_map->m_frame_num != m_map->m_vertices_list.size() ||
+		m_map->m_frame_num != m_map->m_inter_graph_list.size() + 1)
+		return false;
+
+	TableWriter::Format tf = format == 1 ?
+		TableWriter::TABLE_CHUNK : TableWriter::TABLE_CSV;
+	std::string ext = format == 1 ? ".flt" : ".csv";
+	TableWriter cells, vertices, links, contacts;
+
+	cells.AddColumn("frame", TableWriter::COL_UINT);
+	cells.AddColumn("id", TableWriter::COL_UINT);
+	cells.AddColumn("brick_id", TableWriter::COL_UINT);
+	cells.AddColumn("vertex", TableWriter::COL_UINT);
+	cells.AddColumn("x", TableWriter::COL_DOUBLE);
+	cells.AddColumn("y", TableWriter::COL_DOUBLE);
+	cells.AddColumn("z", TableWriter::COL_DOUBLE);
+	cells.AddColumn("size_ui", TableWriter::COL_UINT);
+	cells.AddColumn("size_f", TableWriter::COL_FLOAT);
+	cells.AddColumn("ext_ui", TableWriter::COL_UINT);
+	cells.AddColumn("ext_f", TableWriter::COL_FLOAT);
+	cells.AddColumn("min_x", TableWriter::COL_DOUBLE);
+	cells.AddColumn("min_y", TableWriter::COL_DOUBLE);
+	cells.AddColumn("min_z", TableWriter::COL_DOUBLE);
+	cells.AddColumn("max_x", TableWriter::COL_DOUBLE);
+	cells.AddColumn("max_y", TableWriter::COL_DOUBLE);
+	cells.AddColumn("max_z", TableWriter::COL_DOUBLE);
+
+	vertices.AddColumn("frame", TableWriter::COL_UINT);
+	vertices.AddColumn("id", TableWriter::COL_UINT);
+	vertices.AddColumn("x", TableWriter::COL_DOUBLE);
+	vertices.AddColumn("y", TableWriter::COL_DOUBLE);
+	vertices.AddColumn("z", TableWriter::COL_DOUBLE);
+	vertices.AddColumn("size_ui", TableWriter::COL_UINT);
+	vertices.AddColumn("size_f", TableWriter::COL_FLOAT);
+	vertices.AddColumn("cells", TableWriter::COL_UINT);
+
+	//inter edges, from frame to frame + 1
+	links.AddColumn("frame", TableWriter::COL_UINT);
+	links.AddColumn("id1", TableWriter::COL_UINT);
+	links.AddColumn("id2", TableWriter::COL_UINT);
+	links.AddColumn("size_ui", TableWriter::COL_UINT);
+	links.AddColumn("size_f", TableWriter::COL_FLOAT);
+	links.AddColumn("dist", TableWriter::COL_FLOAT);
+	links.AddColumn("link", TableWriter::COL_UINT);
+	links.AddColumn("count1", TableWriter::COL_UINT);
+	links.AddColumn("count2", TableWriter::COL_UINT);
+	links.AddColumn("count", TableWriter::COL_UINT);
+
+	//intra edges
+	contacts.AddColumn("frame", TableWriter::COL_UINT);
+	contacts.AddColumn("id1", TableWriter::COL_UINT);
+	contacts.AddColumn("id2", TableWriter::COL_UINT);
+	contacts.AddColumn("size_ui", TableWriter::COL_UINT);
+	contacts.AddColumn("size_f", TableWriter::COL_FLOAT);
+	contacts.AddColumn("dist_v", TableWriter::COL_FLOAT);
+	contacts.AddColumn("dist_s", TableWriter::COL_FLOAT);
+
+	if (!cells.Open(prefix + "_cells" + ext, tf) ||
+		!vertices.Open(prefix + "_vertices" + ext, tf) ||
+		!links.Open(prefix + "_links" + ext, tf) ||
+		!contacts.Open(prefix + "_contacts" + ext, tf))
+		return false;
+
+	auto put_link = [&](unsigned int frame,
+		InterVertexData &vd0, InterVertexData &vd1, InterEdgeData &ed)
+	{
+		bool order = vd0.frame < vd1.frame;
+		InterVertexData &first = order ? vd0 : vd1;
+		InterVertexData &second = order ? vd1 : vd0;
+		links.Put(frame);
+		links.Put(first.id);
+		links.Put(second.id);
+		links.Put(ed.size_ui);
+		links.Put(ed.size_f);
+		links.Put(ed.dist_f);
+		links.Put(ed.link);
+		links.Put(first.count);
+		links.Put(second.count);
+		links.Put(ed.count);
+		links.EndRow();
+	};
+	auto put_contact = [&](unsigned int frame,
+		IntraCellData &vd0, IntraCellData &vd1, IntraEdgeData &ed)
+	{
+		contacts.Put(frame);
+		contacts.Put(vd0.id);
+		contacts.Put(vd1.id);
+		contacts.Put(ed.size_ui);
+		contacts.Put(ed.size_f);
+		contacts.Put(ed.dist_v);
+		contacts.Put(ed.dist_s);
+		contacts.EndRow();
+	};
+
+	for (size_t i = 0; i < m_map->m_frame_num; ++i)
+	{
+		unsigned int frame = (unsigned int)i;
+
+		CellList &cell_list = m_map->m_cells_list.at(i);
+		for (auto iter = cell_list.begin();
+			iter != cell_list.end(); ++iter)
+		{
+			pCell &cell = iter->second;
+			FLIVR::Point &center = cell->GetCenter();
+			FLIVR::BBox &box = cell->GetBox();
+			cells.Put(frame);
+			cells.Put(cell->Id());
+			cells.Put(cell->BrickId());
+			cells.Put(cell->GetVertexId());
+			cells.Put(center.x());
+			cells.Put(center.y());
+			cells.Put(center.z());
+			cells.Put(cell->GetSizeUi());
+			cells.Put(cell->GetSizeF());
+			cells.Put(cell->GetExternalUi());
+			cells.Put(cell->GetExternalF());
+			cells.Put(box.min().x());
+			cells.Put(box.min().y());
+			cells.Put(box.min().z());
+			cells.Put(box.max().x());
+			cells.Put(box.max().y());
+			cells.Put(box.max().z());
+			cells.EndRow();
+		}
+
+		VertexList &vertex_list = m_map->m_vertices_list.at(i);
+		for (auto iter = vertex_list.begin();
+			iter != vertex_list.end(); ++iter)
+		{
+			pVertex &vertex = iter->second;
+			FLIVR::Point &center = vertex->GetCenter();
+			vertices.Put(frame);
+			vertices.Put(vertex->Id());
+			vertices.Put(center.x());
+			vertices.Put(center.y());
+			vertices.Put(center.z());
+			vertices.Put(vertex->GetSizeUi());
+			vertices.Put(vertex->GetSizeF());
+			vertices.Put((unsigned int)vertex->GetCellNum());
+			vertices.EndRow();
+		}
+
+		//intra edges
+		if (i < m_map->m_intra_csr_list.size() &&
+			m_map->m_intra_csr_list[i].packed())
+		{
+			CsrIntraGraph &csr = m_map->m_intra_csr_list[i];
+			for (size_t ie = 0; ie < csr.edge_num(); ++ie)
+			{
+				CsrIntraGraph::Edge &edge = csr.edge(ie);
+				put_contact(frame, csr.vertex(edge.v1),
+					csr.vertex(edge.v2), edge.data);
+			}
+		}
+		else if (i < m_map->m_intra_graph_list.size())
+		{
+			IntraGraph &intra_graph = m_map->m_intra_graph_list.at(i);
+			std::pair<IntraEdgeIter, IntraEdgeIter> intra_pair =
+				boost::edges(intra_graph);
+			for (IntraEdgeIter iter = intra_pair.first;
+				iter != intra_pair.second; ++iter)
+				put_contact(frame,
+					intra_graph[boost::source(*iter, intra_graph)],
+					intra_graph[boost::target(*iter, intra_graph)],
+					intra_graph[*iter]);
+		}
+
+		//inter edges to the next frame
+		if (i + 1 >= m_map->m_frame_num)
+			continue;
+		if (i < m_map->m_inter_csr_list.size() &&
+			m_map->m_inter_csr_list[i].packed())
+		{
+			CsrInterGraph &csr = m_map->m_inter_csr_list[i];
+			for (size_t ie = 0; ie < csr.edge_num(); ++ie)
+			{
+				CsrInterGraph::Edge &edge = csr.edge(ie);
+				put_link(frame, csr.vertex(edge.v1),
+					csr.vertex(edge.v2), edge.data);
+			}
+		}
+		else
+		{
+			InterGraph &inter_graph = m_map->m_inter_graph_list.at(i);
+			std::pair<InterEdgeIter, InterEdgeIter> inter_pair =
+				boost::edges(inter_graph);
+			for (InterEdgeIter iter = inter_pair.first;
+				iter != inter_pair.second; ++iter)
+				put_link(frame,
+					inter_graph[boost::source(*iter, inter_graph)],
+					inter_graph[boost::target(*iter, inter_graph)],
+					inter_graph[*iter]);
+		}
+	}
+
+	bool result = cells.Close();
+	result = vertices.Close() && result;
+	result = links.Close() && result;
+	result = contacts.Close() && result;
+	return result;
+}
+
 bool TrackMapProcessor::Import(std::string &filename)
 {
 	//clear everything
@@ -2829,14 +3837,14 @@ bool TrackMapProcessor::ResetVertexIDs()
 				vertex->Id(max_id);
 				if (fi > 0)
 				{
-					InterGraph &inter_graph = m_map->m_inter_graph_list.at(fi - 1);
+					InterGraph &inter_graph = m_map->GetInterGraph(fi - 1);
 					InterVert inter_vert = vertex->GetInterVert(inter_graph);
 					if (inter_vert != InterGraph::null_vertex())
 						inter_graph[inter_vert].id = max_id;
 				}
 				if (fi < m_map->m_frame_num - 1)
 				{
-					InterGraph &inter_graph = m_map->m_inter_graph_list.at(fi);
+					InterGraph &inter_graph = m_map->GetInterGraph(fi);
 					InterVert inter_vert = vertex->GetInterVert(inter_graph);
 					if (inter_vert != InterGraph::null_vertex())
 						inter_graph[inter_vert].id = max_id;
@@ -2999,8 +4007,9 @@ unsigned int TrackMapProcessor::GetTrackedID(
 		frame1 == frame2)
 		return false;
 
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	LinkIndex &link_index = m_map->GetLinkIndex(
 		frame1 > frame2 ? frame2 : frame1);
+	int side = frame1 > frame2 ? 1 : 0;
 
 	pCell cell = GetCell(frame1, id);
 	if (!cell)
@@ -3009,28 +4018,14 @@ unsigned int TrackMapProcessor::GetTrackedID(
 	if (!vert)
 		return rid;
 
-	InterVert v1 = vert->GetInterVert(inter_graph);
-	if (v1 == InterGraph::null_vertex())
-		return rid;
-
-	std::pair<InterAdjIter, InterAdjIter> adj_verts =
-		boost::adjacent_vertices(v1, inter_graph);
-	InterVert v2;
+	std::pair<LinkIndex::LinkIter, LinkIndex::LinkIter> links =
+		link_index.links(side, vert.get());
 	pVertex vert2;
 	pCell cell2;
-	std::pair<InterEdge, bool> edge;
-	for (auto it = adj_verts.first;
-		it != adj_verts.second; ++it)
+	for (auto it = links.first;
+		it != links.second; ++it)
 	{
-		v2 = *it;
-		if (v2 == InterGraph::null_vertex() ||
-			v2 == v1)
-			continue;
-		edge = boost::edge(v1, v2, inter_graph);
-		if (!edge.second ||
-			!inter_graph[edge.first].link)
-			continue;
-		vert2 = inter_graph[v2].vertex.lock();
+		vert2 = it->lock();
 		if (!vert2)
 			continue;
 		cell2 = (*vert2->GetCellsBegin()).lock();
@@ -3043,6 +4038,62 @@ unsigned int TrackMapProcessor::GetTrackedID(
 	return rid;
 }
 
+unsigned int TrackMapProcessor::GetTrack(size_t frame, unsigned int id,
+	size_t &frame0, std::vector<pVertex> &track)
+{
+	track.clear();
+	frame0 = frame;
+	size_t frame_num = m_map->m_frame_num;
+	if (frame >= frame_num)
+		return 0;
+
+	pCell cell = GetCell(frame, id);
+	if (!cell)
+		return 0;
+	pVertex vert = GetVertex(cell);
+	if (!vert)
+		return 0;
+
+	//a track goes on while a vertex has only one link
+	//and the linked vertex has only one link back
+	std::pair<LinkIndex::LinkIter, LinkIndex::LinkIter> links;
+	pVertex vert2;
+	std::vector<pVertex> back;
+	pVertex cur = vert;
+	for (size_t f = frame; f > 0; --f)
+	{
+		LinkIndex &link_index = m_map->GetLinkIndex(f - 1);
+		links = link_index.links(1, cur.get());
+		if (links.second - links.first != 1)
+			break;
+		vert2 = links.first->lock();
+		if (!vert2 ||
+			link_index.link_num(0, vert2.get()) != 1)
+			break;
+		back.push_back(vert2);
+		cur = vert2;
+		frame0 = f - 1;
+	}
+	track.assign(back.rbegin(), back.rend());
+	track.push_back(vert);
+	cur = vert;
+	for (size_t f = frame; f + 1 < frame_num; ++f)
+	{
+		LinkIndex &link_index = m_map->GetLinkIndex(f);
+		links = link_index.links(0, cur.get());
+		if (links.second - links.first != 1)
+			break;
+		vert2 = links.first->lock();
+		if (!vert2 ||
+			link_index.link_num(1, vert2.get()) != 1)
+			break;
+		track.push_back(vert2);
+		cur = vert2;
+	}
+
+	return track.front()->Id();
+}
+
 bool TrackMapProcessor::GetMappedCells(
 	CellList &sel_list1, CellList &sel_list2,
 	size_t frame1, size_t frame2)
@@ -3054,16 +4105,15 @@ bool TrackMapProcessor::GetMappedCells(
 		return false;
 
 	CellList &cell_list1 = m_map->m_cells_list.at(frame1);
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	LinkIndex &link_index = m_map->GetLinkIndex(
 		frame1 > frame2 ? frame2 : frame1);
+	int side = frame1 > frame2 ? 1 : 0;
 	CellListIter sel_iter, cell_iter;
 	pVertex vertex1, vertex2;
 	pCell cell;
-	InterVert v1, v2;
-	std::pair<InterAdjIter, InterAdjIter> adj_verts;
-	InterAdjIter inter_iter;
+	std::pair<LinkIndex::LinkIter, LinkIndex::LinkIter> links;
+	LinkIndex::LinkIter link_iter;
 	CellBinIter pwcell_iter;
-	std::pair<InterEdge, bool> inter_edge;
 
 	for (sel_iter = sel_list1.begin();
 	sel_iter != sel_list1.end();
@@ -3075,23 +4125,13 @@ bool TrackMapProcessor::GetMappedCells(
 		vertex1 = cell_iter->second->GetVertex().lock();
 		if (!vertex1)
 			continue;
-		v1 = vertex1->GetInterVert(inter_graph);
-		if (v1 == InterGraph::null_vertex())
-			continue;
-		adj_verts = boost::adjacent_vertices(v1, inter_graph);
-		//for each adjacent vertex
-		for (inter_iter = adj_verts.first;
-		inter_iter != adj_verts.second;
-			++inter_iter)
+		links = link_index.links(side, vertex1.get());
+		//for each linked vertex
+		for (link_iter = links.first;
+		link_iter != links.second;
+			++link_iter)
 		{
-			v2 = *inter_iter;
-			//get edge
-			inter_edge = boost::edge(v1, v2, inter_graph);
-			if (!inter_edge.second)
-				continue;
-			else if (!inter_graph[inter_edge.first].link)
-				continue;
-			vertex2 = inter_graph[v2].vertex.lock();
+			vertex2 = link_iter->lock();
 			if (!vertex2)
 				continue;
 			//store all cells in sel_list2
@@ -3117,6 +4157,9 @@ bool TrackMapProcessor::LinkCells(
 	size_t frame1, size_t frame2,
 	bool exclusive)
 {
+	m_map->DirtyLinks(frame1, frame2);
+	DirtyCells(list1, frame1);
+	DirtyCells(list2, frame2);
 	//check validity
 	if ((frame2 != frame1 + 1 &&
 		frame2 != frame1 - 1) ||
@@ -3171,7 +4214,7 @@ bool TrackMapProcessor::LinkCells(
 		vlist2.size() == 0)
 		return false;
 
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		frame1 > frame2 ? frame2 : frame1);
 	
 	VertexListIter viter1, viter2;
@@ -3200,6 +4243,13 @@ bool TrackMapProcessor::LinkCells(
 bool TrackMapProcessor::LinkCells(pCell &cell1, pCell &cell2,
 	size_t frame1, size_t frame2, bool exclusive)
 {
+	m_map->DirtyLinks(frame1, frame2);
+	pCell dirty_cell = GetCell(frame1, cell1->Id());
+	pVertex dirty_vert = GetVertex(dirty_cell);
+	DirtyVertex(dirty_vert, frame1);
+	dirty_cell = GetCell(frame2, cell2->Id());
+	dirty_vert = GetVertex(dirty_cell);
+	DirtyVertex(dirty_vert, frame2);
 	//check validity
 	if ((frame2 != frame1 + 1 &&
 		frame2 != frame1 - 1) ||
@@ -3229,7 +4279,7 @@ bool TrackMapProcessor::LinkCells(pCell &cell1, pCell &cell2,
 	if (!vert1 || !vert2)
 		return false;
 
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		frame1 > frame2 ? frame2 : frame1);
 
 	if (exclusive)
@@ -3248,6 +4298,8 @@ bool TrackMapProcessor::LinkCells(pCell &cell1, pCell &cell2,
 bool TrackMapProcessor::IsolateCells(
 	CellList &list, size_t frame)
 {
+	m_map->DirtyLinks(frame, frame);
+	DirtyCells(list, frame);
 	//check validity
 	size_t frame_num = m_map->m_frame_num;
 	if (frame >= frame_num)
@@ -3276,7 +4328,7 @@ bool TrackMapProcessor::IsolateCells(
 
 	if (frame > 0)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame - 1);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame - 1);
 		VertexListIter viter;
 		for (viter = vlist.begin();
 		viter != vlist.end(); ++viter)
@@ -3284,7 +4336,7 @@ bool TrackMapProcessor::IsolateCells(
 	}
 	if (frame < frame_num - 1)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame);
 		VertexListIter viter;
 		for (viter = vlist.begin();
 		viter != vlist.end(); ++viter)
@@ -3298,6 +4350,9 @@ bool TrackMapProcessor::UnlinkCells(
 	CellList &list1, CellList &list2,
 	size_t frame1, size_t frame2)
 {
+	m_map->DirtyLinks(frame1, frame2);
+	DirtyCells(list1, frame1);
+	DirtyCells(list2, frame2);
 	//check validity
 	size_t frame_num = m_map->m_frame_num;
 	if (frame1 >= frame_num ||
@@ -3340,7 +4395,7 @@ bool TrackMapProcessor::UnlinkCells(
 		vlist2.size() == 0)
 		return false;
 
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		frame1 > frame2 ? frame2 : frame1);
 
 	VertexListIter viter1, viter2;
@@ -3373,6 +4428,7 @@ bool TrackMapProcessor::AddCellDup(pCell & cell, size_t frame)
 bool TrackMapProcessor::AddCell(
 	pCell &cell, size_t frame, CellListIter &iter)
 {
+	m_map->DirtyLinks(frame, frame);
 	//check validity
 	if (!m_map->ExtendFrameNum(frame))
 		return false;
@@ -3395,11 +4451,14 @@ bool TrackMapProcessor::AddCell(
 	std::pair<CellListIter, bool> result = cell_list.insert(
 		std::pair<unsigned int, pCell>(cell->Id(), cell));
 	iter = result.first;
+	AddUsedId(frame, cell->Id());
+	DirtyVertex(vertex, frame);
 	return true;
 }
 
 bool TrackMapProcessor::AddCells(CellList &list, size_t frame)
 {
+	m_map->DirtyLinks(frame, frame);
 	//check validity
 	if (!m_map->ExtendFrameNum(frame))
 		return false;
@@ -3425,13 +4484,57 @@ bool TrackMapProcessor::AddCells(CellList &list, size_t frame)
 			(vertex->Id(), vertex));
 		cell_list.insert(std::pair<unsigned int, pCell>
 			(cell->Id(), cell));
+		AddUsedId(frame, cell->Id());
 	}
 
+	DirtyCells(list, frame);
 	return true;
 }
 
+std::vector<unsigned int> &TrackMapProcessor::GetUsedIds(size_t frame, void* label)
+{
+	if (m_map->m_used_ids_list.size() <= frame)
+		m_map->m_used_ids_list.resize(frame + 1);
+	std::vector<unsigned int> &ids = m_map->m_used_ids_list[frame];
+	if (!ids.empty() || !label)
+		return ids;
+
+	//frames of an imported track map
+	unsigned int* lbl = (unsigned int*)label;
+	unsigned long long size = (unsigned long long)m_map->m_size_x *
+		(unsigned long long)m_map->m_size_y *
+		(unsigned long long)m_map->m_size_z;
+	boost::unordered_set<unsigned int> found;
+	unsigned int last = 0;
+	for (unsigned long long index = 0; index < size; ++index)
+	{
+		unsigned int lv = lbl[index];
+		if (!lv || lv == last)
+			continue;
+		found.insert(lv);
+		last = lv;
+	}
+	ids.assign(found.begin(), found.end());
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+void TrackMapProcessor::AddUsedId(size_t frame, unsigned int id)
+{
+	//unknown lists are read when needed
+	if (frame >= m_map->m_used_ids_list.size() ||
+		m_map->m_used_ids_list[frame].empty())
+		return;
+	std::vector<unsigned int> &ids = m_map->m_used_ids_list[frame];
+	auto iter = std::lower_bound(ids.begin(), ids.end(), id);
+	if (iter == ids.end() || *iter != id)
+		ids.insert(iter, id);
+}
+
 bool TrackMapProcessor::RemoveCells(CellList &list, size_t frame)
 {
+	m_map->DirtyLinks(frame, frame);
+	DirtyCells(list, frame);
 	//check validity
 	if (!m_map->ExtendFrameNum(frame))
 		return false;
@@ -3465,6 +4568,8 @@ bool TrackMapProcessor::RemoveCells(CellList &list, size_t frame)
 
 bool TrackMapProcessor::LinkAddedCells(CellList &list, size_t f1, size_t f2)
 {
+	m_map->DirtyLinks(f1, f2);
+	DirtyCells(list, f1);
 	size_t frame_num = m_map->m_frame_num;
 	if (f1 >= frame_num || f2 >= frame_num || f1 == f2)
 		return false;
@@ -3482,7 +4587,7 @@ bool TrackMapProcessor::LinkAddedCells(CellList &list, size_t f1, size_t f2)
 	if (!data2 || !label2)
 		return false;
 
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		f1 > f2 ? f2 : f1);
 	pVertex v1, v2;
 	pCell cl1, cl2;
@@ -3561,6 +4666,11 @@ bool TrackMapProcessor::LinkAddedCells(CellList &list, size_t f1, size_t f2)
 bool TrackMapProcessor::CombineCells(
 	pCell &cell, CellList &list, size_t frame)
 {
+	m_map->DirtyLinks(frame, frame);
+	pCell dirty_cell = GetCell(frame, cell->Id());
+	pVertex dirty_vert = GetVertex(dirty_cell);
+	DirtyVertex(dirty_vert, frame);
+	DirtyCells(list, frame);
 	//check validity
 	if (!m_map->ExtendFrameNum(frame))
 		return false;
@@ -3596,12 +4706,12 @@ bool TrackMapProcessor::CombineCells(
 				//relink inter graph
 				if (frame > 0)
 				{
-					InterGraph &graph = m_map->m_inter_graph_list.at(frame - 1);
+					InterGraph &graph = m_map->GetInterGraph(frame - 1);
 					RelinkInterGraph(vertex1, vertex0, frame, graph, true);
 				}
 				if (frame < m_map->m_frame_num - 1)
 				{
-					InterGraph &graph = m_map->m_inter_graph_list.at(frame);
+					InterGraph &graph = m_map->GetInterGraph(frame);
 					RelinkInterGraph(vertex1, vertex0, frame, graph, true);
 				}
 
@@ -3623,6 +4733,7 @@ bool TrackMapProcessor::CombineCells(
 bool TrackMapProcessor::DivideCells(
 	CellList &list, size_t frame)
 {
+	m_map->DirtyLinks(frame, frame);
 	//check validity
 	if (!m_map->ExtendFrameNum(frame))
 		return false;
@@ -3716,6 +4827,7 @@ bool TrackMapProcessor::DivideCells(
 		}
 	}
 
+	DirtyCells(list, frame);
 	return true;
 }
 
@@ -3745,6 +4857,12 @@ bool TrackMapProcessor::ClusterCellsMerge(CellList &list, size_t frame)
 	unsigned int id = 0;
 	float data_value;
 
+	size_t point_num = 0;
+	for (CellListIter cliter = list.begin();
+		cliter != list.end(); ++cliter)
+		point_num += cliter->second->GetSizeUi();
+	cs_processor.ReservePoints(point_num);
+
 	//add cluster points
 	for (CellListIter cliter = list.begin();
 		cliter != list.end(); ++cliter)
@@ -3820,6 +4938,12 @@ bool TrackMapProcessor::ClusterCellsSplit(CellList &list, size_t frame,
 	unsigned int id = 0;
 	float data_value;
 
+	size_t point_num = 0;
+	for (CellListIter cliter = list.begin();
+		cliter != list.end(); ++cliter)
+		point_num += cliter->second->GetSizeUi();
+	cs_proc_km.ReservePoints(point_num);
+
 	//add cluster points
 	for (CellListIter cliter = list.begin();
 		cliter != list.end(); ++cliter)
@@ -3874,8 +4998,12 @@ bool TrackMapProcessor::ClusterCellsSplit(CellList &list, size_t frame,
 
 	if (result)
 	{
+		cs_proc_em.SetUsedIds(&GetUsedIds(frame, label));
 		cs_proc_em.GenerateNewIDs(id, label,
 			nx, ny, nz, true);
+		std::vector<unsigned int> &new_ids = cs_proc_em.GetNewIDs();
+		for (size_t ii = 0; ii < new_ids.size(); ++ii)
+			AddUsedId(frame, new_ids[ii]);
 		listout = cs_proc_em.GetCellList();
 		//generate output cell list
 /*		Cluster &points = cs_proc_em.GetData();
@@ -3918,7 +5046,9 @@ bool TrackMapProcessor::ClusterCellsSplit(CellList &list, size_t frame,
 bool TrackMapProcessor::SegmentCells(
 	CellList &list, size_t frame, int clnum)
 {
-	if (clnum < 2)
+	m_map->DirtyLinks(frame, frame);
+	DirtyCells(list, frame);
+	if (clnum < 2 || frame >= m_map->m_frame_num)
 		return false;
 
 	//get label and data from cache
@@ -3935,10 +5065,25 @@ bool TrackMapProcessor::SegmentCells(
 	size_t nx = m_map->m_size_x;
 	size_t ny = m_map->m_size_y;
 	size_t nz = m_map->m_size_z;
+	size_t minx, miny, minz;
+	size_t maxx, maxy, maxz;
 	unsigned int label_value;
 	unsigned int id = 0;
 	float data_value;
 
+	//the listed cells may only have ids
+	//the stored ones have boxes and sizes
+	CellList &cell_list = m_map->m_cells_list.at(frame);
+	size_t point_num = 0;
+	for (CellListIter cliter = list.begin();
+		cliter != list.end(); ++cliter)
+	{
+		CellListIter stored = cell_list.find(cliter->first);
+		if (stored != cell_list.end())
+			point_num += stored->second->GetSizeUi();
+	}
+	cs_proc_km.ReservePoints(point_num);
+
 	//add cluster points
 	for (CellListIter cliter = list.begin();
 		cliter != list.end(); ++cliter)
@@ -3947,9 +5092,26 @@ bool TrackMapProcessor::SegmentCells(
 		unsigned int cid = cell->Id();
 		if (!id) id = cid;
 
-		for (i = 0; i < nx; ++i)
-		for (j = 0; j < ny; ++j)
-		for (k = 0; k < nz; ++k)
+		//scan the whole frame if the box is unknown
+		minx = miny = minz = 0;
+		maxx = nx - 1;
+		maxy = ny - 1;
+		maxz = nz - 1;
+		CellListIter stored = cell_list.find(cid);
+		if (stored != cell_list.end() &&
+			stored->second->GetBox().valid())
+		{
+			FLIVR::BBox &box = stored->second->GetBox();
+			minx = size_t(box.min().x() + 0.5);
+			miny = size_t(box.min().y() + 0.5);
+			minz = size_t(box.min().z() + 0.5);
+			maxx = std::min(maxx, size_t(box.max().x() + 0.5));
+			maxy = std::min(maxy, size_t(box.max().y() + 0.5));
+			maxz = std::min(maxz, size_t(box.max().z() + 0.5));
+		}
+		for (i = minx; i <= maxx; ++i)
+		for (j = miny; j <= maxy; ++j)
+		for (k = minz; k <= maxz; ++k)
 		{
 			index = nx*ny*k + nx*j + i;
 			label_value = ((unsigned int*)label)[index];
@@ -3981,7 +5143,11 @@ bool TrackMapProcessor::SegmentCells(
 	cs_proc_km.Execute();
 	cs_proc_km.AddIDsToData();
 	//cs_proc_em.SetData(cs_proc_km.GetData());
+	cs_proc_km.SetUsedIds(&GetUsedIds(frame, label));
 	cs_proc_km.GenerateNewIDs(id, label, nx, ny, nz, true);
+	std::vector<unsigned int> &new_ids = cs_proc_km.GetNewIDs();
+	for (size_t ii = 0; ii < new_ids.size(); ++ii)
+		AddUsedId(frame, new_ids[ii]);
 	//label modified, save before delete
 	m_vol_cache.set_modified(frame);
 
@@ -3997,6 +5163,7 @@ bool TrackMapProcessor::SegmentCells(
 
 void TrackMapProcessor::RelinkCells(CellList &in, CellList& out, size_t frame)
 {
+	m_map->DirtyLinks(frame, frame);
 	VolCache cache = m_vol_cache.get(frame);
 	bool result = false;
 	result |= RemoveCells(in, frame);
@@ -4029,6 +5196,7 @@ bool TrackMapProcessor::ReplaceCellID(
 	cell_list.erase(iter);
 	cell_list.insert(std::pair<unsigned int, pCell>
 		(new_id, new_cell));
+	AddUsedId(frame, new_id);
 
 	//vertex
 	pVertex vertex = old_cell->GetVertex().lock();
@@ -4040,7 +5208,7 @@ bool TrackMapProcessor::ReplaceCellID(
 	}
 
 	//intra graph
-	IntraGraph &graph = m_map->m_intra_graph_list.at(frame);
+	IntraGraph &graph = m_map->GetIntraGraph(frame);
 	IntraVert intra_vert = new_cell->GetIntraVert();
 	if (intra_vert != IntraGraph::null_vertex())
 	{
@@ -4051,6 +5219,18 @@ bool TrackMapProcessor::ReplaceCellID(
 	return true;
 }
 
+//queries from the ui unpack the graphs around the frame they read
+//pack the others again, so that browsing frames doesn't leave
+//a packed map unpacked
+void TrackMapProcessor::KeepQueryGraphs(size_t frame)
+{
+	if (m_map->m_intra_csr_list.empty() &&
+		m_map->m_inter_csr_list.empty())
+		return;
+	m_map->PackGraphs(frame, frame,
+		m_graph_cache ? m_graph_cache : 1);
+}
+
 void TrackMapProcessor::GetLinkLists(
 	size_t frame,
 	FL::VertexList &in_orphan_list,
@@ -4060,6 +5240,7 @@ void TrackMapProcessor::GetLinkLists(
 {
 	if (frame >= m_map->m_frame_num)
 		return;
+	KeepQueryGraphs(frame);
 
 	VertexList &vertex_list = m_map->m_vertices_list.at(frame);
 
@@ -4071,7 +5252,7 @@ void TrackMapProcessor::GetLinkLists(
 	//in lists
 	if (frame > 0)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame - 1);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame - 1);
 		for (VertexListIter iter = vertex_list.begin();
 		iter != vertex_list.end(); ++iter)
 		{
@@ -4109,7 +5290,7 @@ void TrackMapProcessor::GetLinkLists(
 	//out lists
 	if (frame < m_map->m_frame_num - 1)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame);
 		for (VertexListIter iter = vertex_list.begin();
 		iter != vertex_list.end(); ++iter)
 		{
@@ -4151,6 +5332,7 @@ void TrackMapProcessor::GetCellsByUncertainty(
 {
 	if (frame >= m_map->m_frame_num)
 		return;
+	KeepQueryGraphs(frame);
 
 	bool filter = !(list_in.empty());
 	unsigned int count;
@@ -4162,7 +5344,7 @@ void TrackMapProcessor::GetCellsByUncertainty(
 	if (frame > 0)
 	{
 		InterGraph &inter_graph = 
-			m_map->m_inter_graph_list.at(frame-1);
+			m_map->GetInterGraph(frame-1);
 		for (auto ie : boost::make_iterator_range(edges(inter_graph)))
 		{
 			count = inter_graph[ie].count;
@@ -4222,7 +5404,7 @@ void TrackMapProcessor::GetCellsByUncertainty(
 	if (frame < m_map->m_frame_num - 1)
 	{
 		InterGraph &inter_graph =
-			m_map->m_inter_graph_list.at(frame);
+			m_map->GetInterGraph(frame);
 		for (auto ie : boost::make_iterator_range(edges(inter_graph)))
 		{
 			count = inter_graph[ie].count;
@@ -4286,6 +5468,7 @@ void TrackMapProcessor::GetCellUncertainty(
 {
 	if (frame >= m_map->m_frame_num)
 		return;
+	KeepQueryGraphs(frame);
 
 	VertexList &vertex_list = m_map->m_vertices_list.at(frame);
 
@@ -4298,7 +5481,7 @@ void TrackMapProcessor::GetCellUncertainty(
 	//in lists
 	if (frame > 0)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame - 1);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame - 1);
 		for (VertexListIter iter = vertex_list.begin();
 			iter != vertex_list.end(); ++iter)
 		{
@@ -4337,7 +5520,7 @@ void TrackMapProcessor::GetCellUncertainty(
 	//out lists
 	if (frame < m_map->m_frame_num - 1)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame);
 		for (VertexListIter iter = vertex_list.begin();
 			iter != vertex_list.end(); ++iter)
 		{
@@ -4379,20 +5562,21 @@ void TrackMapProcessor::GetUncertainHist(
 {
 	if (frame >= m_map->m_frame_num)
 		return;
+	KeepQueryGraphs(frame);
 
 	VertexList &vertex_list = m_map->m_vertices_list.at(frame);
 
 	//in lists
 	if (frame > 0)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame - 1);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame - 1);
 		GetUncertainHist(hist1, vertex_list, inter_graph);
 	}
 
 	//out lists
 	if (frame < m_map->m_frame_num - 1)
 	{
-		InterGraph &inter_graph = m_map->m_inter_graph_list.at(frame);
+		InterGraph &inter_graph = m_map->GetInterGraph(frame);
 		GetUncertainHist(hist2, vertex_list, inter_graph);
 	}
 }
@@ -4455,9 +5639,12 @@ void TrackMapProcessor::GetPaths(CellList &cell_list, PathList &path_list, size_
 		frame2 >= frame_num ||
 		frame1 == frame2)
 		return;
+	//the paths refer to the graph between the two frames
+	//it stays unpacked after returning
+	KeepQueryGraphs(frame1);
 
 	CellList &cell_list1 = m_map->m_cells_list.at(frame1);
-	InterGraph &inter_graph = m_map->m_inter_graph_list.at(
+	InterGraph &inter_graph = m_map->GetInterGraph(
 		frame1 > frame2 ? frame2 : frame1);
 	VertexList vertex_list;
 	CellListIter cell_iter;
@@ -4483,12 +5670,13 @@ void TrackMapProcessor::GetPaths(CellList &cell_list, PathList &path_list, size_
 	for (auto iter = vertex_list.begin();
 		iter != vertex_list.end(); ++iter)
 	{
-		GetAlterPath(inter_graph, iter->second, path_list);
+		GetAlterPath(inter_graph, iter->second, path_list, m_level_thresh);
 	}
 }
 
 bool TrackMapProcessor::TrackStencils(size_t f1, size_t f2)
 {
+	m_map->DirtyLinks(f1, f2);
 	//check validity
 	if (!m_map->ExtendFrameNum(std::max(f1, f2)))
 		return false;
@@ -4519,11 +5707,16 @@ bool TrackMapProcessor::TrackStencils(size_t f1, size_t f2)
 	unsigned int label_value;
 
 	//get all stencils from frame1
+	//the volume is read in memory order, and the stencils are listed
+	//in the order of their first voxels in x, y, z, as they used to be
 	StencilList stencil_list;
 	StencilListIter iter;
-	for (i = 0; i < nx; ++i)
-	for (j = 0; j < ny; ++j)
+	std::vector<Stencil> found;
+	std::vector<std::array<size_t, 3> > firsts;
+	boost::unordered_map<unsigned int, size_t> found_map;
 	for (k = 0; k < nz; ++k)
+	for (j = 0; j < ny; ++j)
+	for (i = 0; i < nx; ++i)
 	{
 		index = nx*ny*k + nx*j + i;
 		label_value = ((unsigned int*)label1)[index];
@@ -4531,10 +5724,13 @@ bool TrackMapProcessor::TrackStencils(size_t f1, size_t f2)
 		if (!label_value)
 			continue;
 
-		iter = stencil_list.find(label_value);
-		if (iter != stencil_list.end())
+		std::array<size_t, 3> first = {{ i, j, k }};
+		auto fiter = found_map.find(label_value);
+		if (fiter != found_map.end())
 		{
-			iter->second.extend(i, j, k);
+			found[fiter->second].extend(i, j, k);
+			if (first < firsts[fiter->second])
+				firsts[fiter->second] = first;
 		}
 		else
 		{
@@ -4547,47 +5743,86 @@ bool TrackMapProcessor::TrackStencils(size_t f1, size_t f2)
 			stencil.bits = m_map->m_data_bits;
 			stencil.scale = m_map->m_scale;
 			stencil.box.extend(FLIVR::Point(i, j, k));
-			stencil_list.insert(std::pair<unsigned int, Stencil>
-				(label_value, stencil));
+			found_map.insert(std::pair<unsigned int, size_t>
+				(label_value, found.size()));
+			found.push_back(stencil);
+			firsts.push_back(first);
 		}
 	}
+	std::vector<size_t> order(found.size());
+	for (size_t n = 0; n < order.size(); ++n)
+		order[n] = n;
+	std::sort(order.begin(), order.end(),
+		[&](size_t a, size_t b) { return firsts[a] < firsts[b]; });
+	for (size_t n = 0; n < order.size(); ++n)
+		stencil_list.insert(std::pair<unsigned int, Stencil>
+			(found[order[n]].id, found[order[n]]));
 
 	//find matching stencil in frame2
-	FLIVR::Point center;
 	FLIVR::Vector ext(1.5, 1.5, 0.5);
-	float prob;
-	Stencil s1, s2;
+	Stencil s2;
 	s2.data = data2;
 	s2.nx = nx;
 	s2.ny = ny;
 	s2.nz = nz;
 	s2.bits = m_map->m_data_bits;
 	s2.scale = m_map->m_scale;
+	std::vector<Stencil> s1_list;
 	for (iter = stencil_list.begin(); iter != stencil_list.end(); ++iter)
-	{
-		s1 = iter->second;
-		if (match_stencils(s1, s2, ext, center, prob))
+		s1_list.push_back(iter->second);
+	size_t stencil_num = s1_list.size();
+	std::vector<Stencil> s2_list(stencil_num, s2);
+	std::vector<char> matched(stencil_num, 0);
+	//stencils are matched on threads, the large ones first
+	order.resize(stencil_num);
+	for (size_t n = 0; n < stencil_num; ++n)
+		order[n] = n;
+	std::sort(order.begin(), order.end(),
+		[&](size_t a, size_t b)
+	{
+		FLIVR::Point sa = s1_list[a].box.size();
+		FLIVR::Point sb = s1_list[b].box.size();
+		return (sa.x() + 1) * (sa.y() + 1) * (sa.z() + 1) >
+			(sb.x() + 1) * (sb.y() + 1) * (sb.z() + 1);
+	});
+	std::atomic<size_t> next(0);
+	RunSlabs(GetSlabNum(stencil_num), stencil_num,
+		[&](size_t, size_t, size_t)
+	{
+		FLIVR::Point center;
+		float prob;
+		for (size_t n = next++; n < stencil_num; n = next++)
 		{
-			//if (prob > 0.5f)
-			//	continue;
-
-			//label stencil 2
-			label_stencil(s1, s2, label1, label2);
-
-			//add s1 to track map
-			CellListIter iter;
-			pCell cell1(new Cell(s1.id));
-			cell1->SetCenter(s1.box.center());
-			cell1->SetBox(s1.box);
-			AddCell(cell1, f1, iter);
-			//add s2 id to track map
-			pCell cell2(new Cell(s2.id));
-			cell2->SetCenter(s2.box.center());
-			cell2->SetBox(s2.box);
-			AddCell(cell2, f2, iter);
-			//connect cells
-			LinkCells(cell1, cell2, f1, f2, false);
+			size_t si = order[n];
+			matched[si] = match_stencils(s1_list[si],
+				s2_list[si], ext, center, prob);
 		}
+	});
+
+	//results are added in the order of the list
+	for (size_t n = 0; n < stencil_num; ++n)
+	{
+		if (!matched[n])
+			continue;
+		Stencil &s1 = s1_list[n];
+		Stencil &s2 = s2_list[n];
+
+		//label stencil 2
+		label_stencil(s1, s2, label1, label2);
+
+		//add s1 to track map
+		CellListIter iter;
+		pCell cell1(new Cell(s1.id));
+		cell1->SetCenter(s1.box.center());
+		cell1->SetBox(s1.box);
+		AddCell(cell1, f1, iter);
+		//add s2 id to track map
+		pCell cell2(new Cell(s2.id));
+		cell2->SetCenter(s2.box.center());
+		cell2->SetBox(s2.box);
+		AddCell(cell2, f2, iter);
+		//connect cells
+		LinkCells(cell1, cell2, f1, f2, false);
 	}
 
 	m_vol_cache.unprotect(f1);
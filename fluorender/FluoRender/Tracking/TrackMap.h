@@ -31,6 +31,8 @@ DEALINGS IN THE SOFTWARE.
 #include "CellList.h"
 #include "VertexList.h"
 #include "VolCache.h"
+#include "CsrGraph.h"
+#include "LinkIndex.h"
 #include <fstream>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
@@ -53,6 +55,9 @@ namespace FL
 #define TAG_VER220		9	//new values added in v2.20
 #define TAG_VER221		10	//new values added in v2.21
 
+	typedef CsrGraph<IntraCellData, IntraEdgeData> CsrIntraGraph;
+	typedef CsrGraph<InterVertexData, InterEdgeData> CsrInterGraph;
+
 	class TrackMap;
 	typedef boost::shared_ptr<TrackMap> pTrackMap;
 	typedef boost::weak_ptr<TrackMap> pwTrackMap;
@@ -66,6 +71,7 @@ namespace FL
 		m_level_thresh(2),
 		m_merge(false),
 		m_split(false),
+		m_graph_cache(0),
 		m_map(track_map) {}
 		~TrackMapProcessor();
 
@@ -83,6 +89,9 @@ namespace FL
 		void SetSpacings(float spcx, float spcy, float spcz);
 
 		void SetVolCacheSize(size_t size);
+		//graphs farther than size frames from the ones being processed
+		//are packed to save memory, 0 keeps all graphs unpacked
+		void SetGraphCacheSize(size_t size);
 
 		//build cell list and intra graph
 		bool InitializeFrame(size_t frame);
@@ -92,6 +101,14 @@ namespace FL
 		bool ResolveGraph(size_t frame1, size_t frame2);
 		//find the maximum overlapping and set link flags on inter graph
 		bool ProcessFrames(size_t frame1, size_t frame2);
+		//same as above but only for the vertices connected to edited ones
+		//returns false if no edits have touched the frames
+		bool ProcessDirty(size_t frame1, size_t frame2);
+		bool HasDirty();
+		//edits in either frame
+		bool HasDirty(size_t frame1, size_t frame2);
+		void ClearDirty();
+		void ClearDirty(size_t frame);
 
 		//make id consistent
 		bool MakeConsistent(size_t frame);//combine cells within vertex
@@ -102,6 +119,11 @@ namespace FL
 
 		bool Export(std::string &filename);
 		bool Import(std::string &filename);
+		//per-frame attributes as tables for analysis, written to
+		//prefix_cells, prefix_vertices, prefix_links (inter edges)
+		//and prefix_contacts (intra edges)
+		//format: 0-csv; 1-binary column chunks (.flt)
+		bool ExportTables(const std::string &prefix, int format);
 
 		bool ResetVertexIDs();
 
@@ -111,6 +133,10 @@ namespace FL
 		unsigned int GetUniCellID(size_t frame, unsigned int id);
 		unsigned int GetNewCellID(size_t frame, unsigned int id, bool inc=false);
 		unsigned int GetTrackedID(size_t frame1, size_t frame2, unsigned int id);
+		//vertices linked one to one with the vertex of a cell, one per frame
+		//the track starts at frame0 and its id is the id of the first vertex
+		unsigned int GetTrack(size_t frame, unsigned int id,
+			size_t &frame0, std::vector<pVertex> &track);
 
 		//get mapped cell
 		//bool GetMappedID(unsigned int id_in, unsigned int& id_out,
@@ -172,6 +198,8 @@ namespace FL
 		bool m_split;
 		//uncertainty filter
 		unsigned int m_uncertain_low;
+		//frames of graphs kept unpacked around the processed ones
+		size_t m_graph_cache;
 		//the trackmap
 		pTrackMap m_map;
 		//volume data cache
@@ -184,21 +212,26 @@ namespace FL
 		bool m_major_converge;//majority of the links have converged
 
 	private:
+		//mark vertices of cells and their neighbors as edited
+		void DirtyCells(CellList &list, size_t frame);
+		//ids in the label of a frame
+		//read from the label once if the frame wasn't initialized here
+		std::vector<unsigned int> &GetUsedIds(size_t frame, void* label);
+		void AddUsedId(size_t frame, unsigned int id);
+		//pack graphs away from a frame read by a ui query
+		void KeepQueryGraphs(size_t frame);
+		void DirtyVertex(pVertex &vertex, size_t frame);
 		//modification
-		bool CheckCellContact(pCell &cell, void *data, void *label,
-			size_t ci, size_t cj, size_t ck);
-		bool AddContact(IntraGraph& graph,
-			pCell &cell1, pCell &cell2,
-			float contact_value);
 		bool CheckCellDist(pCell &cell, void *label,
 			size_t ci, size_t cj, size_t ck);
 		bool AddNeighbor(IntraGraph& graph,
 			pCell &cell1, pCell &cell2,
 			float dist_v, float dist_s);
+		//overlap_size voxels with a total of overlap_value
 		bool LinkVertices(InterGraph& graph,
 			pVertex &vertex1, pVertex &vertex2,
 			size_t f1, size_t f2,
-			float overlap_value);
+			float overlap_value, unsigned int overlap_size = 1);
 		bool IsolateVertex(InterGraph& graph,
 			pVertex &vertex);
 		bool ForceVertices(InterGraph& graph,
@@ -223,9 +256,25 @@ namespace FL
 		bool GreaterThanCellBin(pCell &cell1, CellBin &bin, pwCell &cell2);
 		size_t GetBinsCellCount(std::vector<CellBin> &bins);
 
+		//a vertex left for orphan linking or segmentation,
+		//which change the graph outside of its subgraph
+		struct PendingVertex
+		{
+			size_t order;//position in the processed list
+			pVertex vertex;
+			unsigned int count;
+			bool calc_sim;
+			bool orphan;
+		};
+		typedef std::vector<PendingVertex> PendingList;
+		//process subgraphs of the vertices on threads
+		//pending vertices are then resolved in list order
+		void ProcessVertices(VertexList &vertex_list, InterGraph &graph,
+			unsigned int seg_count_min);
 		//replaces all previous match/unmatch funcs
+		//only changes links, others are added to pending
 		bool ProcessVertex(pVertex &vertex, InterGraph &graph,
-			unsigned int seg_count_min);
+			unsigned int seg_count_min, size_t order, PendingList &pending);
 		//vertex matching routines
 		//find out current valence of a vertex
 		bool GetValence(pVertex &vertex, InterGraph &graph,
@@ -264,7 +313,7 @@ namespace FL
 			std::vector<InterEdge> &linked_edges, bool calc_sim,
 			bool segment, unsigned int seg_count_min);
 		bool GetAlterPath(InterGraph &graph, pVertex &vertex,
-			PathList &paths);
+			PathList &paths, int level_thresh);
 		bool UnlinkAlterPathMaxMatch(InterGraph &graph, pVertex &vertex,
 			PathList &paths, bool calc_sim);
 		bool UnlinkAlterPathSize(InterGraph &graph, pVertex &vertex,
@@ -288,7 +337,7 @@ namespace FL
 
 		//helper functions
 		bool get_alter_path(InterGraph &graph, pVertex &vertex,
-			Path &alt_path, VertVisitList &visited, int curl);
+			Path &alt_path, VertVisitList &visited, int curl, int level_thresh);
 		float get_path_max(InterGraph &graph, PathList &paths,
 			size_t curl, InterVert v0);
 		bool unlink_alt_path(InterGraph &graph, PathList &paths);
@@ -308,8 +357,8 @@ namespace FL
 		void link_edge(InterEdge edge, InterGraph &graph, unsigned int value = 1);
 		void unlink_edge(InterEdge edge, InterGraph &graph, unsigned int value = 0);
 
-		//random number
-		bool get_random(size_t count, InterGraph &graph);
+		//random number, from the vertex id and the pass
+		bool get_random(size_t count, unsigned int id, InterGraph &graph);
 		//get if segmentation is computed
 		bool get_segment(VertexList &vertex_list, InterGraph &inter_graph, unsigned int &count_thresh);
 		bool get_major_converge(InterGraph &inter_graph, size_t vertex_frame, UncertainBin &major_bin);
@@ -523,12 +572,20 @@ namespace FL
 	}
 
 	//random
-	inline bool TrackMapProcessor::get_random(size_t count, InterGraph &graph)
+	//hashed instead of rand() so that vertices processed on
+	//different threads get the same values in any order
+	inline bool TrackMapProcessor::get_random(size_t count, unsigned int id, InterGraph &graph)
 	{
 		int c = graph.counter;
 		if (c < 4)
 			return true;
-		int r = c / 2 + rand() % c;
+		unsigned int h = id * 0x9e3779b1u ^ unsigned(c) * 0x85ebca77u;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		int r = c / 2 + int(h % unsigned(c));
 		return count < r;
 
 		//if (rand() % c < 10)
@@ -554,6 +611,14 @@ namespace FL
 		bool ExtendFrameNum(size_t frame);
 		void Clear();
 
+		//pack graphs outside [frame1-range, frame2+range]
+		void PackGraphs(size_t frame1, size_t frame2, size_t range);
+
+		//links between frame and frame+1, built on demand
+		LinkIndex &GetLinkIndex(size_t frame);
+		//links of frames in [frame1, frame2] have been modified
+		void DirtyLinks(size_t frame1, size_t frame2);
+
 	private:
 		unsigned int m_counter;//counter for frame processing
 		//data information
@@ -572,6 +637,24 @@ namespace FL
 		std::deque<VertexList> m_vertices_list;
 		std::deque<IntraGraph> m_intra_graph_list;
 		std::deque<InterGraph> m_inter_graph_list;
+		//packed graphs, a graph is either here or in the lists above
+		std::deque<CsrIntraGraph> m_intra_csr_list;
+		std::deque<CsrInterGraph> m_inter_csr_list;
+		//link lookup, one for each inter graph
+		std::deque<LinkIndex> m_link_list;
+		//vertices touched by edits since the last refinement
+		std::deque<VertexList> m_dirty_list;
+		//sorted ids in the label of each frame, including the cells
+		//under the size threshold, for choosing new ids
+		//ids given to cells are added; one left in the list after its
+		//cell is gone only makes it skipped
+		std::deque<std::vector<unsigned int>> m_used_ids_list;
+
+		void PackIntraGraph(size_t frame);
+		void UnpackIntraGraph(size_t frame);
+		void PackInterGraph(size_t frame);
+		void UnpackInterGraph(size_t frame);
+		void BuildLinkIndex(size_t frame);
 
 		friend class TrackMapProcessor;
 	};
@@ -593,14 +676,39 @@ namespace FL
 
 	inline IntraGraph &TrackMap::GetIntraGraph(size_t frame)
 	{
+		if (frame < m_intra_csr_list.size() &&
+			m_intra_csr_list[frame].packed())
+			UnpackIntraGraph(frame);
 		return m_intra_graph_list.at(frame);
 	}
 
 	inline InterGraph &TrackMap::GetInterGraph(size_t frame)
 	{
+		if (frame < m_inter_csr_list.size() &&
+			m_inter_csr_list[frame].packed())
+			UnpackInterGraph(frame);
 		return m_inter_graph_list.at(frame);
 	}
 
+	inline LinkIndex &TrackMap::GetLinkIndex(size_t frame)
+	{
+		if (m_link_list.size() < m_inter_graph_list.size())
+			m_link_list.resize(m_inter_graph_list.size());
+		if (!m_link_list.at(frame).valid())
+			BuildLinkIndex(frame);
+		return m_link_list.at(frame);
+	}
+
+	inline void TrackMap::DirtyLinks(size_t frame1, size_t frame2)
+	{
+		size_t fmin = std::min(frame1, frame2);
+		size_t fmax = std::max(frame1, frame2);
+		//the inter graphs on both sides of the frames
+		fmin = fmin ? fmin - 1 : 0;
+		for (size_t i = fmin; i <= fmax && i < m_link_list.size(); ++i)
+			m_link_list[i].clear();
+	}
+
 	inline bool TrackMap::ExtendFrameNum(size_t frame)
 	{
 		size_t sframe = m_frame_num;
@@ -625,6 +733,11 @@ namespace FL
 		m_vertices_list.clear();
 		m_intra_graph_list.clear();
 		m_inter_graph_list.clear();
+		m_intra_csr_list.clear();
+		m_inter_csr_list.clear();
+		m_link_list.clear();
+		m_dirty_list.clear();
+		m_used_ids_list.clear();
 		m_frame_num = 0;
 		m_size_x = m_size_y = m_size_z = 0;
 		m_data_bits = 8;
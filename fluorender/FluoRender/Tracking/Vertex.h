@@ -93,7 +93,8 @@ namespace FL
 	public:
 		Vertex(unsigned int id) :
 			m_id(id), m_size_ui(0),
-			m_size_f(0.0f), m_split(false)
+			m_size_f(0.0f), m_split(false),
+			m_packed(0)
 		{}
 		~Vertex() {};
 
@@ -102,6 +103,9 @@ namespace FL
 		InterVert GetInterVert(InterGraph& graph);
 		void SetInterVert(InterGraph& graph, InterVert inter_vert);
 		bool GetRemovedFromGraph();
+		//the graph is packed and its descriptors are gone
+		void PackInterVert(InterGraph& graph);
+		void UnpackInterVert(InterGraph& graph, InterVert inter_vert);
 		size_t GetFrame(InterGraph& graph);
 		void SetSplit(bool split = true);
 		bool GetSplit();
@@ -136,6 +140,7 @@ namespace FL
 		InterVertList m_inter_verts;
 		CellBin m_cells;//children
 		bool m_split;//true if em has been run already
+		unsigned int m_packed;//number of packed graphs containing this
 	};
 
 	inline unsigned int Cell::GetVertexId()
@@ -181,6 +186,8 @@ namespace FL
 
 	inline bool Vertex::GetRemovedFromGraph()
 	{
+		if (m_packed)
+			return false;
 		for (auto iter = m_inter_verts.begin();
 			iter != m_inter_verts.end(); ++iter)
 			if (iter->second != InterGraph::null_vertex())
@@ -188,6 +195,20 @@ namespace FL
 		return true;
 	}
 
+	inline void Vertex::PackInterVert(InterGraph& graph)
+	{
+		m_inter_verts.erase(graph.index);
+		m_packed++;
+	}
+
+	inline void Vertex::UnpackInterVert(InterGraph& graph,
+		InterVert inter_vert)
+	{
+		SetInterVert(graph, inter_vert);
+		if (m_packed)
+			m_packed--;
+	}
+
 	inline size_t Vertex::GetFrame(InterGraph& graph)
 	{
 		unsigned int key = graph.index;
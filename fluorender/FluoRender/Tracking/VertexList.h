@@ -60,8 +60,8 @@ namespace FL
 		~Path() {}
 		inline Path& operator=(const Path& path)
 		{
+			//paths of a list share the graph, which isn't copied
 			m_path = path.m_path;
-			m_graph = path.m_graph;
 			m_max_size = path.m_max_size;
 			m_odd_size = path.m_odd_size;
 			m_evn_size = path.m_evn_size;
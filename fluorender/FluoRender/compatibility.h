@@ -502,6 +502,9 @@ inline void FIND_FILES(std::wstring m_path_name,
 	std::vector<std::wstring> &m_batch_list,
 	int &m_cur_batch, std::wstring regex = L"") {
 	std::wstring search_path = m_path_name.substr(0, m_path_name.find_last_of(L'/')) + L'/';
+	//a wildcard extension is matched as a suffix
+	if (!search_ext.empty() && search_ext[0] == L'*')
+		search_ext = search_ext.substr(1);
 	std::wstring regex_min;
 	if (regex.find(search_path) != std::string::npos)
 		regex_min = regex.substr(search_path.length(), regex.length() - search_path.length());
@@ -532,6 +535,7 @@ inline void FIND_FILES(std::wstring m_path_name,
 				cnt++;
 			}
 		}
+		closedir(dir);
 	}
 }
 
@@ -2,6 +2,10 @@
 #include <codecvt>
 #include <sstream>
 #include <iomanip>
+#include <deque>
+#include <future>
+#include <thread>
+#include <algorithm>
 #include <wx/wx.h>
 #include <wx/xml/xml.h>
 #include "../compatibility.h"
@@ -130,7 +134,25 @@ double Gaussian(glm::vec3 x, glm::vec3 m, glm::mat3 s)
 	return exp(-p);
 }
 
-void AddLabel(int num, wxXmlNode* node, unsigned int* label_data)
+//a gaussian rasterized on a worker thread
+struct GmmCell
+{
+	unsigned int id;
+	unsigned int prev_id;
+	glm::vec3 center;
+	unsigned int size;
+};
+
+//default memory budget in MB for the frames in flight
+#define READGMM_MEM_BUDGET 4096.0
+
+//a frame read ahead of linking
+struct GmmFrame
+{
+	std::vector<GmmCell> cells;
+};
+
+bool AddLabel(wxXmlNode* node, unsigned int* label_data, GmmCell &cell)
 {
 	unsigned long ival;
 	double dval;
@@ -138,88 +160,109 @@ void AddLabel(int num, wxXmlNode* node, unsigned int* label_data)
 
 	//id
 	if (!node->GetAttribute("id", &strItem))
-		return;
+		return false;
 	strItem.ToULong(&ival);
 	unsigned int id = ival + 1;//nonzero
 	//parent
 	if (!node->GetAttribute("parent", &strItem))
-		return;
+		return false;
 	strItem.ToULong(&ival);
 	unsigned int prev_id = ival + 1;
 	//splitScore
 	if (!node->GetAttribute("splitScore", &strItem))
-		return;
+		return false;
 	strItem.ToDouble(&dval);
 	//double uncertainty = 5.0 - dval;
 	//scale
 	if (!node->GetAttribute("scale", &strItem))
-		return;
+		return false;
     auto item = strItem.ToStdString();
 	glm::vec3 scale = ReadVector(item);
 	//centroid
 	if (!node->GetAttribute("m", &strItem))
-		return;
+		return false;
     item = strItem.ToStdString();
 	glm::vec3 centroid = ReadVector(item);
 	//corr
 	if (!node->GetAttribute("W", &strItem))
-		return;
+		return false;
     item = strItem.ToStdString();
 	glm::mat3 corr = ReadMatrix(item);
 
-	//fill label
-	unsigned int cell_size = 0;
-	for (int i=0; i<nx; ++i)
-	for (int j=0; j<ny; ++j)
-	for (int k=0; k<nz; ++k)
+	//the gaussian is over 0.93 where d'qd < -ln(0.93),
+	//d being the voxel offset from the centroid
+	glm::mat3 scale_mat;
+	scale_mat[0][0] = 1/scale.x / scale.x;
+	scale_mat[1][1] = 1/scale.y / scale.y;
+	scale_mat[2][2] = 1/scale.z / scale.z;
+	glm::mat3 s = corr * scale_mat;
+	glm::mat3 scale_diag;
+	scale_diag[0][0] = scale.x;
+	scale_diag[1][1] = scale.y;
+	scale_diag[2][2] = scale.z;
+	glm::mat3 a = scale_diag * s * scale_diag;
+	glm::mat3 q = (a + glm::transpose(a)) * 0.5f;
+	float thresh = float(-log(0.93));
+
+	//bounding box of the ellipsoid
+	//the whole volume if the form isn't positive definite
+	int lo[3] = { 0, 0, 0 };
+	int hi[3] = { nx, ny, nz };
+	if (q[0][0] > 0.0f &&
+		q[0][0] * q[1][1] - q[0][1] * q[1][0] > 0.0f &&
+		glm::determinant(q) > 0.0f)
 	{
-		glm::vec3 x = scale * glm::vec3(i, j, k);
-		glm::vec3 m = centroid * scale;
-		glm::mat3 scale_mat;
-		scale_mat[0][0] = 1/scale.x / scale.x;
-		scale_mat[1][1] = 1/scale.y / scale.y;
-		scale_mat[2][2] = 1/scale.z / scale.z;
-		glm::mat3 s = corr * scale_mat;
-		double g = Gaussian(x, m, s);
-		if (g > 0.93)
+		glm::mat3 qi = glm::inverse(q);
+		for (int n = 0; n < 3; ++n)
 		{
-			unsigned long long index = nx*ny*k + nx*j + i;
-			label_data[index] = id;
-			cell_size++;
+			float r = sqrt(thresh * qi[n][n]);
+			lo[n] = std::max(lo[n], int(floor(centroid[n] - r)) - 1);
+			hi[n] = std::min(hi[n], int(ceil(centroid[n] + r)) + 2);
 		}
 	}
-	if (!cell_size)
-		return;
-	//add to track map
-	FL::pCell cell = FL::pCell(new FL::Cell(id));
-	FLIVR::Point center(centroid.x, centroid.y, centroid.z);
-	cell->SetCenter(center);
-	cell->SetSizeUi(cell_size);
-	cell->SetSizeF(cell_size);
-	FL::CellListIter iter;
-	m_tm_processor.AddCell(cell, num, iter);
-	if (prev_id)
+
+	//fill label, a row at a time
+	unsigned int cell_size = 0;
+	int row_size = hi[0] - lo[0];
+	for (int k = lo[2]; k < hi[2]; ++k)
+	for (int j = lo[1]; j < hi[1]; ++j)
 	{
-		//link
-		FL::CellList list1, list2;
-		list1.insert(pair<unsigned int, FL::pCell>
-			(id, cell));
-		FL::pCell cell2 = FL::pCell(new FL::Cell(prev_id));
-		list2.insert(pair<unsigned int, FL::pCell>
-			(prev_id, cell2));
-		m_tm_processor.LinkCells(list1, list2, num, num-1, false);
+		float dy = j - centroid.y;
+		float dz = k - centroid.z;
+		float b = 2.0f * (q[1][0] * dy + q[2][0] * dz);
+		float c = q[1][1] * dy * dy + 2.0f * q[2][1] * dy * dz +
+			q[2][2] * dz * dz;
+		unsigned int* row = label_data +
+			(unsigned long long)nx*ny*k + (unsigned long long)nx*j + lo[0];
+		for (int i = 0; i < row_size; ++i)
+		{
+			float dx = (lo[0] + i) - centroid.x;
+			bool in = (q[0][0] * dx + b) * dx + c < thresh;
+			row[i] = in ? id : row[i];
+			cell_size += in;
+		}
 	}
+	if (!cell_size)
+		return false;
+
+	cell.id = id;
+	cell.prev_id = prev_id;
+	cell.center = centroid;
+	cell.size = cell_size;
+	return true;
 }
 
-void ProcessXml(int num)
+//read, rasterize and save a frame, on a worker thread
+GmmFrame ProcessXml(int num)
 {
+	GmmFrame frame;
 	wxXmlDocument doc;
 	wxString xmlfile = m_xml_list[num];
 	if (!doc.Load(xmlfile))
-		return;
+		return frame;
 	wxXmlNode *root = doc.GetRoot();
 	if (!root || root->GetName() != "document")
-		return;
+		return frame;
 
 	Nrrd* nrrd_label = nrrdNew();
 	unsigned long long mem_size = (unsigned long long)nx*
@@ -231,7 +274,9 @@ void ProcessXml(int num)
 	{
 		if (child->GetName() == "GaussianMixtureModel")
 		{
-			AddLabel(num, child, data_label);
+			GmmCell cell;
+			if (AddLabel(child, data_label, cell))
+				frame.cells.push_back(cell);
 		}
 		child = child->GetNext();
 	}
@@ -249,6 +294,38 @@ void ProcessXml(int num)
 
 	delete[] data_label;
 	nrrdNix(nrrd_label);
+	return frame;
+}
+
+//add cells to the track map and link them to their parents
+//frames are linked in order
+void LinkFrame(int num, GmmFrame &frame)
+{
+	for (size_t i = 0; i < frame.cells.size(); ++i)
+	{
+		GmmCell &gmm = frame.cells[i];
+		unsigned int id = gmm.id;
+		unsigned int prev_id = gmm.prev_id;
+		//add to track map
+		FL::pCell cell = FL::pCell(new FL::Cell(id));
+		FLIVR::Point center(gmm.center.x, gmm.center.y, gmm.center.z);
+		cell->SetCenter(center);
+		cell->SetSizeUi(gmm.size);
+		cell->SetSizeF(gmm.size);
+		FL::CellListIter iter;
+		m_tm_processor.AddCell(cell, num, iter);
+		if (prev_id)
+		{
+			//link
+			FL::CellList list1, list2;
+			list1.insert(pair<unsigned int, FL::pCell>
+				(id, cell));
+			FL::pCell cell2 = FL::pCell(new FL::Cell(prev_id));
+			list2.insert(pair<unsigned int, FL::pCell>
+				(prev_id, cell2));
+			m_tm_processor.LinkCells(list1, list2, num, num-1, false);
+		}
+	}
 }
 
 int main(int argc, char* argv[])
@@ -270,9 +347,29 @@ int main(int argc, char* argv[])
 	ProcessInputName(in_filename);
 	ProcessOutputName(out_filename);
 
-	for (int i = 0; i < m_xml_list.size(); ++i)
+	//frames ahead are read and rasterized on worker threads
+	//while the current one is linked
+	//each frame in flight holds its label volume and, while saving,
+	//a compressed copy of it, so the read-ahead is bounded by memory
+	//the optional last argument sets the budget in MB
+	double budget = argc > 7 ? atof(argv[7]) : READGMM_MEM_BUDGET;
+	double frame_size = double(nx) * ny * nz * sizeof(unsigned int) * 2.0 / 1048576.0;
+	int cores = std::max(1, int(std::thread::hardware_concurrency()));
+	int ahead = frame_size > 0.0 ? int(budget / frame_size) - 1 : cores;
+	ahead = std::max(0, std::min(cores, ahead));
+	//the workers share the cores, so their saves don't start
+	//a full thread pool each
+	ParallelIO::SetThreadNum(std::max(1, cores / (ahead + 1)));
+	int num = m_xml_list.size();
+	std::deque<std::future<GmmFrame>> frames;
+	int next = 0;
+	for (int i = 0; i < num; ++i)
 	{
-		ProcessXml(i);
+		for (; next < num && next <= i + ahead; ++next)
+			frames.push_back(std::async(std::launch::async, ProcessXml, next));
+		GmmFrame frame = frames.front().get();
+		frames.pop_front();
+		LinkFrame(i, frame);
 		printf("Frame %d processed.\n", i);
 	}
 
@@ -0,0 +1,468 @@
+#include "LZWBench.h"
+#include <Formats/lzw_codec.h>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+//reference copy of the linked-list decoder that BaseReader used before
+//LZWCodec, kept here as the baseline
+//derived from libtiff tif_lzw.c
+//Copyright (c) 1988-1997 Sam Leffler
+//Copyright (c) 1991-1997 Silicon Graphics, Inc.
+#define L_MAXCODE(n)	((1L<<(n))-1)
+#define L_BITS_MIN	9
+#define L_BITS_MAX	12
+#define L_CODE_CLEAR	256
+#define L_CODE_EOI	257
+#define L_CODE_FIRST	258
+#define L_CSIZE		(L_MAXCODE(L_BITS_MAX)+1024L)
+typedef unsigned short hcode_t;
+typedef unsigned char* tidata_t;
+typedef int tsize_t;
+typedef struct code_ent
+{
+	struct code_ent *next;
+	unsigned short length;
+	unsigned char value;
+	unsigned char firstchar;
+} code_t;
+typedef struct
+{
+	int stride;
+	unsigned short nbits;
+	unsigned short maxcode;
+	long nextdata;
+	long nextbits;
+	long dec_nbitsmask;
+	long dec_restart;
+	long dec_bitsleft;
+	code_t* dec_codep;
+	code_t* dec_oldcodep;
+	code_t* dec_free_entp;
+	code_t* dec_maxcodep;
+	code_t* dec_codetab;
+} LZWCodecState;
+#define GetNextCode(sp, bp, code) {\
+	nextdata = (nextdata<<8) | *(bp)++;\
+	nextbits += 8;\
+	if (nextbits < nbits) {\
+		nextdata = (nextdata<<8) | *(bp)++;\
+		nextbits += 8;\
+	}\
+	code = (hcode_t)((nextdata >> (nextbits-nbits)) & nbitsmask);\
+	nextbits -= nbits;\
+}
+
+static int LegacyLZWDecode(tidata_t tif, tidata_t op0, tsize_t occ0)
+{
+	//initialize codec state
+	LZWCodecState *sp = new LZWCodecState;
+	//sp->predictor = m_predictor;
+	sp->stride = 1;
+	//sp->rowsize = m_x_size;
+	sp->dec_codetab = new code_t[L_CSIZE*sizeof(code_t)];
+	int icode = 255;
+	do
+	{
+		sp->dec_codetab[icode].value = icode;
+		sp->dec_codetab[icode].firstchar = icode;
+		sp->dec_codetab[icode].length = 1;
+		sp->dec_codetab[icode].next = NULL;
+	} while (icode--);
+	sp->maxcode = L_MAXCODE(L_BITS_MIN)-1;
+	sp->nbits = L_BITS_MIN;
+	sp->nextbits = 0;
+	sp->nextdata = 0;
+	sp->dec_restart = 0;
+	sp->dec_nbitsmask = L_MAXCODE(L_BITS_MIN);
+	sp->dec_bitsleft = occ0 << 3;
+	sp->dec_free_entp = sp->dec_codetab + L_CODE_FIRST;
+	memset(sp->dec_free_entp, 0, (L_CSIZE-L_CODE_FIRST)*sizeof(code_t));
+	sp->dec_oldcodep = &sp->dec_codetab[-1];
+	sp->dec_maxcodep = &sp->dec_codetab[sp->dec_nbitsmask-1];
+
+	char *op = (char*) op0;
+	long occ = (long) occ0;
+	char *tp;
+	unsigned char *bp;
+	hcode_t code;
+	int len;
+	long nbits, nextbits, nextdata, nbitsmask;
+	code_t *codep, *free_entp, *maxcodep, *oldcodep;
+
+	bp = (unsigned char *)tif;
+	nbits = sp->nbits;
+	nextdata = sp->nextdata;
+	nextbits = sp->nextbits;
+	nbitsmask = sp->dec_nbitsmask;
+	oldcodep = sp->dec_oldcodep;
+	free_entp = sp->dec_free_entp;
+	maxcodep = sp->dec_maxcodep;
+
+	while (occ > 0)
+	{
+		GetNextCode(sp, bp, code);
+		//NextCode(tif, sp, bp, code, GetNextCode);
+		if (code == L_CODE_EOI)
+			break;
+		if (code == L_CODE_CLEAR)
+		{
+			free_entp = sp->dec_codetab + L_CODE_FIRST;
+			nbits = L_BITS_MIN;
+			nbitsmask = L_MAXCODE(L_BITS_MIN);
+			maxcodep = sp->dec_codetab + nbitsmask-1;
+			GetNextCode(sp, bp, code);
+			//NextCode(tif, sp, bp, code, GetNextCode);
+			if (code == L_CODE_EOI)
+				break;
+			*op++ = (char)code, occ--;
+			oldcodep = sp->dec_codetab + code;
+			continue;
+		}
+		codep = sp->dec_codetab + code;
+
+		/*
+	 	 * Add the new entry to the code table.
+	 	 */
+		if (free_entp < &sp->dec_codetab[0] ||
+			free_entp >= &sp->dec_codetab[L_CSIZE])
+			return 0;
+
+		free_entp->next = oldcodep;
+		if (free_entp->next < &sp->dec_codetab[0] ||
+			free_entp->next >= &sp->dec_codetab[L_CSIZE])
+			return 0;
+
+		free_entp->firstchar = free_entp->next->firstchar;
+		free_entp->length = free_entp->next->length+1;
+		free_entp->value = (codep < free_entp) ?
+		    codep->firstchar : free_entp->firstchar;
+		if (++free_entp > maxcodep)
+		{
+			if (++nbits > L_BITS_MAX)		/* should not happen */
+				nbits = L_BITS_MAX;
+			nbitsmask = L_MAXCODE(nbits);
+			maxcodep = sp->dec_codetab + nbitsmask-1;
+		}
+		oldcodep = codep;
+		if (code >= 256)
+		{
+			/*
+			 * Code maps to a string, copy string
+			 * value to output (written in reverse).
+			 */
+			if(codep->length == 0)
+				return 0;
+			if (codep->length > occ)
+			{
+				/*
+				 * String is too long for decode buffer,
+				 * locate portion that will fit, copy to
+				 * the decode buffer, and setup restart
+				 * logic for the next decoding call.
+				 */
+				sp->dec_codep = codep;
+				do
+				{
+					codep = codep->next;
+				} while (codep && codep->length > occ);
+				if (codep)
+				{
+					sp->dec_restart = occ;
+					tp = op + occ;
+					do
+					{
+						*--tp = codep->value;
+						codep = codep->next;
+					} while (--occ && codep);
+				}
+				break;
+			}
+			len = codep->length;
+			tp = op + len;
+			do
+			{
+				int t;
+				--tp;
+				t = codep->value;
+				codep = codep->next;
+				*tp = t;
+			} while (codep && tp > op);
+			if (codep)
+				break;
+			op += len, occ -= len;
+		} else
+			*op++ = (char)code, occ--;
+	}
+
+	delete []sp->dec_codetab;
+	delete sp;
+
+	if (occ > 0)
+		return 0;
+
+	return (1);
+}
+
+//synthetic microscopy-like slice: dim background, gaussian blobs, noise
+static void MakeSlice(std::vector<unsigned char> &data, int nx, int ny, int bytes, unsigned seed)
+{
+	data.assign(size_t(nx)*ny*bytes, 0);
+	unsigned s = seed;
+	auto rnd = [&s]() { s = s * 1103515245u + 12345u; return (s >> 16) & 0x7fff; };
+	int max_val = bytes == 1 ? 255 : 4095;
+	std::vector<float> img(size_t(nx)*ny, float(max_val) * 0.05f);
+	for (int b = 0; b < 60; ++b)
+	{
+		int cx = rnd() % nx;
+		int cy = rnd() % ny;
+		float r = 4.0f + rnd() % 12;
+		float a = float(max_val) * (0.3f + (rnd() % 64) / 100.0f);
+		for (int j = std::max(0, int(cy - 3 * r)); j < std::min(ny, int(cy + 3 * r)); ++j)
+		for (int i = std::max(0, int(cx - 3 * r)); i < std::min(nx, int(cx + 3 * r)); ++i)
+		{
+			float d2 = float((i - cx)*(i - cx) + (j - cy)*(j - cy));
+			img[size_t(j)*nx + i] += a * std::exp(-d2 / (2.0f*r*r));
+		}
+	}
+	for (size_t i = 0; i < img.size(); ++i)
+	{
+		int v = int(img[i]) + int(rnd() % 5) - 2;
+		v = std::max(0, std::min(max_val, v));
+		if (bytes == 1)
+			data[i] = (unsigned char)v;
+		else
+		{
+			data[i * 2] = (unsigned char)(v & 0xff);
+			data[i * 2 + 1] = (unsigned char)(v >> 8);
+		}
+	}
+	//horizontal differencing, as written with predictor 2
+	for (int j = 0; j < ny; ++j)
+	{
+		if (bytes == 1)
+		{
+			unsigned char* row = &data[size_t(j)*nx];
+			for (int i = nx - 1; i > 0; --i)
+				row[i] -= row[i - 1];
+		}
+		else
+		{
+			unsigned short* row = (unsigned short*)&data[size_t(j)*nx * 2];
+			for (int i = nx - 1; i > 0; --i)
+				row[i] -= row[i - 1];
+		}
+	}
+}
+
+//decode a strip with both decoders
+//the legacy decoder may read past the last code, so src is padded
+static bool DecodeBoth(vector<unsigned char> &src, size_t src_size,
+	vector<unsigned char> &out_old, vector<unsigned char> &out_new, size_t size)
+{
+	src.resize(src_size + 8, 0);
+	out_old.assign(size, 0);
+	out_new.assign(size, 0);
+	bool ok_old = size == 0 ||
+		LegacyLZWDecode(&src[0], &out_old[0], tsize_t(size));
+	bool ok_new = size == 0 ||
+		LZWCodec::Decode(&src[0], src_size, &out_new[0], size);
+	src.resize(src_size);
+	return ok_old && ok_new;
+}
+
+//random data from runs over a small alphabet
+//sizes reach past the 4096 entry table, so clear codes are exercised
+static int RoundTrips(int rounds)
+{
+	unsigned s = 2020u;
+	auto rnd = [&s]() { s = s * 1103515245u + 12345u; return (s >> 16) & 0x7fff; };
+	int failed = 0;
+	vector<unsigned char> data, code, out_old, out_new;
+	for (int r = 0; r < rounds; ++r)
+	{
+		size_t size = 1 + (size_t(rnd()) << 3 | rnd() % 8) % 262144;
+		int alphabet = 1 + rnd() % 256;
+		int max_run = 1 + rnd() % 64;
+		data.resize(size);
+		for (size_t i = 0; i < size;)
+		{
+			unsigned char v = (unsigned char)(rnd() % alphabet);
+			size_t run = std::min(size - i, size_t(1 + rnd() % max_run));
+			memset(&data[i], v, run);
+			i += run;
+		}
+		LZWCodec::Encode(&data[0], size, code);
+		bool ok = DecodeBoth(code, code.size(), out_old, out_new, size);
+		if (!ok || out_old != data || out_new != data)
+			failed++;
+	}
+	printf("{\"lzw\":\"round_trip\",\"rounds\":%d,\"failed\":%d}\n",
+		rounds, failed);
+	return failed;
+}
+
+static int BenchSlice(int bytes)
+{
+	const int nx = 1024, ny = 1024, iter = 20;
+	const int rows_per_strip = 8192 / (nx * bytes) > 0 ? 8192 / (nx * bytes) : 1;
+	const size_t strip_size = size_t(rows_per_strip) * nx * bytes;
+
+	vector<unsigned char> slice;
+	MakeSlice(slice, nx, ny, bytes, 1234u + bytes);
+	vector<vector<unsigned char>> strips;
+	size_t comp_size = 0;
+	for (size_t pos = 0; pos < slice.size(); pos += strip_size)
+	{
+		size_t size = std::min(strip_size, slice.size() - pos);
+		vector<unsigned char> strip;
+		LZWCodec::Encode(&slice[pos], size, strip);
+		comp_size += strip.size();
+		strip.resize(strip.size() + 8, 0);
+		strips.push_back(strip);
+	}
+
+	vector<unsigned char> out_old(slice.size(), 0);
+	vector<unsigned char> out_new(slice.size(), 0);
+	double t_old = 0.0, t_new = 0.0;
+	bool ok_old = true, ok_new = true;
+	for (int it = 0; it < iter; ++it)
+	{
+		auto t0 = chrono::high_resolution_clock::now();
+		for (size_t s = 0; s < strips.size(); ++s)
+		{
+			size_t pos = s * strip_size;
+			size_t size = std::min(strip_size, slice.size() - pos);
+			ok_old = LegacyLZWDecode(&strips[s][0], &out_old[pos], tsize_t(size)) && ok_old;
+		}
+		auto t1 = chrono::high_resolution_clock::now();
+		for (size_t s = 0; s < strips.size(); ++s)
+		{
+			size_t pos = s * strip_size;
+			size_t size = std::min(strip_size, slice.size() - pos);
+			ok_new = LZWCodec::Decode(&strips[s][0], strips[s].size() - 8,
+				&out_new[pos], size) && ok_new;
+		}
+		auto t2 = chrono::high_resolution_clock::now();
+		t_old += chrono::duration<double>(t1 - t0).count();
+		t_new += chrono::duration<double>(t2 - t1).count();
+	}
+
+	bool valid = ok_old && ok_new && out_old == slice && out_new == slice;
+	double mb = double(slice.size()) * iter / (1024.0 * 1024.0);
+	printf("{\"lzw\":\"slice_%d\",\"valid\":%s,\"strips\":%d,\"ratio\":%.2f,"
+		"\"legacy_mb_per_s\":%.1f,\"codec_mb_per_s\":%.1f,\"speedup\":%.2f}\n",
+		bytes * 8, valid ? "true" : "false", int(strips.size()),
+		double(slice.size()) / comp_size, mb / t_old, mb / t_new, t_old / t_new);
+	return valid ? 0 : 1;
+}
+
+//first page of a classic tiff
+//strips written by other software are decoded by both and compared
+static int CheckTiff(const string &filename)
+{
+	ifstream ifs(filename, ios::binary);
+	vector<unsigned char> file((istreambuf_iterator<char>(ifs)),
+		istreambuf_iterator<char>());
+	bool le = file.size() >= 8 && file[0] == 'I' && file[1] == 'I';
+	auto get = [&](size_t pos, int len) -> unsigned long long
+	{
+		unsigned long long v = 0;
+		if (pos + len > file.size())
+			return 0;
+		for (int i = 0; i < len; ++i)
+			v |= (unsigned long long)file[pos + (le ? i : len - 1 - i)] << (8 * i);
+		return v;
+	};
+	auto type_len = [](unsigned long long type) { return type == 3 ? 2 : (type == 4 ? 4 : 1); };
+	if (file.size() < 8 || get(2, 2) != 42)
+	{
+		printf("{\"lzw\":\"tiff\",\"file\":\"%s\",\"valid\":false,\"error\":\"not a classic tiff\"}\n",
+			filename.c_str());
+		return 1;
+	}
+
+	size_t ifd = size_t(get(4, 4));
+	int entry_num = int(get(ifd, 2));
+	unsigned long long width = 0, height = 0, samples = 1, bits = 8,
+		rows = 0, compression = 1;
+	vector<unsigned long long> offsets, counts;
+	for (int e = 0; e < entry_num; ++e)
+	{
+		size_t pos = ifd + 2 + size_t(e) * 12;
+		unsigned long long tag = get(pos, 2);
+		unsigned long long type = get(pos + 2, 2);
+		unsigned long long count = get(pos + 4, 4);
+		int len = type_len(type);
+		size_t vpos = count * len > 4 ? size_t(get(pos + 8, 4)) : pos + 8;
+		unsigned long long value = get(vpos, len);
+		switch (tag)
+		{
+		case 256: width = value; break;
+		case 257: height = value; break;
+		case 258: bits = value; break;
+		case 259: compression = value; break;
+		case 277: samples = value; break;
+		case 278: rows = value; break;
+		case 273:
+		case 279:
+			for (unsigned long long i = 0; i < count; ++i)
+				(tag == 273 ? offsets : counts).push_back(get(vpos + i * len, len));
+			break;
+		}
+	}
+	if (!rows || rows > height)
+		rows = height;
+	size_t row_size = size_t(width * samples * bits / 8);
+	if (compression != 5 || !row_size || offsets.empty() ||
+		offsets.size() != counts.size())
+	{
+		printf("{\"lzw\":\"tiff\",\"file\":\"%s\",\"valid\":false,\"error\":\"no lzw strips\"}\n",
+			filename.c_str());
+		return 1;
+	}
+
+	int failed = 0;
+	size_t bytes = 0;
+	vector<unsigned char> strip, out_old, out_new;
+	for (size_t s = 0; s < offsets.size(); ++s)
+	{
+		unsigned long long first = s * rows;
+		if (first >= height)
+			break;
+		size_t size = size_t(std::min(rows, height - first)) * row_size;
+		if (offsets[s] + counts[s] > file.size())
+		{
+			failed++;
+			continue;
+		}
+		strip.assign(file.begin() + size_t(offsets[s]),
+			file.begin() + size_t(offsets[s] + counts[s]));
+		bool ok = DecodeBoth(strip, strip.size(), out_old, out_new, size);
+		if (!ok || out_old != out_new)
+			failed++;
+		bytes += size;
+	}
+	printf("{\"lzw\":\"tiff\",\"file\":\"%s\",\"valid\":%s,\"strips\":%d,"
+		"\"failed\":%d,\"data_bytes\":%llu}\n",
+		filename.c_str(), failed ? "false" : "true", int(offsets.size()),
+		failed, (unsigned long long)bytes);
+	return failed ? 1 : 0;
+}
+
+int RunLZWBench(int rounds, const string &tiff_file)
+{
+	int failed = RoundTrips(rounds);
+	failed += BenchSlice(1);
+	failed += BenchSlice(2);
+	if (!tiff_file.empty())
+		failed += CheckTiff(tiff_file);
+	fflush(stdout);
+	return failed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+
+//compares LZWCodec with the linked-list decoder BaseReader used before it
+//random round trips check both against the source data,
+//synthetic 8- and 16-bit slices are timed,
+//and the strips of an lzw tiff, if given, are decoded by both and compared
+//returns the number of failed checks
+int RunLZWBench(int rounds, const std::string &tiff_file);
@@ -0,0 +1,618 @@
+#include "SynthData.h"
+#include <Formats/lzw_codec.h>
+#include <Formats/nrrd_writer.h>
+#include <Formats/msk_writer.h>
+#include <Formats/lbl_writer.h>
+#include <compatibility.h>
+#include <pole.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+SynthVolume::SynthVolume(int nx, int ny, int nz, int bits, unsigned int seed) :
+	nx_(nx), ny_(ny), nz_(nz), bits_(bits)
+{
+	unsigned int s = seed * 2654435761u + 1u;
+	auto rnd = [&s]() { s = s * 1103515245u + 12345u; return int((s >> 16) & 0x7fff); };
+
+	float max_val = bits_ == 8 ? 255.0f : 4095.0f;
+	size_t num = size_t(nx_) * ny_ * nz_;
+	vector<float> img(num, max_val * 0.05f);
+	//ids of the blobs for labels
+	vector<unsigned int> ids;
+	if (bits_ == 32)
+		ids.assign(num, 0);
+
+	//about one blob in every 32^3 voxels
+	int blob_num = int(max(size_t(1), num / 32768));
+	for (int b = 0; b < blob_num; ++b)
+	{
+		int cx = rnd() % nx_;
+		int cy = rnd() % ny_;
+		int cz = rnd() % nz_;
+		float r = 2.0f + rnd() % 6;
+		float a = max_val * (0.3f + (rnd() % 64) / 100.0f);
+		int ext = int(3.0f * r);
+		for (int k = max(0, cz - ext); k < min(nz_, cz + ext); ++k)
+		for (int j = max(0, cy - ext); j < min(ny_, cy + ext); ++j)
+		for (int i = max(0, cx - ext); i < min(nx_, cx + ext); ++i)
+		{
+			float d2 = float((i - cx)*(i - cx) + (j - cy)*(j - cy) + (k - cz)*(k - cz));
+			img[(size_t(k)*ny_ + j)*nx_ + i] += a * exp(-d2 / (2.0f*r*r));
+			//inside half maximum
+			if (bits_ == 32 && d2 < 1.386f * r * r)
+				ids[(size_t(k)*ny_ + j)*nx_ + i] = unsigned(b + 1);
+		}
+	}
+
+	if (bits_ == 32)
+	{
+		data_.resize(num * sizeof(unsigned int));
+		memcpy(&data_[0], &ids[0], data_.size());
+		return;
+	}
+
+	data_.resize(num * (bits_ / 8));
+	for (size_t i = 0; i < num; ++i)
+	{
+		int v = int(img[i]) + rnd() % 9 - 4;
+		v = max(0, min(int(max_val), v));
+		if (bits_ == 8)
+			data_[i] = (unsigned char)v;
+		else
+		{
+			data_[i * 2] = (unsigned char)(v & 0xff);
+			data_[i * 2 + 1] = (unsigned char)(v >> 8);
+		}
+	}
+}
+
+//tiff writing
+#define TIFF_SHORT	3
+#define TIFF_LONG	4
+#define TIFF_LONG8	16
+#define TIFF_TILE_SIZE	128
+#define TIFF_STRIP_SIZE	8192
+
+struct TiffField
+{
+	unsigned short tag;
+	unsigned short type;
+	vector<unsigned long long> values;
+};
+
+static void PutInt(vector<unsigned char> &out, unsigned long long v, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)
+		out.push_back((unsigned char)(v >> (i * 8)));
+}
+
+static void SetInt(vector<unsigned char> &out, size_t pos, unsigned long long v, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)
+		out[pos + i] = (unsigned char)(v >> (i * 8));
+}
+
+static int TypeSize(unsigned short type)
+{
+	switch (type)
+	{
+	case TIFF_SHORT:
+		return 2;
+	case TIFF_LONG:
+		return 4;
+	case TIFF_LONG8:
+		return 8;
+	default:
+		return 1;
+	}
+}
+
+static void AlignWord(vector<unsigned char> &out)
+{
+	if (out.size() & 1)
+		out.push_back(0);
+}
+
+//header of a tiff, returns where the first directory offset goes
+static size_t PutTiffHeader(vector<unsigned char> &out, bool big)
+{
+	out.push_back('I');
+	out.push_back('I');
+	if (big)
+	{
+		PutInt(out, 43, 2);
+		PutInt(out, 8, 2);
+		PutInt(out, 0, 2);
+		PutInt(out, 0, 8);
+		return 8;
+	}
+	PutInt(out, 42, 2);
+	PutInt(out, 0, 4);
+	return 4;
+}
+
+//write a directory and link it from next_ptr
+//arrays that don't fit in an entry are written ahead of it
+static void PutTiffIfd(vector<unsigned char> &out, size_t &next_ptr,
+	const vector<TiffField> &fields, bool big)
+{
+	int val_size = big ? 8 : 4;
+	vector<unsigned long long> value_pos(fields.size(), 0);
+	for (size_t i = 0; i < fields.size(); ++i)
+	{
+		int type_size = TypeSize(fields[i].type);
+		if (type_size * fields[i].values.size() <= size_t(val_size))
+			continue;
+		value_pos[i] = out.size();
+		for (size_t j = 0; j < fields[i].values.size(); ++j)
+			PutInt(out, fields[i].values[j], type_size);
+		AlignWord(out);
+	}
+
+	SetInt(out, next_ptr, out.size(), val_size);
+	PutInt(out, fields.size(), big ? 8 : 2);
+	for (size_t i = 0; i < fields.size(); ++i)
+	{
+		int type_size = TypeSize(fields[i].type);
+		PutInt(out, fields[i].tag, 2);
+		PutInt(out, fields[i].type, 2);
+		PutInt(out, fields[i].values.size(), val_size);
+		if (value_pos[i])
+			PutInt(out, value_pos[i], val_size);
+		else
+		{
+			for (size_t j = 0; j < fields[i].values.size(); ++j)
+				PutInt(out, fields[i].values[j], type_size);
+			for (size_t j = type_size * fields[i].values.size(); j < size_t(val_size); ++j)
+				out.push_back(0);
+		}
+	}
+	next_ptr = out.size();
+	PutInt(out, 0, val_size);
+}
+
+//predictor 2, each row keeps its first sample
+static void Difference(vector<unsigned char> &chunk, int width, int rows, int bytes)
+{
+	for (int j = 0; j < rows; ++j)
+	{
+		if (bytes == 1)
+		{
+			unsigned char* row = &chunk[size_t(j) * width];
+			for (int i = width - 1; i > 0; --i)
+				row[i] -= row[i - 1];
+		}
+		else
+		{
+			unsigned short* row = (unsigned short*)&chunk[size_t(j) * width * 2];
+			for (int i = width - 1; i > 0; --i)
+				row[i] -= row[i - 1];
+		}
+	}
+}
+
+static void PutTiffPage(vector<unsigned char> &out, size_t &next_ptr,
+	const SynthVolume &vol, int z, const TiffLayout &layout)
+{
+	int bytes = vol.bits() / 8;
+	int w = vol.nx();
+	int h = vol.ny();
+	const unsigned char* page = vol.slice(z);
+
+	//strips span the width, tiles are padded at the edges
+	int cw = layout.tiled ? TIFF_TILE_SIZE : w;
+	int ch = layout.tiled ? TIFF_TILE_SIZE :
+		max(1, int(TIFF_STRIP_SIZE / (size_t(w) * bytes)));
+	int ncx = (w + cw - 1) / cw;
+	int ncy = (h + ch - 1) / ch;
+
+	vector<unsigned long long> offsets;
+	vector<unsigned long long> counts;
+	vector<unsigned char> chunk;
+	vector<unsigned char> code;
+	for (int cy = 0; cy < ncy; ++cy)
+	for (int cx = 0; cx < ncx; ++cx)
+	{
+		int rows = layout.tiled ? ch : min(ch, h - cy * ch);
+		int cols = min(cw, w - cx * cw);
+		chunk.assign(size_t(cw) * rows * bytes, 0);
+		for (int j = 0; j < rows && cy * ch + j < h; ++j)
+			memcpy(&chunk[size_t(j) * cw * bytes],
+				page + (size_t(cy * ch + j) * w + cx * cw) * bytes,
+				size_t(cols) * bytes);
+		if (layout.lzw)
+		{
+			Difference(chunk, cw, rows, bytes);
+			LZWCodec::Encode(&chunk[0], chunk.size(), code);
+		}
+		const vector<unsigned char> &src = layout.lzw ? code : chunk;
+		offsets.push_back(out.size());
+		counts.push_back(src.size());
+		out.insert(out.end(), src.begin(), src.end());
+		AlignWord(out);
+	}
+
+	unsigned short otype = layout.big ? TIFF_LONG8 : TIFF_LONG;
+	vector<TiffField> fields;
+	fields.push_back({ 254, TIFF_LONG, { 0 } });
+	fields.push_back({ 256, TIFF_LONG, { (unsigned long long)w } });
+	fields.push_back({ 257, TIFF_LONG, { (unsigned long long)h } });
+	fields.push_back({ 258, TIFF_SHORT, { (unsigned long long)vol.bits() } });
+	fields.push_back({ 259, TIFF_SHORT, { layout.lzw ? 5ull : 1ull } });
+	fields.push_back({ 262, TIFF_SHORT, { 1 } });
+	if (!layout.tiled)
+		fields.push_back({ 273, otype, offsets });
+	fields.push_back({ 277, TIFF_SHORT, { 1 } });
+	if (!layout.tiled)
+	{
+		fields.push_back({ 278, TIFF_LONG, { (unsigned long long)ch } });
+		fields.push_back({ 279, otype, counts });
+	}
+	fields.push_back({ 284, TIFF_SHORT, { 1 } });
+	fields.push_back({ 317, TIFF_SHORT, { layout.lzw ? 2ull : 1ull } });
+	if (layout.tiled)
+	{
+		fields.push_back({ 322, TIFF_LONG, { (unsigned long long)cw } });
+		fields.push_back({ 323, TIFF_LONG, { (unsigned long long)ch } });
+		fields.push_back({ 324, otype, offsets });
+		fields.push_back({ 325, otype, counts });
+	}
+	PutTiffIfd(out, next_ptr, fields, layout.big);
+}
+
+void BuildTiff(const SynthVolume &vol, int z0, int z1,
+	const TiffLayout &layout, vector<unsigned char> &out)
+{
+	out.clear();
+	size_t next_ptr = PutTiffHeader(out, layout.big);
+	for (int z = z0; z < z1; ++z)
+		PutTiffPage(out, next_ptr, vol, z, layout);
+}
+
+static bool WriteBuffer(const wstring &filename, const vector<unsigned char> &buf)
+{
+	FILE* fp = 0;
+	if (!WFOPEN(&fp, filename.c_str(), L"wb"))
+		return false;
+	bool result = fwrite(&buf[0], 1, buf.size(), fp) == buf.size();
+	fclose(fp);
+	return result;
+}
+
+bool WriteTiff(const wstring &filename, const SynthVolume &vol,
+	const TiffLayout &layout)
+{
+	vector<unsigned char> buf;
+	BuildTiff(vol, 0, vol.nz(), layout, buf);
+	return WriteBuffer(filename, buf);
+}
+
+//zeiss lsm: a tiff with all channels of a slice in one directory
+//and the scan information in tag 34412
+#define LSM_INFO_SIZE	512
+
+bool WriteLsm(const wstring &filename, const vector<SynthVolume> &chans)
+{
+	if (chans.empty())
+		return false;
+	const SynthVolume &vol = chans[0];
+	int nc = int(chans.size());
+
+	vector<unsigned char> out;
+	size_t next_ptr = PutTiffHeader(out, false);
+
+	//scan information
+	size_t info_pos = out.size();
+	out.resize(info_pos + LSM_INFO_SIZE, 0);
+	SetInt(out, info_pos, 0x0400494C, 4);
+	SetInt(out, info_pos + 4, LSM_INFO_SIZE, 4);
+	SetInt(out, info_pos + 8, vol.nx(), 4);
+	SetInt(out, info_pos + 12, vol.ny(), 4);
+	SetInt(out, info_pos + 16, vol.nz(), 4);
+	SetInt(out, info_pos + 20, nc, 4);
+	SetInt(out, info_pos + 24, 1, 4);
+	//1: 8-bit; 2: 12-bit
+	SetInt(out, info_pos + 28, vol.bits() == 8 ? 1 : 2, 4);
+	//voxel size in meters
+	double spc[3] = { 0.2e-6, 0.2e-6, 1.0e-6 };
+	memcpy(&out[info_pos + 40], spc, sizeof(spc));
+
+	for (int z = 0; z < vol.nz(); ++z)
+	{
+		vector<unsigned long long> offsets;
+		vector<unsigned long long> counts;
+		for (int c = 0; c < nc; ++c)
+		{
+			offsets.push_back(out.size());
+			counts.push_back(chans[c].slice_bytes());
+			out.insert(out.end(), chans[c].slice(z),
+				chans[c].slice(z) + chans[c].slice_bytes());
+			AlignWord(out);
+		}
+		vector<TiffField> fields;
+		fields.push_back({ 254, TIFF_LONG, { 0 } });
+		fields.push_back({ 256, TIFF_LONG, { (unsigned long long)vol.nx() } });
+		fields.push_back({ 257, TIFF_LONG, { (unsigned long long)vol.ny() } });
+		fields.push_back({ 258, TIFF_SHORT, vector<unsigned long long>(nc, vol.bits()) });
+		fields.push_back({ 259, TIFF_SHORT, { 1 } });
+		fields.push_back({ 262, TIFF_SHORT, { 1 } });
+		fields.push_back({ 273, TIFF_LONG, offsets });
+		fields.push_back({ 277, TIFF_SHORT, { (unsigned long long)nc } });
+		fields.push_back({ 279, TIFF_LONG, counts });
+		fields.push_back({ 284, TIFF_SHORT, { 2 } });
+		if (z == 0)
+		{
+			//a byte array, so it isn't inlined
+			fields.push_back({ 34412, 1, {} });
+		}
+		size_t link = next_ptr;
+		PutTiffIfd(out, next_ptr, fields, false);
+		if (z == 0)
+		{
+			//point the lsm entry at the scan information
+			size_t ifd = out[link] | (out[link + 1] << 8) |
+				(out[link + 2] << 16) | (size_t(out[link + 3]) << 24);
+			size_t entry = ifd + 2 + 12 * (fields.size() - 1);
+			SetInt(out, entry + 4, LSM_INFO_SIZE, 4);
+			SetInt(out, entry + 8, info_pos, 4);
+		}
+	}
+
+	return WriteBuffer(filename, out);
+}
+
+bool WriteNrrd(const wstring &filename, SynthVolume &vol, bool gzip)
+{
+	Nrrd* nrrd = nrrdNew();
+	nrrdWrap(nrrd, vol.data(),
+		vol.bits() == 8 ? nrrdTypeUChar : nrrdTypeUShort, 3,
+		(size_t)vol.nx(), (size_t)vol.ny(), (size_t)vol.nz());
+	NRRDWriter writer;
+	writer.SetData(nrrd);
+	writer.SetSpacings(0.2, 0.2, 1.0);
+	writer.SetCompression(gzip);
+	writer.Save(filename, 0);
+	//the data belongs to the volume
+	nrrdNix(nrrd);
+	return boost::filesystem::exists(filename);
+}
+
+bool WriteMsk(const wstring &filename, SynthVolume &vol)
+{
+	Nrrd* nrrd = nrrdNew();
+	nrrdWrap(nrrd, vol.data(), nrrdTypeUChar, 3,
+		(size_t)vol.nx(), (size_t)vol.ny(), (size_t)vol.nz());
+	MSKWriter writer;
+	writer.SetData(nrrd);
+	writer.SetSpacings(0.2, 0.2, 1.0);
+	writer.Save(filename, 0);
+	nrrdNix(nrrd);
+	return boost::filesystem::exists(filename);
+}
+
+bool WriteLbl(const wstring &filename, SynthVolume &vol)
+{
+	Nrrd* nrrd = nrrdNew();
+	nrrdWrap(nrrd, vol.data(), nrrdTypeUInt, 3,
+		(size_t)vol.nx(), (size_t)vol.ny(), (size_t)vol.nz());
+	LBLWriter writer;
+	writer.SetData(nrrd);
+	writer.SetSpacings(0.2, 0.2, 1.0);
+	writer.Save(filename, 0);
+	nrrdNix(nrrd);
+	return boost::filesystem::exists(filename);
+}
+
+//olympus text files are utf-16
+static void PutUtf16(vector<unsigned char> &out, const string &str)
+{
+	for (size_t i = 0; i < str.size(); ++i)
+		PutInt(out, (unsigned char)str[i], 2);
+}
+
+static string OifText(const SynthVolume &vol, int nc, const string &eol)
+{
+	ostringstream oss;
+	oss << "[ProfileSaveInfo]" << eol;
+	const char* codes[3] = { "X", "Y", "Z" };
+	int sizes[3] = { vol.nx(), vol.ny(), vol.nz() };
+	double spcs[3] = { 0.2, 0.2, 1.0 };
+	int axes[3] = { 0, 1, 3 };
+	for (int i = 0; i < 3; ++i)
+	{
+		oss << "[Axis " << axes[i] << " Parameters Common]" << eol;
+		oss << "AxisCode=\"" << codes[i] << "\"" << eol;
+		oss << "EndPosition=" << sizes[i] * spcs[i] << eol;
+		oss << "MaxSize=" << sizes[i] << eol;
+		oss << "PixUnit=\"um\"" << eol;
+		oss << "StartPosition=0.0" << eol;
+	}
+	for (int c = 0; c < nc; ++c)
+	{
+		oss << "[Channel " << c + 1 << " Parameters]" << eol;
+		oss << "ExcitationWavelength=" << 488 + c * 73 << eol;
+		oss << "LightType=\"Laser\"" << eol;
+	}
+	return oss.str();
+}
+
+static string SliceName(int c, int z)
+{
+	char name[32];
+	SPRINTF(name, sizeof(name), "s_C%03dZ%03d.tif", c + 1, z + 1);
+	return name;
+}
+
+bool WriteOif(const wstring &filename, const vector<SynthVolume> &chans)
+{
+	if (chans.empty())
+		return false;
+	int nc = int(chans.size());
+
+	//slices go in a folder next to the oif file
+	wstring dir = filename + L".files" + GETSLASH();
+	boost::system::error_code ec;
+	boost::filesystem::create_directories(dir, ec);
+	TiffLayout layout = { false, false, false };
+	vector<unsigned char> buf;
+	for (int c = 0; c < nc; ++c)
+	for (int z = 0; z < chans[c].nz(); ++z)
+	{
+		BuildTiff(chans[c], z, z + 1, layout, buf);
+		if (!WriteBuffer(dir + s2ws(SliceName(c, z)), buf))
+			return false;
+	}
+
+	buf.clear();
+	PutInt(buf, 0xFEFF, 2);
+	PutUtf16(buf, OifText(chans[0], nc, "\r\n"));
+	return WriteBuffer(filename, buf);
+}
+
+static bool WriteStream(POLE::Storage &stg, const string &name,
+	vector<unsigned char> &buf)
+{
+	POLE::Stream stm(&stg, name, true, buf.size());
+	if (stm.fail())
+		return false;
+	if (stm.write(&buf[0], buf.size()) != buf.size())
+		return false;
+	//pole only writes the header and tables on a flush
+	stm.flush();
+	return true;
+}
+
+bool WriteOib(const wstring &filename, const vector<SynthVolume> &chans)
+{
+	if (chans.empty())
+		return false;
+	int nc = int(chans.size());
+
+	boost::system::error_code ec;
+	boost::filesystem::remove(filename, ec);
+	POLE::Storage stg(ws2s(filename).c_str());
+	if (!stg.open(true, true))
+		return false;
+
+	string name = ws2s(filename);
+	name = name.substr(name.find_last_of("/\\") + 1);
+	name = name.substr(0, name.find_last_of('.')) + ".oif";
+
+	//the oib info maps streams to the slice names of an oif
+	ostringstream info;
+	info << "[OibSaveInfo]\n";
+	info << "MainFileName=" << name << "\n";
+	info << "[Storage]\n";
+	info << "Storage00001=" << name << ".files\n";
+	info << "[Stream]\n";
+	int stream = 0;
+	bool result = true;
+	vector<unsigned char> buf;
+	TiffLayout layout = { false, false, false };
+	for (int c = 0; c < nc && result; ++c)
+	for (int z = 0; z < chans[c].nz() && result; ++z, ++stream)
+	{
+		char stream_name[32];
+		SPRINTF(stream_name, sizeof(stream_name), "Stream%05d", stream);
+		info << stream_name << "=" << name << ".files/" << SliceName(c, z) << "\n";
+		BuildTiff(chans[c], z, z + 1, layout, buf);
+		result = WriteStream(stg, string("/Storage00001/") + stream_name, buf);
+	}
+
+	if (result)
+	{
+		buf.clear();
+		PutInt(buf, 0xFEFF, 2);
+		PutUtf16(buf, info.str());
+		result = WriteStream(stg, "/OibInfo.txt", buf);
+	}
+	if (result)
+	{
+		buf.clear();
+		PutInt(buf, 0xFEFF, 2);
+		PutUtf16(buf, OifText(chans[0], nc, "\n"));
+		result = WriteStream(stg, "/" + name, buf);
+	}
+	stg.close();
+	return result;
+}
+
+bool WriteBrk(const wstring &filename, const SynthVolume &vol, int brick_size)
+{
+	string name = ws2s(filename);
+	string dir_name = name.substr(name.find_last_of("/\\") + 1);
+	dir_name = dir_name.substr(0, dir_name.find_last_of('.')) + "_data";
+	wstring dir = GET_PATH(const_cast<wstring&>(filename)) + s2ws(dir_name);
+	boost::system::error_code ec;
+	boost::filesystem::create_directories(dir, ec);
+
+	int bytes = vol.bits() / 8;
+	ostringstream xml;
+	xml << "<BRK nChannel=\"1\" nFrame=\"1\" nLevel=\"2\" CopyableLv=\"1\">\n";
+	for (int lv = 0; lv < 2; ++lv)
+	{
+		//the second level halves x and y
+		int step = 1 << lv;
+		int nx = vol.nx() / step;
+		int ny = vol.ny() / step;
+		int nz = vol.nz();
+		int bx = min(brick_size, nx);
+		int by = min(brick_size, ny);
+		int bz = min(brick_size, nz);
+		xml << "<Level lv=\"" << lv << "\" imageW=\"" << nx << "\" imageH=\"" << ny <<
+			"\" imageD=\"" << nz << "\" xspc=\"" << 0.2 * step << "\" yspc=\"" << 0.2 * step <<
+			"\" zspc=\"1\" bitDepth=\"" << vol.bits() << "\" FileType=\"RAW\">\n";
+		xml << "<Bricks brick_baseW=\"" << bx << "\" brick_baseH=\"" << by <<
+			"\" brick_baseD=\"" << bz << "\">\n";
+
+		ostringstream files;
+		vector<unsigned char> buf;
+		string raw_name = "lv" + to_string(lv) + ".raw";
+		int id = 0;
+		for (int z0 = 0; z0 < nz; z0 += bz)
+		for (int y0 = 0; y0 < ny; y0 += by)
+		for (int x0 = 0; x0 < nx; x0 += bx, ++id)
+		{
+			int w = min(bx, nx - x0);
+			int h = min(by, ny - y0);
+			int d = min(bz, nz - z0);
+			size_t offset = buf.size();
+			for (int k = z0; k < z0 + d; ++k)
+			for (int j = y0; j < y0 + h; ++j)
+			for (int i = x0; i < x0 + w; ++i)
+			{
+				const unsigned char* v = vol.slice(k) +
+					(size_t(j * step) * vol.nx() + i * step) * bytes;
+				buf.insert(buf.end(), v, v + bytes);
+			}
+			size_t size = buf.size() - offset;
+			xml << "<Brick id=\"" << id << "\" width=\"" << w << "\" height=\"" << h <<
+				"\" depth=\"" << d << "\" st_x=\"" << x0 << "\" st_y=\"" << y0 <<
+				"\" st_z=\"" << z0 << "\" offset=\"" << offset << "\" size=\"" << size << "\">\n";
+			xml << "<tbox x0=\"0\" y0=\"0\" z0=\"0\" x1=\"1\" y1=\"1\" z1=\"1\"/>\n";
+			xml << "<bbox x0=\"" << double(x0) / nx << "\" y0=\"" << double(y0) / ny <<
+				"\" z0=\"" << double(z0) / nz << "\" x1=\"" << double(x0 + w) / nx <<
+				"\" y1=\"" << double(y0 + h) / ny << "\" z1=\"" << double(z0 + d) / nz << "\"/>\n";
+			xml << "</Brick>\n";
+			files << "<File frame=\"0\" channel=\"0\" brickID=\"" << id <<
+				"\" filepath=\"" << dir_name << "/" << raw_name << "\" offset=\"" << offset <<
+				"\" datasize=\"" << size << "\" filetype=\"RAW\"/>\n";
+		}
+		xml << "</Bricks>\n";
+		xml << "<Files>\n" << files.str() << "</Files>\n";
+		xml << "</Level>\n";
+
+		if (!WriteBuffer(dir + GETSLASH() + s2ws(raw_name), buf))
+			return false;
+	}
+	xml << "</BRK>\n";
+
+	string str = xml.str();
+	return WriteBuffer(filename, vector<unsigned char>(str.begin(), str.end()));
+}
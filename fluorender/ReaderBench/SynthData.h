@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <string>
+
+//a synthetic stack that compresses like a fluorescence image:
+//dim background, gaussian blobs and a little noise
+//16-bit volumes hold 12-bit values, as most confocal data does
+//32-bit volumes hold the blob ids, as a label volume does
+class SynthVolume
+{
+public:
+	SynthVolume(int nx, int ny, int nz, int bits, unsigned int seed);
+
+	int nx() const { return nx_; }
+	int ny() const { return ny_; }
+	int nz() const { return nz_; }
+	int bits() const { return bits_; }
+	size_t bytes() const { return data_.size(); }
+	size_t slice_bytes() const { return size_t(nx_) * ny_ * (bits_ / 8); }
+	const unsigned char* slice(int z) const { return &data_[0] + slice_bytes() * z; }
+	unsigned char* data() { return &data_[0]; }
+	const unsigned char* data() const { return &data_[0]; }
+
+private:
+	int nx_, ny_, nz_, bits_;
+	std::vector<unsigned char> data_;
+};
+
+//how image data of a tiff is laid out
+struct TiffLayout
+{
+	bool lzw;	//compression 5 with horizontal differencing
+	bool tiled;	//128x128 tiles instead of strips
+	bool big;	//bigtiff header and directories
+};
+
+//build a tiff in memory, one page for each slice in [z0, z1)
+void BuildTiff(const SynthVolume &vol, int z0, int z1,
+	const TiffLayout &layout, std::vector<unsigned char> &out);
+
+//dataset writers, one volume per channel
+//all return false if the files can't be created
+bool WriteTiff(const std::wstring &filename, const SynthVolume &vol,
+	const TiffLayout &layout);
+bool WriteLsm(const std::wstring &filename, const std::vector<SynthVolume> &chans);
+bool WriteNrrd(const std::wstring &filename, SynthVolume &vol, bool gzip);
+//block compressed mask and run length coded label
+bool WriteMsk(const std::wstring &filename, SynthVolume &vol);
+bool WriteLbl(const std::wstring &filename, SynthVolume &vol);
+bool WriteOif(const std::wstring &filename, const std::vector<SynthVolume> &chans);
+bool WriteOib(const std::wstring &filename, const std::vector<SynthVolume> &chans);
+//two pyramid levels of raw bricks
+bool WriteBrk(const std::wstring &filename, const SynthVolume &vol, int brick_size);
@@ -0,0 +1,477 @@
+//headless reader benchmark
+//generates synthetic datasets once, then times Preprocess() and Convert()
+//of each reader in its own process, so the peak memory of a case isn't
+//inflated by the ones before it
+//results are printed as one json object per line
+#include "SynthData.h"
+#include "LZWBench.h"
+#include <Formats/tif_reader.h>
+#include <Formats/lsm_reader.h>
+#include <Formats/nrrd_reader.h>
+#include <Formats/oif_reader.h>
+#include <Formats/oib_reader.h>
+#include <Formats/brkxml_reader.h>
+#include <Formats/msk_reader.h>
+#include <Formats/lbl_reader.h>
+#include <FLIVR/TextureBrick.h>
+#include <compatibility.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+struct BenchCase
+{
+	const char* name;
+	const char* format;	//tif, lsm, nrrd, oif, oib, brk, msk, lbl
+	const char* file;
+	int bits;
+	int chans;
+	TiffLayout layout;	//tif only
+	bool gzip;		//nrrd only
+};
+
+static const BenchCase bench_cases[] =
+{
+	{ "tif_raw_8", "tif", "raw8.tif", 8, 1, { false, false, false }, false },
+	{ "tif_raw_16", "tif", "raw16.tif", 16, 1, { false, false, false }, false },
+	{ "tif_lzw_8", "tif", "lzw8.tif", 8, 1, { true, false, false }, false },
+	{ "tif_lzw_16", "tif", "lzw16.tif", 16, 1, { true, false, false }, false },
+	{ "tif_tiled_16", "tif", "tiled16.tif", 16, 1, { false, true, false }, false },
+	{ "tif_tiled_lzw_16", "tif", "tiledlzw16.tif", 16, 1, { true, true, false }, false },
+	{ "tif_big_16", "tif", "big16.tif", 16, 1, { false, false, true }, false },
+	{ "tif_big_lzw_16", "tif", "biglzw16.tif", 16, 1, { true, false, true }, false },
+	{ "lsm_8", "lsm", "scan8.lsm", 8, 2, {}, false },
+	{ "lsm_12", "lsm", "scan12.lsm", 16, 2, {}, false },
+	{ "nrrd_raw_8", "nrrd", "raw8.nrrd", 8, 1, {}, false },
+	{ "nrrd_raw_16", "nrrd", "raw16.nrrd", 16, 1, {}, false },
+	{ "nrrd_gz_16", "nrrd", "gz16.nrrd", 16, 1, {}, true },
+	{ "oif_16", "oif", "olympus.oif", 16, 2, {}, false },
+	{ "oib_16", "oib", "olympus.oib", 16, 2, {}, false },
+	{ "brk_8", "brk", "bricks8.vvd", 8, 1, {}, false },
+	{ "brk_16", "brk", "bricks16.vvd", 16, 1, {}, false },
+	{ "msk_8", "msk", "mask8.msk", 8, 1, {}, false },
+	{ "lbl_rle_32", "lbl", "label32.lbl", 32, 1, {}, false },
+};
+
+static const int bench_case_num = int(sizeof(bench_cases) / sizeof(BenchCase));
+
+struct BenchParams
+{
+	int nx, ny, nz;
+	int repeat;
+	int brick_size;
+	wstring dir;
+};
+
+//the generation parameters are part of the file name,
+//so a dataset is only reused by runs that would write the same one
+static wstring CaseFile(const BenchParams &params, int index)
+{
+	const BenchCase &bc = bench_cases[index];
+	string file = bc.file;
+	size_t ext = file.find_last_of('.');
+	char tag[64];
+	if (string(bc.format) == "brk")
+		SPRINTF(tag, sizeof(tag), "_%dx%dx%d_b%d",
+			params.nx, params.ny, params.nz, params.brick_size);
+	else
+		SPRINTF(tag, sizeof(tag), "_%dx%dx%d",
+			params.nx, params.ny, params.nz);
+	return params.dir + s2ws(file.substr(0, ext) + tag + file.substr(ext));
+}
+
+//channels are seeded by case and channel, so a run can regenerate them
+static vector<SynthVolume> MakeVolumes(const BenchParams &params, int index)
+{
+	const BenchCase &bc = bench_cases[index];
+	vector<SynthVolume> vols;
+	for (int c = 0; c < bc.chans; ++c)
+		vols.push_back(SynthVolume(params.nx, params.ny, params.nz,
+			bc.bits, unsigned(index * 16 + c)));
+	//masks are selections of the blobs
+	if (string(bc.format) == "msk")
+	{
+		for (auto &vol : vols)
+		{
+			unsigned char* p = vol.data();
+			for (size_t i = 0; i < vol.bytes(); ++i)
+				p[i] = p[i] > 64 ? 255 : 0;
+		}
+	}
+	return vols;
+}
+
+static bool Generate(const BenchParams &params, int index)
+{
+	const BenchCase &bc = bench_cases[index];
+	wstring filename = CaseFile(params, index);
+	vector<SynthVolume> vols = MakeVolumes(params, index);
+	string format = bc.format;
+	if (format == "tif")
+		return WriteTiff(filename, vols[0], bc.layout);
+	else if (format == "lsm")
+		return WriteLsm(filename, vols);
+	else if (format == "nrrd")
+		return WriteNrrd(filename, vols[0], bc.gzip);
+	else if (format == "oif")
+		return WriteOif(filename, vols);
+	else if (format == "oib")
+		return WriteOib(filename, vols);
+	else if (format == "brk")
+		return WriteBrk(filename, vols[0], params.brick_size);
+	else if (format == "msk")
+		return WriteMsk(filename, vols[0]);
+	else if (format == "lbl")
+		return WriteLbl(filename, vols[0]);
+	return false;
+}
+
+static BaseReader* CreateReader(const string &format, string &reader_name)
+{
+	if (format == "tif")
+	{
+		reader_name = "TIFReader";
+		return new TIFReader();
+	}
+	else if (format == "lsm")
+	{
+		reader_name = "LSMReader";
+		return new LSMReader();
+	}
+	else if (format == "nrrd")
+	{
+		reader_name = "NRRDReader";
+		return new NRRDReader();
+	}
+	else if (format == "oif")
+	{
+		reader_name = "OIFReader";
+		return new OIFReader();
+	}
+	else if (format == "oib")
+	{
+		reader_name = "OIBReader";
+		return new OIBReader();
+	}
+	else if (format == "brk")
+	{
+		reader_name = "BRKXMLReader";
+		return new BRKXMLReader();
+	}
+	else if (format == "msk")
+	{
+		reader_name = "MSKReader";
+		return new MSKReader();
+	}
+	else if (format == "lbl")
+	{
+		reader_name = "LBLReader";
+		return new LBLReader();
+	}
+	return 0;
+}
+
+//peak resident memory of this process in kb
+static size_t GetPeakRss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return pmc.PeakWorkingSetSize / 1024;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+#ifdef _DARWIN
+	return size_t(usage.ru_maxrss) / 1024;
+#else
+	return size_t(usage.ru_maxrss);
+#endif
+#endif
+}
+
+static size_t GetFileBytes(const wstring &filename)
+{
+	boost::system::error_code ec;
+	if (boost::filesystem::is_directory(filename, ec))
+		return 0;
+	size_t size = boost::filesystem::file_size(filename, ec);
+	if (ec)
+		return 0;
+	//slices of an oif and the bricks of a vvd are next to it
+	wstring dirs[] = { filename + L".files",
+		filename.substr(0, filename.find_last_of(L'.')) + L"_data" };
+	for (auto &dir : dirs)
+	{
+		if (!boost::filesystem::is_directory(dir, ec))
+			continue;
+		for (boost::filesystem::directory_iterator it(dir), end; it != end; ++it)
+			size += boost::filesystem::file_size(it->path(), ec);
+	}
+	return size;
+}
+
+//bricks are read by the renderer, not by Convert()
+//load the first level the way the brick loader does
+static size_t LoadBricks(BRKXMLReader* reader, const BenchParams &params)
+{
+	int b = params.brick_size;
+	int brick_num = ((params.nx + b - 1) / b) *
+		((params.ny + b - 1) / b) * ((params.nz + b - 1) / b);
+	size_t bytes = 0;
+	for (int c = 0; c < reader->GetChanNum(); ++c)
+	for (int id = 0; id < brick_num; ++id)
+	{
+		FLIVR::FileLocInfo finfo = reader->GetBrickFilePath(0, c, id, 0);
+		if (finfo.filename.empty())
+			break;
+		char* data = 0;
+		size_t size = 0;
+		if (!FLIVR::TextureBrick::read_brick_without_decomp(data, size, &finfo))
+			break;
+		bytes += size;
+		delete[] data;
+	}
+	return bytes;
+}
+
+static int RunCase(const BenchParams &params, int index)
+{
+	const BenchCase &bc = bench_cases[index];
+	wstring filename = CaseFile(params, index);
+	string reader_name;
+	bool brk = string(bc.format) == "brk";
+	//mask and label readers have no channels of their own
+	bool side = string(bc.format) == "msk" || string(bc.format) == "lbl";
+
+	double pre_best = 0.0, conv_best = 0.0, total_best = 0.0;
+	size_t data_bytes = 0;
+	int result = READER_OK;
+	vector<Nrrd*> nrrds;
+	for (int r = 0; r < params.repeat && result == READER_OK; ++r)
+	{
+		for (size_t i = 0; i < nrrds.size(); ++i)
+			nrrdNuke(nrrds[i]);
+		nrrds.clear();
+
+		unique_ptr<BaseReader> reader(CreateReader(bc.format, reader_name));
+		auto t0 = chrono::high_resolution_clock::now();
+		reader->SetFile(filename);
+		result = reader->Preprocess();
+		auto t1 = chrono::high_resolution_clock::now();
+		data_bytes = 0;
+		if (result == READER_OK)
+		{
+			int chan_num = side ? 1 : reader->GetChanNum();
+			for (int c = 0; c < chan_num; ++c)
+			{
+				Nrrd* nrrd = reader->Convert(0, c, true);
+				if (!nrrd)
+					continue;
+				if (nrrd->data)
+					data_bytes += nrrdElementNumber(nrrd) * nrrdElementSize(nrrd);
+				nrrds.push_back(nrrd);
+			}
+			if (brk)
+				data_bytes = LoadBricks((BRKXMLReader*)reader.get(), params);
+		}
+		auto t2 = chrono::high_resolution_clock::now();
+
+		double pre = chrono::duration<double>(t1 - t0).count();
+		double conv = chrono::duration<double>(t2 - t1).count();
+		if (r == 0 || pre + conv < total_best)
+		{
+			pre_best = pre;
+			conv_best = conv;
+			total_best = pre + conv;
+		}
+	}
+	//before the reference data is made
+	size_t peak_rss = GetPeakRss();
+
+	//check the data against what was written
+	bool valid = result == READER_OK;
+	if (valid)
+	{
+		vector<SynthVolume> vols = MakeVolumes(params, index);
+		size_t expected = 0;
+		for (size_t c = 0; c < vols.size(); ++c)
+			expected += vols[c].bytes();
+		valid = data_bytes == expected;
+		if (valid && !brk)
+		{
+			valid = nrrds.size() == vols.size();
+			for (size_t c = 0; c < nrrds.size() && valid; ++c)
+				valid = memcmp(nrrds[c]->data, vols[c].data(), vols[c].bytes()) == 0;
+		}
+	}
+	for (size_t i = 0; i < nrrds.size(); ++i)
+		nrrdNuke(nrrds[i]);
+
+	double mb = double(data_bytes) / (1024.0 * 1024.0);
+	printf("{\"case\":\"%s\",\"reader\":\"%s\",\"result\":%d,\"valid\":%s,"
+		"\"width\":%d,\"height\":%d,\"depth\":%d,\"channels\":%d,\"bits\":%d,"
+		"\"file_bytes\":%llu,\"data_bytes\":%llu,"
+		"\"preprocess_ms\":%.3f,\"convert_ms\":%.3f,\"mb_per_s\":%.1f,"
+		"\"peak_rss_kb\":%llu}\n",
+		bc.name, reader_name.c_str(), result, valid ? "true" : "false",
+		params.nx, params.ny, params.nz, bc.chans, bc.bits,
+		(unsigned long long)GetFileBytes(filename), (unsigned long long)data_bytes,
+		pre_best * 1000.0, conv_best * 1000.0,
+		total_best > 0.0 ? mb / total_best : 0.0,
+		(unsigned long long)peak_rss);
+	fflush(stdout);
+	return valid ? 0 : 1;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"usage: ReaderBench [-dir path] [-size x y z] [-repeat n] [-brick n]\n"
+		"                   [-case name] [-list]\n"
+		"       ReaderBench -run name [-dir path] [-size x y z] [-repeat n] [-brick n]\n"
+		"       ReaderBench -lzw [-lzw_tiff file]\n"
+		"datasets are kept in the directory and reused by later runs\n"
+		"with the same size and brick size\n"
+		"-run times one case in this process, on a dataset already generated;\n"
+		"it is how each case is started in its own process\n"
+		"-lzw compares the lzw decoder with the legacy one; -lzw_tiff also\n"
+		"decodes the strips of an lzw tiff written by other software\n");
+}
+
+int main(int argc, char* argv[])
+{
+	BenchParams params;
+	params.nx = 512;
+	params.ny = 512;
+	params.nz = 64;
+	params.repeat = 3;
+	params.brick_size = 128;
+	string dir;
+	string filter;
+	string run;
+	bool lzw = false;
+	string lzw_tiff;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "-dir" && i + 1 < argc)
+			dir = argv[++i];
+		else if (arg == "-size" && i + 3 < argc)
+		{
+			params.nx = atoi(argv[++i]);
+			params.ny = atoi(argv[++i]);
+			params.nz = atoi(argv[++i]);
+		}
+		else if (arg == "-repeat" && i + 1 < argc)
+			params.repeat = atoi(argv[++i]);
+		else if (arg == "-brick" && i + 1 < argc)
+			params.brick_size = atoi(argv[++i]);
+		else if (arg == "-case" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "-run" && i + 1 < argc)
+			run = argv[++i];
+		else if (arg == "-lzw")
+			lzw = true;
+		else if (arg == "-lzw_tiff" && i + 1 < argc)
+		{
+			lzw = true;
+			lzw_tiff = argv[++i];
+		}
+		else if (arg == "-list")
+		{
+			for (int c = 0; c < bench_case_num; ++c)
+				printf("%s\n", bench_cases[c].name);
+			return 0;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (lzw)
+		return RunLZWBench(300, lzw_tiff) ? 1 : 0;
+
+	if (params.nx < 16 || params.ny < 16 || params.nz < 1 ||
+		params.repeat < 1 || params.brick_size < 16)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	//datasets of different sizes go in different folders
+	if (dir.empty())
+	{
+		char name[64];
+		SPRINTF(name, sizeof(name), "fluorender_bench_%dx%dx%d",
+			params.nx, params.ny, params.nz);
+		dir = (boost::filesystem::temp_directory_path() / name).string();
+	}
+	params.dir = s2ws(dir);
+	if (params.dir.back() != GETSLASH())
+		params.dir.push_back(GETSLASH());
+
+	//a single case in this process
+	if (!run.empty())
+	{
+		for (int c = 0; c < bench_case_num; ++c)
+		{
+			if (run == bench_cases[c].name)
+				return RunCase(params, c);
+		}
+		fprintf(stderr, "unknown case %s\n", run.c_str());
+		return 1;
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::create_directories(params.dir, ec);
+	int failed = 0;
+	for (int c = 0; c < bench_case_num; ++c)
+	{
+		const BenchCase &bc = bench_cases[c];
+		if (!filter.empty() && string(bc.name).find(filter) == string::npos)
+			continue;
+
+		wstring filename = CaseFile(params, c);
+		if (!boost::filesystem::exists(filename))
+		{
+			string file = ws2s(GET_NAME(filename));
+			fprintf(stderr, "generating %s\n", file.c_str());
+			if (!Generate(params, c))
+			{
+				fprintf(stderr, "failed to write %s\n", file.c_str());
+				failed++;
+				continue;
+			}
+		}
+
+		//each case runs in a child process
+		char args[256];
+		SPRINTF(args, sizeof(args), " -run %s -size %d %d %d -repeat %d -brick %d -dir ",
+			bc.name, params.nx, params.ny, params.nz, params.repeat, params.brick_size);
+		string cmd = string("\"") + argv[0] + "\"" + args + "\"" + dir + "\"";
+#ifdef _WIN32
+		//cmd.exe drops the outer quotes
+		cmd = "\"" + cmd + "\"";
+#endif
+		fflush(stdout);
+		if (system(cmd.c_str()) != 0)
+			failed++;
+	}
+
+	return failed ? 1 : 0;
+}